@@ -0,0 +1,152 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::{
+    env,
+    hint,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Time spent running a benchmark before measuring it.
+const WARMUP_TIME: Duration = Duration::from_millis(500);
+
+/// Time spent measuring a benchmark.
+const MEASUREMENT_TIME: Duration = Duration::from_secs(2);
+
+/// Number of samples taken of a benchmark.
+const NUM_SAMPLES: usize = 50;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Benchmark Runner
+///
+/// Runs the benchmarks selected on the command line. When invoked by `cargo bench`, each benchmark is warmed up and
+/// then sampled, and its median time per operation is reported along with the spread of samples. Otherwise (e.g.
+/// `cargo test --benches`), each benchmark runs a single iteration, to check that it works.
+pub struct Runner {
+    /// Take measurements?
+    measure: bool,
+    /// Run only the benchmarks whose name contains one of these.
+    filters: Vec<String>,
+}
+
+/// Benchmark Iteration Driver
+pub struct Bencher {
+    /// Number of iterations to run.
+    iters: u64,
+    /// Time taken by the last run.
+    elapsed: Duration,
+    /// Number of bytes processed by each iteration, if any.
+    pub bytes: u64,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+/// Associate Functions for Benchmark Runners
+impl Runner {
+    /// Creates a benchmark runner from the command line arguments.
+    pub fn from_args() -> Self {
+        let mut measure: bool = false;
+        let mut filters: Vec<String> = Vec::new();
+        for arg in env::args().skip(1) {
+            match arg.as_str() {
+                "--bench" => measure = true,
+                _ if arg.starts_with("-") => (),
+                _ => filters.push(arg),
+            }
+        }
+        Self { measure, filters }
+    }
+
+    /// Runs a benchmark, unless it was filtered out.
+    pub fn bench<F: FnMut(&mut Bencher)>(&self, name: &str, mut f: F) {
+        if !self.filters.is_empty() && !self.filters.iter().any(|filter| name.contains(filter.as_str())) {
+            return;
+        }
+
+        let mut b: Bencher = Bencher {
+            iters: 1,
+            elapsed: Duration::ZERO,
+            bytes: 0,
+        };
+        if !self.measure {
+            f(&mut b);
+            println!("{:<48} ok", name);
+            return;
+        }
+
+        // Warm up, doubling the number of iterations until the warm up time is exhausted, to estimate the time taken
+        // by an iteration.
+        let start: Instant = Instant::now();
+        loop {
+            f(&mut b);
+            if start.elapsed() >= WARMUP_TIME {
+                break;
+            }
+            b.iters = b.iters.saturating_mul(2);
+        }
+        let ns_per_iter: f64 = b.elapsed.as_nanos().max(1) as f64 / b.iters as f64;
+
+        // Take samples of equal length.
+        let sample_time: f64 = MEASUREMENT_TIME.as_nanos() as f64 / NUM_SAMPLES as f64;
+        b.iters = ((sample_time / ns_per_iter) as u64).max(1);
+        let mut samples: Vec<f64> = (0..NUM_SAMPLES)
+            .map(|_| {
+                f(&mut b);
+                b.elapsed.as_nanos() as f64 / b.iters as f64
+            })
+            .collect();
+        samples.sort_by(|a, b| a.total_cmp(b));
+
+        let median: f64 = samples[NUM_SAMPLES / 2];
+        let low: f64 = samples[NUM_SAMPLES / 20];
+        let high: f64 = samples[NUM_SAMPLES - 1 - NUM_SAMPLES / 20];
+        let mut report: String = format!(
+            "{:<48} {:>12.1} ns/op [{:.1} .. {:.1}] {:>14.0} ops/s",
+            name,
+            median,
+            low,
+            high,
+            1e9 / median
+        );
+        if b.bytes > 0 {
+            report.push_str(&format!(" {:>10.1} MB/s", b.bytes as f64 * 1e3 / median));
+        }
+        println!("{}", report);
+    }
+}
+
+/// Associate Functions for Benchmark Iteration Drivers
+impl Bencher {
+    /// Times the given number of iterations of a routine. The value returned by the routine is dropped within the
+    /// measurement.
+    pub fn iter<T, F: FnMut() -> T>(&mut self, mut routine: F) {
+        let start: Instant = Instant::now();
+        for _ in 0..self.iters {
+            hint::black_box(routine());
+        }
+        self.elapsed = start.elapsed();
+    }
+
+    /// Lets a routine time the given number of iterations by itself, for benchmarks that need to exclude some work
+    /// from the measurement or that span several threads.
+    #[allow(unused)]
+    pub fn iter_custom<F: FnMut(u64) -> Duration>(&mut self, mut routine: F) {
+        self.elapsed = routine(self.iters);
+    }
+}
@@ -0,0 +1,214 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+mod common;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::demikernel::{
+    inetstack::protocols::{
+        ip::IpProtocol,
+        ipv4::Ipv4Header,
+        tcp::segment::{
+            tcp_checksum,
+            TcpHeader,
+        },
+    },
+    runtime::{
+        memory::DemiBuffer,
+        timer::{
+            Timer,
+            TimerRc,
+            WaitFuture,
+            DEFAULT_TIMER_GRANULARITY,
+        },
+    },
+    scheduler::{
+        Scheduler,
+        SchedulerFuture,
+        SchedulerHandle,
+    },
+};
+use ::futures::task::noop_waker_ref;
+use ::std::{
+    any::Any,
+    future::Future,
+    net::Ipv4Addr,
+    pin::Pin,
+    rc::Rc,
+    task::{
+        Context,
+        Poll,
+    },
+    time::{
+        Duration,
+        Instant,
+    },
+};
+use common::{
+    Bencher,
+    Runner,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Source address of TCP segments.
+const SRC_IPV4: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 1);
+
+/// Destination address of TCP segments.
+const DST_IPV4: Ipv4Addr = Ipv4Addr::new(192, 168, 1, 2);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A task that never completes. If `busy`, it asks to be polled again each time it is polled, otherwise it is never
+/// woken up.
+struct Task {
+    busy: bool,
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+impl Future for Task {
+    type Output = ();
+
+    fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<()> {
+        if self.busy {
+            ctx.waker().wake_by_ref();
+        }
+        Poll::Pending
+    }
+}
+
+impl SchedulerFuture for Task {
+    fn as_any(self: Box<Self>) -> Box<dyn Any> {
+        self
+    }
+
+    fn get_future(&self) -> &dyn Future<Output = ()> {
+        self
+    }
+}
+
+//======================================================================================================================
+// Benchmarks
+//======================================================================================================================
+
+fn bench_demibuffer_alloc_drop(b: &mut Bencher) {
+    b.iter(|| DemiBuffer::new(1500));
+}
+
+fn bench_demibuffer_clone_drop(b: &mut Bencher) {
+    let buf: DemiBuffer = DemiBuffer::new(1500);
+    b.iter(|| buf.clone());
+}
+
+fn bench_demibuffer_split_drop(b: &mut Bencher) {
+    let buf: DemiBuffer = DemiBuffer::new(1500);
+    b.iter(|| {
+        let mut front: DemiBuffer = buf.clone();
+        let back: DemiBuffer = front.split_off(54).unwrap();
+        (front, back)
+    });
+}
+
+/// Polls a scheduler that holds `idle` tasks which are never woken up, along with a single task that is, if `busy`.
+fn bench_scheduler_poll(b: &mut Bencher, idle: usize, busy: bool) {
+    let scheduler: Scheduler = Scheduler::default();
+    let mut handles: Vec<SchedulerHandle> = (0..idle)
+        .map(|_| scheduler.insert(Task { busy: false }).unwrap())
+        .collect();
+    if busy {
+        handles.push(scheduler.insert(Task { busy: true }).unwrap());
+    }
+    // Tasks are polled once when inserted.
+    scheduler.poll();
+
+    b.iter(|| scheduler.poll());
+}
+
+fn bench_timer_arm_expire(b: &mut Bencher) {
+    let mut ctx: Context = Context::from_waker(noop_waker_ref());
+    let mut now: Instant = Instant::now();
+    let timer: TimerRc = TimerRc(Rc::new(Timer::new(now)));
+
+    // Keep many entries armed in the background, far enough that they never expire.
+    let mut background: Vec<Pin<Box<WaitFuture<TimerRc>>>> = (0..4096)
+        .map(|i| Box::pin(timer.wait(timer.clone(), Duration::from_secs(3600 * 24 * 365 + i))))
+        .collect();
+    for wait_future in background.iter_mut() {
+        assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_pending());
+    }
+
+    b.iter(|| {
+        let mut wait_future: Pin<Box<WaitFuture<TimerRc>>> =
+            Box::pin(timer.wait(timer.clone(), DEFAULT_TIMER_GRANULARITY));
+        assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_pending());
+        now += DEFAULT_TIMER_GRANULARITY;
+        timer.advance_clock(now);
+        assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_ready());
+    });
+}
+
+fn bench_tcp_checksum(b: &mut Bencher, len: usize) {
+    let ipv4_hdr: Ipv4Header = Ipv4Header::new(SRC_IPV4, DST_IPV4, IpProtocol::TCP);
+    let header: [u8; 20] = [0; 20];
+    let data: Vec<u8> = (0..len).map(|i| i as u8).collect();
+    b.bytes = (header.len() + len) as u64;
+    b.iter(|| tcp_checksum(&ipv4_hdr, &header, &data));
+}
+
+/// Returns the header of a pure ACK segment, along with the IPv4 header that carries it.
+fn ack_header() -> (Ipv4Header, TcpHeader) {
+    let ipv4_hdr: Ipv4Header = Ipv4Header::new(SRC_IPV4, DST_IPV4, IpProtocol::TCP);
+    let mut tcp_hdr: TcpHeader = TcpHeader::new(49152, 80);
+    tcp_hdr.ack = true;
+    tcp_hdr.window_size = 0xffff;
+    (ipv4_hdr, tcp_hdr)
+}
+
+fn bench_tcp_header_serialize(b: &mut Bencher) {
+    let (ipv4_hdr, tcp_hdr): (Ipv4Header, TcpHeader) = ack_header();
+    let mut buf: Vec<u8> = vec![0; tcp_hdr.compute_size()];
+    b.iter(|| tcp_hdr.serialize(&mut buf, &ipv4_hdr, &[], false));
+}
+
+fn bench_tcp_header_parse(b: &mut Bencher) {
+    let (ipv4_hdr, tcp_hdr): (Ipv4Header, TcpHeader) = ack_header();
+    let mut segment: DemiBuffer = DemiBuffer::new(tcp_hdr.compute_size() as u16);
+    tcp_hdr.serialize(&mut segment, &ipv4_hdr, &[], false);
+    // Parsing consumes the segment, so the cost of cloning it is included.
+    b.iter(|| TcpHeader::parse(&ipv4_hdr, segment.clone(), false).unwrap());
+}
+
+//======================================================================================================================
+// Main
+//======================================================================================================================
+
+fn main() {
+    let runner: Runner = Runner::from_args();
+    runner.bench("demibuffer/alloc_drop", bench_demibuffer_alloc_drop);
+    runner.bench("demibuffer/clone_drop", bench_demibuffer_clone_drop);
+    runner.bench("demibuffer/split_drop", bench_demibuffer_split_drop);
+    for idle in [0, 1024, 16384] {
+        runner.bench(&format!("scheduler/poll_idle/{}", idle), |b| {
+            bench_scheduler_poll(b, idle, false)
+        });
+        runner.bench(&format!("scheduler/poll_one_ready/{}", idle), |b| {
+            bench_scheduler_poll(b, idle, true)
+        });
+    }
+    runner.bench("timer/arm_expire", bench_timer_arm_expire);
+    for len in [0, 64, 1460, 8960] {
+        runner.bench(&format!("tcp/checksum/{}", len), |b| bench_tcp_checksum(b, len));
+    }
+    runner.bench("tcp/header_serialize", bench_tcp_header_serialize);
+    runner.bench("tcp/header_parse", bench_tcp_header_parse);
+}
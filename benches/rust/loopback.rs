@@ -0,0 +1,191 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+mod common;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::demikernel::{
+    inetstack::test_helpers::{
+        self,
+        Engine,
+    },
+    runtime::{
+        memory::DemiBuffer,
+        QDesc,
+    },
+};
+use ::futures::task::noop_waker_ref;
+use ::std::{
+    future::Future,
+    net::SocketAddrV4,
+    pin::Pin,
+    task::{
+        Context,
+        Poll,
+    },
+    time::{
+        Duration,
+        Instant,
+    },
+};
+use common::{
+    Bencher,
+    Runner,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Port on which the server listens.
+const PORT: u16 = 80;
+
+/// Virtual time that elapses whenever the network goes quiet.
+const IDLE_TICK: Duration = Duration::from_millis(1);
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A TCP connection between two network stacks that are wired back to back, without a NIC.
+struct Connection {
+    now: Instant,
+    client: Engine,
+    server: Engine,
+    client_qd: QDesc,
+    server_qd: QDesc,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+impl Connection {
+    /// Establishes a connection between Alice (the client) and Bob (the server).
+    fn new() -> Self {
+        let now: Instant = Instant::now();
+        let mut client: Engine = test_helpers::new_alice2(now);
+        let mut server: Engine = test_helpers::new_bob2(now);
+        let listen_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, PORT);
+
+        let listen_qd: QDesc = server.tcp_socket().unwrap();
+        server.tcp_bind(listen_qd, listen_addr).unwrap();
+        server.tcp_listen(listen_qd, 1).unwrap();
+        let mut accept_future = server.tcp_accept(listen_qd);
+        let client_qd: QDesc = client.tcp_socket().unwrap();
+        let mut connect_future = client.tcp_connect(client_qd, listen_addr);
+
+        let mut connection: Connection = Self {
+            now,
+            client,
+            server,
+            client_qd,
+            server_qd: listen_qd,
+        };
+        connection.run(&mut connect_future).unwrap();
+        connection.server_qd = connection.run(&mut accept_future).unwrap().0;
+        connection
+    }
+
+    /// Delivers frames between both ends until the network goes quiet. Returns true if some frame was delivered.
+    fn pump(&mut self) -> bool {
+        let mut delivered: bool = false;
+        loop {
+            self.client.rt.poll_scheduler();
+            self.server.rt.poll_scheduler();
+            let mut idle: bool = true;
+            while let Some(frame) = self.client.rt.pop_frame_unchecked() {
+                self.server.receive(frame).unwrap();
+                idle = false;
+            }
+            while let Some(frame) = self.server.rt.pop_frame_unchecked() {
+                self.client.receive(frame).unwrap();
+                idle = false;
+            }
+            if idle {
+                return delivered;
+            }
+            delivered = true;
+        }
+    }
+
+    /// Drives both ends until a future completes. Time only goes by when the network is quiet, so that timers (e.g.
+    /// delayed acknowledgements) fire without stalling the benchmark.
+    fn run<F: Future + Unpin>(&mut self, future: &mut F) -> F::Output {
+        let mut ctx: Context = Context::from_waker(noop_waker_ref());
+        loop {
+            if let Poll::Ready(output) = Future::poll(Pin::new(&mut *future), &mut ctx) {
+                return output;
+            }
+            if !self.pump() {
+                self.now += IDLE_TICK;
+                self.client.clock.advance_clock(self.now);
+                self.server.clock.advance_clock(self.now);
+            }
+        }
+    }
+
+    /// Pushes a buffer from one end and pops it on the other. Returns the number of bytes popped.
+    fn transfer(&mut self, buf: DemiBuffer, to_server: bool) -> usize {
+        let len: usize = buf.len();
+        let mut push_future = if to_server {
+            self.client.tcp_push(self.client_qd, buf)
+        } else {
+            self.server.tcp_push(self.server_qd, buf)
+        };
+        let mut received: usize = 0;
+        while received < len {
+            let mut pop_future = if to_server {
+                self.server.tcp_pop(self.server_qd)
+            } else {
+                self.client.tcp_pop(self.client_qd)
+            };
+            received += self.run(&mut pop_future).unwrap().len();
+        }
+        self.run(&mut push_future).unwrap();
+        received
+    }
+}
+
+//======================================================================================================================
+// Benchmarks
+//======================================================================================================================
+
+/// Request/response rate: each operation is a round trip of a `size`-byte request and a `size`-byte response.
+fn bench_request_response(b: &mut Bencher, size: u16) {
+    let mut connection: Connection = Connection::new();
+    let request: DemiBuffer = DemiBuffer::new(size);
+    let response: DemiBuffer = DemiBuffer::new(size);
+    b.bytes = 2 * size as u64;
+    b.iter(|| {
+        connection.transfer(request.clone(), true);
+        connection.transfer(response.clone(), false)
+    });
+}
+
+/// Bulk throughput: each operation moves a `size`-byte buffer from the client to the server.
+fn bench_bulk(b: &mut Bencher, size: u16) {
+    let mut connection: Connection = Connection::new();
+    let buf: DemiBuffer = DemiBuffer::new(size);
+    b.bytes = size as u64;
+    b.iter(|| connection.transfer(buf.clone(), true));
+}
+
+//======================================================================================================================
+// Main
+//======================================================================================================================
+
+fn main() {
+    let runner: Runner = Runner::from_args();
+    for size in [64, 1024] {
+        runner.bench(&format!("loopback/tcp_request_response/{}", size), |b| {
+            bench_request_response(b, size)
+        });
+    }
+    for size in [1460, 32768] {
+        runner.bench(&format!("loopback/tcp_bulk/{}", size), |b| bench_bulk(b, size));
+    }
+}
@@ -0,0 +1,88 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+mod common;
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::demikernel::collections::{
+    ring::RingBuffer,
+    shared_ring::SharedRingBuffer,
+};
+use ::std::{
+    mem,
+    process,
+    thread,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+use common::{
+    Bencher,
+    Runner,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Capacity of ring buffers.
+const RING_BUFFER_CAPACITY: usize = 4096;
+
+/// Size of the memory region of shared ring buffers, which fits [RING_BUFFER_CAPACITY] items along with the indexes.
+const SHARED_RING_BUFFER_SIZE: usize = 2 * RING_BUFFER_CAPACITY * mem::size_of::<u64>();
+
+//======================================================================================================================
+// Benchmarks
+//======================================================================================================================
+
+/// Enqueues and dequeues an item on the same thread.
+fn bench_ring_enqueue_dequeue(b: &mut Bencher) {
+    let ring: RingBuffer<u64> = RingBuffer::new(RING_BUFFER_CAPACITY).unwrap();
+    b.iter(|| {
+        ring.enqueue(1);
+        ring.dequeue()
+    });
+}
+
+/// Moves items from a producer thread to a consumer thread, which dequeues them as they come.
+fn spsc(iters: u64, producer: &RingBuffer<u64>, consumer: &RingBuffer<u64>) -> Duration {
+    thread::scope(|s| {
+        let start: Instant = Instant::now();
+        s.spawn(|| {
+            for i in 0..iters {
+                producer.enqueue(i);
+            }
+        });
+        for i in 0..iters {
+            assert_eq!(consumer.dequeue(), i);
+        }
+        start.elapsed()
+    })
+}
+
+fn bench_ring_spsc(b: &mut Bencher) {
+    let ring: RingBuffer<u64> = RingBuffer::new(RING_BUFFER_CAPACITY).unwrap();
+    b.iter_custom(|iters| spsc(iters, &ring, &ring));
+}
+
+fn bench_shared_ring_spsc(b: &mut Bencher) {
+    let name: String = format!("demikernel-bench-ring-{}", process::id());
+    let producer: SharedRingBuffer<u64> = SharedRingBuffer::create(&name, SHARED_RING_BUFFER_SIZE).unwrap();
+    let consumer: SharedRingBuffer<u64> = SharedRingBuffer::open(&name, SHARED_RING_BUFFER_SIZE).unwrap();
+    b.iter_custom(|iters| spsc(iters, &producer, &consumer));
+}
+
+//======================================================================================================================
+// Main
+//======================================================================================================================
+
+fn main() {
+    let runner: Runner = Runner::from_args();
+    runner.bench("ring/enqueue_dequeue", bench_ring_enqueue_dequeue);
+    runner.bench("ring/spsc", bench_ring_spsc);
+    runner.bench("shared_ring/spsc", bench_shared_ring_spsc);
+}
@@ -150,6 +150,65 @@ extern "C"
      */
     extern int demi_pop(demi_qtoken_t *qt_out, int qd);
 
+    /**
+     * @brief Asynchronously pushes a batch of scatter-gather arrays to I/O queues.
+     *
+     * @details Operations are issued in order, and issuing stops at the first one that fails. Queue tokens of the
+     * operations that were issued are stored in @p qts_out. The error of the failed operation is only returned if no
+     * operation was issued at all, so callers learn about it by issuing the remaining operations again.
+     *
+     * @param qts_out Store location for the I/O queue tokens of up to @p n operations.
+     * @param qds     Target I/O queue descriptors, one per operation.
+     * @param sgas    Scatter-gather arrays to push, one per operation.
+     * @param n       Number of operations in the batch.
+     * @param nr_out  Store location for the number of operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_push_batch(demi_qtoken_t qts_out[], const int qds[], const demi_sgarray_t sgas[], int n,
+                               int *nr_out);
+
+    /**
+     * @brief Asynchronously pops scatter-gather arrays from a batch of I/O queues.
+     *
+     * @details Operations are issued in order, and issuing stops at the first one that fails. Queue tokens of the
+     * operations that were issued are stored in @p qts_out. The error of the failed operation is only returned if no
+     * operation was issued at all, so callers learn about it by issuing the remaining operations again.
+     *
+     * @param qts_out Store location for the I/O queue tokens of up to @p n operations.
+     * @param qds     Target I/O queue descriptors, one per operation.
+     * @param n       Number of operations in the batch.
+     * @param nr_out  Store location for the number of operations that were issued.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_pop_batch(demi_qtoken_t qts_out[], const int qds[], int n, int *nr_out);
+
+    /**
+     * @brief Reads the statistics of all threads, added up. This may be called from any thread, at any time.
+     *
+     * @param stats_out Store location for the statistics.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_get_stats(demi_stats_t *stats_out);
+
+    /**
+     * @brief Sets an option on a socket I/O queue.
+     *
+     * @details Supported options are TCP_NODELAY and, on Linux, TCP_CORK at level IPPROTO_TCP, both of which take an
+     * int. Nagle's algorithm is disabled by default, as if TCP_NODELAY had been set.
+     *
+     * @param qd      Target I/O queue descriptor.
+     * @param level   Protocol level at which the option resides.
+     * @param optname Name of the option.
+     * @param optval  Value of the option.
+     * @param optlen  Size of the option value.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_setsockopt(int qd, int level, int optname, const void *optval, socklen_t optlen);
+
 #ifdef __cplusplus
 }
 #endif
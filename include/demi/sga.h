@@ -22,6 +22,22 @@ extern "C"
      */
     extern demi_sgarray_t demi_sgaalloc(size_t size);
 
+    /**
+     * @brief Allocates a scatter-gather array for an I/O queue.
+     *
+     * @details On memory queues, the scatter-gather array lives in memory that is shared with the other end of the
+     * queue, and pushing it to that queue hands over this memory instead of copying it. This memory is set up on the
+     * first call, and then only the calling end of the queue may allocate from it. On other queues, this is the same as
+     * demi_sgaalloc().
+     *
+     * @param qd   Target I/O queue.
+     * @param size Size of the scatter-gather array.
+     *
+     * @return On successful completion, the allocated scatter-gather array is returned. On error, a null scatter-gather
+     * array is returned instead.
+     */
+    extern demi_sgarray_t demi_sgaalloc_qd(int qd, size_t size);
+
     /**
      * @brief Releases a scatter-gather array.
      *
@@ -24,7 +24,7 @@ extern "C"
 /**
  * @brief Maximum number of segments in a scatter-gather array.
  */
-#define DEMI_SGARRAY_MAXSIZE 1
+#define DEMI_SGARRAY_MAXSIZE 16
 
     /**
      * @brief An I/O queue token.
@@ -94,6 +94,38 @@ extern "C"
         } qr_value;
     } demi_qresult_t;
 
+    /**
+     * @brief Summary of a histogram. Percentiles are accurate to within 1/16 of their value.
+     */
+    typedef struct demi_histogram
+    {
+        uint64_t count; /**< Number of values recorded. */
+        uint64_t sum;   /**< Sum of values recorded.    */
+        uint64_t min;   /**< Smallest value recorded.   */
+        uint64_t max;   /**< Largest value recorded.    */
+        uint64_t p50;   /**< 50th percentile.           */
+        uint64_t p90;   /**< 90th percentile.           */
+        uint64_t p99;   /**< 99th percentile.           */
+        uint64_t p999;  /**< 99.9th percentile.         */
+    } demi_histogram_t;
+
+    /**
+     * @brief Statistics.
+     */
+    typedef struct demi_stats
+    {
+        demi_histogram_t push_latency_ns;     /**< Latency of push operations, from issue to wait (in ns).    */
+        demi_histogram_t pop_latency_ns;      /**< Latency of pop operations, from issue to wait (in ns).     */
+        demi_histogram_t accept_latency_ns;   /**< Latency of accept operations, from issue to wait (in ns).  */
+        demi_histogram_t connect_latency_ns;  /**< Latency of connect operations, from issue to wait (in ns). */
+        demi_histogram_t rx_burst_size;       /**< Packets per non-empty receive burst.                       */
+        demi_histogram_t tx_burst_size;       /**< Packets per transmit burst.                                */
+        demi_histogram_t tcp_ooo_queue_depth; /**< Segments in a TCP out-of-order queue, on each insertion.   */
+        uint64_t tcp_retransmits;             /**< TCP segments retransmitted.                                */
+        uint64_t heap_pool_misses;            /**< Allocations that missed the free list of a heap pool.      */
+        uint64_t mbuf_chunk_misses;           /**< Mbuf allocations that missed the last DPDK pool chunk.     */
+    } demi_stats_t;
+
 #ifdef __cplusplus
 }
 #endif
@@ -47,6 +47,22 @@ extern "C"
      */
     extern int demi_wait_any(demi_qresult_t *qr_out, int *ready_offset, const demi_qtoken_t qts[], int num_qts, const struct timespec *timeout);
 
+    /**
+     * @brief Waits for the next asynchronous I/O operations to complete.
+     *
+     * @details Results are reported in order of completion, regardless of the order in which operations were issued.
+     * This call only visits operations that have completed, so its cost does not depend on the number of pending
+     * operations. Results that cannot be extracted are skipped, and an error is only returned if no result was stored.
+     *
+     * @param qr_out  Store location for the results of up to @p n completed I/O operations.
+     * @param n       Maximum number of results to store in @p qr_out.
+     * @param nr_out  Store location for the number of results stored in @p qr_out.
+     * @param timeout Timeout interval in seconds and nanoseconds.
+     *
+     * @return On successful completion, zero is returned. On failure, a positive error code is returned instead.
+     */
+    extern int demi_wait_next_n(demi_qresult_t qr_out[], int n, int *nr_out, const struct timespec *timeout);
+
 #ifdef __cplusplus
 }
 #endif
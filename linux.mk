@@ -209,3 +209,7 @@ test-unit-rust:
 	$(CARGO) test --test sga $(BUILD) $(CARGO_FEATURES) -- --nocapture --test-threads=1 test_unit_sga_alloc_free_single_big
 	$(CARGO) test --test sga $(BUILD) $(CARGO_FEATURES) -- --nocapture --test-threads=1 test_unit_sga_alloc_free_loop_tight_big
 	$(CARGO) test --test sga $(BUILD) $(CARGO_FEATURES) -- --nocapture --test-threads=1 test_unit_sga_alloc_free_loop_decoupled_big
+
+# Runs benchmarks (these do not depend on the target LibOS).
+test-bench:
+	$(CARGO) bench --features=catmem-libos,test-helpers $(FEATURES) -- $(BENCH)
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::demikernel::config::Config;
+use ::std::time::Duration;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Default time after which the kernel thread that polls the submission queue goes to sleep (in milliseconds).
+const DEFAULT_SQPOLL_IDLE_MS: u64 = 1000;
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Catcollar associated functions for Demikernel configuration object.
+impl Config {
+    /// Reads the "SQPOLL" parameters from the underlying configuration file. If the kernel polls the submission queue,
+    /// this returns the time after which the polling thread goes to sleep.
+    pub fn io_uring_sqpoll_idle(&self) -> Option<Duration> {
+        // FIXME: this function should return a Result.
+        match self.0["catcollar"]["sqpoll"].as_bool() {
+            Some(true) => match self.0["catcollar"]["sqpoll_idle_ms"].as_i64() {
+                Some(idle) if idle > 0 => Some(Duration::from_millis(idle as u64)),
+                Some(idle) => panic!("invalid sqpoll idle time ({:?})", idle),
+                None => Some(Duration::from_millis(DEFAULT_SQPOLL_IDLE_MS)),
+            },
+            Some(false) | None => None,
+        }
+    }
+}
@@ -6,10 +6,7 @@
 //==============================================================================
 
 use crate::{
-    catcollar::{
-        runtime::RequestId,
-        IoUringRuntime,
-    },
+    catcollar::IoUringRuntime,
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
@@ -39,8 +36,6 @@ pub struct PopFuture {
     qd: QDesc,
     /// Associated file descriptor.
     fd: RawFd,
-    /// Associated receive buffer.
-    buf: DemiBuffer,
 }
 
 //==============================================================================
@@ -50,8 +45,8 @@ pub struct PopFuture {
 /// Associate Functions for Pop Operation Descriptors
 impl PopFuture {
     /// Creates a descriptor for a pop operation.
-    pub fn new(rt: IoUringRuntime, qd: QDesc, fd: RawFd, buf: DemiBuffer) -> Self {
-        Self { rt, qd, fd, buf }
+    pub fn new(rt: IoUringRuntime, qd: QDesc, fd: RawFd) -> Self {
+        Self { rt, qd, fd }
     }
 
     /// Returns the queue descriptor associated to the target pop operation descriptor.
@@ -71,38 +66,20 @@ impl Future for PopFuture {
     /// Polls the underlying pop operation.
     fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<Self::Output> {
         let self_: &mut PopFuture = self.get_mut();
-        let request_id: RequestId = self_.rt.pop(self_.fd, self_.buf.clone())?;
-        match self_.rt.peek(request_id) {
+        // Data is received with a multishot receive, so there is no request to issue per pop.
+        match self_.rt.pop(self_.fd, ctx.waker()) {
             // Operation completed.
-            Ok((addr, size)) if size >= 0 => {
-                trace!("data received ({:?} bytes)", size);
-                let trim_size: usize = self_.buf.len() - (size as usize);
-                let mut buf: DemiBuffer = self_.buf.clone();
-                buf.trim(trim_size)?;
-                Poll::Ready(Ok((addr, buf)))
-            },
-            // Operation not completed, thus parse errno to find out what happened.
-            Ok((None, size)) if size < 0 => {
-                let errno: i32 = -size;
-                // Operation in progress.
-                if errno == libc::EWOULDBLOCK || errno == libc::EAGAIN {
-                    ctx.waker().wake_by_ref();
-                    return Poll::Pending;
-                }
-                // Operation failed.
-                else {
-                    let message: String = format!("pus(): operation failed (errno={:?})", errno);
-                    error!("{}", message);
-                    return Poll::Ready(Err(Fail::new(errno, &message)));
-                }
+            Ok(Some(buf)) => {
+                trace!("data received ({:?} bytes)", buf.len());
+                Poll::Ready(Ok((None, buf)))
             },
+            // Operation in progress. The runtime wakes us up once data arrives.
+            Ok(None) => Poll::Pending,
             // Operation failed.
             Err(e) => {
                 warn!("pop failed ({:?})", e);
                 Poll::Ready(Err(e))
             },
-            // Should not happen.
-            _ => panic!("pop failed: unknown error"),
         }
     }
 }
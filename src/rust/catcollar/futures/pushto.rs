@@ -43,6 +43,8 @@ pub struct PushtoFuture {
     addr: SocketAddrV4,
     /// Associated receive buffer.
     buf: DemiBuffer,
+    /// Request in the I/O user ring, once it is prepared.
+    request_id: Option<RequestId>,
 }
 
 //==============================================================================
@@ -53,7 +55,14 @@ pub struct PushtoFuture {
 impl PushtoFuture {
     /// Creates a descriptor for a pushto operation.
     pub fn new(rt: IoUringRuntime, qd: QDesc, fd: RawFd, addr: SocketAddrV4, buf: DemiBuffer) -> Self {
-        Self { rt, qd, fd, addr, buf }
+        Self {
+            rt,
+            qd,
+            fd,
+            addr,
+            buf,
+            request_id: None,
+        }
     }
 
     /// Returns the queue descriptor associated to the target push operation descriptor.
@@ -73,36 +82,59 @@ impl Future for PushtoFuture {
     /// Polls the target [PushtoFuture].
     fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<Self::Output> {
         let self_: &mut PushtoFuture = self.get_mut();
-        let request_id: RequestId = self_.rt.pushto(self_.fd, self_.addr, self_.buf.clone())?;
+        // Prepare the request once. It is submitted along with others, when the runtime is polled.
+        let request_id: RequestId = match self_.request_id {
+            Some(request_id) => request_id,
+            None => match self_.rt.pushto(self_.fd, self_.addr, self_.buf.clone()) {
+                Ok(request_id) => *self_.request_id.insert(request_id),
+                // The submission queue is full, try again later.
+                Err(e) if e.errno == libc::EAGAIN => {
+                    ctx.waker().wake_by_ref();
+                    return Poll::Pending;
+                },
+                Err(e) => {
+                    warn!("pushto failed ({:?})", e);
+                    return Poll::Ready(Err(e));
+                },
+            },
+        };
 
-        match self_.rt.peek(request_id) {
+        match self_.rt.peek(request_id, ctx.waker()) {
             // Operation completed.
-            Ok((_, size)) if size >= 0 => {
+            Some(size) if size >= 0 => {
                 trace!("data pushed ({:?} bytes)", size);
+                self_.request_id = None;
                 Poll::Ready(Ok(()))
             },
             // Operation not completed, thus parse errno to find out what happened.
-            Ok((None, size)) if size < 0 => {
+            Some(size) => {
                 let errno: i32 = -size;
-                // Operation in progress.
+                // Operation in progress, so issue it again.
                 if errno == libc::EWOULDBLOCK || errno == libc::EAGAIN {
+                    self_.request_id = None;
                     ctx.waker().wake_by_ref();
                     return Poll::Pending;
                 }
                 // Operation failed.
                 else {
+                    self_.request_id = None;
                     let message: String = format!("pushto(): operation failed (errno={:?})", errno);
                     error!("{}", message);
                     return Poll::Ready(Err(Fail::new(errno, &message)));
                 }
             },
-            // Operation failed.
-            Err(e) => {
-                warn!("push failed ({:?})", e);
-                Poll::Ready(Err(e))
-            },
-            // Should not happen.
-            _ => panic!("push failed: unknown error"),
+            // Operation in flight. The runtime wakes us up once it completes.
+            None => Poll::Pending,
+        }
+    }
+}
+
+/// Drop Trait Implementation for Pushto Operation Descriptors
+impl Drop for PushtoFuture {
+    fn drop(&mut self) {
+        // Forget about the result of a request that is still in flight, as no one is going to take it.
+        if let Some(request_id) = self.request_id.take() {
+            self.rt.abandon(request_id);
         }
     }
 }
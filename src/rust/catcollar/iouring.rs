@@ -13,33 +13,161 @@ use crate::{
         memory::DemiBuffer,
     },
 };
-use ::libc::socklen_t;
 use ::std::{
+    collections::{
+        BTreeMap,
+        HashMap,
+        VecDeque,
+    },
     ffi::{
         c_void,
-        CString,
+        CStr,
     },
     mem,
     mem::MaybeUninit,
-    net::SocketAddrV4,
+    net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    },
     os::{
-        raw::c_int,
+        raw::{
+            c_int,
+            c_uint,
+        },
         unix::prelude::RawFd,
     },
     ptr::{
         self,
         null_mut,
     },
+    task::Waker,
+    time::Duration,
 };
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+// Flags of the io_uring ABI (see include/uapi/linux/io_uring.h). These are defined with shifts of enumerators, so the
+// bindings do not export them.
+const IORING_SETUP_SQPOLL: u32 = 1 << 1;
+const IOSQE_BUFFER_SELECT: c_uint = 1 << 5;
+const IORING_CQE_F_BUFFER: u32 = 1 << 0;
+const IORING_CQE_F_MORE: u32 = 1 << 1;
+const IORING_CQE_F_NOTIF: u32 = 1 << 3;
+const IORING_CQE_BUFFER_SHIFT: u32 = 16;
+const IORING_OP_SEND_ZC: c_int = 47;
+
+/// Identifier of the group of provided buffers that receives select from. Preparing an SQE clears its buffer group,
+/// so using group zero saves us from setting it on each receive.
+const BUFFER_GROUP_ID: c_int = 0;
+
+/// Maximum number of completions that are reaped at once.
+const REAP_BATCH_SIZE: usize = 64;
+
 //==============================================================================
 // Structures
 //==============================================================================
 
+/// Request ID
+#[derive(Clone, Copy, Hash, Debug, Eq, PartialEq)]
+pub struct RequestId(pub u64);
+
+/// Send Request
+///
+/// The kernel reads the message header, the I/O vector and the destination address only after the request is
+/// submitted, so they live on the heap until the request completes. So does the buffer that holds the data.
+struct SendRequest {
+    msg: liburing::msghdr,
+    iovecs: Vec<liburing::iovec>,
+    addr: libc::sockaddr_in,
+    _buf: DemiBuffer,
+    /// Whether the push that issued the request was dropped, in which case its result is not kept.
+    abandoned: bool,
+}
+
+/// Multishot Receive
+///
+/// A single receive request stays armed on a socket and completes once for every chunk of data that arrives, each
+/// time placing the data in a buffer of the provided-buffer ring.
+struct Receiver {
+    /// Receive request that is currently armed on the socket, if any.
+    armed: Option<RequestId>,
+    /// Data received but not yet popped, or what ended a receive.
+    queue: VecDeque<Received>,
+    /// Pop operation waiting for data, if any.
+    waker: Option<Waker>,
+}
+
+/// Outcome of a receive, in the queue of a [Receiver].
+enum Received {
+    /// Data, in a buffer taken from the provided-buffer ring.
+    Data(DemiBuffer),
+    /// End of the stream.
+    End,
+    /// Error that ended the receive.
+    Error(i32),
+}
+
+/// Provided-Buffer Ring
+///
+/// Buffers that the kernel picks from when data arrives on a socket with a multishot receive. The buffer that holds
+/// the data is handed as is to the application, and its slot is refilled only once the application pops it. This
+/// bounds the amount of received data that the ring holds on to.
+struct BufferRing {
+    /// Underlying ring shared with the kernel.
+    ring: *mut liburing::io_uring_buf_ring,
+    /// Number of slots in the ring.
+    nentries: u32,
+    /// Buffers in the ring, indexed by buffer ID.
+    buffers: Vec<Option<DemiBuffer>>,
+    /// Size of each buffer.
+    buffer_size: u16,
+    /// IDs of buffers that the kernel consumed and that are waiting to be refilled.
+    empty: Vec<u16>,
+    /// Number of buffers added to the ring but not yet made visible to the kernel.
+    unpublished: c_int,
+}
+
+/// Registered Buffer Pool
+///
+/// Buffers registered with the kernel as fixed buffers, from which large scatter-gather arrays are allocated. The
+/// kernel sends data straight out of these buffers, without pinning or copying it. The pool keeps a reference to each
+/// buffer, and reuses a buffer once that is the only reference left: the application released its scatter-gather array
+/// and no zero-copy send holds on to it anymore.
+struct BufferPool {
+    /// Registered buffers, indexed by fixed buffer index.
+    buffers: Vec<DemiBuffer>,
+    /// Fixed buffer indexes, by start address of the data of buffers.
+    addresses: BTreeMap<usize, u16>,
+    /// Size of each buffer.
+    buffer_size: u16,
+    /// Next buffer to consider for allocation.
+    next: usize,
+}
+
 /// IO User Ring
 pub struct IoUring {
     /// Underlying io_uring.
     io_uring: liburing::io_uring,
+    /// Buffers provided for multishot receives.
+    buffer_ring: BufferRing,
+    /// Buffers registered for zero-copy sends, if the kernel supports them.
+    buffer_pool: Option<BufferPool>,
+    /// Next request ID.
+    next_request_id: u64,
+    /// Number of submission queue entries prepared since the last submission.
+    unsubmitted: u32,
+    /// In-flight send requests.
+    sends: HashMap<RequestId, Box<SendRequest>>,
+    /// Results of completed send requests.
+    completed: HashMap<RequestId, i32>,
+    /// Push operations waiting for their send requests to complete.
+    wakers: HashMap<RequestId, Waker>,
+    /// Multishot receives, indexed by socket.
+    receivers: HashMap<RawFd, Receiver>,
+    /// Sockets of armed multishot receive requests.
+    receive_requests: HashMap<RequestId, RawFd>,
 }
 
 //==============================================================================
@@ -47,176 +175,530 @@ pub struct IoUring {
 //==============================================================================
 
 impl IoUring {
-    /// Instantiates an IO user ring.
-    pub fn new(nentries: u32) -> Result<Self, Fail> {
+    /// Instantiates an IO user ring with `nentries` submission queue entries and `nbuffers` receive buffers of
+    /// `buffer_size` bytes. If `sqpoll_idle` is set, a kernel thread polls the submission queue and goes to sleep
+    /// after being idle for that long.
+    pub fn new(nentries: u32, nbuffers: u32, buffer_size: u16, sqpoll_idle: Option<Duration>) -> Result<Self, Fail> {
+        if !nbuffers.is_power_of_two() || nbuffers > u16::MAX as u32 {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "number of receive buffers should be a power of two",
+            ));
+        }
+
         unsafe {
             let mut params: MaybeUninit<liburing::io_uring_params> = MaybeUninit::zeroed();
+            if let Some(idle) = sqpoll_idle {
+                (*params.as_mut_ptr()).flags |= IORING_SETUP_SQPOLL;
+                (*params.as_mut_ptr()).sq_thread_idle = idle.as_millis() as u32;
+            }
             let mut io_uring: MaybeUninit<liburing::io_uring> = MaybeUninit::zeroed();
             let ret: c_int = liburing::io_uring_queue_init_params(nentries, io_uring.as_mut_ptr(), params.as_mut_ptr());
             // Failed to initialize io_uring structure.
             if ret < 0 {
-                let errno: i32 = -ret;
-                let strerror: CString = CString::from_raw(libc::strerror(errno));
-                let cause: &str = strerror.to_str().unwrap_or("failed to initialize io_uring");
-                return Err(Fail::new(errno, cause));
+                return Err(Self::fail(-ret, "failed to initialize io_uring"));
             }
+            let mut io_uring: liburing::io_uring = io_uring.assume_init();
+
+            // Register provided-buffer ring.
+            let mut ret: c_int = 0;
+            let ring: *mut liburing::io_uring_buf_ring =
+                liburing::io_uring_setup_buf_ring(&mut io_uring, nbuffers, BUFFER_GROUP_ID, 0, &mut ret);
+            if ring.is_null() {
+                liburing::io_uring_queue_exit(&mut io_uring);
+                return Err(Self::fail(-ret, "failed to register buffer ring"));
+            }
+            let mut buffer_ring: BufferRing = BufferRing {
+                ring,
+                nentries: nbuffers,
+                buffers: (0..nbuffers).map(|_| None).collect(),
+                buffer_size,
+                empty: (0..nbuffers as u16).rev().collect(),
+                unpublished: 0,
+            };
+            for _ in 0..nbuffers {
+                buffer_ring.refill();
+            }
+            buffer_ring.publish();
 
             Ok(Self {
-                io_uring: io_uring.assume_init(),
+                io_uring,
+                buffer_ring,
+                buffer_pool: None,
+                next_request_id: 0,
+                unsubmitted: 0,
+                sends: HashMap::new(),
+                completed: HashMap::new(),
+                wakers: HashMap::new(),
+                receivers: HashMap::new(),
+                receive_requests: HashMap::new(),
             })
         }
     }
 
-    /// Pushes a buffer to the target IO user ring.
-    pub fn push(&mut self, sockfd: RawFd, buf: DemiBuffer) -> Result<*mut liburing::msghdr, Fail> {
-        let len: usize = buf.len();
-        let data_ptr: *const u8 = buf.as_ptr();
-        let io_uring: &mut liburing::io_uring = &mut self.io_uring;
+    /// Registers `nbuffers` buffers of `buffer_size` bytes, for zero-copy sends.
+    pub fn register_buffers(&mut self, nbuffers: u16, buffer_size: u16) -> Result<(), Fail> {
+        // Safety: the probe is released right after we check it.
+        let send_zc_supported: bool = unsafe {
+            let probe: *mut liburing::io_uring_probe = liburing::io_uring_get_probe_ring(&mut self.io_uring);
+            if probe.is_null() {
+                return Err(Fail::new(libc::ENOTSUP, "cannot probe io_uring operations"));
+            }
+            let supported: c_int = liburing::io_uring_opcode_supported(probe, IORING_OP_SEND_ZC);
+            liburing::io_uring_free_probe(probe);
+            supported != 0
+        };
+        if !send_zc_supported {
+            return Err(Fail::new(libc::ENOTSUP, "zero-copy send is not supported"));
+        }
+
+        let buffers: Vec<DemiBuffer> = (0..nbuffers).map(|_| DemiBuffer::new(buffer_size)).collect();
+        let iovecs: Vec<liburing::iovec> = buffers
+            .iter()
+            .map(|buf| liburing::iovec {
+                iov_base: buf.as_ptr() as *mut c_void,
+                iov_len: buf.len() as u64,
+            })
+            .collect();
+        // Safety: the buffers stay alive, and at the same place, as long as the io_uring.
+        let ret: c_int =
+            unsafe { liburing::io_uring_register_buffers(&mut self.io_uring, iovecs.as_ptr(), nbuffers as c_uint) };
+        if ret < 0 {
+            return Err(Self::fail(-ret, "failed to register buffers"));
+        }
+
+        let addresses: BTreeMap<usize, u16> = buffers
+            .iter()
+            .enumerate()
+            .map(|(index, buf)| (buf.as_ptr().addr(), index as u16))
+            .collect();
+        self.buffer_pool = Some(BufferPool {
+            buffers,
+            addresses,
+            buffer_size,
+            next: 0,
+        });
+        Ok(())
+    }
+
+    /// Allocates a buffer of `size` bytes out of the registered buffers, if one is free.
+    pub fn alloc_registered(&mut self, size: usize) -> Option<DemiBuffer> {
+        self.buffer_pool.as_mut()?.alloc(size)
+    }
+
+    /// Prepares the push of a buffer to the target IO user ring. The request is submitted on the next call to
+    /// [IoUring::submit]. Single-segment buffers that were allocated out of the registered buffers are sent with zero
+    /// copy.
+    pub fn push(&mut self, sockfd: RawFd, buf: DemiBuffer) -> Result<RequestId, Fail> {
+        let buf_index: Option<u16> = match self.buffer_pool {
+            Some(ref pool) if buf.nb_segs() == 1 => pool.lookup(&buf),
+            _ => None,
+        };
+        match buf_index {
+            Some(buf_index) => self.prepare_send_zc(sockfd, buf, buf_index),
+            None => self.prepare_send(sockfd, None, buf),
+        }
+    }
+
+    /// Prepares the push of a buffer to the target IO user ring. The request is submitted on the next call to
+    /// [IoUring::submit].
+    pub fn pushto(&mut self, sockfd: RawFd, addr: SocketAddrV4, buf: DemiBuffer) -> Result<RequestId, Fail> {
+        self.prepare_send(sockfd, Some(addr), buf)
+    }
+
+    /// Pops data received on a socket. If none is available, this arms a multishot receive on the socket, unless it is
+    /// armed already, and `waker` is woken once some data arrives.
+    pub fn pop(&mut self, sockfd: RawFd, waker: &Waker) -> Result<Option<DemiBuffer>, Fail> {
+        let receiver: &mut Receiver = self.receivers.entry(sockfd).or_insert_with(|| Receiver {
+            armed: None,
+            queue: VecDeque::new(),
+            waker: None,
+        });
+        match receiver.queue.pop_front() {
+            Some(Received::Data(buf)) => {
+                // Give the ring a new buffer in place of the one we hand out.
+                self.buffer_ring.refill();
+                Ok(Some(buf))
+            },
+            Some(Received::End) => Ok(Some(DemiBuffer::new(0))),
+            Some(Received::Error(errno)) => {
+                let cause: String = format!("pop(): operation failed (errno={:?})", errno);
+                error!("{}", cause);
+                Err(Fail::new(errno, &cause))
+            },
+            None => {
+                receiver.waker = Some(waker.clone());
+                if receiver.armed.is_none() {
+                    let request_id: RequestId = self.prepare_receive(sockfd)?;
+                    self.receivers.get_mut(&sockfd).expect("receiver should exist").armed = Some(request_id);
+                }
+                Ok(None)
+            },
+        }
+    }
+
+    /// Takes the result of a completed push, if it is done. Otherwise, `waker` is woken once it is.
+    pub fn take_completion(&mut self, request_id: RequestId, waker: &Waker) -> Option<i32> {
+        let result: Option<i32> = self.completed.remove(&request_id);
+        if result.is_none() {
+            self.wakers.insert(request_id, waker.clone());
+        }
+        result
+    }
+
+    /// Forgets about the result of a push that is no longer waited for. The request itself stays in flight until the
+    /// kernel is done with its buffer.
+    pub fn abandon(&mut self, request_id: RequestId) {
+        self.completed.remove(&request_id);
+        self.wakers.remove(&request_id);
+        if let Some(request) = self.sends.get_mut(&request_id) {
+            request.abandoned = true;
+        }
+    }
+
+    /// Stops receiving on a socket, that is about to be closed. Data that was received but not popped is dropped.
+    pub fn forget(&mut self, sockfd: RawFd) -> Result<(), Fail> {
+        if let Some(receiver) = self.receivers.remove(&sockfd) {
+            // Give the ring new buffers in place of those that are dropped.
+            for received in &receiver.queue {
+                if let Received::Data(_) = received {
+                    self.buffer_ring.refill();
+                }
+            }
+            // A pending pop runs again, and fails on the closed socket.
+            if let Some(waker) = receiver.waker {
+                waker.wake();
+            }
+            if let Some(request_id) = receiver.armed {
+                // Completions of the cancelled request are dropped when they are reaped.
+                self.receive_requests.remove(&request_id);
+                let sqe: *mut liburing::io_uring_sqe = self.get_sqe()?;
+                unsafe {
+                    liburing::io_uring_prep_cancel_fd(sqe, sockfd, 0);
+                    liburing::io_uring_sqe_set_data(sqe, self.new_request_id().0 as *mut c_void);
+                }
+            }
+        }
+        Ok(())
+    }
+
+    /// Submits all prepared requests at once, and makes refilled receive buffers visible to the kernel.
+    pub fn submit(&mut self) -> Result<(), Fail> {
+        self.buffer_ring.publish();
+        if self.unsubmitted == 0 {
+            return Ok(());
+        }
+        let ret: c_int = unsafe { liburing::io_uring_submit(&mut self.io_uring) };
+        if ret < 0 {
+            let errno: c_int = -ret;
+            // The kernel is short of resources or the completion queue is full, so try again later.
+            if errno == libc::EAGAIN || errno == libc::EBUSY {
+                return Ok(());
+            }
+            return Err(Self::fail(errno, "failed to submit requests"));
+        }
+        self.unsubmitted = 0;
+        Ok(())
+    }
+
+    /// Blocks until some completion is available or `timeout` expires. Completions are left in the completion queue,
+    /// for [IoUring::reap] to handle.
+    pub fn wait(&mut self, timeout: Option<Duration>) {
+        // Requests that could not be submitted yet would never complete.
+        if self.unsubmitted > 0 {
+            return;
+        }
+        let mut cqe: *mut liburing::io_uring_cqe = null_mut();
+        let mut ts: Option<liburing::__kernel_timespec> = timeout.map(|timeout| liburing::__kernel_timespec {
+            tv_sec: timeout.as_secs() as i64,
+            tv_nsec: timeout.subsec_nanos() as _,
+        });
+        let ts_ptr: *mut liburing::__kernel_timespec = match ts {
+            Some(ref mut ts) => ts,
+            None => null_mut(),
+        };
+        // Safety: the timeout outlives the call, and the completion is only peeked at.
+        let ret: c_int = unsafe { liburing::io_uring_wait_cqe_timeout(&mut self.io_uring, &mut cqe, ts_ptr) };
+        if ret < 0 && -ret != libc::ETIME && -ret != libc::EINTR {
+            warn!("failed to wait for completions (errno={:?})", -ret);
+        }
+    }
+
+    /// Reaps all available completions, without blocking. Returns the number of completions.
+    pub fn reap(&mut self) -> usize {
+        let mut cqes: [*mut liburing::io_uring_cqe; REAP_BATCH_SIZE] = [null_mut(); REAP_BATCH_SIZE];
+        let mut reaped: usize = 0;
+        loop {
+            let count: c_uint = unsafe {
+                liburing::io_uring_peek_batch_cqe(&mut self.io_uring, cqes.as_mut_ptr(), REAP_BATCH_SIZE as c_uint)
+            };
+            for cqe in &cqes[..count as usize] {
+                // Safety: the kernel does not touch the completion until we advance the completion queue.
+                let (user_data, res, flags): (u64, i32, u32) =
+                    unsafe { ((**cqe).user_data, (**cqe).res, (**cqe).flags) };
+                self.complete(RequestId(user_data), res, flags);
+            }
+            unsafe { liburing::io_uring_cq_advance(&mut self.io_uring, count) };
+            reaped += count as usize;
+            if (count as usize) < REAP_BATCH_SIZE {
+                break;
+            }
+        }
+        reaped
+    }
+
+    /// Handles a completion.
+    fn complete(&mut self, request_id: RequestId, res: i32, flags: u32) {
+        // Send requests. Zero-copy sends complete twice: once with their result, and once more with a notification
+        // when the kernel is done with the buffer. Only then the buffer is released.
+        if let Some(request) = self.sends.get(&request_id) {
+            if flags & IORING_CQE_F_NOTIF == 0 && !request.abandoned {
+                self.completed.insert(request_id, res);
+                if let Some(waker) = self.wakers.remove(&request_id) {
+                    waker.wake();
+                }
+            }
+            if flags & IORING_CQE_F_MORE == 0 {
+                self.sends.remove(&request_id);
+            }
+            return;
+        }
 
+        // Receive requests.
+        let buf: Option<DemiBuffer> = if flags & IORING_CQE_F_BUFFER != 0 {
+            let buffer_id: u16 = (flags >> IORING_CQE_BUFFER_SHIFT) as u16;
+            self.buffer_ring.take(buffer_id, res.max(0) as usize)
+        } else {
+            None
+        };
+        let sockfd: RawFd = match self.receive_requests.get(&request_id) {
+            Some(&sockfd) => sockfd,
+            // Cancelled receives and cancel requests.
+            None => {
+                if buf.is_some() {
+                    self.buffer_ring.refill();
+                }
+                return;
+            },
+        };
+        let receiver: &mut Receiver = self.receivers.get_mut(&sockfd).expect("receiver should exist");
+        if flags & IORING_CQE_F_MORE == 0 {
+            // The request is no longer armed, and the next pop re-arms it.
+            receiver.armed = None;
+            self.receive_requests.remove(&request_id);
+        }
+        match (res, buf) {
+            (res, Some(buf)) if res >= 0 => receiver.queue.push_back(Received::Data(buf)),
+            // End of stream.
+            (0, None) => receiver.queue.push_back(Received::End),
+            // The ring ran out of buffers. This is not an error and the data stays in the socket.
+            (res, None) if -res == libc::ENOBUFS => (),
+            (res, _) => receiver.queue.push_back(Received::Error(-res)),
+        }
+        // Data arrived or the request is no longer armed, so the pending pop has something to do.
+        if !receiver.queue.is_empty() || receiver.armed.is_none() {
+            if let Some(waker) = receiver.waker.take() {
+                waker.wake();
+            }
+        }
+    }
+
+    /// Prepares a send request.
+    fn prepare_send(&mut self, sockfd: RawFd, addr: Option<SocketAddrV4>, buf: DemiBuffer) -> Result<RequestId, Fail> {
+        let sqe: *mut liburing::io_uring_sqe = self.get_sqe()?;
+        let request_id: RequestId = self.new_request_id();
+
+        let mut request: Box<SendRequest> = Box::new(SendRequest {
+            // Safety: the message header is a plain C struct, for which all zeros is valid.
+            msg: unsafe { mem::zeroed() },
+            // Each segment of the buffer gets its own entry in the I/O vector.
+            iovecs: buf
+                .segments()
+                .map(|segment| liburing::iovec {
+                    iov_base: segment.as_ptr() as *mut c_void,
+                    iov_len: segment.len() as u64,
+                })
+                .collect(),
+            addr: linux::socketaddrv4_to_sockaddr_in(&addr.unwrap_or(SocketAddrV4::new(Ipv4Addr::UNSPECIFIED, 0))),
+            _buf: buf,
+            abandoned: false,
+        });
+        request.msg.msg_iov = request.iovecs.as_mut_ptr();
+        request.msg.msg_iovlen = request.iovecs.len() as u64;
+        if addr.is_some() {
+            request.msg.msg_name = ptr::addr_of_mut!(request.addr) as *mut c_void;
+            request.msg.msg_namelen = mem::size_of::<libc::sockaddr_in>() as u32;
+        }
+
+        // Safety: the request is not moved out of its box until it completes.
         unsafe {
-            // Allocate a submission queue entry.
-            let sqe: *mut liburing::io_uring_sqe = liburing::io_uring_get_sqe(io_uring);
-            if sqe.is_null() {
-                let errno: libc::c_int = *libc::__errno_location();
-                error!("push(): failed to get sqe (errno={:?})", errno);
-                return Err(Fail::new(errno, "operation failed"));
-            }
-
-            // Submit operation.
-            let iov: Box<liburing::iovec> = Box::new(liburing::iovec {
-                iov_base: data_ptr as *mut c_void,
-                iov_len: len as u64,
-            });
-            let iov_ptr: *mut liburing::iovec = Box::into_raw(iov);
-            let msg: Box<liburing::msghdr> = Box::new(liburing::msghdr {
-                msg_name: ptr::null_mut() as *mut _,
-                msg_namelen: 0,
-                msg_iov: iov_ptr,
-                msg_iovlen: 1,
-                msg_control: ptr::null_mut() as *mut _,
-                msg_controllen: 0,
-                msg_flags: 0,
-            });
-            let msg_ptr: *mut liburing::msghdr = Box::into_raw(msg);
-            liburing::io_uring_sqe_set_data(sqe, msg_ptr as *mut c_void);
-            liburing::io_uring_prep_sendmsg(sqe, sockfd, msg_ptr, 0);
-            if liburing::io_uring_submit(io_uring) != 1 {
-                return Err(Fail::new(libc::EIO, "failed to submit push operation"));
-            }
-
-            Ok(msg_ptr)
-        }
-    }
-
-    /// Pushes a buffer to the target IO user ring.
-    pub fn pushto(
-        &mut self,
-        sockfd: RawFd,
-        addr: SocketAddrV4,
-        buf: DemiBuffer,
-    ) -> Result<*mut liburing::msghdr, Fail> {
-        let len: usize = buf.len();
-        let data_ptr: *const u8 = buf.as_ptr();
-        let saddr: libc::sockaddr_in = linux::socketaddrv4_to_sockaddr_in(&addr);
-        let (sockaddr, addrlen): (&libc::sockaddr_in, socklen_t) = (&saddr, mem::size_of_val(&saddr) as u32);
-        let sockaddr_ptr: *const libc::sockaddr_in = sockaddr as *const libc::sockaddr_in;
-        let io_uring: &mut liburing::io_uring = &mut self.io_uring;
+            liburing::io_uring_prep_sendmsg(sqe, sockfd, ptr::addr_of!(request.msg), 0);
+            liburing::io_uring_sqe_set_data(sqe, request_id.0 as *mut c_void);
+        }
+        self.sends.insert(request_id, request);
+        Ok(request_id)
+    }
 
+    /// Prepares a zero-copy send request, out of the registered buffer with index `buf_index`.
+    fn prepare_send_zc(&mut self, sockfd: RawFd, buf: DemiBuffer, buf_index: u16) -> Result<RequestId, Fail> {
+        let sqe: *mut liburing::io_uring_sqe = self.get_sqe()?;
+        let request_id: RequestId = self.new_request_id();
+        // Safety: the request holds a reference to the buffer until the kernel notifies us that it is done with it.
         unsafe {
-            // Allocate a submission queue entry.
-            let sqe: *mut liburing::io_uring_sqe = liburing::io_uring_get_sqe(io_uring);
-            if sqe.is_null() {
-                let errno: libc::c_int = *libc::__errno_location();
-                error!("pushto(): failed to get sqe (errno={:?})", errno);
-                return Err(Fail::new(errno, "operation failed"));
-            }
-
-            // Submit operation.
-            let iov: Box<liburing::iovec> = Box::new(liburing::iovec {
-                iov_base: data_ptr as *mut c_void,
-                iov_len: len as u64,
-            });
-            let iov_ptr: *mut liburing::iovec = Box::into_raw(iov);
-            let msg: Box<liburing::msghdr> = Box::new(liburing::msghdr {
-                msg_name: sockaddr_ptr as *mut c_void,
-                msg_namelen: addrlen as u32,
-                msg_iov: iov_ptr,
-                msg_iovlen: 1,
-                msg_control: ptr::null_mut() as *mut _,
-                msg_controllen: 0,
-                msg_flags: 0,
-            });
-            let msg_ptr: *mut liburing::msghdr = Box::into_raw(msg);
-            liburing::io_uring_sqe_set_data(sqe, msg_ptr as *mut c_void);
-            liburing::io_uring_prep_sendmsg(sqe, sockfd, msg_ptr, 0);
-            if liburing::io_uring_submit(io_uring) != 1 {
-                return Err(Fail::new(libc::EIO, "failed to submit pushto operation"));
-            }
-
-            Ok(msg_ptr)
-        }
-    }
-
-    /// Pops a buffer from the target IO user ring.
-    pub fn pop(&mut self, sockfd: RawFd, buf: DemiBuffer) -> Result<*mut liburing::msghdr, Fail> {
-        let len: usize = buf.len();
-        let data_ptr: *const u8 = buf.as_ptr();
-        let io_uring: &mut liburing::io_uring = &mut self.io_uring;
+            liburing::io_uring_prep_send_zc_fixed(
+                sqe,
+                sockfd,
+                buf.as_ptr() as *const c_void,
+                buf.len(),
+                0,
+                0,
+                buf_index as c_uint,
+            );
+            liburing::io_uring_sqe_set_data(sqe, request_id.0 as *mut c_void);
+        }
+        let request: Box<SendRequest> = Box::new(SendRequest {
+            // Safety: the message header and the address are plain C structs, for which all zeros is valid.
+            msg: unsafe { mem::zeroed() },
+            iovecs: Vec::new(),
+            addr: unsafe { mem::zeroed() },
+            _buf: buf,
+            abandoned: false,
+        });
+        self.sends.insert(request_id, request);
+        Ok(request_id)
+    }
 
+    /// Prepares a multishot receive request on a socket.
+    fn prepare_receive(&mut self, sockfd: RawFd) -> Result<RequestId, Fail> {
+        let sqe: *mut liburing::io_uring_sqe = self.get_sqe()?;
+        let request_id: RequestId = self.new_request_id();
         unsafe {
-            // Allocate a submission queue entry.
-            let sqe: *mut liburing::io_uring_sqe = liburing::io_uring_get_sqe(io_uring);
+            liburing::io_uring_prep_recv_multishot(sqe, sockfd, null_mut(), 0, 0);
+            liburing::io_uring_sqe_set_flags(sqe, IOSQE_BUFFER_SELECT);
+            liburing::io_uring_sqe_set_data(sqe, request_id.0 as *mut c_void);
+        }
+        self.receive_requests.insert(request_id, sockfd);
+        Ok(request_id)
+    }
+
+    /// Gets a submission queue entry. If the submission queue is full, this submits it first.
+    fn get_sqe(&mut self) -> Result<*mut liburing::io_uring_sqe, Fail> {
+        let mut sqe: *mut liburing::io_uring_sqe = unsafe { liburing::io_uring_get_sqe(&mut self.io_uring) };
+        if sqe.is_null() {
+            self.submit()?;
+            sqe = unsafe { liburing::io_uring_get_sqe(&mut self.io_uring) };
             if sqe.is_null() {
-                let errno: libc::c_int = *libc::__errno_location();
-                error!("pop(): failed to get sqe (errno={:?})", errno);
-                return Err(Fail::new(errno, "operation failed"));
-            }
-
-            // Submit operation.
-            let iov: Box<liburing::iovec> = Box::new(liburing::iovec {
-                iov_base: data_ptr as *mut c_void,
-                iov_len: len as u64,
-            });
-            let iov_ptr: *mut liburing::iovec = Box::into_raw(iov);
-            let msg: Box<liburing::msghdr> = Box::new(liburing::msghdr {
-                msg_name: ptr::null_mut() as *mut _,
-                msg_namelen: 0,
-                msg_iov: iov_ptr,
-                msg_iovlen: 1,
-                msg_control: ptr::null_mut() as *mut _,
-                msg_controllen: 0,
-                msg_flags: 0,
-            });
-            let msg_ptr: *mut liburing::msghdr = Box::into_raw(msg);
-            liburing::io_uring_sqe_set_data(sqe, msg_ptr as *mut c_void);
-            liburing::io_uring_prep_recvmsg(sqe, sockfd, msg_ptr as *mut liburing::msghdr, 0);
-            if liburing::io_uring_submit(io_uring) != 1 {
-                return Err(Fail::new(libc::EIO, "failed to submit pop operation"));
-            }
-
-            Ok(msg_ptr)
-        }
-    }
-
-    /// Waits for an operation to complete in the target IO user ring.
-    pub fn wait(&mut self) -> Result<(*mut liburing::msghdr, i32), Fail> {
-        let io_uring: &mut liburing::io_uring = &mut self.io_uring;
+                return Err(Fail::new(libc::EAGAIN, "submission queue is full"));
+            }
+        }
+        self.unsubmitted += 1;
+        Ok(sqe)
+    }
+
+    /// Allocates a request ID.
+    fn new_request_id(&mut self) -> RequestId {
+        let request_id: RequestId = RequestId(self.next_request_id);
+        self.next_request_id += 1;
+        request_id
+    }
+
+    /// Builds a failure for an error code that was returned by liburing.
+    fn fail(errno: c_int, default: &str) -> Fail {
+        // Safety: strerror() returns a static string.
+        let strerror: &CStr = unsafe { CStr::from_ptr(libc::strerror(errno)) };
+        let cause: &str = strerror.to_str().unwrap_or(default);
+        Fail::new(errno, cause)
+    }
+}
+
+/// Associated Functions for Provided-Buffer Rings
+impl BufferRing {
+    /// Takes the buffer that the kernel filled with `len` bytes out of the ring.
+    fn take(&mut self, buffer_id: u16, len: usize) -> Option<DemiBuffer> {
+        let mut buf: DemiBuffer = self.buffers.get_mut(buffer_id as usize)?.take()?;
+        self.empty.push(buffer_id);
+        let trim_size: usize = buf.len() - len.min(buf.len());
+        buf.trim(trim_size)
+            .expect("'buf' should hold at least 'trim_size' bytes");
+        Some(buf)
+    }
+
+    /// Places a new buffer in an empty slot of the ring.
+    fn refill(&mut self) {
+        if let Some(buffer_id) = self.empty.pop() {
+            let mut buf: DemiBuffer = DemiBuffer::new(self.buffer_size);
+            unsafe {
+                liburing::io_uring_buf_ring_add(
+                    self.ring,
+                    buf.as_mut_ptr() as *mut c_void,
+                    buf.len() as c_uint,
+                    buffer_id,
+                    liburing::io_uring_buf_ring_mask(self.nentries),
+                    self.unpublished,
+                );
+            }
+            self.buffers[buffer_id as usize] = Some(buf);
+            self.unpublished += 1;
+        }
+    }
+
+    /// Makes the buffers that were added to the ring visible to the kernel.
+    fn publish(&mut self) {
+        if self.unpublished > 0 {
+            unsafe { liburing::io_uring_buf_ring_advance(self.ring, self.unpublished) };
+            self.unpublished = 0;
+        }
+    }
+}
+
+/// Associated Functions for Registered Buffer Pools
+impl BufferPool {
+    /// Allocates a buffer of `size` bytes, if one is free.
+    fn alloc(&mut self, size: usize) -> Option<DemiBuffer> {
+        if size > self.buffer_size as usize {
+            return None;
+        }
+        let nbuffers: usize = self.buffers.len();
+        for i in 0..nbuffers {
+            let index: usize = (self.next + i) % nbuffers;
+            if self.buffers[index].is_exclusive() {
+                self.next = (index + 1) % nbuffers;
+                let mut buf: DemiBuffer = self.buffers[index].clone();
+                buf.trim(self.buffer_size as usize - size)
+                    .expect("'buf' should hold at least 'size' bytes");
+                return Some(buf);
+            }
+        }
+        None
+    }
+
+    /// Returns the fixed buffer index of the registered buffer that holds the data of `buf`, if any.
+    fn lookup(&self, buf: &DemiBuffer) -> Option<u16> {
+        let start: usize = buf.as_ptr().addr();
+        let (&base, &index): (&usize, &u16) = self.addresses.range(..=start).next_back()?;
+        if start + buf.len() <= base + self.buffer_size as usize {
+            Some(index)
+        } else {
+            None
+        }
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Drop Trait Implementation for IO User Rings
+impl Drop for IoUring {
+    fn drop(&mut self) {
         unsafe {
-            let mut cqe_ptr: *mut liburing::io_uring_cqe = null_mut();
-            let cqe_ptr_ptr: *mut *mut liburing::io_uring_cqe = ptr::addr_of_mut!(cqe_ptr);
-            let wait_nr: c_int = liburing::io_uring_wait_cqe(io_uring, cqe_ptr_ptr);
-            if wait_nr < 0 {
-                let errno: i32 = -wait_nr;
-                warn!("io_uring_wait_cqe() failed ({:?})", errno);
-                return Err(Fail::new(errno, "operation in progress"));
-            } else if wait_nr == 0 {
-                let size: i32 = (*cqe_ptr).res;
-                let msg_ptr: *mut liburing::msghdr = liburing::io_uring_cqe_get_data(cqe_ptr) as *mut liburing::msghdr;
-                liburing::io_uring_cqe_seen(io_uring, cqe_ptr);
-                return Ok((msg_ptr, size));
-            }
-        }
-
-        unreachable!("should not happen")
+            liburing::io_uring_free_buf_ring(
+                &mut self.io_uring,
+                self.buffer_ring.ring,
+                self.buffer_ring.nentries,
+                BUFFER_GROUP_ID,
+            );
+            liburing::io_uring_queue_exit(&mut self.io_uring);
+        }
     }
 }
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod config;
 mod futures;
 mod iouring;
 mod queue;
@@ -53,19 +54,12 @@ use crate::{
     scheduler::SchedulerHandle,
 };
 use ::std::{
-    any::Any,
     mem,
     net::SocketAddrV4,
     os::unix::prelude::RawFd,
+    time::Duration,
 };
 
-//======================================================================================================================
-// Constants
-//======================================================================================================================
-
-// Size of receive buffers.
-const CATCOLLAR_RECVBUF_SIZE: u16 = 9000;
-
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -85,9 +79,9 @@ pub struct CatcollarLibOS {
 /// Associate Functions for Catcollar LibOS
 impl CatcollarLibOS {
     /// Instantiates a Catcollar LibOS.
-    pub fn new(_config: &Config) -> Self {
+    pub fn new(config: &Config) -> Self {
         let qtable: IoQueueTable<CatcollarQueue> = IoQueueTable::<CatcollarQueue>::new();
-        let runtime: IoUringRuntime = IoUringRuntime::new();
+        let runtime: IoUringRuntime = IoUringRuntime::new(config.io_uring_sqpoll_idle());
         Self { qtable, runtime }
     }
 
@@ -277,13 +271,16 @@ impl CatcollarLibOS {
         trace!("close() qd={:?}", qd);
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
-                Some(fd) => match unsafe { libc::close(fd) } {
-                    stats if stats == 0 => (),
-                    _ => {
-                        let errno: libc::c_int = unsafe { *libc::__errno_location() };
-                        error!("failed to close socket (fd={:?}, errno={:?})", fd, errno);
-                        return Err(Fail::new(errno, "operation failed"));
-                    },
+                Some(fd) => {
+                    self.runtime.forget(fd)?;
+                    match unsafe { libc::close(fd) } {
+                        stats if stats == 0 => (),
+                        _ => {
+                            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                            error!("failed to close socket (fd={:?}, errno={:?})", fd, errno);
+                            return Err(Fail::new(errno, "operation failed"));
+                        },
+                    }
                 },
                 None => unreachable!("CatcollarQueue has invalid underlying file descriptor"),
             },
@@ -299,6 +296,7 @@ impl CatcollarLibOS {
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
+                    self.runtime.forget(fd)?;
                     let future: Operation = Operation::from(CloseFuture::new(qd, fd));
                     let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                         Some(handle) => handle,
@@ -318,7 +316,7 @@ impl CatcollarLibOS {
 
         let buf: DemiBuffer = self.runtime.clone_sgarray(sga)?;
 
-        if buf.len() == 0 {
+        if buf.pkt_len() == 0 {
             return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
         }
 
@@ -346,7 +344,7 @@ impl CatcollarLibOS {
 
         match self.runtime.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
 
@@ -376,13 +374,11 @@ impl CatcollarLibOS {
     pub fn pop(&mut self, qd: QDesc) -> Result<QToken, Fail> {
         trace!("pop() qd={:?}", qd);
 
-        let buf: DemiBuffer = DemiBuffer::new(CATCOLLAR_RECVBUF_SIZE);
-
         // Issue pop operation.
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
-                    let future: Operation = Operation::from(PopFuture::new(self.runtime.clone(), qd, fd, buf));
+                    let future: Operation = Operation::from(PopFuture::new(self.runtime.clone(), qd, fd));
                     let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                         Some(handle) => handle,
                         None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -396,8 +392,13 @@ impl CatcollarLibOS {
         }
     }
 
-    pub fn poll(&self) {
-        self.runtime.scheduler.poll()
+    pub fn poll(&self) -> bool {
+        self.runtime.poll()
+    }
+
+    /// Blocks until some request completes or `timeout` expires. See [IoUringRuntime::park].
+    pub fn park(&self, timeout: Option<Duration>) {
+        self.runtime.park(timeout)
     }
 
     pub fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
@@ -407,6 +408,11 @@ impl CatcollarLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.runtime.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, r): (QDesc, OperationResult) = self.take_result(handle);
         Ok(pack_result(&self.runtime, r, qd, qt.into()))
@@ -426,11 +432,9 @@ impl CatcollarLibOS {
 
     /// Takes out the operation result descriptor associated with the target scheduler handle.
     fn take_result(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.runtime.scheduler.take(handle).as_any();
-        let boxed_concrete_type: Operation = *boxed_future.downcast::<Operation>().expect("Wrong type!");
+        let operation: Operation = self.runtime.scheduler.take(handle);
 
-        let (qd, new_qd, new_fd, qr): (QDesc, Option<QDesc>, Option<RawFd>, OperationResult) =
-            boxed_concrete_type.get_result();
+        let (qd, new_qd, new_fd, qr): (QDesc, Option<QDesc>, Option<RawFd>, OperationResult) = operation.get_result();
         trace!("take_result(): qd={:?}, new_qd={:?}, new_fd={:?}", qd, new_qd, new_fd,);
 
         // Handle accept operation.
@@ -3,34 +3,39 @@
 
 mod network;
 
+//==============================================================================
+// Exports
+//==============================================================================
+
+pub use super::iouring::RequestId;
+
 //==============================================================================
 // Imports
 //==============================================================================
 
 use super::iouring::IoUring;
 use crate::{
-    pal::linux,
     runtime::{
         fail::Fail,
-        liburing,
         memory::{
             DemiBuffer,
             MemoryRuntime,
         },
+        types::{
+            demi_sgarray_t,
+            DEMI_SGARRAY_MAXLEN,
+        },
         Runtime,
     },
     scheduler::scheduler::Scheduler,
 };
 use ::std::{
     cell::RefCell,
-    collections::{
-        HashMap,
-        HashSet,
-    },
-    mem,
     net::SocketAddrV4,
     os::unix::prelude::RawFd,
     rc::Rc,
+    task::Waker,
+    time::Duration,
 };
 
 //==============================================================================
@@ -40,14 +45,27 @@ use ::std::{
 /// Number of slots in an I/O User ring.
 const CATCOLLAR_NUM_RINGS: u32 = 128;
 
+/// Number of buffers provided for receives. This must be a power of two.
+const CATCOLLAR_NUM_RECVBUFS: u32 = 256;
+
+/// Size of receive buffers.
+const CATCOLLAR_RECVBUF_SIZE: u16 = 9000;
+
+/// Number of buffers registered for zero-copy sends.
+const CATCOLLAR_NUM_SENDBUFS: u16 = 64;
+
+/// Size of buffers registered for zero-copy sends. The size of heap buffers is a 16-bit value, so this is the largest
+/// one, which is one byte short of 64 KiB.
+const CATCOLLAR_SENDBUF_SIZE: u16 = u16::MAX;
+
+/// Scatter-gather arrays of at least this size are allocated out of registered buffers. Zero-copy sends only pay off
+/// for large messages, as the kernel has to send a notification once it is done with the buffer.
+const CATCOLLAR_ZEROCOPY_THRESHOLD: usize = 16 * 1024;
+
 //==============================================================================
 // Structures
 //==============================================================================
 
-/// Request ID
-#[derive(Clone, Copy, Hash, Debug, Eq, PartialEq)]
-pub struct RequestId(pub *const liburing::msghdr);
-
 /// I/O User Ring Runtime
 #[derive(Clone)]
 pub struct IoUringRuntime {
@@ -55,10 +73,6 @@ pub struct IoUringRuntime {
     pub scheduler: Scheduler,
     /// Underlying io_uring.
     io_uring: Rc<RefCell<IoUring>>,
-    /// Pending requests.
-    pending: HashSet<RequestId>,
-    /// Completed requests.
-    completed: HashMap<RequestId, (Option<SocketAddrV4>, i32)>,
 }
 
 //==============================================================================
@@ -67,81 +81,74 @@ pub struct IoUringRuntime {
 
 /// Associate Functions for I/O User Ring Runtime
 impl IoUringRuntime {
-    /// Creates an I/O user ring runtime.
-    pub fn new() -> Self {
-        let io_uring: IoUring = IoUring::new(CATCOLLAR_NUM_RINGS).expect("cannot create io_uring");
+    /// Creates an I/O user ring runtime. If `sqpoll_idle` is set, the kernel polls the submission queue.
+    pub fn new(sqpoll_idle: Option<Duration>) -> Self {
+        let mut io_uring: IoUring = IoUring::new(
+            CATCOLLAR_NUM_RINGS,
+            CATCOLLAR_NUM_RECVBUFS,
+            CATCOLLAR_RECVBUF_SIZE,
+            sqpoll_idle,
+        )
+        .expect("cannot create io_uring");
+        if let Err(e) = io_uring.register_buffers(CATCOLLAR_NUM_SENDBUFS, CATCOLLAR_SENDBUF_SIZE) {
+            warn!("zero-copy sends are disabled ({:?})", e);
+        }
         Self {
             scheduler: Scheduler::default(),
             io_uring: Rc::new(RefCell::new(io_uring)),
-            pending: HashSet::new(),
-            completed: HashMap::new(),
         }
     }
 
     /// Pushes a buffer to the target I/O user ring.
     pub fn push(&mut self, sockfd: RawFd, buf: DemiBuffer) -> Result<RequestId, Fail> {
-        let msg_ptr: *const liburing::msghdr = self.io_uring.borrow_mut().push(sockfd, buf)?;
-        let request_id: RequestId = RequestId(msg_ptr);
-        self.pending.insert(request_id);
-        Ok(request_id)
+        self.io_uring.borrow_mut().push(sockfd, buf)
     }
 
     /// Pushes a buffer to the target I/O user ring.
     pub fn pushto(&mut self, sockfd: i32, addr: SocketAddrV4, buf: DemiBuffer) -> Result<RequestId, Fail> {
-        let msg_ptr: *const liburing::msghdr = self.io_uring.borrow_mut().pushto(sockfd, addr, buf)?;
-        let request_id: RequestId = RequestId(msg_ptr);
-        self.pending.insert(request_id);
-        Ok(request_id)
+        self.io_uring.borrow_mut().pushto(sockfd, addr, buf)
     }
 
-    /// Pops a buffer from the target I/O user ring.
-    pub fn pop(&mut self, sockfd: RawFd, buf: DemiBuffer) -> Result<RequestId, Fail> {
-        let msg_ptr: *const liburing::msghdr = self.io_uring.borrow_mut().pop(sockfd, buf)?;
-        let request_id: RequestId = RequestId(msg_ptr);
-        self.pending.insert(request_id);
-        Ok(request_id)
+    /// Pops a buffer from the target I/O user ring, if some data was received. Otherwise, `waker` is woken once some
+    /// data arrives.
+    pub fn pop(&mut self, sockfd: RawFd, waker: &Waker) -> Result<Option<DemiBuffer>, Fail> {
+        self.io_uring.borrow_mut().pop(sockfd, waker)
     }
 
-    /// Peeks for the completion of an operation in the target I/O user ring.
-    pub fn peek(&mut self, request_id: RequestId) -> Result<(Option<SocketAddrV4>, i32), Fail> {
-        // Check if pending request has completed.
-        match self.completed.remove(&request_id) {
-            // The target request has already completed.
-            Some(result) => Ok(result),
-            // The target request may not be completed.
-            None => {
-                // Peek the underlying io_uring.
-                match self.io_uring.borrow_mut().wait() {
-                    // Some operation has completed.
-                    Ok((other_request_id, size)) => {
-                        let msg: Box<liburing::msghdr> = unsafe { Box::from_raw(other_request_id) };
-                        let _: Box<liburing::iovec> = unsafe { Box::from_raw(msg.msg_iov) };
-                        let addr: Option<SocketAddrV4> = if msg.msg_name.is_null() {
-                            None
-                        } else {
-                            let saddr: *const libc::sockaddr = msg.msg_name as *const libc::sockaddr;
-                            let sin: libc::sockaddr_in =
-                                unsafe { *mem::transmute::<*const libc::sockaddr, *const libc::sockaddr_in>(saddr) };
-                            Some(linux::sockaddr_in_to_socketaddrv4(&sin))
-                        };
-
-                        // This is not the request that we are waiting for.
-                        if request_id.0 != other_request_id {
-                            let other_request_id: RequestId = RequestId(other_request_id);
-                            if self.pending.remove(&other_request_id) {
-                                self.completed.insert(other_request_id, (addr, size));
-                            } else {
-                                warn!("spurious event?");
-                            }
-                        }
-
-                        // Done.
-                        Ok((addr, size))
-                    },
-                    // Something bad has happened.
-                    Err(e) => Err(e),
-                }
-            },
+    /// Peeks for the completion of an operation in the target I/O user ring. If it is not completed, `waker` is woken
+    /// once it is.
+    pub fn peek(&mut self, request_id: RequestId, waker: &Waker) -> Option<i32> {
+        self.io_uring.borrow_mut().take_completion(request_id, waker)
+    }
+
+    /// Forgets about the result of a push that is no longer waited for.
+    pub fn abandon(&mut self, request_id: RequestId) {
+        self.io_uring.borrow_mut().abandon(request_id)
+    }
+
+    /// Stops receiving on a socket that is about to be closed.
+    pub fn forget(&mut self, sockfd: RawFd) -> Result<(), Fail> {
+        self.io_uring.borrow_mut().forget(sockfd)
+    }
+
+    /// Polls the runtime. Completions that are available are reaped before scheduled operations run, and the requests
+    /// that these operations prepared are submitted afterwards, all at once. Returns whether any request completed:
+    /// operations that do not go through the I/O user ring retry by waking themselves up, so running tasks does not
+    /// tell whether anything happened.
+    pub fn poll(&self) -> bool {
+        let reaped: usize = self.io_uring.borrow_mut().reap();
+        self.scheduler.poll();
+        if let Err(e) = self.io_uring.borrow_mut().submit() {
+            warn!("failed to submit requests ({:?})", e);
+        }
+        reaped > 0
+    }
+
+    /// Blocks until some request completes or `timeout` expires, unless some task is ready to run already.
+    /// Operations that do not go through the I/O user ring keep their tasks ready, so this never blocks them.
+    pub fn park(&self, timeout: Option<Duration>) {
+        if !self.scheduler.has_ready() {
+            self.io_uring.borrow_mut().wait(timeout);
         }
     }
 }
@@ -151,7 +158,26 @@ impl IoUringRuntime {
 //==============================================================================
 
 /// Memory Runtime Trait Implementation for IoUring Runtime
-impl MemoryRuntime for IoUringRuntime {}
+impl MemoryRuntime for IoUringRuntime {
+    /// Allocates a scatter-gather array. Large ones are allocated out of registered buffers, if one is free.
+    fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
+        // We can't allocate more than a buffer per segment.
+        if size > DEMI_SGARRAY_MAXLEN * u16::MAX as usize {
+            return Err(Fail::new(libc::EINVAL, "size too large for a demi_sgarray_t"));
+        }
+
+        let registered: Option<DemiBuffer> = if size >= CATCOLLAR_ZEROCOPY_THRESHOLD {
+            self.io_uring.borrow_mut().alloc_registered(size)
+        } else {
+            None
+        };
+        let buf: DemiBuffer = match registered {
+            Some(buf) => buf,
+            None => DemiBuffer::new_chain(size)?,
+        };
+        self.into_sgarray(buf)
+    }
+}
 
 /// Runtime Trait Implementation for I/O User Ring Runtime
 impl Runtime for IoUringRuntime {}
@@ -48,7 +48,6 @@ use crate::{
     QType,
 };
 use ::std::{
-    any::Any,
     cell::RefCell,
     collections::HashMap,
     mem,
@@ -405,6 +404,26 @@ impl CatloopLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        // Connection establishment operations run on our own scheduler.
+        self.scheduler.for_each_completed(|key| {
+            let qt: QToken = key.into();
+            match self.qts.get(&qt) {
+                Some((demi_opcode_t::DEMI_OPC_ACCEPT, _)) | Some((demi_opcode_t::DEMI_OPC_CONNECT, _)) => visitor(qt),
+                _ => false,
+            }
+        });
+
+        // Data path operations run on Catmem LibOS, which also runs operations that we issue internally.
+        self.catmem
+            .borrow()
+            .for_each_completed(&mut |qt| match self.qts.get(&qt) {
+                Some((demi_opcode_t::DEMI_OPC_PUSH, _)) | Some((demi_opcode_t::DEMI_OPC_POP, _)) => visitor(qt),
+                _ => false,
+            });
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         match self.qts.remove(&qt) {
             Some((demi_opcode_t::DEMI_OPC_ACCEPT, _)) | Some((demi_opcode_t::DEMI_OPC_CONNECT, _)) => {
@@ -450,17 +469,16 @@ impl CatloopLibOS {
     }
 
     /// Polls scheduling queues.
-    pub fn poll(&self) {
-        self.catmem.borrow().poll();
-        self.scheduler.poll()
+    pub fn poll(&self) -> bool {
+        let progress: bool = self.catmem.borrow().poll();
+        self.scheduler.poll() || progress
     }
 
     /// Takes out the [OperationResult] associated with the target [SchedulerHandle].
     fn take_result(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.scheduler.take(handle).as_any();
-        let boxed_concrete_type: Operation = *boxed_future.downcast::<Operation>().expect("Wrong type!");
+        let operation: Operation = self.scheduler.take(handle);
 
-        boxed_concrete_type.get_result()
+        operation.get_result()
     }
 
     // Cooks a magic connect message.
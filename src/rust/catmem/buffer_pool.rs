@@ -0,0 +1,511 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::message_ring::MessageRing,
+    pal::linux::shm::SharedMemory,
+    runtime::{
+        fail::Fail,
+        types::{
+            demi_sgarray_t,
+            demi_sgaseg_t,
+            DEMI_SGARRAY_MAXLEN,
+        },
+    },
+};
+use ::libc::c_void;
+use ::std::{
+    cell::{
+        RefCell,
+        RefMut,
+    },
+    mem,
+    ptr,
+    rc::Rc,
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Number of buffers in a buffer pool.
+const NUM_BUFFERS: usize = 64;
+
+/// Size (in bytes) of each buffer in a buffer pool.
+pub const BUFFER_SIZE: usize = 32768;
+
+/// Capacity (in bytes) of the ring where the reader returns buffers to the writer.
+const RETURN_RING_CAPACITY: usize = 1024;
+
+/// Size (in bytes) of a buffer descriptor.
+pub const BUFFER_DESCRIPTOR_SIZE: usize = 12;
+
+/// The buffer is held by the application on the writer side.
+const HELD_BY_WRITER: u8 = 1 << 0;
+
+/// The buffer was pushed, and it is held by the reader side until it comes back through the return ring.
+const HELD_BY_READER: u8 = 1 << 1;
+
+/// Tag in tokens of scatter-gather arrays that were popped (as opposed to allocated).
+const TOKEN_TAG_POPPED: usize = 1;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Describes a range of bytes in a buffer of a buffer pool.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct BufferDescriptor {
+    /// Index of the buffer.
+    index: u32,
+    /// Offset of the first byte in the buffer.
+    offset: u32,
+    /// Number of bytes.
+    len: u32,
+}
+
+/// A pool of fixed-size buffers that live in a shared memory region.
+///
+/// The writer side of a memory queue allocates scatter-gather arrays from this pool and pushes them by publishing a
+/// [BufferDescriptor] on the message ring of the queue, instead of copying the data. The reader side pops a view on
+/// the same memory, and releasing that view sends the buffer back to the writer through a return ring, which lives in
+/// the first bytes of the region. Ownership of each buffer is tracked by the writer, so a buffer is recycled only
+/// once both the writing application and the reader are done with it.
+pub struct BufferPool {
+    /// Underlying shared memory region.
+    #[allow(unused)]
+    shm: SharedMemory,
+    /// Whether the target buffer pool is used by the writer side, as opposed to the reader side.
+    writer: bool,
+    /// Ring where the reader returns indexes of buffers that it no longer uses.
+    returns: MessageRing,
+    /// First buffer.
+    buffers: *mut u8,
+    /// Holders of each buffer, as seen by the writer.
+    holders: RefCell<Vec<u8>>,
+    /// Buffers that are free on the writer side.
+    free: RefCell<Vec<u32>>,
+    /// Buffers that were popped and not released yet on the reader side.
+    popped: RefCell<Vec<bool>>,
+}
+
+/// The buffer pool of a memory queue, which is only mapped once the queue first carries zero-copy buffers.
+///
+/// Buffers flow in one direction only: the end that first allocates a buffer creates the pool and becomes the writer,
+/// while the other end opens the pool when it first pops a buffer, and becomes the reader. An end can never take both
+/// roles, and the shared memory region is created exclusively, so two writers cannot hand out the same buffers.
+pub struct LazyBufferPool {
+    /// Name of the shared memory region of the pool.
+    name: String,
+    /// Underlying buffer pool, if it was mapped already.
+    pool: RefCell<Option<Rc<BufferPool>>>,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Associated functions for buffer descriptors.
+impl BufferDescriptor {
+    /// Serializes the target buffer descriptor.
+    pub fn to_bytes(&self) -> [u8; BUFFER_DESCRIPTOR_SIZE] {
+        let mut bytes: [u8; BUFFER_DESCRIPTOR_SIZE] = [0; BUFFER_DESCRIPTOR_SIZE];
+        bytes[0..4].copy_from_slice(&self.index.to_le_bytes());
+        bytes[4..8].copy_from_slice(&self.offset.to_le_bytes());
+        bytes[8..12].copy_from_slice(&self.len.to_le_bytes());
+        bytes
+    }
+
+    /// Parses a buffer descriptor.
+    pub fn from_bytes(bytes: &[u8]) -> Result<Self, Fail> {
+        if bytes.len() != BUFFER_DESCRIPTOR_SIZE {
+            return Err(Fail::new(libc::EINVAL, "invalid buffer descriptor size"));
+        }
+        // These unwraps cannot panic, as we checked the size of the descriptor above.
+        Ok(Self {
+            index: u32::from_le_bytes(bytes[0..4].try_into().unwrap()),
+            offset: u32::from_le_bytes(bytes[4..8].try_into().unwrap()),
+            len: u32::from_le_bytes(bytes[8..12].try_into().unwrap()),
+        })
+    }
+}
+
+/// Associated functions for buffer pools.
+impl BufferPool {
+    /// Creates a buffer pool in a new shared memory region.
+    pub fn create(name: &str) -> Result<Self, Fail> {
+        let shm: SharedMemory = SharedMemory::create(name, Self::region_size())?;
+        Self::new(true, shm)
+    }
+
+    /// Opens a buffer pool in an existing shared memory region.
+    pub fn open(name: &str) -> Result<Self, Fail> {
+        let shm: SharedMemory = SharedMemory::open(name, Self::region_size())?;
+        Self::new(false, shm)
+    }
+
+    /// Checks if a scatter-gather array was allocated from (or popped to) the target buffer pool.
+    pub fn contains(&self, sga: &demi_sgarray_t) -> bool {
+        let addr: usize = sga.sga_buf as usize;
+        let base: usize = self.buffers as usize;
+        addr >= base && addr < base + NUM_BUFFERS * BUFFER_SIZE
+    }
+
+    /// Checks if any buffer of the target buffer pool is still in use by the application.
+    pub fn in_use(&self) -> bool {
+        self.popped.borrow().iter().any(|popped| *popped)
+            || self
+                .holders
+                .borrow()
+                .iter()
+                .any(|holders| holders & HELD_BY_WRITER != 0)
+    }
+
+    /// Allocates a scatter-gather array from the target buffer pool.
+    pub fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
+        if size == 0 || size > BUFFER_SIZE {
+            return Err(Fail::new(libc::EINVAL, "invalid size for a buffer of a memory queue"));
+        }
+
+        // Recycle buffers that the reader is done with.
+        self.reclaim();
+
+        let index: u32 = match self.free.borrow_mut().pop() {
+            Some(index) => index,
+            None => return Err(Fail::new(libc::EAGAIN, "no free buffers in the memory queue")),
+        };
+        self.holders.borrow_mut()[index as usize] = HELD_BY_WRITER;
+
+        let buf: *mut u8 = self.buffer_ptr(index);
+        Ok(Self::make_sgarray(buf as usize, buf, size))
+    }
+
+    /// Releases a scatter-gather array that was allocated from (or popped to) the target buffer pool.
+    pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
+        let (index, popped): (u32, bool) = self.parse_token(&sga)?;
+
+        if popped {
+            if !self.popped.borrow()[index as usize] {
+                return Err(Fail::new(libc::EINVAL, "buffer of memory queue was already released"));
+            }
+            // Give the buffer back to the writer. This should not fail, as the return ring can fit all buffers.
+            self.returns.try_push(&index.to_le_bytes())?;
+            self.popped.borrow_mut()[index as usize] = false;
+        } else {
+            let holders: u8 = self.holders.borrow()[index as usize];
+            if holders & HELD_BY_WRITER == 0 {
+                return Err(Fail::new(libc::EINVAL, "buffer of memory queue was already released"));
+            }
+            self.release(index, HELD_BY_WRITER);
+        }
+
+        Ok(())
+    }
+
+    /// Hands over the buffer of a scatter-gather array to the reader side. On success, the descriptor that should be
+    /// pushed to the reader is returned. The application may still release the scatter-gather array afterwards.
+    pub fn publish(&self, sga: &demi_sgarray_t) -> Result<BufferDescriptor, Fail> {
+        let (index, popped): (u32, bool) = self.parse_token(sga)?;
+        if popped {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "cannot push a buffer that was popped without copying it",
+            ));
+        }
+
+        let holders: u8 = self.holders.borrow()[index as usize];
+        if holders != HELD_BY_WRITER {
+            return Err(Fail::new(
+                libc::EBUSY,
+                "buffer of memory queue is not owned by the application",
+            ));
+        }
+
+        // Check if the segment still lies within the buffer, as the application may have trimmed it.
+        let seg: &demi_sgaseg_t = &sga.sga_segs[0];
+        let buf: usize = self.buffer_ptr(index) as usize;
+        let data: usize = seg.sgaseg_buf as usize;
+        let len: usize = seg.sgaseg_len as usize;
+        if len == 0 || data < buf || data + len > buf + BUFFER_SIZE {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "demi_sgarray_t describes data outside backing buffer's allocated region",
+            ));
+        }
+
+        self.holders.borrow_mut()[index as usize] |= HELD_BY_READER;
+
+        Ok(BufferDescriptor {
+            index,
+            offset: (data - buf) as u32,
+            len: len as u32,
+        })
+    }
+
+    /// Exposes the data referred by a descriptor that was popped from a memory queue as a scatter-gather array.
+    pub fn view(&self, descriptor: &BufferDescriptor) -> Result<demi_sgarray_t, Fail> {
+        let (index, offset, len): (usize, usize, usize) = (
+            descriptor.index as usize,
+            descriptor.offset as usize,
+            descriptor.len as usize,
+        );
+        if index >= NUM_BUFFERS || offset + len > BUFFER_SIZE {
+            return Err(Fail::new(libc::EINVAL, "invalid buffer descriptor"));
+        }
+
+        let mut popped: RefMut<Vec<bool>> = self.popped.borrow_mut();
+        if popped[index] {
+            return Err(Fail::new(libc::EBUSY, "buffer of memory queue was already popped"));
+        }
+        popped[index] = true;
+
+        let buf: *mut u8 = self.buffer_ptr(descriptor.index);
+        // Safety: the offset lies within the buffer, as we checked above.
+        let data: *mut u8 = unsafe { buf.add(offset) };
+        Ok(Self::make_sgarray(buf as usize | TOKEN_TAG_POPPED, data, len))
+    }
+
+    /// Returns the size of the shared memory region of a buffer pool.
+    fn region_size() -> usize {
+        Self::buffers_offset() + NUM_BUFFERS * BUFFER_SIZE
+    }
+
+    /// Returns the offset of the first buffer in the shared memory region of a buffer pool.
+    fn buffers_offset() -> usize {
+        MessageRing::region_size(RETURN_RING_CAPACITY)
+    }
+
+    /// Checks if the target buffer pool is used by the writer side, as opposed to the reader side.
+    pub fn is_writer(&self) -> bool {
+        self.writer
+    }
+
+    /// Constructs a buffer pool on top of a shared memory region. The writer side initializes the region.
+    fn new(writer: bool, mut shm: SharedMemory) -> Result<Self, Fail> {
+        let returns: MessageRing = MessageRing::from_raw_parts(writer, shm.as_mut_ptr(), Self::buffers_offset())?;
+        // Safety: the offset lies within the shared memory region, which spans over all buffers.
+        let buffers: *mut u8 = unsafe { shm.as_mut_ptr().add(Self::buffers_offset()) };
+        Ok(Self {
+            shm,
+            writer,
+            returns,
+            buffers,
+            holders: RefCell::new(vec![0; NUM_BUFFERS]),
+            free: RefCell::new((0..NUM_BUFFERS as u32).rev().collect()),
+            popped: RefCell::new(vec![false; NUM_BUFFERS]),
+        })
+    }
+
+    /// Recycles buffers that were returned by the reader.
+    fn reclaim(&self) {
+        let mut bytes: [u8; 4] = [0; 4];
+        while let Some((index, _)) = self.returns.try_pop(|len| &mut bytes[..len.min(4)]) {
+            let index: u32 = match <[u8; 4]>::try_from(&*index) {
+                Ok(index) => u32::from_le_bytes(index),
+                Err(_) => {
+                    warn!("reclaim(): malformed message in return ring");
+                    continue;
+                },
+            };
+            match self.holders.borrow().get(index as usize) {
+                Some(holders) if holders & HELD_BY_READER != 0 => {},
+                _ => {
+                    warn!("reclaim(): unexpected buffer returned (index={:?})", index);
+                    continue;
+                },
+            }
+            self.release(index, HELD_BY_READER);
+        }
+    }
+
+    /// Drops a holder of a buffer, and recycles the buffer if no one else holds it.
+    fn release(&self, index: u32, holder: u8) {
+        let mut holders: RefMut<Vec<u8>> = self.holders.borrow_mut();
+        holders[index as usize] &= !holder;
+        if holders[index as usize] == 0 {
+            self.free.borrow_mut().push(index);
+        }
+    }
+
+    /// Parses the token of a scatter-gather array of the target buffer pool. On success, the index of the underlying
+    /// buffer is returned, along with a flag that indicates whether or not the scatter-gather array was popped.
+    fn parse_token(&self, sga: &demi_sgarray_t) -> Result<(u32, bool), Fail> {
+        if sga.sga_numsegs != 1 || !self.contains(sga) {
+            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+        }
+        let token: usize = sga.sga_buf as usize;
+        let offset: usize = (token & !TOKEN_TAG_POPPED) - self.buffers as usize;
+        if offset % BUFFER_SIZE != 0 {
+            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+        }
+        Ok(((offset / BUFFER_SIZE) as u32, token & TOKEN_TAG_POPPED != 0))
+    }
+
+    /// Returns a pointer to the buffer with a given index.
+    fn buffer_ptr(&self, index: u32) -> *mut u8 {
+        debug_assert!((index as usize) < NUM_BUFFERS);
+        // Safety: the buffer lies within the shared memory region.
+        unsafe { self.buffers.add(index as usize * BUFFER_SIZE) }
+    }
+
+    /// Builds a single-segment scatter-gather array.
+    fn make_sgarray(token: usize, data: *mut u8, len: usize) -> demi_sgarray_t {
+        let mut sga_segs: [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN] = [demi_sgaseg_t {
+            sgaseg_buf: ptr::null_mut(),
+            sgaseg_len: 0,
+        }; DEMI_SGARRAY_MAXLEN];
+        sga_segs[0] = demi_sgaseg_t {
+            sgaseg_buf: data as *mut c_void,
+            sgaseg_len: len as u32,
+        };
+        demi_sgarray_t {
+            sga_buf: token as *mut c_void,
+            sga_numsegs: 1,
+            sga_segs,
+            sga_addr: unsafe { mem::zeroed() },
+        }
+    }
+}
+
+/// Associated functions for lazily mapped buffer pools.
+impl LazyBufferPool {
+    /// Prepares the buffer pool that lives in the shared memory region `name`, without mapping it.
+    pub fn new(name: String) -> Self {
+        Self {
+            name,
+            pool: RefCell::new(None),
+        }
+    }
+
+    /// Returns the underlying buffer pool, if it was mapped already.
+    pub fn get(&self) -> Option<Rc<BufferPool>> {
+        self.pool.borrow().clone()
+    }
+
+    /// Checks if any buffer of the target buffer pool is still in use by the application.
+    pub fn in_use(&self) -> bool {
+        self.pool.borrow().as_ref().map_or(false, |pool| pool.in_use())
+    }
+
+    /// Returns the underlying buffer pool for allocating buffers, and creates it if needed.
+    pub fn writer(&self) -> Result<Rc<BufferPool>, Fail> {
+        self.get_or_map(true)
+    }
+
+    /// Returns the underlying buffer pool for viewing popped buffers, and opens it if needed.
+    pub fn reader(&self) -> Result<Rc<BufferPool>, Fail> {
+        self.get_or_map(false)
+    }
+
+    /// Returns the underlying buffer pool, provided that it is used with the given role, and maps it if needed.
+    fn get_or_map(&self, writer: bool) -> Result<Rc<BufferPool>, Fail> {
+        let mut pool: RefMut<Option<Rc<BufferPool>>> = self.pool.borrow_mut();
+        match *pool {
+            Some(ref pool) if pool.is_writer() == writer => Ok(pool.clone()),
+            Some(_) => Err(Fail::new(
+                libc::EINVAL,
+                "zero-copy buffers of a memory queue only flow in one direction",
+            )),
+            None => {
+                let new_pool: Rc<BufferPool> = Rc::new(if writer {
+                    BufferPool::create(&self.name)?
+                } else {
+                    BufferPool::open(&self.name)?
+                });
+                *pool = Some(new_pool.clone());
+                Ok(new_pool)
+            },
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use super::{
+        BufferDescriptor,
+        BufferPool,
+        LazyBufferPool,
+        BUFFER_SIZE,
+        NUM_BUFFERS,
+    };
+    use crate::runtime::types::demi_sgarray_t;
+
+    /// Tests if buffers travel from writer to reader and back without being copied.
+    #[ignore]
+    #[test]
+    fn buffer_pool_round_trip() {
+        let shm_name: String = "shm-test-buffer-pool-round-trip".to_string();
+        let writer: BufferPool = BufferPool::create(&shm_name).expect("creating a buffer pool should be possible");
+        let reader: BufferPool = BufferPool::open(&shm_name).expect("opening a buffer pool should be possible");
+
+        // Exhaust the pool.
+        let mut sgas: Vec<demi_sgarray_t> = Vec::new();
+        for _ in 0..NUM_BUFFERS {
+            sgas.push(writer.alloc_sgarray(BUFFER_SIZE).expect("pool should not be empty"));
+        }
+        assert!(writer.alloc_sgarray(1).is_err());
+
+        // Publish a buffer and release it on the writer side. It should not be recycled yet.
+        let sga: demi_sgarray_t = sgas.pop().unwrap();
+        let descriptor: BufferDescriptor = writer.publish(&sga).expect("publishing a buffer should be possible");
+        assert!(writer.publish(&sga).is_err());
+        writer.free_sgarray(sga).expect("releasing a buffer should be possible");
+        assert!(writer.alloc_sgarray(1).is_err());
+
+        // Release the buffer on the reader side. Now it should be recycled.
+        let bytes: [u8; super::BUFFER_DESCRIPTOR_SIZE] = descriptor.to_bytes();
+        let view: demi_sgarray_t = reader
+            .view(&BufferDescriptor::from_bytes(&bytes).unwrap())
+            .expect("viewing a buffer should be possible");
+        assert!(reader.in_use());
+        reader.free_sgarray(view).expect("releasing a view should be possible");
+        assert!(!reader.in_use());
+        let sga: demi_sgarray_t = writer.alloc_sgarray(1).expect("buffer should have been recycled");
+        writer.free_sgarray(sga).expect("releasing a buffer should be possible");
+
+        for sga in sgas {
+            writer.free_sgarray(sga).expect("releasing a buffer should be possible");
+        }
+        assert!(!writer.in_use());
+    }
+
+    /// Tests if buffer pools are only mapped on first use, and if each end of a memory queue takes a single role.
+    #[ignore]
+    #[test]
+    fn lazy_buffer_pool_roles() {
+        let shm_name: String = "shm-test-lazy-buffer-pool-roles".to_string();
+        let writer: LazyBufferPool = LazyBufferPool::new(shm_name.clone());
+        let reader: LazyBufferPool = LazyBufferPool::new(shm_name.clone());
+        assert!(writer.get().is_none());
+        assert!(!writer.in_use());
+
+        // The writer creates the pool, and it cannot view buffers as a reader then.
+        let sga: demi_sgarray_t = writer
+            .writer()
+            .expect("creating a buffer pool should be possible")
+            .alloc_sgarray(1)
+            .expect("pool should not be empty");
+        assert!(writer.in_use());
+        assert!(writer.reader().is_err());
+
+        // The other end cannot create the pool again, nor write once it became the reader.
+        assert!(LazyBufferPool::new(shm_name).writer().is_err());
+        reader.reader().expect("opening a buffer pool should be possible");
+        assert!(reader.writer().is_err());
+
+        writer
+            .get()
+            .unwrap()
+            .free_sgarray(sga)
+            .expect("releasing a buffer should be possible");
+        assert!(!writer.in_use());
+    }
+}
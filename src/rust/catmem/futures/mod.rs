@@ -13,13 +13,15 @@ pub mod push;
 //======================================================================================================================
 
 use self::{
-    pop::PopFuture,
+    pop::{
+        PopData,
+        PopFuture,
+    },
     push::PushFuture,
 };
 use crate::{
     runtime::{
         fail::Fail,
-        memory::DemiBuffer,
         QDesc,
     },
     scheduler::{
@@ -44,7 +46,7 @@ use ::std::{
 /// Operation Result
 pub enum OperationResult {
     Push,
-    Pop(DemiBuffer, bool),
+    Pop(PopData, bool),
     Failed(Fail),
 }
 
@@ -78,8 +80,8 @@ impl Operation {
             // Pop operation.
             Operation::Pop(FutureResult {
                 future,
-                done: Some(Ok((buf, eof))),
-            }) => (future.get_qd(), OperationResult::Pop(buf, eof)),
+                done: Some(Ok((data, eof))),
+            }) => (future.get_qd(), OperationResult::Pop(data, eof)),
             Operation::Pop(FutureResult {
                 future,
                 done: Some(Err(e)),
@@ -6,10 +6,18 @@
 //======================================================================================================================
 
 use crate::{
-    catmem::SharedRingBuffer,
+    catmem::{
+        buffer_pool::{
+            BufferDescriptor,
+            LazyBufferPool,
+        },
+        SharedMessageRing,
+    },
+    collections::message_ring::MessageKind,
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
+        types::demi_sgarray_t,
     },
     QDesc,
 };
@@ -27,12 +35,22 @@ use ::std::{
 // Structures
 //======================================================================================================================
 
+/// Data that is Popped
+pub enum PopData {
+    /// Buffer that was copied out of the ring.
+    Buffer(DemiBuffer),
+    /// View on a buffer that lives in the shared memory of the queue.
+    Shared(demi_sgarray_t),
+}
+
 /// Pop Operation Descriptor
 pub struct PopFuture {
     /// Associated queue descriptor.
     qd: QDesc,
-    /// Underlying shared ring buffer.
-    ring: Rc<SharedRingBuffer<u16>>,
+    /// Underlying shared message ring.
+    ring: Rc<SharedMessageRing>,
+    /// Buffers in the shared memory of the queue.
+    pool: Rc<LazyBufferPool>,
 }
 
 //======================================================================================================================
@@ -41,12 +59,9 @@ pub struct PopFuture {
 
 /// Associate Functions for Pop Operation Descriptors
 impl PopFuture {
-    /// Maximum Size for a Pop Operation
-    const POP_SIZE_MAX: usize = 9216;
-
     /// Creates a descriptor for a pop operation.
-    pub fn new(qd: QDesc, ring: Rc<SharedRingBuffer<u16>>) -> Self {
-        PopFuture { qd, ring }
+    pub fn new(qd: QDesc, ring: Rc<SharedMessageRing>, pool: Rc<LazyBufferPool>) -> Self {
+        PopFuture { qd, ring, pool }
     }
 
     /// Returns the queue descriptor associated to the target [PopFuture].
@@ -61,47 +76,29 @@ impl PopFuture {
 
 /// Future Trait Implementation for Pop Operation Descriptors
 impl Future for PopFuture {
-    type Output = Result<(DemiBuffer, bool), Fail>;
+    type Output = Result<(PopData, bool), Fail>;
 
     /// Polls the target [PopFuture].
     fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<Self::Output> {
         let self_: &mut PopFuture = self.get_mut();
-        let mut buf: DemiBuffer = DemiBuffer::new(Self::POP_SIZE_MAX as u16);
-        let mut eof: bool = false;
-        let mut index: usize = 0;
-        loop {
-            match self_.ring.try_dequeue() {
-                Some(x) => {
-                    let (high, low): (u8, u8) = (((x >> 8) & 0xff) as u8, (x & 0xff) as u8);
-                    if high != 0 {
-                        buf.trim(Self::POP_SIZE_MAX - index)
-                            .expect("cannot trim more bytes than the buffer has");
-                        eof = true;
-                        break;
-                    } else {
-                        buf[index] = low;
-                        index += 1;
-                    }
-                },
-                None => {
-                    if index > 0 {
-                        buf.trim(Self::POP_SIZE_MAX - index)
-                            .expect("cannot trim more bytes than the buffer has");
-                        break;
-                    } else {
-                        ctx.waker().wake_by_ref();
-                        return Poll::Pending;
-                    }
-                },
-            }
+        // Read a single message. Pushers split data in messages of at most MAX_MESSAGE_SIZE bytes.
+        match self_.ring.try_pop(|len| DemiBuffer::new(len as u16)) {
+            Some((buf, MessageKind::Descriptor)) => {
+                // Expose buffer in place, instead of copying it. The pool is opened on the first buffer.
+                let result: Result<demi_sgarray_t, Fail> =
+                    BufferDescriptor::from_bytes(&buf).and_then(|descriptor| self_.pool.reader()?.view(&descriptor));
+                trace!("descriptor read (qd={:?}, ok={:?})", self_.qd, result.is_ok());
+                Poll::Ready(result.map(|sga| (PopData::Shared(sga), false)))
+            },
+            Some((buf, kind)) => {
+                let eof: bool = kind == MessageKind::Eof;
+                trace!("data read (qd={:?}, {:?} bytes, eof={:?})", self_.qd, buf.len(), eof);
+                Poll::Ready(Ok((PopData::Buffer(buf), eof)))
+            },
+            None => {
+                ctx.waker().wake_by_ref();
+                Poll::Pending
+            },
         }
-        trace!(
-            "data read (qd={:?}, {:?}/{:?} bytes, eof={:?})",
-            self_.qd,
-            buf.len(),
-            Self::POP_SIZE_MAX,
-            eof
-        );
-        Poll::Ready(Ok((buf, eof)))
     }
 }
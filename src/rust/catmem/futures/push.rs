@@ -6,7 +6,11 @@
 //======================================================================================================================
 
 use crate::{
-    catmem::SharedRingBuffer,
+    catmem::{
+        buffer_pool::BufferDescriptor,
+        SharedMessageRing,
+        MAX_MESSAGE_SIZE,
+    },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
@@ -27,16 +31,24 @@ use ::std::{
 // Structures
 //======================================================================================================================
 
+/// Data to Push
+enum PushData {
+    /// Buffer that is copied into the ring.
+    Buffer(DemiBuffer),
+    /// Buffer that lives in the shared memory of the queue, and thus only its descriptor is written into the ring.
+    Descriptor(BufferDescriptor),
+}
+
 /// Push Operation Descriptor
 pub struct PushFuture {
     /// Associated queue descriptor.
     qd: QDesc,
-    /// Write index on the underlying shared ring buffer.
+    /// Offset of the first byte of the buffer that was not yet written.
     index: usize,
-    // Underlying shared ring buffer.
-    ring: Rc<SharedRingBuffer<u16>>,
-    /// Buffer to send.
-    buf: DemiBuffer,
+    // Underlying shared message ring.
+    ring: Rc<SharedMessageRing>,
+    /// Data to send.
+    data: PushData,
 }
 
 //======================================================================================================================
@@ -46,12 +58,22 @@ pub struct PushFuture {
 /// Associate Functions for Push Operation Descriptors
 impl PushFuture {
     /// Creates a descriptor for a push operation.
-    pub fn new(qd: QDesc, ring: Rc<SharedRingBuffer<u16>>, buf: DemiBuffer) -> Self {
+    pub fn new(qd: QDesc, ring: Rc<SharedMessageRing>, buf: DemiBuffer) -> Self {
+        PushFuture {
+            qd,
+            ring,
+            index: 0,
+            data: PushData::Buffer(buf),
+        }
+    }
+
+    /// Creates a descriptor for a push operation that hands over a buffer of the shared memory of the queue.
+    pub fn new_descriptor(qd: QDesc, ring: Rc<SharedMessageRing>, descriptor: BufferDescriptor) -> Self {
         PushFuture {
             qd,
             ring,
             index: 0,
-            buf,
+            data: PushData::Descriptor(descriptor),
         }
     }
 
@@ -72,19 +94,36 @@ impl Future for PushFuture {
     /// Polls the target [PushFuture].
     fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<Self::Output> {
         let self_: &mut PushFuture = self.get_mut();
+        let buf: &DemiBuffer = match self_.data {
+            PushData::Buffer(ref buf) => buf,
+            PushData::Descriptor(ref descriptor) => match self_.ring.try_push_descriptor(&descriptor.to_bytes()) {
+                Ok(()) => {
+                    trace!("descriptor written ({:?})", descriptor);
+                    return Poll::Ready(Ok(()));
+                },
+                Err(e) if e.errno == libc::EAGAIN => {
+                    ctx.waker().wake_by_ref();
+                    return Poll::Pending;
+                },
+                Err(e) => return Poll::Ready(Err(e)),
+            },
+        };
+        let chunk_size: usize = self_.ring.max_message_size().min(MAX_MESSAGE_SIZE);
         let mut index: usize = self_.index;
-        for low in &self_.buf[index..] {
-            let x: u16 = (low & 0xff) as u16;
-            match self_.ring.try_enqueue(x) {
-                Ok(()) => index += 1,
-                Err(_) => {
+        // Write buffer as a sequence of messages.
+        while index < buf.len() {
+            let end: usize = (index + chunk_size).min(buf.len());
+            match self_.ring.try_push(&buf[index..end]) {
+                Ok(()) => index = end,
+                Err(e) if e.errno == libc::EAGAIN => {
                     self_.index = index;
                     ctx.waker().wake_by_ref();
                     return Poll::Pending;
                 },
+                Err(e) => return Poll::Ready(Err(e)),
             }
         }
-        trace!("data written ({:?}/{:?} bytes)", index, self_.buf.len());
+        trace!("data written ({:?}/{:?} bytes)", index, buf.len());
         Poll::Ready(Ok(()))
     }
 }
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod buffer_pool;
 mod futures;
 mod pipe;
 mod queue;
@@ -10,8 +11,16 @@ mod queue;
 //======================================================================================================================
 
 use self::{
+    buffer_pool::{
+        BufferDescriptor,
+        BufferPool,
+        LazyBufferPool,
+    },
     futures::{
-        pop::PopFuture,
+        pop::{
+            PopData,
+            PopFuture,
+        },
         push::PushFuture,
         Operation,
         OperationResult,
@@ -20,16 +29,20 @@ use self::{
     queue::CatmemQueue,
 };
 use crate::{
-    collections::shared_ring::SharedRingBuffer,
+    collections::shared_message_ring::SharedMessageRing,
     runtime::{
         fail::Fail,
-        memory::MemoryRuntime,
+        memory::{
+            DemiBuffer,
+            MemoryRuntime,
+        },
         queue::IoQueueTable,
         types::{
             demi_opcode_t,
             demi_qr_value_t,
             demi_qresult_t,
             demi_sgarray_t,
+            demi_sgaseg_t,
         },
         QDesc,
         QToken,
@@ -40,17 +53,21 @@ use crate::{
     },
 };
 use ::std::{
-    any::Any,
     mem,
     rc::Rc,
+    slice,
 };
 
 //======================================================================================================================
 // Constants
 //======================================================================================================================
 
+/// Capacity (in bytes) of the message ring that backs a memory queue.
 const RING_BUFFER_CAPACITY: usize = 4096;
 
+/// Maximum size (in bytes) of a message in a memory queue. Larger pushes are split into several messages.
+const MAX_MESSAGE_SIZE: usize = 9216;
+
 //======================================================================================================================
 // Structures
 //======================================================================================================================
@@ -59,6 +76,8 @@ const RING_BUFFER_CAPACITY: usize = 4096;
 pub struct CatmemLibOS {
     qtable: IoQueueTable<CatmemQueue>,
     scheduler: Scheduler,
+    /// Buffer pools of all memory queues, including those that were closed but still have buffers in use.
+    pools: Vec<Rc<LazyBufferPool>>,
 }
 
 //======================================================================================================================
@@ -78,6 +97,7 @@ impl CatmemLibOS {
         CatmemLibOS {
             qtable: IoQueueTable::<CatmemQueue>::new(),
             scheduler: Scheduler::default(),
+            pools: Vec::new(),
         }
     }
 
@@ -85,8 +105,10 @@ impl CatmemLibOS {
     pub fn create_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
         trace!("create_pipe() name={:?}", name);
 
-        let ring: SharedRingBuffer<u16> = SharedRingBuffer::<u16>::create(name, RING_BUFFER_CAPACITY)?;
-        let qd: QDesc = self.qtable.alloc(CatmemQueue::new(ring));
+        let ring: SharedMessageRing = SharedMessageRing::create(name, RING_BUFFER_CAPACITY)?;
+        let pool: Rc<LazyBufferPool> = Rc::new(LazyBufferPool::new(Self::pool_name(name)));
+        self.register_pool(pool.clone());
+        let qd: QDesc = self.qtable.alloc(CatmemQueue::new(ring, pool));
 
         Ok(qd)
     }
@@ -95,18 +117,37 @@ impl CatmemLibOS {
     pub fn open_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
         trace!("open_pipe() name={:?}", name);
 
-        let ring: SharedRingBuffer<u16> = SharedRingBuffer::<u16>::open(name, RING_BUFFER_CAPACITY)?;
-        let qd: QDesc = self.qtable.alloc(CatmemQueue::new(ring));
+        let ring: SharedMessageRing = SharedMessageRing::open(name, RING_BUFFER_CAPACITY)?;
+        let pool: Rc<LazyBufferPool> = Rc::new(LazyBufferPool::new(Self::pool_name(name)));
+        self.register_pool(pool.clone());
+        let qd: QDesc = self.qtable.alloc(CatmemQueue::new(ring, pool));
 
         Ok(qd)
     }
 
-    // Pushes EoF.
-    fn push_eof(&mut self, ring: Rc<SharedRingBuffer<u16>>) -> Result<(), Fail> {
-        let x: u16 = ((1 & 0xff) << 8) as u16;
+    /// Returns the name of the shared memory region that holds the buffer pool of a memory queue.
+    fn pool_name(name: &str) -> String {
+        format!("{}.buffers", name)
+    }
+
+    /// Registers the buffer pool of a memory queue, and forgets about pools of closed queues that are no longer used.
+    fn register_pool(&mut self, pool: Rc<LazyBufferPool>) {
+        self.pools.retain(|pool| Rc::strong_count(pool) > 1 || pool.in_use());
+        self.pools.push(pool);
+    }
+
+    /// Finds the buffer pool from which a scatter-gather array was allocated (or popped), if any.
+    fn find_pool(&self, sga: &demi_sgarray_t) -> Option<Rc<BufferPool>> {
+        self.pools
+            .iter()
+            .filter_map(|pool| pool.get())
+            .find(|pool| pool.contains(sga))
+    }
 
+    // Pushes EoF.
+    fn push_eof(&mut self, ring: Rc<SharedMessageRing>) -> Result<(), Fail> {
         loop {
-            match ring.try_enqueue(x) {
+            match ring.try_push_eof() {
                 Ok(()) => break,
                 Err(_) => {
                     warn!("failed to push EoF")
@@ -151,36 +192,46 @@ impl CatmemLibOS {
     pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
         trace!("push() qd={:?}", qd);
 
-        match self.clone_sgarray(sga) {
-            Ok(buf) => {
-                if buf.len() == 0 {
-                    return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
-                }
+        let pipe: &Pipe = match self.qtable.get(&qd) {
+            Some(queue) => queue.get_pipe(),
+            None => return Err(Fail::new(libc::EBADF, "invalid queue descriptor")),
+        };
 
-                // Issue push operation.
-                match self.qtable.get(&qd) {
-                    Some(queue) => {
-                        let pipe: &Pipe = queue.get_pipe();
-                        // Handle end of file.
-                        if pipe.eof() {
-                            let cause: String = format!("end of file (qd={:?})", qd);
-                            error!("push(): {:?}", cause);
-                            return Err(Fail::new(libc::ECONNRESET, &cause));
-                        }
-                        let future: Operation = Operation::from(PushFuture::new(qd, pipe.buffer(), buf));
-                        let handle: SchedulerHandle = match self.scheduler.insert(future) {
-                            Some(handle) => handle,
-                            None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
-                        };
-                        let qt: QToken = handle.into_raw().into();
-                        trace!("push() qt={:?}", qt);
-                        Ok(qt)
-                    },
-                    None => Err(Fail::new(libc::EBADF, "invalid queue descriptor")),
-                }
-            },
-            Err(e) => Err(e),
+        // Handle end of file.
+        if pipe.eof() {
+            let cause: String = format!("end of file (qd={:?})", qd);
+            error!("push(): {:?}", cause);
+            return Err(Fail::new(libc::ECONNRESET, &cause));
         }
+
+        let future: PushFuture = if let Some(pool) = pipe.pool().get().filter(|pool| pool.contains(sga)) {
+            // The buffer lives in the shared memory of the pipe, so hand it over instead of copying it.
+            let descriptor: BufferDescriptor = pool.publish(sga)?;
+            PushFuture::new_descriptor(qd, pipe.buffer(), descriptor)
+        } else {
+            let buf: DemiBuffer = match self.find_pool(sga) {
+                // The buffer lives in the shared memory of some other pipe.
+                Some(_) => Self::copy_sgarray(sga)?,
+                // The data is copied into the pipe anyway, so gather the segments of buffer chains up front.
+                None => match self.clone_sgarray(sga)? {
+                    buf if buf.nb_segs() > 1 => buf.coalesce()?,
+                    buf => buf,
+                },
+            };
+            if buf.pkt_len() == 0 {
+                return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
+            }
+            PushFuture::new(qd, pipe.buffer(), buf)
+        };
+
+        // Issue push operation.
+        let handle: SchedulerHandle = match self.scheduler.insert(Operation::from(future)) {
+            Some(handle) => handle,
+            None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
+        };
+        let qt: QToken = handle.into_raw().into();
+        trace!("push() qt={:?}", qt);
+        Ok(qt)
     }
 
     /// Pops data from a socket.
@@ -199,7 +250,7 @@ impl CatmemLibOS {
                     return Err(Fail::new(libc::ECONNRESET, &cause));
                 }
 
-                let future: Operation = Operation::from(PopFuture::new(qd, pipe.buffer()));
+                let future: Operation = Operation::from(PopFuture::new(qd, pipe.buffer(), pipe.pool()));
                 let handle: SchedulerHandle = match self.scheduler.insert(future) {
                     Some(handle) => handle,
                     None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -217,17 +268,38 @@ impl CatmemLibOS {
         MemoryRuntime::alloc_sgarray(self, size)
     }
 
+    /// Allocates a scatter-gather array in the shared memory of a memory queue. Pushing it to that queue hands over
+    /// the underlying memory to the other end, instead of copying it. The shared memory is created on the first
+    /// allocation, and only this end of the queue may allocate from it afterwards.
+    pub fn alloc_shared_sgarray(&self, qd: QDesc, size: usize) -> Result<demi_sgarray_t, Fail> {
+        trace!("alloc_shared_sgarray() qd={:?}, size={:?}", qd, size);
+        match self.qtable.get(&qd) {
+            Some(queue) => queue.get_pipe().pool().writer()?.alloc_sgarray(size),
+            None => Err(Fail::new(libc::EBADF, "invalid queue descriptor")),
+        }
+    }
+
     /// Releases a scatter-gather array.
     pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        MemoryRuntime::free_sgarray(self, sga)
+        match self.find_pool(&sga) {
+            Some(pool) => pool.free_sgarray(sga),
+            None => MemoryRuntime::free_sgarray(self, sga),
+        }
+    }
+
+    /// Copies the data of a single-segment scatter-gather array into a new buffer.
+    fn copy_sgarray(sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
+        let seg: &demi_sgaseg_t = &sga.sga_segs[0];
+        // Safety: the segment was handed out by one of our buffer pools and it refers to mapped memory.
+        let data: &[u8] = unsafe { slice::from_raw_parts(seg.sgaseg_buf as *const u8, seg.sgaseg_len as usize) };
+        DemiBuffer::try_from(data)
     }
 
     /// Takes out the [OperationResult] associated with the target [SchedulerHandle].
     fn take_result(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.scheduler.take(handle).as_any();
-        let boxed_concrete_type: Operation = *boxed_future.downcast::<Operation>().expect("Wrong type!");
+        let operation: Operation = self.scheduler.take(handle);
 
-        boxed_concrete_type.get_result()
+        operation.get_result()
     }
 
     pub fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
@@ -237,6 +309,11 @@ impl CatmemLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, result): (QDesc, OperationResult) = self.take_result(handle);
         let qr = match result {
@@ -247,7 +324,7 @@ impl CatmemLibOS {
                 qr_ret: 0,
                 qr_value: unsafe { mem::zeroed() },
             },
-            OperationResult::Pop(bytes, eof) => {
+            OperationResult::Pop(data, eof) => {
                 // Handle end of file.
                 if eof {
                     let queue: &mut CatmemQueue = self.qtable.get_mut(&qd).expect("unregisted queue descriptor");
@@ -255,7 +332,11 @@ impl CatmemLibOS {
                     pipe.set_eof();
                 }
 
-                match self.into_sgarray(bytes) {
+                let sga: Result<demi_sgarray_t, Fail> = match data {
+                    PopData::Buffer(bytes) => self.into_sgarray(bytes),
+                    PopData::Shared(sga) => Ok(sga),
+                };
+                match sga {
                     Ok(sga) => {
                         let qr_value: demi_qr_value_t = demi_qr_value_t { sga };
                         demi_qresult_t {
@@ -292,7 +373,7 @@ impl CatmemLibOS {
         Ok(qr)
     }
 
-    pub fn poll(&self) {
+    pub fn poll(&self) -> bool {
         self.scheduler.poll()
     }
 }
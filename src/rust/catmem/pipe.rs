@@ -5,7 +5,8 @@
 // Imports
 //======================================================================================================================
 
-use crate::collections::shared_ring::SharedRingBuffer;
+use super::buffer_pool::LazyBufferPool;
+use crate::collections::shared_message_ring::SharedMessageRing;
 use ::std::rc::Rc;
 
 //======================================================================================================================
@@ -17,7 +18,9 @@ pub struct Pipe {
     /// Indicates end of file.
     eof: bool,
     /// Underlying buffer.
-    buffer: Rc<SharedRingBuffer<u16>>,
+    buffer: Rc<SharedMessageRing>,
+    /// Buffers in the shared memory of the pipe.
+    pool: Rc<LazyBufferPool>,
 }
 
 //======================================================================================================================
@@ -26,10 +29,11 @@ pub struct Pipe {
 
 impl Pipe {
     /// Creates a new pipe.
-    pub fn new(buffer: SharedRingBuffer<u16>) -> Self {
+    pub fn new(buffer: SharedMessageRing, pool: Rc<LazyBufferPool>) -> Self {
         Self {
             eof: false,
             buffer: Rc::new(buffer),
+            pool,
         }
     }
 
@@ -44,7 +48,12 @@ impl Pipe {
     }
 
     /// Gets a reference to the underlying buffer of the target pipe.
-    pub fn buffer(&self) -> Rc<SharedRingBuffer<u16>> {
+    pub fn buffer(&self) -> Rc<SharedMessageRing> {
         self.buffer.clone()
     }
+
+    /// Gets a reference to the buffer pool of the target pipe.
+    pub fn pool(&self) -> Rc<LazyBufferPool> {
+        self.pool.clone()
+    }
 }
@@ -5,14 +5,18 @@
 // Imports
 //======================================================================================================================
 
-use super::pipe::Pipe;
+use super::{
+    buffer_pool::LazyBufferPool,
+    pipe::Pipe,
+};
 use crate::{
-    collections::shared_ring::SharedRingBuffer,
+    collections::shared_message_ring::SharedMessageRing,
     runtime::{
         queue::IoQueue,
         QType,
     },
 };
+use ::std::rc::Rc;
 
 //======================================================================================================================
 // Structures
@@ -28,8 +32,10 @@ pub struct CatmemQueue {
 //======================================================================================================================
 
 impl CatmemQueue {
-    pub fn new(ring: SharedRingBuffer<u16>) -> Self {
-        Self { pipe: Pipe::new(ring) }
+    pub fn new(ring: SharedMessageRing, pool: Rc<LazyBufferPool>) -> Self {
+        Self {
+            pipe: Pipe::new(ring, pool),
+        }
     }
 
     /// Get underlying uni-directional pipe.
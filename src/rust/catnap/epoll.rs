@@ -0,0 +1,250 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::runtime::fail::Fail;
+use ::std::{
+    cell::{
+        RefCell,
+        RefMut,
+    },
+    collections::HashMap,
+    os::unix::prelude::RawFd,
+    ptr,
+    task::Waker,
+    time::Duration,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Maximum number of events that are retrieved at once.
+const EPOLL_BATCH_SIZE: usize = 64;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Tasks that wait for a socket to become ready.
+#[derive(Default)]
+struct Waiters {
+    /// Tasks that wait for the socket to become readable.
+    readers: Vec<Waker>,
+    /// Tasks that wait for the socket to become writable.
+    writers: Vec<Waker>,
+}
+
+/// Epoll Instance
+///
+/// Sockets are registered in edge-triggered mode, so the kernel reports each change of readiness only once. Operations
+/// therefore always try their system call first, and only wait when it fails with `EAGAIN`. Then, they are not polled
+/// again until the socket becomes ready.
+pub struct Epoll {
+    /// Underlying epoll file descriptor.
+    epfd: RawFd,
+    /// Waiting tasks, indexed by registered socket.
+    waiters: RefCell<HashMap<RawFd, Waiters>>,
+    /// Scratch list of events. It is kept around to avoid allocations.
+    events: RefCell<Vec<libc::epoll_event>>,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Epoll Instances
+impl Epoll {
+    /// Creates an epoll instance.
+    pub fn new() -> Result<Self, Fail> {
+        match unsafe { libc::epoll_create1(libc::EPOLL_CLOEXEC) } {
+            epfd if epfd >= 0 => Ok(Self {
+                epfd,
+                waiters: RefCell::new(HashMap::new()),
+                events: RefCell::new(vec![libc::epoll_event { events: 0, u64: 0 }; EPOLL_BATCH_SIZE]),
+            }),
+            _ => {
+                let errno: libc::c_int = unsafe { *libc::__errno_location() };
+                Err(Fail::new(errno, "failed to create epoll instance"))
+            },
+        }
+    }
+
+    /// Registers a socket.
+    pub fn register(&self, fd: RawFd) -> Result<(), Fail> {
+        let mut event: libc::epoll_event = libc::epoll_event {
+            events: (libc::EPOLLIN | libc::EPOLLOUT | libc::EPOLLRDHUP | libc::EPOLLET) as u32,
+            u64: fd as u64,
+        };
+        if unsafe { libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_ADD, fd, &mut event) } != 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            error!("failed to register socket (fd={:?}, errno={:?})", fd, errno);
+            return Err(Fail::new(errno, "failed to register socket"));
+        }
+        self.waiters.borrow_mut().insert(fd, Waiters::default());
+        Ok(())
+    }
+
+    /// Deregisters a socket that is about to be closed. Tasks that wait on it are woken up.
+    pub fn deregister(&self, fd: RawFd) {
+        if let Some(waiters) = self.waiters.borrow_mut().remove(&fd) {
+            unsafe { libc::epoll_ctl(self.epfd, libc::EPOLL_CTL_DEL, fd, ptr::null_mut()) };
+            waiters.readers.into_iter().chain(waiters.writers).for_each(Waker::wake);
+        }
+    }
+
+    /// Wakes `waker` up once `fd` becomes readable.
+    pub fn wait_readable(&self, fd: RawFd, waker: &Waker) {
+        self.wait(fd, waker, |waiters| &mut waiters.readers)
+    }
+
+    /// Wakes `waker` up once `fd` becomes writable.
+    pub fn wait_writable(&self, fd: RawFd, waker: &Waker) {
+        self.wait(fd, waker, |waiters| &mut waiters.writers)
+    }
+
+    /// Retrieves readiness events, and wakes up the tasks that wait for them. This blocks for up to `timeout`, or
+    /// forever if it is not set. Returns the number of events.
+    pub fn poll(&self, timeout: Option<Duration>) -> usize {
+        let timeout_ms: libc::c_int = match timeout {
+            // Round up, so as to not spin when less than a millisecond is left.
+            Some(timeout) => ((timeout.as_micros() + 999) / 1000).min(libc::c_int::MAX as u128) as libc::c_int,
+            None => -1,
+        };
+        let mut events: RefMut<Vec<libc::epoll_event>> = self.events.borrow_mut();
+        let nevents: libc::c_int = unsafe {
+            libc::epoll_wait(
+                self.epfd,
+                events.as_mut_ptr(),
+                EPOLL_BATCH_SIZE as libc::c_int,
+                timeout_ms,
+            )
+        };
+        if nevents < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            if errno != libc::EINTR {
+                warn!("epoll_wait() failed (errno={:?})", errno);
+            }
+            return 0;
+        }
+
+        let mut waiters: RefMut<HashMap<RawFd, Waiters>> = self.waiters.borrow_mut();
+        for event in &events[..nevents as usize] {
+            let flags: u32 = event.events;
+            if let Some(waiters) = waiters.get_mut(&(event.u64 as RawFd)) {
+                // Errors and hang ups are reported to both readers and writers.
+                let failed: bool = flags & (libc::EPOLLERR | libc::EPOLLHUP) as u32 != 0;
+                if failed || flags & (libc::EPOLLIN | libc::EPOLLRDHUP) as u32 != 0 {
+                    waiters.readers.drain(..).for_each(Waker::wake);
+                }
+                if failed || flags & libc::EPOLLOUT as u32 != 0 {
+                    waiters.writers.drain(..).for_each(Waker::wake);
+                }
+            }
+        }
+        nevents as usize
+    }
+
+    /// Adds `waker` to the tasks that wait on `fd`, in the list that `select` picks.
+    fn wait(&self, fd: RawFd, waker: &Waker, select: fn(&mut Waiters) -> &mut Vec<Waker>) {
+        match self.waiters.borrow_mut().get_mut(&fd) {
+            Some(waiters) => {
+                let list: &mut Vec<Waker> = select(waiters);
+                if !list.iter().any(|other| other.will_wake(waker)) {
+                    list.push(waker.clone());
+                }
+            },
+            // The socket is not registered, so fall back to polling it.
+            None => waker.wake_by_ref(),
+        }
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Drop Trait Implementation for Epoll Instances
+impl Drop for Epoll {
+    fn drop(&mut self) {
+        unsafe { libc::close(self.epfd) };
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::Epoll;
+    use ::std::{
+        os::unix::prelude::RawFd,
+        sync::{
+            atomic::{
+                AtomicBool,
+                Ordering,
+            },
+            Arc,
+        },
+        task::{
+            Wake,
+            Waker,
+        },
+        time::Duration,
+    };
+
+    /// Waker that records whether it was woken up.
+    #[derive(Default)]
+    struct Flag(AtomicBool);
+
+    impl Wake for Flag {
+        fn wake(self: Arc<Self>) {
+            self.0.store(true, Ordering::SeqCst);
+        }
+    }
+
+    #[test]
+    fn wake_readers_on_data() {
+        let mut fds: [RawFd; 2] = [0; 2];
+        assert_eq!(
+            unsafe {
+                libc::socketpair(
+                    libc::AF_UNIX,
+                    libc::SOCK_STREAM | libc::SOCK_NONBLOCK,
+                    0,
+                    fds.as_mut_ptr(),
+                )
+            },
+            0
+        );
+        let epoll: Epoll = Epoll::new().expect("epoll instance should be created");
+        epoll.register(fds[0]).expect("socket should be registered");
+
+        // The socket is writable right away, but nothing was sent yet.
+        let flag: Arc<Flag> = Arc::new(Flag::default());
+        let waker: Waker = Waker::from(flag.clone());
+        epoll.wait_readable(fds[0], &waker);
+        epoll.wait_readable(fds[0], &waker);
+        epoll.poll(Some(Duration::ZERO));
+        assert!(!flag.0.load(Ordering::SeqCst));
+
+        // Once data arrives, the reader is woken up. Since the socket is edge-triggered, it is reported only once.
+        assert_eq!(
+            unsafe { libc::write(fds[1], b"x".as_ptr() as *const libc::c_void, 1) },
+            1
+        );
+        assert_eq!(epoll.poll(Some(Duration::from_secs(1))), 1);
+        assert!(flag.0.load(Ordering::SeqCst));
+        assert_eq!(epoll.poll(Some(Duration::ZERO)), 0);
+
+        epoll.deregister(fds[0]);
+        unsafe {
+            libc::close(fds[0]);
+            libc::close(fds[1]);
+        }
+    }
+}
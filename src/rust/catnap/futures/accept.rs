@@ -6,6 +6,7 @@
 //==============================================================================
 
 use crate::{
+    catnap::PosixRuntime,
     pal::linux,
     runtime::{
         fail::Fail,
@@ -30,6 +31,8 @@ use ::std::{
 
 /// Accept Operation Descriptor
 pub struct AcceptFuture {
+    /// Underlying runtime.
+    rt: PosixRuntime,
     /// Associated queue descriptor.
     qd: QDesc,
     /// Underlying file descriptor.
@@ -47,8 +50,9 @@ pub struct AcceptFuture {
 /// Associate Functions for Accept Operation Descriptors
 impl AcceptFuture {
     /// Creates a descriptor for an accept operation.
-    pub fn new(qd: QDesc, fd: RawFd, new_qd: QDesc) -> Self {
+    pub fn new(rt: PosixRuntime, qd: QDesc, fd: RawFd, new_qd: QDesc) -> Self {
         Self {
+            rt,
             qd,
             fd,
             new_qd,
@@ -116,7 +120,7 @@ impl Future for AcceptFuture {
 
                 if errno == libc::EWOULDBLOCK || errno == libc::EAGAIN {
                     // Operation in progress.
-                    ctx.waker().wake_by_ref();
+                    self_.rt.wait_readable(self_.fd, ctx.waker());
                     return Poll::Pending;
                 } else {
                     // Operation failed.
@@ -6,6 +6,7 @@
 //==============================================================================
 
 use crate::{
+    catnap::PosixRuntime,
     pal::linux,
     runtime::{
         fail::Fail,
@@ -30,6 +31,8 @@ use ::std::{
 
 /// Connect Operation Descriptor
 pub struct ConnectFuture {
+    /// Underlying runtime.
+    rt: PosixRuntime,
     /// Associated queue descriptor.
     qd: QDesc,
     // Underlying file descriptor.
@@ -45,8 +48,9 @@ pub struct ConnectFuture {
 /// Associate Functions for Connect Operation Descriptors
 impl ConnectFuture {
     /// Creates a descriptor for a connect operation.
-    pub fn new(qd: QDesc, fd: RawFd, addr: SocketAddrV4) -> Self {
+    pub fn new(rt: PosixRuntime, qd: QDesc, fd: RawFd, addr: SocketAddrV4) -> Self {
         Self {
+            rt,
             qd,
             fd,
             sockaddr: linux::socketaddrv4_to_sockaddr_in(&addr),
@@ -89,7 +93,7 @@ impl Future for ConnectFuture {
 
                 // Operation in progress.
                 if errno == libc::EINPROGRESS || errno == libc::EALREADY {
-                    ctx.waker().wake_by_ref();
+                    self_.rt.wait_writable(self_.fd, ctx.waker());
                     return Poll::Pending;
                 }
                 // Operation failed.
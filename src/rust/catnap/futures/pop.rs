@@ -6,6 +6,7 @@
 //==============================================================================
 
 use crate::{
+    catnap::PosixRuntime,
     pal::linux,
     runtime::{
         fail::Fail,
@@ -38,6 +39,8 @@ const POP_SIZE: usize = 9216;
 
 /// Pop Operation Descriptor
 pub struct PopFuture {
+    /// Underlying runtime.
+    rt: PosixRuntime,
     /// Associated queue descriptor.
     qd: QDesc,
     /// Underlying file descriptor.
@@ -55,8 +58,9 @@ pub struct PopFuture {
 /// Associate Functions for Pop Operation Descriptors
 impl PopFuture {
     /// Creates a descriptor for a pop operation.
-    pub fn new(qd: QDesc, fd: RawFd) -> Self {
+    pub fn new(rt: PosixRuntime, qd: QDesc, fd: RawFd) -> Self {
         Self {
+            rt,
             qd,
             fd,
             sockaddr: unsafe { mem::zeroed() },
@@ -106,7 +110,7 @@ impl Future for PopFuture {
 
                 // Operation in progress.
                 if errno == libc::EWOULDBLOCK || errno == libc::EAGAIN {
-                    ctx.waker().wake_by_ref();
+                    self_.rt.wait_readable(self_.fd, ctx.waker());
                     return Poll::Pending;
                 }
                 // Operation failed.
@@ -6,6 +6,7 @@
 //==============================================================================
 
 use crate::{
+    catnap::PosixRuntime,
     pal::linux,
     runtime::{
         fail::Fail,
@@ -19,7 +20,6 @@ use ::std::{
     net::SocketAddrV4,
     os::unix::prelude::RawFd,
     pin::Pin,
-    ptr,
     task::{
         Context,
         Poll,
@@ -32,12 +32,16 @@ use ::std::{
 
 /// Push Operation Descriptor
 pub struct PushFuture {
+    /// Underlying runtime.
+    rt: PosixRuntime,
     /// Associated queue descriptor.
     qd: QDesc,
     // Underlying file descriptor.
     fd: RawFd,
     /// Buffer to send.
     buf: DemiBuffer,
+    /// I/O vector that points to each segment of the buffer.
+    iovecs: Vec<libc::iovec>,
     /// Destination address.
     sockaddr: Option<libc::sockaddr_in>,
 }
@@ -49,14 +53,29 @@ pub struct PushFuture {
 /// Associate Functions for Push Operation Descriptors
 impl PushFuture {
     /// Creates a descriptor for a pushto operation.
-    pub fn new(qd: QDesc, fd: RawFd, buf: DemiBuffer, addr: Option<SocketAddrV4>) -> Self {
+    pub fn new(rt: PosixRuntime, qd: QDesc, fd: RawFd, buf: DemiBuffer, addr: Option<SocketAddrV4>) -> Self {
         let sockaddr: Option<libc::sockaddr_in> = if let Some(addr) = addr {
             Some(linux::socketaddrv4_to_sockaddr_in(&addr))
         } else {
             None
         };
 
-        Self { qd, fd, buf, sockaddr }
+        let iovecs: Vec<libc::iovec> = buf
+            .segments()
+            .map(|segment| libc::iovec {
+                iov_base: segment.as_ptr() as *mut libc::c_void,
+                iov_len: segment.len(),
+            })
+            .collect();
+
+        Self {
+            rt,
+            qd,
+            fd,
+            buf,
+            iovecs,
+            sockaddr,
+        }
     }
 
     /// Returns the queue descriptor associated to the target [PushFuture].
@@ -76,27 +95,19 @@ impl Future for PushFuture {
     /// Polls the target [PushFuture].
     fn poll(self: Pin<&mut Self>, ctx: &mut Context<'_>) -> Poll<Self::Output> {
         let self_: &mut PushFuture = self.get_mut();
-        match unsafe {
-            let (addr, addrlen): (*const libc::sockaddr, u32) = if self_.sockaddr.is_some() {
-                (
-                    (self_.sockaddr.as_ref().unwrap() as *const libc::sockaddr_in) as *const libc::sockaddr,
-                    mem::size_of_val(&self_.sockaddr.unwrap()) as u32,
-                )
-            } else {
-                (ptr::null(), 0)
-            };
-            libc::sendto(
-                self_.fd,
-                (self_.buf.as_ptr() as *const u8) as *const libc::c_void,
-                self_.buf.len(),
-                libc::MSG_DONTWAIT,
-                addr,
-                addrlen,
-            )
-        } {
+        // Send all segments of the buffer at once.
+        // Safety: the message header is a plain C struct, for which all zeros is valid.
+        let mut msg: libc::msghdr = unsafe { mem::zeroed() };
+        msg.msg_iov = self_.iovecs.as_mut_ptr();
+        msg.msg_iovlen = self_.iovecs.len();
+        if let Some(ref mut sockaddr) = self_.sockaddr {
+            msg.msg_name = (sockaddr as *mut libc::sockaddr_in) as *mut libc::c_void;
+            msg.msg_namelen = mem::size_of::<libc::sockaddr_in>() as u32;
+        }
+        match unsafe { libc::sendmsg(self_.fd, &msg, libc::MSG_DONTWAIT) } {
             // Operation completed.
             nbytes if nbytes >= 0 => {
-                trace!("data pushed ({:?}/{:?} bytes)", nbytes, self_.buf.len());
+                trace!("data pushed ({:?}/{:?} bytes)", nbytes, self_.buf.pkt_len());
                 Poll::Ready(Ok(()))
             },
 
@@ -106,7 +117,7 @@ impl Future for PushFuture {
 
                 // Operation in progress.
                 if errno == libc::EWOULDBLOCK || errno == libc::EAGAIN {
-                    ctx.waker().wake_by_ref();
+                    self_.rt.wait_writable(self_.fd, ctx.waker());
                     return Poll::Pending;
                 }
                 // Operation failed.
@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod epoll;
 mod futures;
 mod queue;
 mod runtime;
@@ -50,10 +51,10 @@ use crate::{
     scheduler::SchedulerHandle,
 };
 use ::std::{
-    any::Any,
     mem,
     net::SocketAddrV4,
     os::unix::prelude::RawFd,
+    time::Duration,
 };
 
 //==============================================================================
@@ -122,6 +123,11 @@ impl CatnapLibOS {
                     }
                 }
 
+                // Register socket for readiness notifications. Operations on it fall back to polling otherwise.
+                if let Err(e) = self.runtime.register(fd) {
+                    warn!("cannot wait for readiness of socket ({:?})", e);
+                }
+
                 trace!("socket: {:?}, domain: {:?}, typ: {:?}", fd, domain, typ);
                 let qd: QDesc = self.qtable.alloc(CatnapQueue::new(qtype, Some(fd)));
                 Ok(qd)
@@ -223,7 +229,7 @@ impl CatnapLibOS {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
                     let new_qd: QDesc = self.qtable.alloc(CatnapQueue::new(QType::TcpSocket, None));
-                    let future: Operation = Operation::from(AcceptFuture::new(qd, fd, new_qd));
+                    let future: Operation = Operation::from(AcceptFuture::new(self.runtime.clone(), qd, fd, new_qd));
                     match self.runtime.scheduler.insert(future) {
                         Some(handle) => Ok(handle.into_raw().into()),
                         None => {
@@ -246,7 +252,7 @@ impl CatnapLibOS {
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
-                    let future: Operation = Operation::from(ConnectFuture::new(qd, fd, remote));
+                    let future: Operation = Operation::from(ConnectFuture::new(self.runtime.clone(), qd, fd, remote));
                     let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                         Some(handle) => handle,
                         None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -264,9 +270,12 @@ impl CatnapLibOS {
         trace!("close() qd={:?}", qd);
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
-                Some(fd) => match unsafe { libc::close(fd) } {
-                    stats if stats == 0 => (),
-                    _ => return Err(Fail::new(libc::EBADF, "invalid queue descriptor")),
+                Some(fd) => {
+                    self.runtime.deregister(fd);
+                    match unsafe { libc::close(fd) } {
+                        stats if stats == 0 => (),
+                        _ => return Err(Fail::new(libc::EBADF, "invalid queue descriptor")),
+                    }
                 },
                 None => unreachable!("CatnapQueue has invalid underlying file descriptor"),
             },
@@ -283,6 +292,7 @@ impl CatnapLibOS {
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
+                    self.runtime.deregister(fd);
                     let future: Operation = Operation::from(CloseFuture::new(qd, fd));
                     let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                         Some(handle) => handle,
@@ -302,7 +312,7 @@ impl CatnapLibOS {
 
         match self.runtime.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
 
@@ -310,7 +320,8 @@ impl CatnapLibOS {
                 match self.qtable.get(&qd) {
                     Some(queue) => match queue.get_fd() {
                         Some(fd) => {
-                            let future: Operation = Operation::from(PushFuture::new(qd, fd, buf, None));
+                            let future: Operation =
+                                Operation::from(PushFuture::new(self.runtime.clone(), qd, fd, buf, None));
                             let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                                 Some(handle) => handle,
                                 None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -332,7 +343,7 @@ impl CatnapLibOS {
 
         match self.runtime.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
 
@@ -340,7 +351,8 @@ impl CatnapLibOS {
                 match self.qtable.get(&qd) {
                     Some(queue) => match queue.get_fd() {
                         Some(fd) => {
-                            let future: Operation = Operation::from(PushFuture::new(qd, fd, buf, Some(remote)));
+                            let future: Operation =
+                                Operation::from(PushFuture::new(self.runtime.clone(), qd, fd, buf, Some(remote)));
                             let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                                 Some(handle) => handle,
                                 None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -364,7 +376,7 @@ impl CatnapLibOS {
         match self.qtable.get(&qd) {
             Some(queue) => match queue.get_fd() {
                 Some(fd) => {
-                    let future: Operation = Operation::from(PopFuture::new(qd, fd));
+                    let future: Operation = Operation::from(PopFuture::new(self.runtime.clone(), qd, fd));
                     let handle: SchedulerHandle = match self.runtime.scheduler.insert(future) {
                         Some(handle) => handle,
                         None => return Err(Fail::new(libc::EAGAIN, "cannot schedule co-routine")),
@@ -378,8 +390,13 @@ impl CatnapLibOS {
         }
     }
 
-    pub fn poll(&self) {
-        self.runtime.scheduler.poll()
+    pub fn poll(&self) -> bool {
+        self.runtime.poll()
+    }
+
+    /// Blocks until some socket becomes ready or `timeout` expires. See [PosixRuntime::park].
+    pub fn park(&self, timeout: Option<Duration>) {
+        self.runtime.park(timeout)
     }
 
     pub fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
@@ -389,6 +406,11 @@ impl CatnapLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.runtime.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, r): (QDesc, OperationResult) = self.take_result(handle);
         Ok(pack_result(&self.runtime, r, qd, qt.into()))
@@ -408,11 +430,9 @@ impl CatnapLibOS {
 
     /// Takes out the [OperationResult] associated with the target [SchedulerHandle].
     fn take_result(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.runtime.scheduler.take(handle).as_any();
-        let boxed_concrete_type: Operation = *boxed_future.downcast::<Operation>().expect("Wrong type!");
+        let operation: Operation = self.runtime.scheduler.take(handle);
 
-        let (qd, new_qd, new_fd, qr): (QDesc, Option<QDesc>, Option<RawFd>, OperationResult) =
-            boxed_concrete_type.get_result();
+        let (qd, new_qd, new_fd, qr): (QDesc, Option<QDesc>, Option<RawFd>, OperationResult) = operation.get_result();
 
         // Handle accept operation.
         if let Some(new_qd) = new_qd {
@@ -421,6 +441,9 @@ impl CatnapLibOS {
                 match self.qtable.get_mut(&new_qd) {
                     Some(queue) => match qr {
                         OperationResult::Accept((_, addr)) => {
+                            if let Err(e) = self.runtime.register(new_fd) {
+                                warn!("cannot wait for readiness of socket ({:?})", e);
+                            }
                             queue.set_fd(new_fd);
                             queue.set_addr(addr);
                         },
@@ -5,13 +5,21 @@
 // Imports
 //==============================================================================
 
+use super::epoll::Epoll;
 use crate::{
     runtime::{
+        fail::Fail,
         memory::MemoryRuntime,
         Runtime,
     },
     scheduler::scheduler::Scheduler,
 };
+use ::std::{
+    os::unix::prelude::RawFd,
+    rc::Rc,
+    task::Waker,
+    time::Duration,
+};
 
 //==============================================================================
 // Structures
@@ -22,6 +30,8 @@ use crate::{
 pub struct PosixRuntime {
     /// Scheduler
     pub scheduler: Scheduler,
+    /// Readiness notifications of sockets.
+    epoll: Rc<Epoll>,
 }
 
 //==============================================================================
@@ -33,6 +43,43 @@ impl PosixRuntime {
     pub fn new() -> Self {
         Self {
             scheduler: Scheduler::default(),
+            epoll: Rc::new(Epoll::new().expect("cannot create epoll instance")),
+        }
+    }
+
+    /// Registers a socket for readiness notifications.
+    pub fn register(&self, fd: RawFd) -> Result<(), Fail> {
+        self.epoll.register(fd)
+    }
+
+    /// Deregisters a socket that is about to be closed.
+    pub fn deregister(&self, fd: RawFd) {
+        self.epoll.deregister(fd)
+    }
+
+    /// Wakes `waker` up once `fd` becomes readable.
+    pub fn wait_readable(&self, fd: RawFd, waker: &Waker) {
+        self.epoll.wait_readable(fd, waker)
+    }
+
+    /// Wakes `waker` up once `fd` becomes writable.
+    pub fn wait_writable(&self, fd: RawFd, waker: &Waker) {
+        self.epoll.wait_writable(fd, waker)
+    }
+
+    /// Polls the runtime. Tasks that wait for sockets that became ready are woken up and run. Returns whether any socket
+    /// became ready: tasks that cannot wait for readiness retry by waking themselves up, so running tasks does not tell
+    /// whether anything happened.
+    pub fn poll(&self) -> bool {
+        let nevents: usize = self.epoll.poll(Some(Duration::ZERO));
+        self.scheduler.poll();
+        nevents > 0
+    }
+
+    /// Blocks until some socket becomes ready or `timeout` expires, unless some task is ready to run already.
+    pub fn park(&self, timeout: Option<Duration>) {
+        if !self.scheduler.has_ready() {
+            self.epoll.poll(timeout);
         }
     }
 }
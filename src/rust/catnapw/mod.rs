@@ -69,7 +69,6 @@ use ::socket2::{
     Type,
 };
 use ::std::{
-    any::Any,
     cell::RefCell,
     collections::HashMap,
     mem,
@@ -261,10 +260,13 @@ impl CatnapWLibOS {
 
         match self.runtime.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(EINVAL, "zero-length buffer"));
                 }
 
+                // Winsock sends a single buffer, so gather the segments of buffer chains.
+                let buf: DemiBuffer = if buf.nb_segs() > 1 { buf.coalesce()? } else { buf };
+
                 // Issue push operation.
                 self.do_push(qd, buf)
             },
@@ -294,10 +296,13 @@ impl CatnapWLibOS {
 
         match self.runtime.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(EINVAL, "zero-length buffer"));
                 }
 
+                // Winsock sends a single buffer, so gather the segments of buffer chains.
+                let buf: DemiBuffer = if buf.nb_segs() > 1 { buf.coalesce()? } else { buf };
+
                 // Issue pushto operation.
                 self.do_pushto(qd, buf, remote)
             },
@@ -338,11 +343,10 @@ impl CatnapWLibOS {
 
     /// Takes out the [OperationResult] associated with the target [SchedulerHandle].
     fn take_result(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.runtime.scheduler.take(handle).as_any();
-        let boxed_concrete_type: Operation = *boxed_future.downcast::<Operation>().expect("Wrong type!");
+        let operation: Operation = self.runtime.scheduler.take(handle);
 
         let (qd, new_qd, new_socket, qr): (QDesc, Option<QDesc>, Option<Socket>, OperationResult) =
-            boxed_concrete_type.get_result();
+            operation.get_result();
 
         // Handle accept operation.
         if let Some(new_qd) = new_qd {
@@ -358,7 +362,7 @@ impl CatnapWLibOS {
         (qd, qr)
     }
 
-    pub fn poll(&self) {
+    pub fn poll(&self) -> bool {
         self.runtime.scheduler.poll()
     }
 
@@ -369,6 +373,11 @@ impl CatnapWLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.runtime.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, r): (QDesc, OperationResult) = self.take_result(handle);
         Ok(pack_result(&self.runtime, r, qd, qt.into()))
@@ -6,8 +6,27 @@
 //======================================================================================================================
 
 use crate::{
+    catnip::runtime::{
+        memory::MemoryConfig,
+        rss::RssConfig,
+        tx_queue::{
+            DEFAULT_TX_BURST_SIZE,
+            MAX_TX_BURST_SIZE,
+        },
+        DEFAULT_RX_BURST_SIZE,
+    },
     demikernel::config::Config,
-    runtime::network::types::MacAddress,
+    runtime::network::{
+        config::{
+            TcpCongestionControl,
+            TcpLossRecovery,
+        },
+        consts::{
+            MAX_RECEIVE_BUFFER_SIZE,
+            RECEIVE_BATCH_SIZE,
+        },
+        types::MacAddress,
+    },
 };
 use ::anyhow::Error;
 use ::std::{
@@ -75,6 +94,131 @@ impl Config {
         disable_arp
     }
 
+    /// Reads the "TX burst size" parameter from the underlying configuration file.
+    pub fn tx_burst_size(&self) -> usize {
+        // FIXME: this function should return a Result.
+        match self.0["catnip"]["tx_burst_size"].as_i64() {
+            Some(tx_burst_size) if tx_burst_size > 0 && tx_burst_size as usize <= MAX_TX_BURST_SIZE => {
+                tx_burst_size as usize
+            },
+            Some(tx_burst_size) => panic!("invalid TX burst size ({:?})", tx_burst_size),
+            None => DEFAULT_TX_BURST_SIZE,
+        }
+    }
+
+    /// Reads the "RX burst size" parameter from the underlying configuration file.
+    pub fn rx_burst_size(&self) -> usize {
+        // FIXME: this function should return a Result.
+        match self.0["catnip"]["rx_burst_size"].as_i64() {
+            Some(rx_burst_size) if rx_burst_size > 0 && rx_burst_size as usize <= RECEIVE_BATCH_SIZE => {
+                rx_burst_size as usize
+            },
+            Some(rx_burst_size) => panic!("invalid RX burst size ({:?})", rx_burst_size),
+            None => DEFAULT_RX_BURST_SIZE,
+        }
+    }
+
+    /// Reads the "RX burst adaptive" parameter from the underlying configuration file.
+    pub fn rx_burst_adaptive(&self) -> bool {
+        // FIXME: this function should return a Result.
+        self.0["catnip"]["rx_burst_adaptive"].as_bool().unwrap_or(true)
+    }
+
+    /// Reads the "RX interrupts" parameter from the underlying configuration file.
+    pub fn rx_interrupts(&self) -> bool {
+        // FIXME: this function should return a Result.
+        self.0["catnip"]["rx_interrupts"].as_bool().unwrap_or(false)
+    }
+
+    /// Reads the "TCP loss recovery" parameter from the underlying configuration file.
+    pub fn tcp_loss_recovery(&self) -> TcpLossRecovery {
+        // FIXME: this function should return a Result.
+        match self.0["catnip"]["tcp_loss_recovery"].as_str() {
+            Some("rto") => TcpLossRecovery::Rto,
+            Some("sack") | None => TcpLossRecovery::Sack,
+            Some("rack-tlp") => TcpLossRecovery::RackTlp,
+            Some(loss_recovery) => panic!("invalid TCP loss recovery ({:?})", loss_recovery),
+        }
+    }
+
+    /// Reads the "TCP congestion control" parameter from the underlying configuration file.
+    pub fn tcp_congestion_control(&self) -> TcpCongestionControl {
+        // FIXME: this function should return a Result.
+        match self.0["catnip"]["tcp_congestion_control"].as_str() {
+            Some("none") | None => TcpCongestionControl::None,
+            Some("cubic") => TcpCongestionControl::Cubic,
+            Some("bbr") => TcpCongestionControl::Bbr,
+            Some(congestion_control) => panic!("invalid TCP congestion control ({:?})", congestion_control),
+        }
+    }
+
+    /// Reads the "TCP receive buffer max" parameter from the underlying configuration file.
+    pub fn tcp_receive_buffer_max(&self) -> u32 {
+        // FIXME: this function should return a Result.
+        match self.0["catnip"]["tcp_receive_buffer_max"].as_i64() {
+            Some(size) if size >= 0 && size <= MAX_RECEIVE_BUFFER_SIZE as i64 => size as u32,
+            Some(size) => panic!("invalid TCP receive buffer max ({:?})", size),
+            None => 0,
+        }
+    }
+
+    /// Reads the "TCP multi-segment pop" parameter from the underlying configuration file.
+    pub fn tcp_multi_segment_pop(&self) -> bool {
+        // FIXME: this function should return a Result.
+        self.0["catnip"]["tcp_multi_segment_pop"].as_bool().unwrap_or(false)
+    }
+
+    /// Reads the "RSS" parameters from the underlying configuration file.
+    pub fn rss_config(&self) -> RssConfig {
+        // FIXME: this function should return a Result.
+        let num_queues: u16 = match self.0["catnip"]["num_queues"].as_i64() {
+            Some(num_queues) if num_queues > 0 && num_queues <= u16::MAX as i64 => num_queues as u16,
+            Some(num_queues) => panic!("invalid number of queues ({:?})", num_queues),
+            None => 1,
+        };
+
+        let rss_key: Option<Vec<u8>> = self.0["catnip"]["rss_key"].as_vec().map(|arr| {
+            arr.iter()
+                .map(|b| match b.as_i64() {
+                    Some(b) if b >= 0 && b <= u8::MAX as i64 => b as u8,
+                    _ => panic!("invalid RSS key byte ({:?})", b),
+                })
+                .collect()
+        });
+
+        let rss_reta: Option<Vec<u16>> = self.0["catnip"]["rss_reta"].as_vec().map(|arr| {
+            arr.iter()
+                .map(|q| match q.as_i64() {
+                    Some(q) if q >= 0 && q < num_queues as i64 => q as u16,
+                    _ => panic!("invalid RSS redirection table entry ({:?})", q),
+                })
+                .collect()
+        });
+
+        RssConfig::new(num_queues, rss_key, rss_reta)
+    }
+
+    /// Reads the "memory pool" parameters from the underlying configuration file.
+    pub fn memory_config(&self) -> MemoryConfig {
+        // FIXME: this function should return a Result.
+        let read = |key: &str| -> Option<usize> {
+            match self.0["catnip"][key].as_i64() {
+                Some(value) if value > 0 => Some(value as usize),
+                Some(value) => panic!("invalid {} ({:?})", key, value),
+                None => None,
+            }
+        };
+
+        MemoryConfig::new(
+            read("inline_body_size"),
+            read("header_pool_size"),
+            None,
+            read("body_pool_size"),
+            read("mempool_cache_size"),
+            read("mempool_max_chunks"),
+        )
+    }
+
     /// Gets the "MTU" parameter from environment variables.
     pub fn mtu(&self) -> u16 {
         // FIXME: this function should return a Result.
@@ -92,6 +236,11 @@ impl Config {
         ::std::env::var("TCP_CHECKSUM_OFFLOAD").is_ok()
     }
 
+    /// Gets the "TCP_SEGMENTATION_OFFLOAD" parameter from environment variables.
+    pub fn tcp_segmentation_offload(&self) -> bool {
+        ::std::env::var("TCP_SEGMENTATION_OFFLOAD").is_ok()
+    }
+
     /// Gets the "UDP_CHECKSUM_OFFLOAD" parameter from environment variables.
     pub fn udp_checksum_offload(&self) -> bool {
         ::std::env::var("UDP_CHECKSUM_OFFLOAD").is_ok()
@@ -20,6 +20,7 @@ use crate::{
         fail::Fail,
         libdpdk::load_mlx_driver,
         memory::MemoryRuntime,
+        queue::issue_batch,
         timer::{
             Timer,
             TimerRc,
@@ -44,7 +45,10 @@ use ::std::{
         DerefMut,
     },
     rc::Rc,
-    time::Instant,
+    time::{
+        Duration,
+        Instant,
+    },
 };
 
 #[cfg(feature = "profiler")]
@@ -59,6 +63,8 @@ pub struct CatnipLibOS {
     scheduler: Scheduler,
     inetstack: InetStack,
     rt: Rc<DPDKRuntime>,
+    /// Granularity of the clock, which bounds how long the LibOS may block.
+    timer_granularity: Duration,
 }
 
 //==============================================================================
@@ -78,10 +84,22 @@ impl CatnipLibOS {
             config.mtu(),
             config.mss(),
             config.tcp_checksum_offload(),
+            config.tcp_segmentation_offload(),
+            config.tcp_loss_recovery(),
+            config.tcp_congestion_control(),
+            config.tcp_receive_buffer_max(),
+            config.tcp_multi_segment_pop(),
             config.udp_checksum_offload(),
+            config.rx_burst_size(),
+            config.rx_burst_adaptive(),
+            config.rx_interrupts(),
+            config.tx_burst_size(),
+            config.rss_config(),
+            config.memory_config(),
         ));
         let now: Instant = Instant::now();
-        let clock: TimerRc = TimerRc(Rc::new(Timer::new(now)));
+        let timer_granularity: Duration = config.timer_granularity();
+        let clock: TimerRc = TimerRc(Rc::new(Timer::with_granularity(now, timer_granularity)));
         let scheduler: Scheduler = Scheduler::default();
         let rng_seed: [u8; 32] = [0; 32];
         let inetstack: InetStack = InetStack::new(
@@ -100,6 +118,7 @@ impl CatnipLibOS {
             inetstack,
             scheduler,
             rt,
+            timer_granularity,
         }
     }
 
@@ -110,9 +129,13 @@ impl CatnipLibOS {
         #[cfg(feature = "profiler")]
         timer!("catnip::push");
         trace!("push(): qd={:?}", qd);
+        // Hold back new operations while the memory pools are exhausted, so that in-flight data can drain first.
+        if self.rt.is_memory_exhausted() {
+            return Err(Fail::new(libc::EAGAIN, "memory pools are exhausted"));
+        }
         match self.rt.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
                 let future = self.do_push(qd, buf)?;
@@ -131,9 +154,13 @@ impl CatnipLibOS {
         #[cfg(feature = "profiler")]
         timer!("catnip::pushto");
         trace!("pushto2(): qd={:?}", qd);
+        // Hold back new operations while the memory pools are exhausted, so that in-flight data can drain first.
+        if self.rt.is_memory_exhausted() {
+            return Err(Fail::new(libc::EAGAIN, "memory pools are exhausted"));
+        }
         match self.rt.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
                 let future = self.do_pushto(qd, buf, to)?;
@@ -148,6 +175,18 @@ impl CatnipLibOS {
         }
     }
 
+    /// Pushes a batch of scatter-gather arrays, one per queue descriptor. The segments that the pushes emit right away
+    /// are handed over to the NIC in a single burst. See [issue_batch] for the handling of failures.
+    pub fn push_batch(&mut self, qds: &[QDesc], sgas: &[demi_sgarray_t]) -> Result<Vec<QToken>, Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("catnip::push_batch");
+        trace!("push_batch(): n={:?}", qds.len());
+        self.rt.hold_transmit();
+        let qts: Result<Vec<QToken>, Fail> = issue_batch(qds.len(), |i| self.push(qds[i], &sgas[i]));
+        self.rt.release_transmit();
+        qts
+    }
+
     pub fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
         match self.scheduler.from_raw_handle(qt.into()) {
             Some(handle) => Ok(handle),
@@ -155,11 +194,41 @@ impl CatnipLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, r): (QDesc, OperationResult) = self.take_operation(handle);
         Ok(pack_result(self.rt.clone(), r, qd, qt.into()))
     }
 
+    /// Polls the network stack and then hands over to the NIC all packets that were staged for transmission.
+    /// Returns whether any task ran or any packet was received.
+    pub fn poll(&mut self) -> bool {
+        #[cfg(feature = "profiler")]
+        timer!("catnip::poll");
+        let progress: bool = self.inetstack.poll_bg_work();
+        self.rt.flush();
+        progress
+    }
+
+    /// Blocks until a packet arrives or `timeout` expires, unless some task is ready to run already. This is only
+    /// supported if receive interrupts are enabled, and returns whether that is the case. Each wait lasts at most one
+    /// tick of the clock, so that timers of the network stack still fire on time.
+    pub fn park(&mut self, timeout: Option<Duration>) -> bool {
+        if self.scheduler.has_ready() {
+            return true;
+        }
+        let timeout: Duration = timeout.map_or(self.timer_granularity, |timeout| timeout.min(self.timer_granularity));
+        if !self.rt.wait_for_packets(timeout) {
+            return false;
+        }
+        self.inetstack.advance_clock();
+        true
+    }
+
     /// Allocates a scatter-gather array.
     pub fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
         self.rt.alloc_sgarray(size)
@@ -11,6 +11,7 @@ use super::consts::{
     DEFAULT_HEADER_POOL_SIZE,
     DEFAULT_INLINE_BODY_SIZE,
     DEFAULT_MAX_BODY_SIZE,
+    DEFAULT_MAX_POOL_CHUNKS,
 };
 
 //==============================================================================
@@ -18,7 +19,7 @@ use super::consts::{
 //==============================================================================
 
 //// Memory Configuration Descriptor
-#[derive(Debug)]
+#[derive(Clone, Debug)]
 pub struct MemoryConfig {
     /// What is the cutoff point for copying application buffers into reserved body space within a
     /// header `mbuf`? Smaller values copy less but incur the fixed cost of chaining together
@@ -36,6 +37,10 @@ pub struct MemoryConfig {
 
     /// How many buffers should remain within `rte_mempool`'s per-thread cache?
     cache_size: usize,
+
+    /// Up to how many chunks of memory may a pool grow to when it runs dry? Each chunk holds as many buffers as the
+    /// pool was initially created with.
+    max_pool_chunks: usize,
 }
 
 //==============================================================================
@@ -50,6 +55,7 @@ impl MemoryConfig {
         max_body_size: Option<usize>,
         body_pool_size: Option<usize>,
         cache_size: Option<usize>,
+        max_pool_chunks: Option<usize>,
     ) -> Self {
         let mut config: Self = Self::default();
 
@@ -78,6 +84,11 @@ impl MemoryConfig {
             config.cache_size = cache_size;
         }
 
+        // Sets the max pool chunks config option.
+        if let Some(max_pool_chunks) = max_pool_chunks {
+            config.max_pool_chunks = max_pool_chunks;
+        }
+
         config
     }
 
@@ -105,6 +116,11 @@ impl MemoryConfig {
     pub fn get_cache_size(&self) -> usize {
         self.cache_size
     }
+
+    /// Returns the max pool chunks config stored in the target [MemoryConfig].
+    pub fn get_max_pool_chunks(&self) -> usize {
+        self.max_pool_chunks
+    }
 }
 
 //==============================================================================
@@ -120,6 +136,7 @@ impl Default for MemoryConfig {
             max_body_size: DEFAULT_MAX_BODY_SIZE,
             body_pool_size: DEFAULT_BODY_POOL_SIZE,
             cache_size: DEFAULT_CACHE_SIZE,
+            max_pool_chunks: DEFAULT_MAX_POOL_CHUNKS,
         }
     }
 }
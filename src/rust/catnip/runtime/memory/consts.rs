@@ -28,3 +28,6 @@ pub const DEFAULT_MAX_BODY_SIZE: usize = (RTE_MBUF_DEFAULT_BUF_SIZE + RTE_PKTMBU
 
 /// Default per-thread cache size.
 pub const DEFAULT_CACHE_SIZE: usize = 250;
+
+/// Default maximum number of memory chunks in a pool.
+pub const DEFAULT_MAX_POOL_CHUNKS: usize = 4;
@@ -5,7 +5,10 @@
 // Imports
 //==============================================================================
 
-use super::mempool::MemoryPool;
+use super::mempool::{
+    MemoryPool,
+    MemoryPoolStats,
+};
 use crate::{
     inetstack::protocols::{
         ethernet2::ETHERNET2_HEADER_SIZE,
@@ -16,24 +19,16 @@ use crate::{
         fail::Fail,
         libdpdk::{
             rte_mbuf,
-            rte_mempool,
+            rte_socket_id,
+            RTE_PKTMBUF_HEADROOM,
         },
         memory::DemiBuffer,
-        types::{
-            demi_sgarray_t,
-            demi_sgaseg_t,
-        },
+        types::DEMI_SGARRAY_MAXLEN,
     },
 };
 use ::anyhow::Error;
-use ::libc::c_void;
 use ::std::{
     ffi::CString,
-    mem,
-    ptr::{
-        self,
-        NonNull,
-    },
     rc::Rc,
 };
 
@@ -43,6 +38,17 @@ use ::std::{
 
 pub use super::config::MemoryConfig;
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+// TODO: The following computation for header size is bad. It should be fixed to maximum possible size.
+/// Maximum size for the protocol headers of a packet.
+const MAX_HEADER_SIZE: usize = ETHERNET2_HEADER_SIZE + IPV4_HEADER_DEFAULT_SIZE + MAX_TCP_HEADER_SIZE;
+
+// Body mbufs keep the default headroom of DPDK, which must be large enough to prepend protocol headers in place.
+const _: () = assert!(MAX_HEADER_SIZE <= RTE_PKTMBUF_HEADROOM as usize);
+
 //==============================================================================
 // Structures
 //==============================================================================
@@ -56,10 +62,22 @@ pub struct Inner {
     // internally within the network stack.
     header_pool: Rc<MemoryPool>,
 
+    // Number of bytes that fit in a buffer of the header pool.
+    header_mbuf_capacity: usize,
+
     // Large body pool for buffers given to the application for zero-copy.
     body_pool: Rc<MemoryPool>,
 }
 
+/// Memory Manager Statistics
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MemoryStats {
+    /// Statistics of the header pool.
+    pub header_pool: MemoryPoolStats,
+    /// Statistics of the body pool.
+    pub body_pool: MemoryPoolStats,
+}
+
 /// Memory Manager
 #[derive(Clone, Debug)]
 pub struct MemoryManager {
@@ -72,31 +90,56 @@ pub struct MemoryManager {
 
 /// Associated Functions for Memory Managers
 impl MemoryManager {
-    /// Instantiates a memory manager.
-    pub fn new(max_body_size: usize) -> Result<Self, Error> {
-        let memory_config: MemoryConfig = MemoryConfig::new(None, None, Some(max_body_size), None, None);
-
+    /// Instantiates a memory manager for the `queue_id`-th queue of a port. Bodies are allocated from `body_pool`,
+    /// which should be the same pool that backs the receive queue. Headers are allocated from `header_pool`, which is
+    /// created if it is `None`.
+    pub fn new(
+        config: MemoryConfig,
+        queue_id: u16,
+        header_pool: Option<MemoryPool>,
+        body_pool: MemoryPool,
+    ) -> Result<Self, Error> {
         Ok(Self {
-            inner: Rc::new(Inner::new(memory_config)?),
+            inner: Rc::new(Inner::new(config, queue_id, header_pool, body_pool)?),
         })
     }
 
-    /// Converts a runtime buffer into a scatter-gather array.
-    pub fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
+    /// Tears down the target memory manager and hands back its header and body pools, so that they can be reused by a
+    /// later memory manager of the same queue. Fails if the memory manager is still shared.
+    pub fn into_pools(self) -> Result<(MemoryPool, MemoryPool), Self> {
+        let inner: Inner = Rc::try_unwrap(self.inner).map_err(|inner| Self { inner })?;
+        // Pools are never shared outside of the memory manager.
+        let header_pool: MemoryPool = Rc::try_unwrap(inner.header_pool).expect("header pool should not be shared");
+        let body_pool: MemoryPool = Rc::try_unwrap(inner.body_pool).expect("body pool should not be shared");
+        Ok((header_pool, body_pool))
+    }
 
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+    /// Creates the body pool for the `queue_id`-th queue of a port, on the NUMA socket `socket_id`.
+    pub fn new_body_pool(config: &MemoryConfig, queue_id: u16, socket_id: i32) -> Result<MemoryPool, Error> {
+        // Create memory pool for holding packet bodies.
+        let body_pool: MemoryPool = MemoryPool::new(
+            CString::new(format!("body_pool_{}", queue_id))?,
+            config.get_max_body_size(),
+            config.get_body_pool_size(),
+            config.get_cache_size(),
+            config.get_max_pool_chunks(),
+            socket_id,
+        )?;
+
+        Ok(body_pool)
+    }
+
+    /// Checks whether either the header or the body pool ran dry.
+    pub fn is_exhausted(&self) -> bool {
+        self.inner.header_pool.is_exhausted() || self.inner.body_pool.is_exhausted()
+    }
+
+    /// Returns the statistics of the memory pools.
+    pub fn stats(&self) -> MemoryStats {
+        MemoryStats {
+            header_pool: self.inner.header_pool.stats(),
+            body_pool: self.inner.body_pool.stats(),
+        }
     }
 
     /// Allocates a header mbuf.
@@ -106,165 +149,84 @@ impl MemoryManager {
         Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
     }
 
-    /// Allocates a body mbuf.
+    /// Returns the number of bytes (protocol headers plus inline body) that fit in a header mbuf.
+    pub fn header_mbuf_capacity(&self) -> usize {
+        self.inner.header_mbuf_capacity
+    }
+
+    /// Allocates a body mbuf. The mbuf has enough headroom to prepend the protocol headers of a packet.
     /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
     pub fn alloc_body_mbuf(&self) -> Result<DemiBuffer, Fail> {
         let mbuf_ptr: *mut rte_mbuf = self.inner.body_pool.alloc_mbuf(None)?;
-        Ok(unsafe { DemiBuffer::from_mbuf(mbuf_ptr) })
-    }
-
-    /// Allocates a scatter-gather array.
-    pub fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // ToDo: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
-        }
-
-        // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer =
-            if size > self.inner.config.get_inline_body_size() && size <= self.inner.config.get_max_body_size() {
-                // Allocate a DPDK-managed buffer.
-                let mbuf_ptr: *mut rte_mbuf = self.inner.body_pool.alloc_mbuf(Some(size))?;
-                // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
-                unsafe { DemiBuffer::from_mbuf(mbuf_ptr) }
-            } else {
-                // Allocate a heap-managed buffer.
-                DemiBuffer::new(size as u16)
-            };
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
-
-        // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        let buf: DemiBuffer = unsafe { DemiBuffer::from_mbuf(mbuf_ptr) };
+        debug_assert!(buf.headroom() >= MAX_HEADER_SIZE);
+        Ok(buf)
     }
 
-    /// Releases a scatter-gather array.
-    pub fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+    /// Allocates the buffer that backs a scatter-gather array. Small arrays live on the heap, and larger ones in body
+    /// mbufs. Arrays that are too large for a single body mbuf are backed by a chain of them.
+    pub fn alloc_sgarray_buffer(&self, size: usize) -> Result<DemiBuffer, Fail> {
+        // Allocate a heap-managed buffer.
+        if size <= self.inner.config.get_inline_body_size() {
+            return Ok(DemiBuffer::new(size as u16));
         }
 
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
+        // We can't allocate more than a body mbuf per segment. The data room of body mbufs includes their headroom.
+        let body_mbuf_capacity: usize = self.inner.config.get_max_body_size() - RTE_PKTMBUF_HEADROOM as usize;
+        if size > DEMI_SGARRAY_MAXLEN * body_mbuf_capacity {
+            return Err(Fail::new(libc::EINVAL, "size too large for a demi_sgarray_t"));
         }
 
-        // Convert back to a DemiBuffer and drop it.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        drop(buf);
-
-        Ok(())
-    }
-
-    /// Clones a scatter-gather array into a DemiBuffer.
-    pub fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
-        // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
-        }
-
-        if sga.sga_buf == ptr::null_mut() {
-            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
-        }
-
-        // Convert back to a DemiBuffer.
-        // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
-        let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
-        // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
-        // contained a valid `DemiBuffer` token when we provided it to the user (and the user shouldn't change it).
-        let buf: DemiBuffer = unsafe { DemiBuffer::from_raw(token) };
-        let mut clone: DemiBuffer = buf.clone();
-
-        // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
-        mem::forget(buf);
-
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
+        // Allocate DPDK-managed buffers.
+        let mut remaining: usize = size;
+        let mut chain: Option<DemiBuffer> = None;
+        while remaining > 0 {
+            let mbuf_ptr: *mut rte_mbuf = self
+                .inner
+                .body_pool
+                .alloc_mbuf(Some(remaining.min(body_mbuf_capacity)))?;
+            // Safety: `mbuf_ptr` is a valid pointer to a properly initialized `rte_mbuf` struct.
+            let segment: DemiBuffer = unsafe { DemiBuffer::from_mbuf(mbuf_ptr) };
+            remaining -= segment.len();
+            match chain {
+                Some(ref mut head) => head.append(segment)?,
+                None => chain = Some(segment),
             }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
         }
 
-        // Return the clone.
-        Ok(clone)
-    }
-
-    /// Returns a raw pointer to the underlying body pool.
-    /// TODO: Review the need of this function after we are done with the refactor of the DPDK runtime.
-    pub fn body_pool(&self) -> *mut rte_mempool {
-        self.inner.body_pool.into_raw()
+        // This unwrap won't panic, as we allocated at least one segment above.
+        Ok(chain.unwrap())
     }
 }
 
 /// Associated Functions for Memory Managers
 impl Inner {
-    fn new(config: MemoryConfig) -> Result<Self, Error> {
-        // TODO: The following computation for header size is bad. It should be fixed to maximum possible size.
-        let header_size: usize = ETHERNET2_HEADER_SIZE + IPV4_HEADER_DEFAULT_SIZE + MAX_TCP_HEADER_SIZE;
-        let header_mbuf_size: usize = header_size + config.get_inline_body_size();
-
-        // Create memory pool for holding packet headers.
-        let header_pool: MemoryPool = MemoryPool::new(
-            CString::new("header_pool")?,
-            header_mbuf_size,
-            config.get_header_pool_size(),
-            config.get_cache_size(),
-        )?;
-
-        // Create memory pool for holding packet bodies.
-        let body_pool: MemoryPool = MemoryPool::new(
-            CString::new("body_pool")?,
-            config.get_max_body_size(),
-            config.get_body_pool_size(),
-            config.get_cache_size(),
-        )?;
+    fn new(
+        config: MemoryConfig,
+        queue_id: u16,
+        header_pool: Option<MemoryPool>,
+        body_pool: MemoryPool,
+    ) -> Result<Self, Error> {
+        let header_mbuf_size: usize = MAX_HEADER_SIZE + config.get_inline_body_size();
+
+        // Create memory pool for holding packet headers. It is only used by the thread that owns the queue, so it lives
+        // on the NUMA socket of that thread. Pools cannot be freed, so the one of an earlier owner is reused.
+        let header_pool: MemoryPool = match header_pool {
+            Some(header_pool) => header_pool,
+            None => MemoryPool::new(
+                CString::new(format!("header_pool_{}", queue_id))?,
+                header_mbuf_size,
+                config.get_header_pool_size(),
+                config.get_cache_size(),
+                config.get_max_pool_chunks(),
+                unsafe { rte_socket_id() } as i32,
+            )?,
+        };
 
         Ok(Self {
             config,
             header_pool: Rc::new(header_pool),
+            header_mbuf_capacity: header_mbuf_size - RTE_PKTMBUF_HEADROOM as usize,
             body_pool: Rc::new(body_pool),
         })
     }
@@ -5,28 +5,77 @@
 // Imports
 //==============================================================================
 
-use crate::runtime::{
-    fail::Fail,
-    libdpdk::{
-        rte_mbuf,
-        rte_mempool,
-        rte_pktmbuf_alloc,
-        rte_pktmbuf_free,
-        rte_pktmbuf_pool_create,
-        rte_socket_id,
+use crate::{
+    perftools::stats,
+    runtime::{
+        fail::Fail,
+        libdpdk::{
+            rte_mbuf,
+            rte_mempool,
+            rte_mempool_avail_count,
+            rte_mempool_in_use_count,
+            rte_pktmbuf_alloc,
+            rte_pktmbuf_free,
+            rte_pktmbuf_pool_create,
+            rte_socket_id,
+        },
     },
 };
-use ::std::ffi::CString;
+use ::std::{
+    cell::{
+        Cell,
+        RefCell,
+    },
+    ffi::CString,
+    ptr,
+};
 
 //==============================================================================
 // Structures
 //==============================================================================
 
+/// Memory Pool Statistics
+#[derive(Clone, Copy, Debug, Default)]
+pub struct MemoryPoolStats {
+    /// Number of mbufs that were allocated.
+    pub allocations: u64,
+    /// Number of allocations that could not be served from the chunk that served the previous one.
+    pub chunk_misses: u64,
+    /// Number of allocations that failed because the pool was exhausted.
+    pub failures: u64,
+    /// Number of memory chunks in the pool.
+    pub chunks: u64,
+    /// Number of mbufs that are currently in use (or held by per-thread caches).
+    pub in_use: u64,
+    /// Number of mbufs that are currently available.
+    pub available: u64,
+}
+
 /// DPDK Memory Pool
+///
+/// A memory pool is made of one or more chunks, each of which is a DPDK memory pool on its own. The pool starts with a
+/// single chunk, and grows by one chunk at a time whenever all of them run dry, up to a configured number of chunks.
+/// Only the first chunk may back a receive queue, as DPDK binds receive queues to a single pool.
 #[derive(Debug)]
 pub struct MemoryPool {
-    /// Underlying memory pool.
-    pool: *mut rte_mempool,
+    /// Name of the pool. Chunks are named after it.
+    name: String,
+    /// Size of the data room of each mbuf.
+    data_room_size: usize,
+    /// Number of mbufs in each chunk.
+    chunk_size: usize,
+    /// Number of mbufs that are kept in per-thread caches.
+    cache_size: usize,
+    /// Maximum number of chunks.
+    max_chunks: usize,
+    /// Underlying memory pools.
+    chunks: RefCell<Vec<*mut rte_mempool>>,
+    /// Index of the chunk that served the last allocation.
+    current: Cell<usize>,
+    /// Whether the last allocation failed.
+    exhausted: Cell<bool>,
+    /// Statistics.
+    stats: Cell<MemoryPoolStats>,
 }
 
 //==============================================================================
@@ -35,42 +84,57 @@ pub struct MemoryPool {
 
 /// Associated functions for memory pool.
 impl MemoryPool {
-    /// Creates a new memory pool.
-    pub fn new(name: CString, data_room_size: usize, pool_size: usize, cache_size: usize) -> Result<Self, Fail> {
-        let pool: *mut rte_mempool = unsafe {
-            rte_pktmbuf_pool_create(
-                name.as_ptr(),
-                pool_size as u32,
-                cache_size as u32,
-                0,
-                data_room_size as u16,
-                rte_socket_id() as i32,
-            )
+    /// Creates a new memory pool on the NUMA socket `socket_id`. The pool holds `pool_size` mbufs, and may grow to
+    /// `max_chunks` times that. Later chunks are allocated on the NUMA socket of the thread that adds them.
+    pub fn new(
+        name: CString,
+        data_room_size: usize,
+        pool_size: usize,
+        cache_size: usize,
+        max_chunks: usize,
+        socket_id: i32,
+    ) -> Result<Self, Fail> {
+        let name: String = match name.into_string() {
+            Ok(name) => name,
+            Err(_) => return Err(Fail::new(libc::EINVAL, "invalid memory pool name")),
         };
+        let pool: *mut rte_mempool = create_chunk(&name, data_room_size, pool_size, cache_size, socket_id)?;
 
-        // Failed to create memory pool.
-        if pool.is_null() {
-            return Err(Fail::new(libc::EAGAIN, "failed to create memory pool"));
-        }
-
-        Ok(Self { pool })
+        Ok(Self {
+            name,
+            data_room_size,
+            chunk_size: pool_size,
+            cache_size,
+            max_chunks: max_chunks.max(1),
+            chunks: RefCell::new(vec![pool]),
+            current: Cell::new(0),
+            exhausted: Cell::new(false),
+            stats: Cell::new(MemoryPoolStats {
+                chunks: 1,
+                ..Default::default()
+            }),
+        })
     }
 
-    /// Gets a raw pointer to the underlying memory pool.
+    /// Gets a raw pointer to the first chunk of the memory pool.
     pub fn into_raw(&self) -> *mut rte_mempool {
-        self.pool
+        self.chunks.borrow()[0]
     }
 
-    /// Allocates a mbuf in the target memory pool.
+    /// Allocates a mbuf in the target memory pool. Fails with `EAGAIN` if the pool is exhausted and cannot grow.
     pub fn alloc_mbuf(&self, size: Option<usize>) -> Result<*mut rte_mbuf, Fail> {
         // TODO: Drop the following warning once DPDK memory management is more stable.
         warn!("allocating mbuf from DPDK pool");
 
         // Allocate mbuf.
-        let mut mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(self.pool) };
+        let mut mbuf_ptr: *mut rte_mbuf = self.alloc_raw_mbuf();
         if mbuf_ptr.is_null() {
-            return Err(Fail::new(libc::ENOMEM, "cannot allocate more mbufs"));
+            self.exhausted.set(true);
+            self.update_stats(|stats| stats.failures += 1);
+            return Err(Fail::new(libc::EAGAIN, "memory pool is exhausted"));
         }
+        self.exhausted.set(false);
+        self.update_stats(|stats| stats.allocations += 1);
 
         // Fill out some fields of the underlying mbuf.
         unsafe {
@@ -91,4 +155,124 @@ impl MemoryPool {
 
         Ok(mbuf_ptr)
     }
+
+    /// Checks whether the memory pool ran dry. This is the case if the last allocation failed, and no mbuf was
+    /// released since.
+    pub fn is_exhausted(&self) -> bool {
+        if !self.exhausted.get() {
+            return false;
+        }
+        let exhausted: bool = self
+            .chunks
+            .borrow()
+            .iter()
+            .all(|&chunk| unsafe { rte_mempool_avail_count(chunk) } == 0);
+        self.exhausted.set(exhausted);
+        exhausted
+    }
+
+    /// Returns the statistics of the memory pool.
+    pub fn stats(&self) -> MemoryPoolStats {
+        let mut stats: MemoryPoolStats = self.stats.get();
+        stats.in_use = 0;
+        stats.available = 0;
+        for &chunk in self.chunks.borrow().iter() {
+            stats.in_use += unsafe { rte_mempool_in_use_count(chunk) } as u64;
+            stats.available += unsafe { rte_mempool_avail_count(chunk) } as u64;
+        }
+        stats
+    }
+
+    /// Allocates a mbuf from any chunk, starting with the one that served the last allocation. The pool grows if all
+    /// chunks are empty. Returns a null pointer if the pool is exhausted.
+    fn alloc_raw_mbuf(&self) -> *mut rte_mbuf {
+        let current: usize = self.current.get();
+        let mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(self.chunks.borrow()[current]) };
+        if !mbuf_ptr.is_null() {
+            return mbuf_ptr;
+        }
+        self.update_stats(|stats| stats.chunk_misses += 1);
+        stats::record(|stats| stats.mbuf_chunk_misses.add(1));
+
+        // Try the other chunks.
+        let num_chunks: usize = self.chunks.borrow().len();
+        for i in (0..num_chunks).filter(|&i| i != current) {
+            let mbuf_ptr: *mut rte_mbuf = unsafe { rte_pktmbuf_alloc(self.chunks.borrow()[i]) };
+            if !mbuf_ptr.is_null() {
+                self.current.set(i);
+                return mbuf_ptr;
+            }
+        }
+
+        // Add a chunk, if we may.
+        if num_chunks >= self.max_chunks {
+            return ptr::null_mut();
+        }
+        let name: String = format!("{}_{}", self.name, num_chunks);
+        let socket_id: i32 = unsafe { rte_socket_id() } as i32;
+        match create_chunk(&name, self.data_room_size, self.chunk_size, self.cache_size, socket_id) {
+            Ok(chunk) => {
+                self.chunks.borrow_mut().push(chunk);
+                self.current.set(num_chunks);
+                self.update_stats(|stats| stats.chunks += 1);
+                unsafe { rte_pktmbuf_alloc(chunk) }
+            },
+            Err(e) => {
+                warn!("failed to grow memory pool (name={:?}, error={:?})", self.name, e);
+                ptr::null_mut()
+            },
+        }
+    }
+
+    /// Updates the statistics of the memory pool.
+    fn update_stats<F: FnOnce(&mut MemoryPoolStats)>(&self, f: F) {
+        let mut stats: MemoryPoolStats = self.stats.get();
+        f(&mut stats);
+        self.stats.set(stats);
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Send Trait Implementation for Memory Pools
+// Safety: DPDK memory pools are multi-producer/multi-consumer, so a pool may be created in one thread and then used
+// from another one (e.g. the receive pool of a queue is created when the port is initialized, and then handed over to
+// the runtime that owns that queue).
+unsafe impl Send for MemoryPool {}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Creates a chunk of a memory pool, on the NUMA socket `socket_id`.
+fn create_chunk(
+    name: &str,
+    data_room_size: usize,
+    pool_size: usize,
+    cache_size: usize,
+    socket_id: i32,
+) -> Result<*mut rte_mempool, Fail> {
+    let name: CString = match CString::new(name) {
+        Ok(name) => name,
+        Err(_) => return Err(Fail::new(libc::EINVAL, "invalid memory pool name")),
+    };
+    let pool: *mut rte_mempool = unsafe {
+        rte_pktmbuf_pool_create(
+            name.as_ptr(),
+            pool_size as u32,
+            cache_size as u32,
+            0,
+            data_room_size as u16,
+            socket_id,
+        )
+    };
+
+    // Failed to create memory pool.
+    if pool.is_null() {
+        return Err(Fail::new(libc::EAGAIN, "failed to create memory pool"));
+    }
+
+    Ok(pool)
 }
@@ -3,45 +3,75 @@
 
 pub mod memory;
 mod network;
+pub mod rss;
+pub mod tx_queue;
 
 //==============================================================================
 // Imports
 //==============================================================================
 
-use self::memory::{
-    consts::DEFAULT_MAX_BODY_SIZE,
-    MemoryManager,
+use self::{
+    memory::{
+        consts::DEFAULT_MAX_BODY_SIZE,
+        MemoryConfig,
+        MemoryManager,
+        MemoryPool,
+        MemoryStats,
+    },
+    rss::{
+        RssConfig,
+        RssSteering,
+    },
+    tx_queue::TxQueue,
 };
 use crate::runtime::{
     libdpdk::{
         rte_delay_us_block,
         rte_eal_init,
+        rte_epoll_event,
+        rte_epoll_wait,
         rte_eth_conf,
         rte_eth_dev_configure,
         rte_eth_dev_count_avail,
         rte_eth_dev_get_mtu,
         rte_eth_dev_info_get,
         rte_eth_dev_is_valid_port,
+        rte_eth_dev_rss_hash_conf_get,
+        rte_eth_dev_rss_reta_update,
+        rte_eth_dev_rx_intr_ctl_q,
+        rte_eth_dev_rx_intr_disable,
+        rte_eth_dev_rx_intr_enable,
         rte_eth_dev_set_mtu,
+        rte_eth_dev_socket_id,
         rte_eth_dev_start,
         rte_eth_find_next_owned_by,
         rte_eth_link,
         rte_eth_link_get_nowait,
         rte_eth_macaddr_get,
         rte_eth_promiscuous_enable,
+        rte_eth_rss_conf,
         rte_eth_rss_ip,
+        rte_eth_rss_reta_entry64,
         rte_eth_rx_mq_mode_RTE_ETH_MQ_RX_RSS as RTE_ETH_MQ_RX_RSS,
         rte_eth_rx_offload_tcp_cksum,
         rte_eth_rx_offload_udp_cksum,
+        rte_eth_rx_queue_count,
         rte_eth_rx_queue_setup,
         rte_eth_rxconf,
         rte_eth_tx_mq_mode_RTE_ETH_MQ_TX_NONE as RTE_ETH_MQ_TX_NONE,
+        rte_eth_tx_offload_ipv4_cksum,
         rte_eth_tx_offload_multi_segs,
         rte_eth_tx_offload_tcp_cksum,
+        rte_eth_tx_offload_tcp_tso,
         rte_eth_tx_offload_udp_cksum,
         rte_eth_tx_queue_setup,
         rte_eth_txconf,
         rte_ether_addr,
+        rte_mbuf_f_tx_ip_cksum,
+        rte_mbuf_f_tx_ipv4,
+        rte_mbuf_f_tx_tcp_cksum,
+        rte_mbuf_f_tx_tcp_seg,
+        RTE_EPOLL_PER_THREAD,
         RTE_ETHER_MAX_JUMBO_FRAME_LEN,
         RTE_ETHER_MAX_LEN,
         RTE_ETH_DEV_NO_OWNER,
@@ -52,11 +82,17 @@ use crate::runtime::{
         RTE_ETH_RSS_NONFRAG_IPV4_UDP,
         RTE_ETH_RSS_NONFRAG_IPV6_TCP,
         RTE_ETH_RSS_NONFRAG_IPV6_UDP,
+        RTE_INTR_EVENT_ADD,
+        RTE_INTR_EVENT_DEL,
     },
+    memory::DemiBuffer,
     network::{
+        burst::AdaptiveBurstSize,
         config::{
             ArpConfig,
             TcpConfig,
+            TcpCongestionControl,
+            TcpLossRecovery,
             UdpConfig,
         },
         types::MacAddress,
@@ -69,13 +105,33 @@ use ::anyhow::{
     Error,
 };
 use ::std::{
+    cell::Cell,
     collections::HashMap,
     ffi::CString,
-    mem::MaybeUninit,
+    mem::{
+        ManuallyDrop,
+        MaybeUninit,
+    },
     net::Ipv4Addr,
+    ptr,
+    rc::Rc,
+    sync::{
+        Mutex,
+        MutexGuard,
+    },
     time::Duration,
 };
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Default maximum number of packets that are received at once.
+pub const DEFAULT_RX_BURST_SIZE: usize = 32;
+
+/// Length of the RSS hash key that is assumed when the driver does not report one.
+const DEFAULT_RSS_KEY_SIZE: usize = 40;
+
 //==============================================================================
 // Macros
 //==============================================================================
@@ -95,11 +151,68 @@ macro_rules! expect_zero {
 // Structures
 //==============================================================================
 
+/// DPDK Port
+///
+/// State of the port that is shared by all DPDK runtimes in a process. The port is initialized by the first runtime
+/// that comes up, and then each runtime claims one receive/transmit queue pair of it. This way, one process may run
+/// one runtime (and thus one scheduler and one network stack) per core, with RSS steering each flow to its owner.
+struct DPDKPort {
+    port_id: u16,
+    link_addr: MacAddress,
+    /// Configuration of the memory pools of each runtime.
+    memory_config: MemoryConfig,
+    /// Whether the port segments large TCP segments on transmission.
+    tcp_segmentation_offload: bool,
+    /// Software mirror of the steering of the NIC, if flows are spread across many queues.
+    rss_steering: Option<RssSteering>,
+    /// Body pools that back receive queues. Each pool is handed over to the runtime that claims its queue, and is
+    /// handed back when the queue is released.
+    body_pools: Vec<Option<MemoryPool>>,
+    /// Header pools of released queues, which are reused by the next runtime that claims them.
+    header_pools: Vec<Option<MemoryPool>>,
+}
+
+/// DPDK Queue
+///
+/// Queue pair of the port that is claimed by a runtime. It is released once the last clone of the runtime is dropped,
+/// so that a later runtime of the process can claim it.
+struct DPDKQueue {
+    port_id: u16,
+    queue_id: u16,
+    /// Whether the receive queue raises interrupts on the epoll instance of the owner thread.
+    rx_interrupts: bool,
+    /// Memory manager of the queue. It is only taken when the queue is released.
+    mm: ManuallyDrop<MemoryManager>,
+}
+
+/// Transmit Path Statistics
+#[derive(Clone, Copy, Debug, Default)]
+pub struct TransmitStats {
+    /// Number of packets whose headers were prepended into the headroom of the body mbuf.
+    pub headers_prepended: u64,
+    /// Number of packets whose headers were written into a header mbuf that was chained to the body mbuf.
+    pub headers_chained: u64,
+    /// Number of packets whose body was copied into the header mbuf.
+    pub bodies_inlined: u64,
+    /// Number of packets that were dropped because the memory pools were exhausted.
+    pub drops: u64,
+}
+
 /// DPDK Runtime
 #[derive(Clone)]
 pub struct DPDKRuntime {
-    mm: MemoryManager,
+    queue: Rc<DPDKQueue>,
     port_id: u16,
+    queue_id: u16,
+    /// Software mirror of the steering of the NIC, which tells which flows are received by this runtime.
+    rss_steering: Option<Rc<RssSteering>>,
+    rx_burst_size: Rc<AdaptiveBurstSize>,
+    /// Whether the receive queue raises interrupts, which idle runtimes block on.
+    rx_interrupts: bool,
+    tx_queue: Rc<TxQueue>,
+    /// Offload flags of the mbufs that carry segments for the NIC to split.
+    tso_ol_flags: u64,
+    tx_stats: Rc<Cell<TransmitStats>>,
     pub link_addr: MacAddress,
     pub ipv4_addr: Ipv4Addr,
     pub arp_options: ArpConfig,
@@ -107,6 +220,13 @@ pub struct DPDKRuntime {
     pub udp_options: UdpConfig,
 }
 
+//==============================================================================
+// Global Variables
+//==============================================================================
+
+/// Port that is shared by all DPDK runtimes in the process. `None` until the first runtime initializes DPDK.
+static DPDK_PORT: Mutex<Option<DPDKPort>> = Mutex::new(None);
+
 //==============================================================================
 // Associate Functions
 //==============================================================================
@@ -122,17 +242,61 @@ impl DPDKRuntime {
         mtu: u16,
         mss: usize,
         tcp_checksum_offload: bool,
+        tcp_segmentation_offload: bool,
+        tcp_loss_recovery: TcpLossRecovery,
+        tcp_congestion_control: TcpCongestionControl,
+        tcp_receive_buffer_max: u32,
+        tcp_multi_segment_pop: bool,
         udp_checksum_offload: bool,
+        rx_burst_size: usize,
+        rx_burst_adaptive: bool,
+        rx_interrupts: bool,
+        tx_burst_size: usize,
+        rss_config: RssConfig,
+        memory_config: MemoryConfig,
     ) -> DPDKRuntime {
-        let (mm, port_id, link_addr) = Self::initialize_dpdk(
+        let (mm, port_id, queue_id, link_addr, tcp_segmentation_offload, rss_steering) = Self::initialize_dpdk(
             eal_init_args,
             use_jumbo_frames,
             mtu,
             tcp_checksum_offload,
+            tcp_segmentation_offload,
             udp_checksum_offload,
+            rx_interrupts,
+            &rss_config,
+            &memory_config,
         )
         .unwrap();
 
+        // Interrupts of the receive queue are delivered to the epoll instance of the thread that waits on them, which
+        // is the one that owns the runtime.
+        let rx_interrupts: bool = rx_interrupts && {
+            let ret: libc::c_int = unsafe {
+                rte_eth_dev_rx_intr_ctl_q(
+                    port_id,
+                    queue_id,
+                    RTE_EPOLL_PER_THREAD,
+                    RTE_INTR_EVENT_ADD as libc::c_int,
+                    ptr::null_mut(),
+                )
+            };
+            if ret != 0 {
+                warn!("RX interrupts are disabled on queue {:?} (ret={:?})", queue_id, ret);
+            }
+            ret == 0
+        };
+        let queue: Rc<DPDKQueue> = Rc::new(DPDKQueue {
+            port_id,
+            queue_id,
+            rx_interrupts,
+            mm: ManuallyDrop::new(mm),
+        });
+
+        if rss_config.num_queues() > 1 && !disable_arp {
+            // ARP packets carry no transport header and thus are not spread by RSS, so they all land on queue 0.
+            warn!("ARP replies are only seen by queue 0, consider using a static ARP table");
+        }
+
         let arp_options = ArpConfig::new(
             Some(Duration::from_secs(15)),
             Some(Duration::from_secs(20)),
@@ -150,13 +314,38 @@ impl DPDKRuntime {
             None,
             Some(tcp_checksum_offload),
             Some(tcp_checksum_offload),
+            Some(tcp_segmentation_offload),
+            None,
+            Some(tcp_loss_recovery),
+            Some(tcp_congestion_control),
+            Some(tcp_receive_buffer_max),
+            Some(tcp_multi_segment_pop),
         );
 
         let udp_options = UdpConfig::new(Some(udp_checksum_offload), Some(udp_checksum_offload));
 
+        let rx_burst_size: Rc<AdaptiveBurstSize> = Rc::new(if rx_burst_adaptive {
+            AdaptiveBurstSize::new(rx_burst_size)
+        } else {
+            AdaptiveBurstSize::fixed(rx_burst_size)
+        });
+        let tx_queue: Rc<TxQueue> = Rc::new(TxQueue::new(port_id, queue_id, tx_burst_size));
+        // The NIC computes the checksums of the segments it cuts. Flags are fetched once, as they are not constants in
+        // the bindings.
+        let tso_ol_flags: u64 = unsafe {
+            rte_mbuf_f_tx_tcp_seg() | rte_mbuf_f_tx_tcp_cksum() | rte_mbuf_f_tx_ip_cksum() | rte_mbuf_f_tx_ipv4()
+        };
+
         Self {
-            mm,
+            queue,
             port_id,
+            queue_id,
+            rss_steering: rss_steering.map(Rc::new),
+            rx_burst_size,
+            rx_interrupts,
+            tx_queue,
+            tso_ol_flags,
+            tx_stats: Rc::new(Cell::new(TransmitStats::default())),
             link_addr,
             ipv4_addr,
             arp_options,
@@ -165,17 +354,165 @@ impl DPDKRuntime {
         }
     }
 
-    /// Initializes DPDK.
+    /// Hands over all packets that are staged for transmission to the NIC.
+    pub fn flush(&self) {
+        self.tx_queue.flush();
+    }
+
+    /// Holds back packets that are staged for transmission, until [Self::release_transmit] is called, so that they are
+    /// handed over to the NIC in a single burst.
+    pub fn hold_transmit(&self) {
+        self.tx_queue.hold();
+    }
+
+    /// Hands over all packets that were held back for transmission to the NIC.
+    pub fn release_transmit(&self) {
+        self.tx_queue.release();
+    }
+
+    /// Returns the statistics of the transmit path.
+    pub fn transmit_stats(&self) -> TransmitStats {
+        self.tx_stats.get()
+    }
+
+    /// Returns the statistics of the memory pools.
+    pub fn memory_stats(&self) -> MemoryStats {
+        self.queue.mm.stats()
+    }
+
+    /// Blocks until a packet arrives on the receive queue or `timeout` expires, and returns true. Returns false right
+    /// away if the receive queue does not raise interrupts. The timeout is rounded up to the millisecond.
+    pub fn wait_for_packets(&self, timeout: Duration) -> bool {
+        if !self.rx_interrupts {
+            return false;
+        }
+        let timeout_ms: libc::c_int = ((timeout.as_micros() + 999) / 1000).min(libc::c_int::MAX as u128) as libc::c_int;
+        // Safety: the event is a plain C struct, for which all zeros is valid, and it outlives the call.
+        unsafe {
+            let mut event: rte_epoll_event = MaybeUninit::zeroed().assume_init();
+            rte_eth_dev_rx_intr_enable(self.port_id, self.queue_id);
+            // Packets that arrived before interrupts got enabled raise no interrupt, so look at the queue once more
+            // before sleeping. Drivers that cannot tell leave them to the next poll, at worst once the wait times out.
+            if rte_eth_rx_queue_count(self.port_id, self.queue_id) <= 0 {
+                rte_epoll_wait(RTE_EPOLL_PER_THREAD, &mut event, 1, timeout_ms);
+            }
+            rte_eth_dev_rx_intr_disable(self.port_id, self.queue_id);
+        }
+        true
+    }
+
+    /// Checks whether the memory pools ran dry, in which case new operations should be held back.
+    pub fn is_memory_exhausted(&self) -> bool {
+        self.queue.mm.is_exhausted()
+    }
+
+    /// Updates the statistics of the transmit path.
+    fn update_transmit_stats<F: FnOnce(&mut TransmitStats)>(&self, f: F) {
+        let mut stats: TransmitStats = self.tx_stats.get();
+        f(&mut stats);
+        self.tx_stats.set(stats);
+    }
+
+    /// Initializes DPDK, if this was not done yet by another runtime in the process, and claims a queue pair.
     fn initialize_dpdk(
         eal_init_args: &[CString],
         use_jumbo_frames: bool,
         mtu: u16,
         tcp_checksum_offload: bool,
+        tcp_segmentation_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(MemoryManager, u16, MacAddress), Error> {
+        rx_interrupts: bool,
+        rss_config: &RssConfig,
+        memory_config: &MemoryConfig,
+    ) -> Result<(MemoryManager, u16, u16, MacAddress, bool, Option<RssSteering>), Error> {
+        let mut dpdk_port: MutexGuard<Option<DPDKPort>> = match DPDK_PORT.lock() {
+            Ok(dpdk_port) => dpdk_port,
+            Err(_) => bail!("DPDK port state is poisoned"),
+        };
+
+        if dpdk_port.is_none() {
+            *dpdk_port = Some(Self::initialize_dpdk_once(
+                eal_init_args,
+                use_jumbo_frames,
+                mtu,
+                tcp_checksum_offload,
+                tcp_segmentation_offload,
+                udp_checksum_offload,
+                rx_interrupts,
+                rss_config,
+                memory_config,
+            )?);
+        }
+        let dpdk_port: &mut DPDKPort = dpdk_port.as_mut().expect("DPDK port should be initialized");
+
+        // Claim the first queue pair that is not owned by any runtime.
+        let queue_id: usize = match dpdk_port.body_pools.iter().position(|body_pool| body_pool.is_some()) {
+            Some(queue_id) => queue_id,
+            None => bail!(
+                "all queues of port {:?} are in use (num_queues={:?})",
+                dpdk_port.port_id,
+                dpdk_port.body_pools.len()
+            ),
+        };
+        let body_pool: MemoryPool = dpdk_port.body_pools[queue_id].take().expect("queue should be free");
+        let header_pool: Option<MemoryPool> = dpdk_port.header_pools[queue_id].take();
+        let memory_manager: MemoryManager =
+            MemoryManager::new(dpdk_port.memory_config.clone(), queue_id as u16, header_pool, body_pool)?;
+        info!("using queue {:?} of port {:?}", queue_id, dpdk_port.port_id);
+
+        Ok((
+            memory_manager,
+            dpdk_port.port_id,
+            queue_id as u16,
+            dpdk_port.link_addr,
+            dpdk_port.tcp_segmentation_offload,
+            dpdk_port.rss_steering.clone(),
+        ))
+    }
+
+    /// Hands back a queue pair to the port, so that another runtime can claim it. The queue is leaked if its memory
+    /// manager is still in use.
+    fn release_queue(queue_id: u16, mm: MemoryManager) {
+        let mut dpdk_port: MutexGuard<Option<DPDKPort>> = match DPDK_PORT.lock() {
+            Ok(dpdk_port) => dpdk_port,
+            Err(_) => {
+                warn!("DPDK port state is poisoned, queue {:?} is leaked", queue_id);
+                return;
+            },
+        };
+        let dpdk_port: &mut DPDKPort = dpdk_port.as_mut().expect("DPDK port should be initialized");
+
+        match mm.into_pools() {
+            Ok((header_pool, body_pool)) => {
+                dpdk_port.header_pools[queue_id as usize] = Some(header_pool);
+                dpdk_port.body_pools[queue_id as usize] = Some(body_pool);
+                info!("released queue {:?} of port {:?}", queue_id, dpdk_port.port_id);
+            },
+            Err(_) => warn!(
+                "memory manager of queue {:?} is still in use, queue is leaked",
+                queue_id
+            ),
+        }
+    }
+
+    /// Initializes DPDK and the port that is shared by all runtimes in the process.
+    fn initialize_dpdk_once(
+        eal_init_args: &[CString],
+        use_jumbo_frames: bool,
+        mtu: u16,
+        tcp_checksum_offload: bool,
+        tcp_segmentation_offload: bool,
+        udp_checksum_offload: bool,
+        rx_interrupts: bool,
+        rss_config: &RssConfig,
+        memory_config: &MemoryConfig,
+    ) -> Result<DPDKPort, Error> {
         std::env::set_var("MLX5_SHUT_UP_BF", "1");
-        std::env::set_var("MLX5_SINGLE_THREADED", "1");
-        std::env::set_var("MLX4_SINGLE_THREADED", "1");
+        // Queues are polled from different threads when there are many of them.
+        if rss_config.num_queues() == 1 {
+            std::env::set_var("MLX5_SINGLE_THREADED", "1");
+            std::env::set_var("MLX4_SINGLE_THREADED", "1");
+        }
         let eal_init_refs = eal_init_args.iter().map(|s| s.as_ptr() as *mut u8).collect::<Vec<_>>();
         let ret: libc::c_int = unsafe { rte_eal_init(eal_init_refs.len() as i32, eal_init_refs.as_ptr() as *mut _) };
         if ret < 0 {
@@ -193,18 +530,35 @@ impl DPDKRuntime {
         } else {
             DEFAULT_MAX_BODY_SIZE
         };
-
-        let memory_manager = MemoryManager::new(max_body_size)?;
+        let memory_config: MemoryConfig = MemoryConfig::new(
+            Some(memory_config.get_inline_body_size()),
+            Some(memory_config.get_header_pool_size()),
+            Some(max_body_size),
+            Some(memory_config.get_body_pool_size()),
+            Some(memory_config.get_cache_size()),
+            Some(memory_config.get_max_pool_chunks()),
+        );
 
         let owner: u64 = RTE_ETH_DEV_NO_OWNER as u64;
         let port_id: u16 = unsafe { rte_eth_find_next_owned_by(0, owner) as u16 };
-        Self::initialize_dpdk_port(
+
+        // Each receive queue gets its own body pool, so that runtimes do not contend on the same pool. Receive pools
+        // are filled by the NIC, so they live on its NUMA socket.
+        let socket_id: i32 = unsafe { rte_eth_dev_socket_id(port_id) };
+        let mut body_pools: Vec<Option<MemoryPool>> = Vec::with_capacity(rss_config.num_queues() as usize);
+        for queue_id in 0..rss_config.num_queues() {
+            body_pools.push(Some(MemoryManager::new_body_pool(&memory_config, queue_id, socket_id)?));
+        }
+        let (tcp_segmentation_offload, rss_steering): (bool, Option<RssSteering>) = Self::initialize_dpdk_port(
             port_id,
-            &memory_manager,
+            &body_pools,
             use_jumbo_frames,
             mtu,
             tcp_checksum_offload,
+            tcp_segmentation_offload,
             udp_checksum_offload,
+            rx_interrupts,
+            rss_config,
         )?;
 
         // TODO: Where is this function?
@@ -222,20 +576,32 @@ impl DPDKRuntime {
             Err(format_err!("Invalid mac address"))?;
         }
 
-        Ok((memory_manager, port_id, local_link_addr))
+        Ok(DPDKPort {
+            port_id,
+            link_addr: local_link_addr,
+            memory_config,
+            tcp_segmentation_offload,
+            rss_steering,
+            header_pools: (0..body_pools.len()).map(|_| None).collect(),
+            body_pools,
+        })
     }
 
-    /// Initializes a DPDK port.
+    /// Initializes a DPDK port. Returns whether TCP segmentation offload was enabled on it, along with the software
+    /// mirror of its RSS steering, if flows are spread across many queues.
     fn initialize_dpdk_port(
         port_id: u16,
-        memory_manager: &MemoryManager,
+        body_pools: &[Option<MemoryPool>],
         use_jumbo_frames: bool,
         mtu: u16,
         tcp_checksum_offload: bool,
+        tcp_segmentation_offload: bool,
         udp_checksum_offload: bool,
-    ) -> Result<(), Error> {
-        let rx_rings: u16 = 1;
-        let tx_rings: u16 = 1;
+        rx_interrupts: bool,
+        rss_config: &RssConfig,
+    ) -> Result<(bool, Option<RssSteering>), Error> {
+        let rx_rings: u16 = rss_config.num_queues();
+        let tx_rings: u16 = rss_config.num_queues();
         let rx_ring_size: u16 = 2048;
         let tx_ring_size: u16 = 2048;
         let nb_rxd: u16 = rx_ring_size;
@@ -256,6 +622,16 @@ impl DPDKRuntime {
         };
 
         println!("dev_info: {:?}", dev_info);
+        if rx_rings > dev_info.max_rx_queues || tx_rings > dev_info.max_tx_queues {
+            bail!(
+                "port {} does not support {} queues (max_rx_queues={}, max_tx_queues={})",
+                port_id,
+                rx_rings,
+                dev_info.max_rx_queues,
+                dev_info.max_tx_queues
+            );
+        }
+
         let mut port_conf: rte_eth_conf = unsafe { MaybeUninit::zeroed().assume_init() };
         port_conf.rxmode.max_lro_pkt_size = if use_jumbo_frames {
             RTE_ETHER_MAX_JUMBO_FRAME_LEN
@@ -275,6 +651,21 @@ impl DPDKRuntime {
                                                 RTE_ETH_RSS_NONFRAG_IPV6_TCP |
                                                 RTE_ETH_RSS_NONFRAG_IPV6_UDP;
 
+        // Use the configured hash key instead of the default one of the driver. DPDK copies the key while configuring
+        // the device, so it only has to outlive the call to rte_eth_dev_configure().
+        let mut rss_key: Vec<u8> = rss_config.key().map(|key| key.to_vec()).unwrap_or_default();
+        if !rss_key.is_empty() {
+            if dev_info.hash_key_size != 0 && rss_key.len() != dev_info.hash_key_size as usize {
+                bail!(
+                    "invalid RSS key length (expected={:?}, got={:?})",
+                    dev_info.hash_key_size,
+                    rss_key.len()
+                );
+            }
+            port_conf.rx_adv_conf.rss_conf.rss_key = rss_key.as_mut_ptr();
+            port_conf.rx_adv_conf.rss_conf.rss_key_len = rss_key.len() as u8;
+        }
+
         //port_conf.rx_adv_conf.rss_conf.rss_hf = unsafe { rte_eth_rss_ip() as u64 } | dev_info.flow_type_rss_offloads;
 
         port_conf.txmode.mq_mode = RTE_ETH_MQ_TX_NONE;
@@ -286,6 +677,29 @@ impl DPDKRuntime {
         }
         port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_multi_segs() as u64 };
 
+        // Let receive queues raise interrupts. They stay masked until an idle runtime waits on them.
+        if rx_interrupts {
+            port_conf.intr_conf.set_rxq(1);
+        }
+
+        // The NIC computes the checksums of the segments it cuts, so segmentation offload builds on checksum offload.
+        let tcp_segmentation_offload: bool = if !tcp_segmentation_offload {
+            false
+        } else if !tcp_checksum_offload {
+            warn!("TCP segmentation offload requires TCP checksum offload, segmenting in software");
+            false
+        } else if dev_info.tx_offload_capa & unsafe { rte_eth_tx_offload_tcp_tso() as u64 } == 0 {
+            warn!(
+                "port {:?} does not support TCP segmentation offload, segmenting in software",
+                port_id
+            );
+            false
+        } else {
+            port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_tcp_tso() as u64 };
+            port_conf.txmode.offloads |= unsafe { rte_eth_tx_offload_ipv4_cksum() as u64 };
+            true
+        };
+
         let mut rx_conf: rte_eth_rxconf = unsafe { MaybeUninit::zeroed().assume_init() };
         rx_conf.rx_thresh.pthresh = rx_pthresh;
         rx_conf.rx_thresh.hthresh = rx_hthresh;
@@ -320,13 +734,14 @@ impl DPDKRuntime {
 
         unsafe {
             for i in 0..rx_rings {
+                let body_pool: &MemoryPool = body_pools[i as usize].as_ref().expect("queue should be free");
                 expect_zero!(rte_eth_rx_queue_setup(
                     port_id,
                     i,
                     nb_rxd,
                     socket_id,
                     &rx_conf as *const _,
-                    memory_manager.body_pool(),
+                    body_pool.into_raw(),
                 ))?;
             }
             for i in 0..tx_rings {
@@ -342,6 +757,37 @@ impl DPDKRuntime {
             rte_eth_promiscuous_enable(port_id);
         }
 
+        // Program the redirection table, so that each flow is steered to the queue (and thus to the runtime) that
+        // owns it.
+        let mut rss_steering: Option<RssSteering> = None;
+        if rss_config.has_reta() {
+            if dev_info.reta_size == 0 {
+                warn!("port {:?} does not have an RSS redirection table", port_id);
+            } else {
+                let mut reta_conf: Vec<rte_eth_rss_reta_entry64> = rss_config.reta_conf(dev_info.reta_size)?;
+                unsafe {
+                    expect_zero!(rte_eth_dev_rss_reta_update(
+                        port_id,
+                        reta_conf.as_mut_ptr(),
+                        dev_info.reta_size
+                    ))?;
+                }
+
+                // Mirror the steering of the NIC, so that runtimes can pick ephemeral ports whose replies land on
+                // their own queue. The default key of the driver is only known by asking it.
+                if rss_config.num_queues() > 1 {
+                    if rss_key.is_empty() {
+                        rss_key = Self::get_rss_key(port_id, dev_info.hash_key_size as usize)
+                            .map_err(|e| warn!("active opens ignore RSS steering ({:?})", e))
+                            .unwrap_or_default();
+                    }
+                    if !rss_key.is_empty() {
+                        rss_steering = Some(rss_config.steering(rss_key, dev_info.reta_size));
+                    }
+                }
+            }
+        }
+
         if unsafe { rte_eth_dev_is_valid_port(port_id) } == 0 {
             bail!("Invalid port");
         }
@@ -374,7 +820,22 @@ impl DPDKRuntime {
             retry_count -= 1;
         }
 
-        Ok(())
+        Ok((tcp_segmentation_offload, rss_steering))
+    }
+
+    /// Gets the RSS hash key that is used by a port. `key_size` is the length of the key, or zero if unknown.
+    fn get_rss_key(port_id: u16, key_size: usize) -> Result<Vec<u8>, Error> {
+        let mut key: Vec<u8> = vec![0; if key_size == 0 { DEFAULT_RSS_KEY_SIZE } else { key_size }];
+        // Safety: rte_eth_rss_conf is a plain C structure, thus it is safe to zero initialize it. The key outlives the
+        // call, and its length is given to DPDK.
+        unsafe {
+            let mut rss_conf: rte_eth_rss_conf = MaybeUninit::zeroed().assume_init();
+            rss_conf.rss_key = key.as_mut_ptr();
+            rss_conf.rss_key_len = key.len() as u8;
+            expect_zero!(rte_eth_dev_rss_hash_conf_get(port_id, &mut rss_conf))?;
+            key.truncate(rss_conf.rss_key_len as usize);
+        }
+        Ok(key)
     }
 }
 
@@ -383,3 +844,23 @@ impl DPDKRuntime {
 //==============================================================================
 
 impl Runtime for DPDKRuntime {}
+
+/// Drop Trait Implementation for DPDK Queues
+impl Drop for DPDKQueue {
+    fn drop(&mut self) {
+        if self.rx_interrupts {
+            unsafe {
+                rte_eth_dev_rx_intr_ctl_q(
+                    self.port_id,
+                    self.queue_id,
+                    RTE_EPOLL_PER_THREAD,
+                    RTE_INTR_EVENT_DEL as libc::c_int,
+                    ptr::null_mut(),
+                );
+            }
+        }
+        // Safety: the memory manager is not used after it is taken.
+        let mm: MemoryManager = unsafe { ManuallyDrop::take(&mut self.mm) };
+        DPDKRuntime::release_queue(self.queue_id, mm);
+    }
+}
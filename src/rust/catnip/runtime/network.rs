@@ -8,10 +8,11 @@
 use super::DPDKRuntime;
 use crate::{
     inetstack::protocols::ethernet2::MIN_PAYLOAD_SIZE,
+    perftools::stats,
     runtime::{
+        fail::Fail,
         libdpdk::{
             rte_eth_rx_burst,
-            rte_eth_tx_burst,
             rte_mbuf,
             rte_pktmbuf_chain,
         },
@@ -20,15 +21,68 @@ use crate::{
             consts::RECEIVE_BATCH_SIZE,
             NetworkRuntime,
             PacketBuf,
+            SegmentationOffload,
         },
     },
 };
 use ::arrayvec::ArrayVec;
-use ::std::mem;
+use ::std::{
+    cmp,
+    mem,
+    net::SocketAddrV4,
+};
 
 #[cfg(feature = "profiler")]
 use crate::timer;
 
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for DPDK Runtime
+impl DPDKRuntime {
+    /// Copies `body` into a chain of body mbufs. If the body pool runs dry, the mbufs that were allocated so far are
+    /// released.
+    fn copy_into_body_mbufs(&self, body: &DemiBuffer) -> Result<DemiBuffer, Fail> {
+        let mut chain: Option<DemiBuffer> = None;
+        let mut offset: usize = 0;
+        while offset < body.len() {
+            let mut mbuf: DemiBuffer = self.queue.mm.alloc_body_mbuf()?;
+            let len: usize = cmp::min(mbuf.len(), body.len() - offset);
+            mbuf[..len].copy_from_slice(&body[offset..(offset + len)]);
+            mbuf.trim(mbuf.len() - len).unwrap();
+            offset += len;
+
+            match chain {
+                Some(ref mut head) => head.append(mbuf)?,
+                None => chain = Some(mbuf),
+            }
+        }
+
+        Ok(chain.expect("body should not be empty"))
+    }
+
+    /// Drops a packet that could not be transmitted because the memory pools are exhausted. The transport protocol is
+    /// left to recover, as if the packet had been lost on the wire.
+    fn drop_packet(&self, e: Fail) {
+        warn!("dropping packet: {:?}", e);
+        self.update_transmit_stats(|stats| stats.drops += 1);
+    }
+
+    /// Requests `offload` from the NIC for the packet that starts with `mbuf`, if any.
+    fn set_segmentation_offload(&self, mbuf: &mut DemiBuffer, offload: Option<SegmentationOffload>) {
+        if let Some(offload) = offload {
+            // Header lengths and segment size are packed the same way as the l2_len, l3_len, l4_len and tso_segsz
+            // bit-fields of an mbuf.
+            let tx_offload: u64 = (offload.l2_len as u64 & 0x7f)
+                | (offload.l3_len as u64 & 0x1ff) << 7
+                | (offload.l4_len as u64 & 0xff) << 16
+                | (offload.segment_size as u64 & 0xffff) << 24;
+            mbuf.set_tx_offload(self.tso_ol_flags, tx_offload);
+        }
+    }
+}
+
 //==============================================================================
 // Trait Implementations
 //==============================================================================
@@ -36,70 +90,79 @@ use crate::timer;
 /// Network Runtime Trait Implementation for DPDK Runtime
 impl NetworkRuntime for DPDKRuntime {
     fn transmit(&self, buf: Box<dyn PacketBuf>) {
-        // ToDo: Consider an important optimization here: If there is data in this packet (i.e. not just headers), and
-        // that data is in a DPDK-owned mbuf, and there is "headroom" in that mbuf to hold the packet headers, just
-        // prepend the headers into that mbuf and save the extra header mbuf allocation that we currently always do.
-
         // ToDo: cleanup unwrap() and expect() from this code when this function returns a Result.
 
-        // Alloc header mbuf, check header size.
-        // Serialize header.
-        // Decide if we can inline the data --
-        //   1) How much space is left?
+        // Decide if we can inline the body --
+        //   1) How much space is left in a header mbuf?
         //   2) Is the body small enough?
-        // If we can inline, copy and return.
+        // If we can inline, alloc header mbuf, serialize header, copy body and return.
         // If we can't inline...
         //   1) See if the body is managed => take
-        //   2) Not managed => alloc body
-        // Chain body buffer.
+        //   2) Not managed => alloc body and copy
+        // If the body mbuf is not shared and has enough headroom => prepend and serialize header.
+        // Otherwise, alloc header mbuf, serialize header and chain body mbuf.
+        let header_size: usize = buf.header_size();
+        let header_mbuf_capacity: usize = self.queue.mm.header_mbuf_capacity();
+        assert!(header_size <= header_mbuf_capacity);
+
+        match buf.take_body() {
+            // The body does not fit in the header mbuf, so it goes in its own mbuf.
+            Some(body) if body.len() > header_mbuf_capacity - header_size => {
+                assert!(header_size + body.len() >= MIN_PAYLOAD_SIZE);
 
-        // First, allocate a header mbuf and write the header into it.
-        let mut header_mbuf: DemiBuffer = match self.mm.alloc_header_mbuf() {
-            Ok(mbuf) => mbuf,
-            Err(e) => panic!("failed to allocate header mbuf: {:?}", e.cause),
-        };
-        let header_size = buf.header_size();
-        assert!(header_size <= header_mbuf.len());
-        buf.write_header(&mut header_mbuf[..header_size]);
+                // Get the body mbuf.
+                let mut body_mbuf: DemiBuffer = if body.is_dpdk_allocated() {
+                    // The body is already stored in an MBuf.
+                    body
+                } else {
+                    // The body is not dpdk-allocated, copy it into body mbufs. Large segments may span many of them.
+                    match self.copy_into_body_mbufs(&body) {
+                        Ok(body_mbuf) => body_mbuf,
+                        Err(e) => return self.drop_packet(e),
+                    }
+                };
 
-        if let Some(body) = buf.take_body() {
-            // Next, see how much space we have remaining and inline the body if we have room.
-            let inline_space = header_mbuf.len() - header_size;
+                // Fast path: nobody else references the data of the body mbuf and there is enough headroom in it to
+                // hold the packet headers, so prepend them and save the extra header mbuf (and descriptor).
+                if body_mbuf.is_exclusive() && body_mbuf.headroom() >= header_size {
+                    body_mbuf.prepend(header_size).unwrap();
+                    buf.write_header(&mut body_mbuf[..header_size]);
+                    self.set_segmentation_offload(&mut body_mbuf, buf.segmentation_offload());
+                    let mbuf_ptr: *mut rte_mbuf = body_mbuf.into_mbuf().expect("mbuf should not be empty");
+                    self.tx_queue.push(mbuf_ptr);
+                    self.update_transmit_stats(|stats| stats.headers_prepended += 1);
+                    return;
+                }
 
-            // Chain a buffer.
-            if body.len() > inline_space {
-                assert!(header_size + body.len() >= MIN_PAYLOAD_SIZE);
+                // Otherwise, allocate a header mbuf and write the header into it.
+                let mut header_mbuf: DemiBuffer = match self.queue.mm.alloc_header_mbuf() {
+                    Ok(header_mbuf) => header_mbuf,
+                    Err(e) => return self.drop_packet(e),
+                };
+                buf.write_header(&mut header_mbuf[..header_size]);
 
                 // We're only using the header_mbuf for, well, the header.
                 header_mbuf.trim(header_mbuf.len() - header_size).unwrap();
+                self.set_segmentation_offload(&mut header_mbuf, buf.segmentation_offload());
 
-                // Get the body mbuf.
-                let body_mbuf: *mut rte_mbuf = if body.is_dpdk_allocated() {
-                    // The body is already stored in an MBuf, just extract it from the DemiBuffer.
-                    body.into_mbuf().expect("'body' should be DPDK-allocated")
-                } else {
-                    // The body is not dpdk-allocated, allocate a DPDKBuffer and copy the body into it.
-                    let mut mbuf: DemiBuffer = match self.mm.alloc_body_mbuf() {
-                        Ok(mbuf) => mbuf,
-                        Err(e) => panic!("failed to allocate body mbuf: {:?}", e.cause),
-                    };
-                    assert!(mbuf.len() >= body.len());
-                    mbuf[..body.len()].copy_from_slice(&body[..]);
-                    mbuf.trim(mbuf.len() - body.len()).unwrap();
-                    mbuf.into_mbuf().expect("mbuf should not be empty")
-                };
-
-                let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf should not be empty");
+                let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf should not be empty");
+                let body_mbuf_ptr: *mut rte_mbuf = body_mbuf.into_mbuf().expect("mbuf should not be empty");
                 // Safety: rte_pktmbuf_chain is a FFI that is safe to call as both of its args are valid MBuf pointers.
                 unsafe {
                     // Attach the body MBuf onto the header MBuf's buffer chain.
-                    assert_eq!(rte_pktmbuf_chain(header_mbuf_ptr, body_mbuf), 0);
+                    assert_eq!(rte_pktmbuf_chain(header_mbuf_ptr, body_mbuf_ptr), 0);
                 }
-                let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-                assert_eq!(num_sent, 1);
-            }
-            // Otherwise, write in the inline space.
-            else {
+                self.tx_queue.push(header_mbuf_ptr);
+                self.update_transmit_stats(|stats| stats.headers_chained += 1);
+            },
+            // Otherwise, write the body in the inline space of the header mbuf.
+            Some(body) => {
+                let mut header_mbuf: DemiBuffer = match self.queue.mm.alloc_header_mbuf() {
+                    Ok(header_mbuf) => header_mbuf,
+                    Err(e) => return self.drop_packet(e),
+                };
+                buf.write_header(&mut header_mbuf[..header_size]);
+
                 let body_buf = &mut header_mbuf[header_size..(header_size + body.len())];
                 body_buf.copy_from_slice(&body[..]);
 
@@ -113,26 +176,32 @@ impl NetworkRuntime for DPDKRuntime {
 
                 let frame_size = std::cmp::max(header_size + body.len(), MIN_PAYLOAD_SIZE);
                 header_mbuf.trim(header_mbuf.len() - frame_size).unwrap();
+                self.set_segmentation_offload(&mut header_mbuf, buf.segmentation_offload());
+
+                let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
+                self.tx_queue.push(header_mbuf_ptr);
+                self.update_transmit_stats(|stats| stats.bodies_inlined += 1);
+            },
+            // No body on our packet, just send the headers.
+            None => {
+                let mut header_mbuf: DemiBuffer = match self.queue.mm.alloc_header_mbuf() {
+                    Ok(header_mbuf) => header_mbuf,
+                    Err(e) => return self.drop_packet(e),
+                };
+                buf.write_header(&mut header_mbuf[..header_size]);
 
-                let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
-                let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-                assert_eq!(num_sent, 1);
-            }
-        }
-        // No body on our packet, just send the headers.
-        else {
-            if header_size < MIN_PAYLOAD_SIZE {
-                let padding_bytes = MIN_PAYLOAD_SIZE - header_size;
-                let padding_buf = &mut header_mbuf[header_size..][..padding_bytes];
-                for byte in padding_buf {
-                    *byte = 0;
+                if header_size < MIN_PAYLOAD_SIZE {
+                    let padding_bytes = MIN_PAYLOAD_SIZE - header_size;
+                    let padding_buf = &mut header_mbuf[header_size..][..padding_bytes];
+                    for byte in padding_buf {
+                        *byte = 0;
+                    }
                 }
-            }
-            let frame_size = std::cmp::max(header_size, MIN_PAYLOAD_SIZE);
-            header_mbuf.trim(header_mbuf.len() - frame_size).unwrap();
-            let mut header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
-            let num_sent = unsafe { rte_eth_tx_burst(self.port_id, 0, &mut header_mbuf_ptr, 1) };
-            assert_eq!(num_sent, 1);
+                let frame_size = std::cmp::max(header_size, MIN_PAYLOAD_SIZE);
+                header_mbuf.trim(header_mbuf.len() - frame_size).unwrap();
+                let header_mbuf_ptr: *mut rte_mbuf = header_mbuf.into_mbuf().expect("mbuf cannot be empty");
+                self.tx_queue.push(header_mbuf_ptr);
+            },
         }
     }
 
@@ -140,13 +209,18 @@ impl NetworkRuntime for DPDKRuntime {
         let mut out = ArrayVec::new();
 
         let mut packets: [*mut rte_mbuf; RECEIVE_BATCH_SIZE] = unsafe { mem::zeroed() };
+        let burst_size: usize = self.rx_burst_size.get();
         let nb_rx = unsafe {
             #[cfg(feature = "profiler")]
             timer!("catnip_libos::receive::rte_eth_rx_burst");
 
-            rte_eth_rx_burst(self.port_id, 0, packets.as_mut_ptr(), RECEIVE_BATCH_SIZE as u16)
+            rte_eth_rx_burst(self.port_id, self.queue_id, packets.as_mut_ptr(), burst_size as u16)
         };
-        assert!(nb_rx as usize <= RECEIVE_BATCH_SIZE);
+        assert!(nb_rx as usize <= burst_size);
+        self.rx_burst_size.update(nb_rx as usize);
+        if nb_rx > 0 {
+            stats::record(|stats| stats.rx_burst.record(nb_rx as u64));
+        }
 
         {
             #[cfg(feature = "profiler")]
@@ -160,4 +234,11 @@ impl NetworkRuntime for DPDKRuntime {
 
         out
     }
+
+    fn receives_flow(&self, local: SocketAddrV4, remote: SocketAddrV4) -> bool {
+        match self.rss_steering {
+            Some(ref rss_steering) => rss_steering.queue_of(remote, local) == self.queue_id,
+            None => true,
+        }
+    }
 }
@@ -0,0 +1,223 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::runtime::libdpdk::{
+    rte_eth_rss_reta_entry64,
+    RTE_ETH_RETA_GROUP_SIZE,
+};
+use ::anyhow::{
+    bail,
+    Error,
+};
+use ::std::{
+    mem::MaybeUninit,
+    net::SocketAddrV4,
+};
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Receive Side Scaling (RSS) Configuration
+///
+/// Describes how incoming flows are spread across the receive queues of a port. Each queue is owned by a single
+/// runtime (and thus by a single scheduler and network stack), so the hash key and the redirection table (RETA)
+/// together decide which runtime owns each flow.
+#[derive(Clone, Debug)]
+pub struct RssConfig {
+    /// Number of receive/transmit queue pairs in the port.
+    num_queues: u16,
+    /// Hash key. If `None`, the default key of the driver is used.
+    key: Option<Vec<u8>>,
+    /// Redirection table. It is repeated to fill up the one of the NIC. If `None`, queues are assigned in round-robin.
+    reta: Option<Vec<u16>>,
+}
+
+/// RSS Steering
+///
+/// Mirrors the hash key and the redirection table that were programmed into the NIC, so that the queue that receives a
+/// flow can be computed in software. Runtimes rely on this to pick ephemeral ports for their active opens, such that
+/// replies land on their own queue.
+#[derive(Clone, Debug)]
+pub struct RssSteering {
+    /// Hash key.
+    key: Vec<u8>,
+    /// Redirection table, with as many entries as the one of the NIC.
+    reta: Vec<u16>,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for RSS Configuration
+impl RssConfig {
+    /// Creates an RSS configuration.
+    pub fn new(num_queues: u16, key: Option<Vec<u8>>, reta: Option<Vec<u16>>) -> Self {
+        Self { num_queues, key, reta }
+    }
+
+    /// Returns the number of receive/transmit queue pairs in the port.
+    pub fn num_queues(&self) -> u16 {
+        self.num_queues
+    }
+
+    /// Returns the hash key, if any was configured.
+    pub fn key(&self) -> Option<&[u8]> {
+        self.key.as_deref()
+    }
+
+    /// Checks whether or not the redirection table of the NIC should be programmed.
+    pub fn has_reta(&self) -> bool {
+        self.num_queues > 1 || self.reta.is_some()
+    }
+
+    /// Builds the redirection table for a NIC whose table has `reta_size` entries.
+    pub fn reta_conf(&self, reta_size: u16) -> Result<Vec<rte_eth_rss_reta_entry64>, Error> {
+        let group_size: usize = RTE_ETH_RETA_GROUP_SIZE as usize;
+        let reta_size: usize = reta_size as usize;
+
+        let queues: Vec<u16> = match self.reta {
+            Some(ref reta) => reta.clone(),
+            None => (0..self.num_queues).collect(),
+        };
+        if queues.is_empty() {
+            bail!("empty RSS redirection table");
+        }
+        if let Some(queue_id) = queues.iter().find(|&&queue_id| queue_id >= self.num_queues) {
+            bail!(
+                "RSS redirection table points to invalid queue (queue_id={:?}, num_queues={:?})",
+                queue_id,
+                self.num_queues
+            );
+        }
+
+        let num_groups: usize = (reta_size + group_size - 1) / group_size;
+        let mut reta_conf: Vec<rte_eth_rss_reta_entry64> = Vec::with_capacity(num_groups);
+        for group in 0..num_groups {
+            // Safety: rte_eth_rss_reta_entry64 is a plain C structure, thus it is safe to zero initialize it.
+            let mut entry: rte_eth_rss_reta_entry64 = unsafe { MaybeUninit::zeroed().assume_init() };
+            for i in 0..group_size {
+                let index: usize = group * group_size + i;
+                if index >= reta_size {
+                    break;
+                }
+                entry.mask |= 1 << i;
+                entry.reta[i] = queues[index % queues.len()];
+            }
+            reta_conf.push(entry);
+        }
+
+        Ok(reta_conf)
+    }
+
+    /// Builds the software mirror of the steering of a NIC whose hash key is `key` and whose table has `reta_size`
+    /// entries. The redirection table must be valid, see [Self::reta_conf].
+    pub fn steering(&self, key: Vec<u8>, reta_size: u16) -> RssSteering {
+        let queues: Vec<u16> = match self.reta {
+            Some(ref reta) => reta.clone(),
+            None => (0..self.num_queues).collect(),
+        };
+        let reta: Vec<u16> = (0..reta_size as usize)
+            .map(|index| queues[index % queues.len()])
+            .collect();
+        RssSteering { key, reta }
+    }
+}
+
+/// Associate Functions for RSS Steering
+impl RssSteering {
+    /// Returns the queue that receives TCP/UDP packets that are sent from `src` to `dst`.
+    pub fn queue_of(&self, src: SocketAddrV4, dst: SocketAddrV4) -> u16 {
+        let hash: u32 = self.hash(src, dst);
+        self.reta[hash as usize % self.reta.len()]
+    }
+
+    /// Computes the Toeplitz hash of the TCP/UDP packets that are sent from `src` to `dst`, the way the NIC does.
+    fn hash(&self, src: SocketAddrV4, dst: SocketAddrV4) -> u32 {
+        let mut input: [u8; 12] = [0; 12];
+        input[0..4].copy_from_slice(&src.ip().octets());
+        input[4..8].copy_from_slice(&dst.ip().octets());
+        input[8..10].copy_from_slice(&src.port().to_be_bytes());
+        input[10..12].copy_from_slice(&dst.port().to_be_bytes());
+
+        // Missing key bytes are taken as zeros.
+        let key_byte = |i: usize| -> u8 { self.key.get(i).copied().unwrap_or(0) };
+
+        // Slide a 32 bit window over the key, one bit for each bit of the input, and accumulate it for set bits.
+        let mut window: u32 = u32::from_be_bytes([key_byte(0), key_byte(1), key_byte(2), key_byte(3)]);
+        let mut hash: u32 = 0;
+        for (i, byte) in input.iter().enumerate() {
+            for bit in (0..8).rev() {
+                if (byte >> bit) & 1 != 0 {
+                    hash ^= window;
+                }
+                window = (window << 1) | ((key_byte(i + 4) >> bit) & 1) as u32;
+            }
+        }
+        hash
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        RssConfig,
+        RssSteering,
+    };
+    use ::std::net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    };
+
+    /// Hash key of the verification suite of the RSS specification.
+    const KEY: [u8; 40] = [
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0, 0xd0, 0xca,
+        0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b,
+        0xbe, 0xac, 0x01, 0xfa,
+    ];
+
+    /// Checks the Toeplitz hash against the verification suite of the RSS specification.
+    #[test]
+    fn toeplitz_hash() {
+        let steering: RssSteering = RssConfig::new(1, None, None).steering(KEY.to_vec(), 128);
+        let cases: [(SocketAddrV4, SocketAddrV4, u32); 3] = [
+            (
+                SocketAddrV4::new(Ipv4Addr::new(66, 9, 149, 187), 2794),
+                SocketAddrV4::new(Ipv4Addr::new(161, 142, 100, 80), 1766),
+                0x51ccc178,
+            ),
+            (
+                SocketAddrV4::new(Ipv4Addr::new(199, 92, 111, 2), 14230),
+                SocketAddrV4::new(Ipv4Addr::new(65, 69, 140, 83), 4739),
+                0xc626b0ea,
+            ),
+            (
+                SocketAddrV4::new(Ipv4Addr::new(24, 19, 198, 95), 12898),
+                SocketAddrV4::new(Ipv4Addr::new(12, 22, 207, 184), 38024),
+                0x5c2b394a,
+            ),
+        ];
+        for (src, dst, hash) in cases {
+            assert_eq!(steering.hash(src, dst), hash);
+        }
+    }
+
+    /// Checks that flows are steered according to the redirection table.
+    #[test]
+    fn steer_flows() {
+        let steering: RssSteering = RssConfig::new(4, None, Some(vec![3, 1])).steering(KEY.to_vec(), 128);
+        let src: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(66, 9, 149, 187), 2794);
+        let dst: SocketAddrV4 = SocketAddrV4::new(Ipv4Addr::new(161, 142, 100, 80), 1766);
+        // 0x51ccc178 % 128 = 120, which is an even entry.
+        assert_eq!(steering.queue_of(src, dst), 3);
+    }
+}
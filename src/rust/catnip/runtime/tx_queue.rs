@@ -0,0 +1,192 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::{
+    perftools::stats,
+    runtime::libdpdk::{
+        rte_eth_tx_burst,
+        rte_mbuf,
+        rte_pktmbuf_free,
+    },
+};
+use ::arrayvec::ArrayVec;
+use ::std::cell::{
+    Cell,
+    RefCell,
+    RefMut,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Maximum number of packets that may be staged in a transmit queue.
+pub const MAX_TX_BURST_SIZE: usize = 512;
+
+/// Default number of staged packets that triggers a flush of a transmit queue.
+pub const DEFAULT_TX_BURST_SIZE: usize = 32;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Transmit Queue Statistics
+#[derive(Clone, Copy, Debug, Default)]
+pub struct TxQueueStats {
+    /// Number of packets handed over to the NIC.
+    pub packets_sent: u64,
+    /// Number of packets dropped because the transmit queue was full.
+    pub packets_dropped: u64,
+    /// Number of calls to `rte_eth_tx_burst()`.
+    pub bursts: u64,
+    /// Number of bursts in which the NIC did not take all staged packets.
+    pub partial_bursts: u64,
+}
+
+/// Transmit Queue
+///
+/// Stages outgoing packets and hands them over to a NIC transmit queue in bursts, so that we ring the doorbell once
+/// per burst rather than once per packet. Staged packets are flushed either when the configured burst size is reached
+/// or when the owner explicitly asks for it (e.g. at the end of each poll iteration). The owner may also hold back
+/// flushes for a while (e.g. while it issues a batch of operations), so that all packets go out in a single burst.
+pub struct TxQueue {
+    /// Port where packets are sent.
+    port_id: u16,
+    /// Transmit queue of the port where packets are sent.
+    queue_id: u16,
+    /// Number of staged packets that triggers a flush.
+    burst_size: usize,
+    /// Staged packets.
+    pending: RefCell<ArrayVec<*mut rte_mbuf, MAX_TX_BURST_SIZE>>,
+    /// Whether flushes are held back until the staging area fills up.
+    held: Cell<bool>,
+    /// Statistics.
+    stats: Cell<TxQueueStats>,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Transmit Queues
+impl TxQueue {
+    /// Creates a transmit queue.
+    pub fn new(port_id: u16, queue_id: u16, burst_size: usize) -> Self {
+        assert!(burst_size > 0 && burst_size <= MAX_TX_BURST_SIZE);
+        Self {
+            port_id,
+            queue_id,
+            burst_size,
+            pending: RefCell::new(ArrayVec::new()),
+            held: Cell::new(false),
+            stats: Cell::new(TxQueueStats::default()),
+        }
+    }
+
+    /// Stages a packet for transmission. The transmit queue takes ownership of the packet.
+    ///
+    /// If the NIC is not keeping up and the transmit queue is full, the packet is dropped and accounted in the
+    /// statistics, as retransmission of lost packets is a concern of upper-level protocols.
+    pub fn push(&self, mbuf_ptr: *mut rte_mbuf) {
+        let mut pending: RefMut<ArrayVec<*mut rte_mbuf, MAX_TX_BURST_SIZE>> = self.pending.borrow_mut();
+
+        // The NIC did not drain previous bursts, so try again to make room.
+        if pending.is_full() {
+            self.do_flush(&mut pending);
+
+            // Backpressure: the NIC transmit ring is still full.
+            if pending.is_full() {
+                warn!("push(): transmit queue is full, dropping packet");
+                // Safety: rte_pktmbuf_free is a FFI, which is safe since we call it with an actual MBuf pointer.
+                unsafe { rte_pktmbuf_free(mbuf_ptr) };
+                let mut stats: TxQueueStats = self.stats.get();
+                stats.packets_dropped += 1;
+                self.stats.set(stats);
+                return;
+            }
+        }
+
+        pending.push(mbuf_ptr);
+
+        if pending.len() >= self.burst_size && !self.held.get() {
+            self.do_flush(&mut pending);
+        }
+    }
+
+    /// Hands over all staged packets to the NIC. Returns the number of packets that were sent.
+    pub fn flush(&self) -> usize {
+        self.do_flush(&mut self.pending.borrow_mut())
+    }
+
+    /// Holds back flushes of the target transmit queue until [Self::release] is called. Packets are still flushed if the
+    /// staging area fills up.
+    pub fn hold(&self) {
+        self.held.set(true);
+    }
+
+    /// Stops holding back flushes of the target transmit queue, and hands over all staged packets to the NIC. Returns
+    /// the number of packets that were sent.
+    pub fn release(&self) -> usize {
+        self.held.set(false);
+        self.flush()
+    }
+
+    /// Returns the number of packets that are staged in the target transmit queue.
+    pub fn len(&self) -> usize {
+        self.pending.borrow().len()
+    }
+
+    /// Returns the statistics of the target transmit queue.
+    pub fn stats(&self) -> TxQueueStats {
+        self.stats.get()
+    }
+
+    /// Hands over staged packets to the NIC. Packets that the NIC did not accept remain staged (in order) and are
+    /// retried on the next flush.
+    fn do_flush(&self, pending: &mut ArrayVec<*mut rte_mbuf, MAX_TX_BURST_SIZE>) -> usize {
+        if pending.is_empty() {
+            return 0;
+        }
+
+        let nb_pkts: usize = pending.len();
+        // Safety: rte_eth_tx_burst is a FFI, which is safe since we call it with actual MBuf pointers.
+        let nb_tx: usize =
+            unsafe { rte_eth_tx_burst(self.port_id, self.queue_id, pending.as_mut_ptr(), nb_pkts as u16) } as usize;
+        debug_assert!(nb_tx <= nb_pkts);
+
+        let mut stats: TxQueueStats = self.stats.get();
+        stats.bursts += 1;
+        stats.packets_sent += nb_tx as u64;
+        if nb_tx < nb_pkts {
+            trace!("do_flush(): partial burst (nb_tx={:?}, nb_pkts={:?})", nb_tx, nb_pkts);
+            stats.partial_bursts += 1;
+        }
+        self.stats.set(stats);
+        stats::record(|stats| stats.tx_burst.record(nb_tx as u64));
+
+        // The NIC took ownership of the first `nb_tx` packets.
+        pending.drain(..nb_tx);
+
+        nb_tx
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Drop Trait Implementation for Transmit Queues
+impl Drop for TxQueue {
+    fn drop(&mut self) {
+        // Release packets that never made it to the NIC.
+        for mbuf_ptr in self.pending.get_mut().drain(..) {
+            // Safety: rte_pktmbuf_free is a FFI, which is safe since we call it with an actual MBuf pointer.
+            unsafe { rte_pktmbuf_free(mbuf_ptr) };
+        }
+        debug!("drop(): {:?}", self.stats.get());
+    }
+}
@@ -77,7 +77,7 @@ impl CatpowderLibOS {
         ));
         let now: Instant = Instant::now();
         let scheduler: Scheduler = Scheduler::default();
-        let clock: TimerRc = TimerRc(Rc::new(Timer::new(now)));
+        let clock: TimerRc = TimerRc(Rc::new(Timer::with_granularity(now, config.timer_granularity())));
         let rng_seed: [u8; 32] = [0; 32];
         let inetstack: InetStack = InetStack::new(
             rt.clone(),
@@ -107,7 +107,7 @@ impl CatpowderLibOS {
         trace!("push(): qd={:?}", qd);
         match self.rt.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
                 let future = self.do_push(qd, buf)?;
@@ -128,7 +128,7 @@ impl CatpowderLibOS {
         trace!("pushto2(): qd={:?}", qd);
         match self.rt.clone_sgarray(sga) {
             Ok(buf) => {
-                if buf.len() == 0 {
+                if buf.pkt_len() == 0 {
                     return Err(Fail::new(libc::EINVAL, "zero-length buffer"));
                 }
                 let future = self.do_pushto(qd, buf, to)?;
@@ -150,11 +150,26 @@ impl CatpowderLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion. See [crate::scheduler::Scheduler::for_each_completed].
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        self.scheduler.for_each_completed(|key| visitor(key.into()))
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         let (qd, r): (QDesc, OperationResult) = self.take_operation(handle);
         Ok(pack_result(self.rt.clone(), r, qd, qt.into()))
     }
 
+    /// Polls the network stack and then hands over to the kernel all frames that were staged for transmission.
+    /// Returns whether any task ran or any packet was received.
+    pub fn poll(&mut self) -> bool {
+        #[cfg(feature = "profiler")]
+        timer!("catpowder::poll");
+        let progress: bool = self.inetstack.poll_bg_work();
+        self.rt.flush();
+        progress
+    }
+
     /// Allocates a scatter-gather array.
     pub fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
         self.rt.alloc_sgarray(size)
@@ -9,6 +9,7 @@ mod rawsocket;
 //==============================================================================
 
 use self::rawsocket::{
+    PacketRing,
     RawSocket,
     RawSocketAddr,
 };
@@ -48,6 +49,8 @@ pub struct LinuxRuntime {
     pub ipv4_addr: Ipv4Addr,
     ifindex: i32,
     socket: Rc<RefCell<RawSocket>>,
+    /// Memory-mapped rings of the raw socket. Frames go through sendto() and recvfrom() if they are not available.
+    ring: Option<Rc<PacketRing>>,
 }
 
 //==============================================================================
@@ -70,6 +73,13 @@ impl LinuxRuntime {
         let mac_addr: [u8; 6] = [0; 6];
         let ifindex: i32 = Self::get_ifindex(ifname).expect("could not parse ifindex");
         let socket: RawSocket = RawSocket::new().expect("could not create raw socket");
+        let ring: Option<Rc<PacketRing>> = match PacketRing::new(&socket) {
+            Ok(ring) => Some(Rc::new(ring)),
+            Err(e) => {
+                warn!("could not set up packet rings, using sendto() and recvfrom(): {:?}", e);
+                None
+            },
+        };
         let sockaddr: RawSocketAddr = RawSocketAddr::new(ifindex, &mac_addr);
         socket.bind(&sockaddr).expect("could not bind raw socket");
 
@@ -81,6 +91,14 @@ impl LinuxRuntime {
             ipv4_addr,
             ifindex,
             socket: Rc::new(RefCell::new(socket)),
+            ring,
+        }
+    }
+
+    /// Hands over all frames that are staged for transmission to the kernel.
+    pub fn flush(&self) {
+        if let Some(ring) = self.ring.as_ref() {
+            ring.flush();
         }
     }
 
@@ -12,6 +12,7 @@ use super::{
 use crate::{
     inetstack::protocols::ethernet2::Ethernet2Header,
     runtime::{
+        fail::Fail,
         memory::DemiBuffer,
         network::{
             consts::RECEIVE_BATCH_SIZE,
@@ -37,12 +38,27 @@ impl NetworkRuntime for LinuxRuntime {
         let header_size: usize = pkt.header_size();
         let body_size: usize = pkt.body_size();
 
+        // Fast path: write the frame straight into the transmit ring. It is sent along with the rest of the batch.
+        if let Some(ring) = self.ring.as_ref() {
+            let body: Option<DemiBuffer> = pkt.take_body();
+            let result: Result<(), Fail> = ring.transmit(header_size + body_size, |frame| {
+                pkt.write_header(&mut frame[..header_size]);
+                if let Some(body) = body {
+                    copy_body(&mut frame[header_size..], &body);
+                }
+            });
+            if let Err(e) = result {
+                warn!("dropping packet: {:?}", e);
+            }
+            return;
+        }
+
         assert!(header_size + body_size < u16::MAX as usize);
         let mut buf: DemiBuffer = DemiBuffer::new((header_size + body_size) as u16);
 
         pkt.write_header(&mut buf[..header_size]);
         if let Some(body) = pkt.take_body() {
-            buf[header_size..].copy_from_slice(&body[..]);
+            copy_body(&mut buf[header_size..], &body);
         }
 
         let (header, _) = Ethernet2Header::parse(buf.clone()).unwrap();
@@ -59,8 +75,18 @@ impl NetworkRuntime for LinuxRuntime {
     }
 
     /// Receives a batch of [DemiBuffer].
-    // ToDo: This routine currently only tries to receive a single packet buffer, not a batch of them.
+    // ToDo: Without packet rings, this routine currently only tries to receive a single packet buffer, not a batch.
     fn receive(&self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> {
+        // Fast path: copy frames straight out of the receive ring.
+        if let Some(ring) = self.ring.as_ref() {
+            let mut ret: ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> = ArrayVec::new();
+            ring.receive(RECEIVE_BATCH_SIZE, |frame| match DemiBuffer::from_slice(frame) {
+                Ok(dbuf) => ret.push(dbuf),
+                Err(e) => warn!("dropping frame: {:?}", e),
+            });
+            return ret;
+        }
+
         // 4096B buffer size chosen arbitrarily, seems fine for now.
         // REVIEW: Won't this fail for Ethernet jumbo frames?  Conversely, it seems wastefully big for standard frames.
         const BUFFER_SIZE: usize = 4096;
@@ -83,3 +109,16 @@ impl NetworkRuntime for LinuxRuntime {
         }
     }
 }
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Copies the data of all segments of `body` into `frame`, one after the other.
+fn copy_body(frame: &mut [u8], body: &DemiBuffer) {
+    let mut offset: usize = 0;
+    for segment in body.segments() {
+        frame[offset..(offset + segment.len())].copy_from_slice(segment);
+        offset += segment.len();
+    }
+}
@@ -3,6 +3,7 @@
 
 mod rawsockaddr;
 mod rawsocket;
+mod ring;
 
 //======================================================================================================================
 // Exports
@@ -10,3 +11,4 @@ mod rawsocket;
 
 pub use rawsockaddr::RawSocketAddr;
 pub use rawsocket::RawSocket;
+pub use ring::PacketRing;
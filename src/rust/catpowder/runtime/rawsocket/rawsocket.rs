@@ -41,6 +41,11 @@ impl RawSocket {
         Ok(RawSocket(sockfd))
     }
 
+    /// Returns the underlying file descriptor.
+    pub fn as_raw_fd(&self) -> libc::c_int {
+        self.0
+    }
+
     // Binds a socket to a raw address.
     pub fn bind(&self, addr: &RawSocketAddr) -> Result<(), Fail> {
         let ret: i32 = unsafe {
@@ -0,0 +1,295 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use super::RawSocket;
+use crate::runtime::fail::Fail;
+use ::libc;
+use ::std::{
+    cell::Cell,
+    mem,
+    ptr,
+    slice,
+    sync::atomic::{
+        AtomicU32,
+        Ordering,
+    },
+};
+
+//======================================================================================================================
+// Constants & Structures
+//======================================================================================================================
+
+/// Size of a frame in either ring. This is large enough for a standard Ethernet frame plus the frame header.
+const FRAME_SIZE: usize = 4096;
+
+/// Number of frames in each block of either ring.
+const FRAMES_PER_BLOCK: usize = 16;
+
+/// Number of frames in the receive ring.
+const RX_FRAME_COUNT: usize = 1024;
+
+/// Number of frames in the transmit ring.
+const TX_FRAME_COUNT: usize = 1024;
+
+/// Offset of the data in a transmit frame. The kernel expects it right after the (aligned) frame header.
+const TX_DATA_OFFSET: usize = libc::TPACKET2_HDRLEN - mem::size_of::<libc::sockaddr_ll>();
+
+/// Offset of the link-layer address of a receive frame.
+const RX_ADDR_OFFSET: usize = TX_DATA_OFFSET;
+
+/// Ring of frames that is shared with the kernel.
+struct Ring {
+    /// First frame of the ring.
+    base: *mut u8,
+    /// Number of frames in the ring.
+    frame_count: usize,
+    /// Next frame to visit.
+    head: Cell<usize>,
+}
+
+/// Memory-mapped receive and transmit rings of a raw socket (PACKET_MMAP).
+///
+/// Received frames are read straight from the receive ring, without a system call. Frames to be transmitted are
+/// written straight into the transmit ring, and the kernel is only asked to send them once per batch, by [Self::flush].
+pub struct PacketRing {
+    /// Underlying raw socket.
+    sockfd: libc::c_int,
+    /// Memory area that holds both rings.
+    area: *mut libc::c_void,
+    /// Size of the memory area.
+    area_size: usize,
+    /// Receive ring.
+    rx: Ring,
+    /// Transmit ring.
+    tx: Ring,
+    /// Number of frames that were written in the transmit ring since the last flush.
+    tx_pending: Cell<usize>,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+/// Associated functions for rings.
+impl Ring {
+    /// Returns the frame at the head of the ring, and its status word.
+    fn head(&self) -> (*mut u8, &AtomicU32) {
+        // Safety: the head is always in bounds of the ring.
+        let frame: *mut u8 = unsafe { self.base.add(self.head.get() * FRAME_SIZE) };
+        // Safety: each frame starts with its header, whose first field is the status word that the kernel and we use
+        // to hand over the frame. It is aligned, and it is only accessed atomically.
+        let status: &AtomicU32 = unsafe { &*(frame as *const AtomicU32) };
+        (frame, status)
+    }
+
+    /// Moves the head of the ring to the next frame.
+    fn advance(&self) {
+        self.head.set((self.head.get() + 1) % self.frame_count);
+    }
+}
+
+/// Associated functions for packet rings.
+impl PacketRing {
+    /// Sets up receive and transmit rings for `socket`. This must happen before the socket is bound.
+    pub fn new(socket: &RawSocket) -> Result<Self, Fail> {
+        let sockfd: libc::c_int = socket.as_raw_fd();
+
+        // TPACKET_V2 hands over each frame on its own, whereas TPACKET_V3 only hands over blocks of them. The latter
+        // holds back frames until their block fills up or times out, which adds latency at low packet rates.
+        let version: libc::c_int = libc::tpacket_versions::TPACKET_V2 as libc::c_int;
+        setsockopt(sockfd, libc::PACKET_VERSION, &version)?;
+
+        // Release whatever was set up if we fail half way, so that the socket can still be used without rings.
+        Self::map(sockfd).map_err(|e| {
+            let none: libc::tpacket_req = ring_request(0);
+            let _ = setsockopt(sockfd, libc::PACKET_RX_RING, &none);
+            let _ = setsockopt(sockfd, libc::PACKET_TX_RING, &none);
+            e
+        })
+    }
+
+    /// Sets up and maps the rings of `sockfd`.
+    fn map(sockfd: libc::c_int) -> Result<Self, Fail> {
+        let rx_req: libc::tpacket_req = ring_request(RX_FRAME_COUNT);
+        setsockopt(sockfd, libc::PACKET_RX_RING, &rx_req)?;
+        let tx_req: libc::tpacket_req = ring_request(TX_FRAME_COUNT);
+        setsockopt(sockfd, libc::PACKET_TX_RING, &tx_req)?;
+
+        // Hand transmitted frames straight to the driver, as we do our own batching. This is a best-effort setting.
+        let bypass: libc::c_int = 1;
+        if let Err(e) = setsockopt(sockfd, libc::PACKET_QDISC_BYPASS, &bypass) {
+            warn!("could not bypass queueing discipline: {:?}", e);
+        }
+
+        // The transmit ring is mapped right after the receive ring.
+        let rx_size: usize = RX_FRAME_COUNT * FRAME_SIZE;
+        let area_size: usize = rx_size + TX_FRAME_COUNT * FRAME_SIZE;
+        let area: *mut libc::c_void = unsafe {
+            libc::mmap(
+                ptr::null_mut(),
+                area_size,
+                libc::PROT_READ | libc::PROT_WRITE,
+                libc::MAP_SHARED | libc::MAP_POPULATE,
+                sockfd,
+                0,
+            )
+        };
+        if area == libc::MAP_FAILED {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            return Err(Fail::new(errno, "failed to map packet rings"));
+        }
+
+        Ok(Self {
+            sockfd,
+            area,
+            area_size,
+            rx: Ring {
+                base: area as *mut u8,
+                frame_count: RX_FRAME_COUNT,
+                head: Cell::new(0),
+            },
+            tx: Ring {
+                // Safety: the transmit ring is within the mapped area.
+                base: unsafe { (area as *mut u8).add(rx_size) },
+                frame_count: TX_FRAME_COUNT,
+                head: Cell::new(0),
+            },
+            tx_pending: Cell::new(0),
+        })
+    }
+
+    /// Hands over up to `max_frames` received frames to `deliver`, and then returns them to the kernel. Frames that
+    /// were sent by this host are skipped. Returns the number of frames that were delivered.
+    pub fn receive<F: FnMut(&[u8])>(&self, max_frames: usize, mut deliver: F) -> usize {
+        let mut delivered: usize = 0;
+        while delivered < max_frames {
+            let (frame, status): (*mut u8, &AtomicU32) = self.rx.head();
+            if status.load(Ordering::Acquire) & libc::TP_STATUS_USER == 0 {
+                break;
+            }
+
+            // Safety: the kernel handed over the frame, so its header and link-layer address are initialized, and
+            // nobody else accesses them until we hand it back.
+            let (header, addr): (&libc::tpacket2_hdr, &libc::sockaddr_ll) = unsafe {
+                (
+                    &*(frame as *const libc::tpacket2_hdr),
+                    &*(frame.add(RX_ADDR_OFFSET) as *const libc::sockaddr_ll),
+                )
+            };
+            if addr.sll_pkttype != libc::PACKET_OUTGOING {
+                if header.tp_snaplen < header.tp_len {
+                    warn!("dropping truncated frame (len={:?})", header.tp_len);
+                } else {
+                    // Safety: the data of the frame lies within the frame, at the offset that the kernel reported.
+                    let data: &[u8] =
+                        unsafe { slice::from_raw_parts(frame.add(header.tp_mac as usize), header.tp_snaplen as usize) };
+                    deliver(data);
+                    delivered += 1;
+                }
+            }
+
+            status.store(libc::TP_STATUS_KERNEL, Ordering::Release);
+            self.rx.advance();
+        }
+        delivered
+    }
+
+    /// Writes a frame of `len` bytes into the transmit ring. `write` fills in the frame. The frame is sent by the next
+    /// [Self::flush], or right away if the ring is full.
+    pub fn transmit<F: FnOnce(&mut [u8])>(&self, len: usize, write: F) -> Result<(), Fail> {
+        if len > FRAME_SIZE - TX_DATA_OFFSET {
+            return Err(Fail::new(libc::EINVAL, "frame too large for transmit ring"));
+        }
+
+        // If the kernel did not get to the next frame yet, kick it and check again.
+        let (frame, status): (*mut u8, &AtomicU32) = self.tx.head();
+        if !is_available(status) {
+            self.flush();
+            if !is_available(status) {
+                return Err(Fail::new(libc::EAGAIN, "transmit ring is full"));
+            }
+        }
+
+        // Safety: the frame is available, so nobody else accesses it until we hand it over to the kernel.
+        unsafe {
+            write(slice::from_raw_parts_mut(frame.add(TX_DATA_OFFSET), len));
+            (*(frame as *mut libc::tpacket2_hdr)).tp_len = len as u32;
+        }
+        status.store(libc::TP_STATUS_SEND_REQUEST, Ordering::Release);
+        self.tx.advance();
+
+        self.tx_pending.set(self.tx_pending.get() + 1);
+        if self.tx_pending.get() == self.tx.frame_count {
+            self.flush();
+        }
+        Ok(())
+    }
+
+    /// Asks the kernel to send all frames that were written in the transmit ring.
+    pub fn flush(&self) {
+        if self.tx_pending.get() == 0 {
+            return;
+        }
+        if unsafe { libc::send(self.sockfd, ptr::null(), 0, libc::MSG_DONTWAIT) } < 0 {
+            let errno: libc::c_int = unsafe { *libc::__errno_location() };
+            if errno != libc::EAGAIN && errno != libc::ENOBUFS {
+                warn!("failed to flush transmit ring (errno={:?})", errno);
+            }
+        }
+        self.tx_pending.set(0);
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Drop Trait Implementation for Packet Rings
+impl Drop for PacketRing {
+    fn drop(&mut self) {
+        self.flush();
+        unsafe { libc::munmap(self.area, self.area_size) };
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Sets the packet socket option `name` of `sockfd` to `value`.
+fn setsockopt<T>(sockfd: libc::c_int, name: libc::c_int, value: &T) -> Result<(), Fail> {
+    let ret: libc::c_int = unsafe {
+        libc::setsockopt(
+            sockfd,
+            libc::SOL_PACKET,
+            name,
+            value as *const T as *const libc::c_void,
+            mem::size_of::<T>() as libc::socklen_t,
+        )
+    };
+    if ret != 0 {
+        let errno: libc::c_int = unsafe { *libc::__errno_location() };
+        return Err(Fail::new(errno, "failed to set packet socket option"));
+    }
+    Ok(())
+}
+
+/// Describes a ring of `frame_count` frames.
+fn ring_request(frame_count: usize) -> libc::tpacket_req {
+    libc::tpacket_req {
+        tp_block_size: (FRAMES_PER_BLOCK * FRAME_SIZE) as libc::c_uint,
+        tp_block_nr: (frame_count / FRAMES_PER_BLOCK) as libc::c_uint,
+        tp_frame_size: FRAME_SIZE as libc::c_uint,
+        tp_frame_nr: frame_count as libc::c_uint,
+    }
+}
+
+/// Checks whether a transmit frame may be written. Frames that the kernel rejected are reused as well.
+fn is_available(status: &AtomicU32) -> bool {
+    let status: u32 = status.load(Ordering::Acquire);
+    status == libc::TP_STATUS_AVAILABLE || status & libc::TP_STATUS_WRONG_FORMAT != 0
+}
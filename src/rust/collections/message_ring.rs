@@ -0,0 +1,548 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    pal::arch::CPU_DATA_CACHE_LINE_SIZE,
+    runtime::fail::Fail,
+};
+use ::core::{
+    alloc::Layout,
+    ops::DerefMut,
+    ptr,
+    sync::atomic::{
+        AtomicUsize,
+        Ordering,
+    },
+};
+use ::std::alloc;
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Size of the header that precedes each message in a message ring.
+pub const MESSAGE_HEADER_SIZE: usize = 4;
+
+/// Flag in the message header that indicates end of file.
+const MESSAGE_EOF_FLAG: u32 = 1 << 31;
+
+/// Flag in the message header that indicates that the message describes data stored elsewhere.
+const MESSAGE_DESCRIPTOR_FLAG: u32 = 1 << 30;
+
+/// Mask for the length of a message in the message header.
+const MESSAGE_LENGTH_MASK: u32 = MESSAGE_DESCRIPTOR_FLAG - 1;
+
+/// Offset of the `head` index in the memory region of a message ring.
+const HEAD_OFFSET: usize = 0;
+
+/// Offset of the `tail` index in the memory region of a message ring.
+const TAIL_OFFSET: usize = CPU_DATA_CACHE_LINE_SIZE;
+
+/// Offset of the buffer in the memory region of a message ring.
+const BUFFER_OFFSET: usize = 2 * CPU_DATA_CACHE_LINE_SIZE;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Kinds of messages that are stored in a message ring.
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum MessageKind {
+    /// Regular data.
+    Data,
+    /// Descriptor of data that is stored out of the ring. The ring does not interpret the contents of descriptors.
+    Descriptor,
+    /// End of file (always empty).
+    Eof,
+}
+
+/// A lock-free, single writer and single reader, fixed-size circular buffer of variable-length messages.
+///
+/// Each message is stored as a length-prefixed chunk of bytes (padded to the size of the header, so that headers never
+/// wrap around the end of the buffer). Pushing or popping a message costs one copy of its bytes and a single
+/// acquire/release update of the `tail` or `head` index, respectively. These indexes sit on separate cache lines, so
+/// that the writer and the reader do not contend on them, and each side caches the last observed value of the other
+/// side's index, so that it only reads it again when the cached value is not enough to make progress.
+pub struct MessageRing {
+    /// Bytes consumed so far (i.e. free-running index of the first message in the front of the ring).
+    head_ptr: *const AtomicUsize,
+    /// Bytes produced so far (i.e. free-running index of the first empty byte after the message in the back).
+    tail_ptr: *const AtomicUsize,
+    /// Underlying buffer.
+    buffer: *mut u8,
+    /// Pre-computed capacity mask for the buffer.
+    mask: usize,
+    /// Last `head` index observed by the writer.
+    head_cached: AtomicUsize,
+    /// Last `tail` index observed by the reader.
+    tail_cached: AtomicUsize,
+    /// Is the underlying memory managed by this module?
+    is_managed: bool,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Associated functions.
+impl MessageRing {
+    /// Creates a message ring.
+    #[allow(unused)]
+    pub fn new(capacity: usize) -> Result<MessageRing, Fail> {
+        // Check if capacity is invalid.
+        if !capacity.is_power_of_two() || capacity < 2 * MESSAGE_HEADER_SIZE {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "cannot create a message ring that does not have a power of two capacity",
+            ));
+        }
+
+        let layout: Layout = Self::layout(capacity);
+        let ptr: *mut u8 = unsafe {
+            let ptr: *mut u8 = alloc::alloc(layout);
+            if ptr.is_null() {
+                alloc::handle_alloc_error(layout);
+            }
+            ptr
+        };
+
+        let mut ring: MessageRing = Self::from_raw_parts(true, ptr, layout.size())?;
+        ring.is_managed = true;
+        Ok(ring)
+    }
+
+    /// Returns the size of the memory region that fits in a message ring of a given capacity.
+    pub fn region_size(capacity: usize) -> usize {
+        BUFFER_OFFSET + capacity
+    }
+
+    /// Constructs a message ring from raw parts.
+    pub fn from_raw_parts(init: bool, ptr: *mut u8, size: usize) -> Result<MessageRing, Fail> {
+        // Check if we have a valid pointer.
+        if ptr.is_null() {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "cannot construct a message ring from a null pointer",
+            ));
+        }
+
+        // Check if the memory region is properly aligned.
+        if ptr.align_offset(CPU_DATA_CACHE_LINE_SIZE) != 0 {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "cannot construct a message ring from a unaligned memory region",
+            ));
+        }
+
+        // Check if memory region is big enough.
+        if size < Self::region_size(2 * MESSAGE_HEADER_SIZE) {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "memory region is too small to fit in a message ring",
+            ));
+        }
+
+        // Compute length of buffer.
+        // It should be the highest power of two that fits in.
+        let len: usize = 1 << (size - BUFFER_OFFSET).ilog2();
+
+        // Compute pointers.
+        let head_ptr: *const AtomicUsize = unsafe { ptr.add(HEAD_OFFSET) } as *const AtomicUsize;
+        let tail_ptr: *const AtomicUsize = unsafe { ptr.add(TAIL_OFFSET) } as *const AtomicUsize;
+        let buffer: *mut u8 = unsafe { ptr.add(BUFFER_OFFSET) };
+
+        // Initialize head and tail indexes only if requested.
+        if init {
+            unsafe {
+                (*head_ptr).store(0, Ordering::Relaxed);
+                (*tail_ptr).store(0, Ordering::Release);
+            }
+        }
+
+        let head_cached: usize = unsafe { (*head_ptr).load(Ordering::Acquire) };
+        let tail_cached: usize = unsafe { (*tail_ptr).load(Ordering::Acquire) };
+
+        Ok(MessageRing {
+            head_ptr,
+            tail_ptr,
+            buffer,
+            mask: len - 1,
+            head_cached: AtomicUsize::new(head_cached),
+            tail_cached: AtomicUsize::new(tail_cached),
+            is_managed: false,
+        })
+    }
+
+    /// Returns the capacity (in bytes) of the target message ring.
+    #[allow(unused)]
+    pub fn capacity(&self) -> usize {
+        self.mask + 1
+    }
+
+    /// Returns the size of the largest message that fits in the target message ring.
+    pub fn max_message_size(&self) -> usize {
+        (self.capacity() - MESSAGE_HEADER_SIZE).min(MESSAGE_LENGTH_MASK as usize)
+    }
+
+    /// Peeks the target message ring and checks if it is empty.
+    #[allow(unused)]
+    pub fn is_empty(&self) -> bool {
+        self.head().load(Ordering::Acquire) == self.tail().load(Ordering::Acquire)
+    }
+
+    /// Attempts to insert a message at the back of the target message ring. This fails if there is not enough free
+    /// space in the ring at the moment.
+    pub fn try_push(&self, message: &[u8]) -> Result<(), Fail> {
+        if message.len() > self.max_message_size() {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "message is too large to fit in the message ring",
+            ));
+        }
+        if self.try_push_message(message, 0) {
+            Ok(())
+        } else {
+            Err(Fail::new(libc::EAGAIN, "message ring is full"))
+        }
+    }
+
+    /// Attempts to insert a descriptor message at the back of the target message ring. This fails if there is not enough
+    /// free space in the ring at the moment.
+    pub fn try_push_descriptor(&self, descriptor: &[u8]) -> Result<(), Fail> {
+        if descriptor.len() > self.max_message_size() {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "descriptor is too large to fit in the message ring",
+            ));
+        }
+        if self.try_push_message(descriptor, MESSAGE_DESCRIPTOR_FLAG) {
+            Ok(())
+        } else {
+            Err(Fail::new(libc::EAGAIN, "message ring is full"))
+        }
+    }
+
+    /// Attempts to insert an end of file message at the back of the target message ring.
+    pub fn try_push_eof(&self) -> Result<(), Fail> {
+        if self.try_push_message(&[], MESSAGE_EOF_FLAG) {
+            Ok(())
+        } else {
+            Err(Fail::new(libc::EAGAIN, "message ring is full"))
+        }
+    }
+
+    /// Attempts to remove the message from the front of the target message ring. The message is written to the buffer
+    /// returned by `alloc`, which is given the size of the message. On success, this function returns the filled-in
+    /// buffer and the kind of the message.
+    pub fn try_pop<B, F>(&self, alloc: F) -> Option<(B, MessageKind)>
+    where
+        B: DerefMut<Target = [u8]>,
+        F: FnOnce(usize) -> B,
+    {
+        let head: usize = self.head().load(Ordering::Relaxed);
+
+        // Check if the message ring is empty, according to the last tail that we have seen.
+        let mut tail: usize = self.tail_cached.load(Ordering::Relaxed);
+        if head == tail {
+            // Synchronizes with the release store of the writer, so the message is visible after this.
+            tail = self.tail().load(Ordering::Acquire);
+            if head == tail {
+                return None;
+            }
+            self.tail_cached.store(tail, Ordering::Relaxed);
+        }
+
+        // Read header. Messages are padded, so the header never wraps around the end of the buffer.
+        let header: u32 = unsafe { ptr::read(self.buffer.add(head & self.mask) as *const u32) };
+        let kind: MessageKind = if header & MESSAGE_EOF_FLAG != 0 {
+            MessageKind::Eof
+        } else if header & MESSAGE_DESCRIPTOR_FLAG != 0 {
+            MessageKind::Descriptor
+        } else {
+            MessageKind::Data
+        };
+        let len: usize = (header & MESSAGE_LENGTH_MASK) as usize;
+        debug_assert!(len <= self.max_message_size());
+
+        // Read message.
+        let mut buf: B = alloc(len);
+        debug_assert_eq!(buf.len(), len);
+        self.copy_from_ring(head.wrapping_add(MESSAGE_HEADER_SIZE), &mut buf);
+
+        // Commit read. This releases the space of the message back to the writer.
+        self.head()
+            .store(head.wrapping_add(Self::message_size(len)), Ordering::Release);
+
+        Some((buf, kind))
+    }
+
+    /// Attempts to insert a message with a given set of flags at the back of the target message ring.
+    fn try_push_message(&self, message: &[u8], flags: u32) -> bool {
+        let tail: usize = self.tail().load(Ordering::Relaxed);
+        let size: usize = Self::message_size(message.len());
+
+        // Check if there is enough free space, according to the last head that we have seen.
+        let mut head: usize = self.head_cached.load(Ordering::Relaxed);
+        if tail.wrapping_sub(head) + size > self.capacity() {
+            // Synchronizes with the release store of the reader, so the space is free after this.
+            head = self.head().load(Ordering::Acquire);
+            if tail.wrapping_sub(head) + size > self.capacity() {
+                return false;
+            }
+            self.head_cached.store(head, Ordering::Relaxed);
+        }
+
+        // Write header and message.
+        let header: u32 = message.len() as u32 | flags;
+        unsafe { ptr::write(self.buffer.add(tail & self.mask) as *mut u32, header) };
+        self.copy_to_ring(tail.wrapping_add(MESSAGE_HEADER_SIZE), message);
+
+        // Commit write. This publishes the message to the reader.
+        self.tail().store(tail.wrapping_add(size), Ordering::Release);
+
+        true
+    }
+
+    /// Copies bytes from a slice into the buffer, starting at a given free-running index.
+    fn copy_to_ring(&self, index: usize, src: &[u8]) {
+        let offset: usize = index & self.mask;
+        let first: usize = src.len().min(self.capacity() - offset);
+        // Safety: both copies stay within the buffer, which does not overlap with the source slice.
+        unsafe {
+            ptr::copy_nonoverlapping(src.as_ptr(), self.buffer.add(offset), first);
+            ptr::copy_nonoverlapping(src.as_ptr().add(first), self.buffer, src.len() - first);
+        }
+    }
+
+    /// Copies bytes from the buffer into a slice, starting at a given free-running index.
+    fn copy_from_ring(&self, index: usize, dst: &mut [u8]) {
+        let offset: usize = index & self.mask;
+        let first: usize = dst.len().min(self.capacity() - offset);
+        // Safety: both copies stay within the buffer, which does not overlap with the destination slice.
+        unsafe {
+            ptr::copy_nonoverlapping(self.buffer.add(offset), dst.as_mut_ptr(), first);
+            ptr::copy_nonoverlapping(self.buffer, dst.as_mut_ptr().add(first), dst.len() - first);
+        }
+    }
+
+    /// Returns the number of bytes that a message of a given length takes in the buffer.
+    fn message_size(len: usize) -> usize {
+        MESSAGE_HEADER_SIZE + ((len + MESSAGE_HEADER_SIZE - 1) & !(MESSAGE_HEADER_SIZE - 1))
+    }
+
+    /// Returns the layout of the memory region of a message ring with a given capacity.
+    fn layout(capacity: usize) -> Layout {
+        // This unwrap cannot panic, as the alignment is a fixed power of two.
+        Layout::from_size_align(Self::region_size(capacity), CPU_DATA_CACHE_LINE_SIZE).unwrap()
+    }
+
+    /// Gets the `head` index.
+    fn head(&self) -> &AtomicUsize {
+        // Safety: the pointer is aligned and points to an initialized index for as long as the ring exists.
+        unsafe { &*self.head_ptr }
+    }
+
+    /// Gets the `tail` index.
+    fn tail(&self) -> &AtomicUsize {
+        // Safety: the pointer is aligned and points to an initialized index for as long as the ring exists.
+        unsafe { &*self.tail_ptr }
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Send trait implementation.
+unsafe impl Send for MessageRing {}
+
+/// Sync trait implementation.
+// Safety: the ring is meant to be accessed by a single writer and a single reader. The writer only stores to `tail`
+// and `head_cached`, while the reader only stores to `head` and `tail_cached`.
+unsafe impl Sync for MessageRing {}
+
+/// Drop trait implementation.
+impl Drop for MessageRing {
+    fn drop(&mut self) {
+        // Check if underlying memory was allocated by this module.
+        if self.is_managed {
+            // Release underlying memory.
+            let layout: Layout = Self::layout(self.capacity());
+            unsafe { alloc::dealloc(self.head_ptr as *mut u8, layout) };
+            self.is_managed = false;
+        }
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use super::{
+        MessageKind,
+        MessageRing,
+        MESSAGE_HEADER_SIZE,
+    };
+    use std::thread;
+
+    /// Capacity for message ring.
+    const MESSAGE_RING_CAPACITY: usize = 4096;
+
+    /// Creates a message ring with a valid capacity.
+    fn do_new() -> MessageRing {
+        let ring: MessageRing = match MessageRing::new(MESSAGE_RING_CAPACITY) {
+            Ok(ring) => ring,
+            Err(_) => panic!("creating a message ring with valid capcity should be possible"),
+        };
+
+        // Check if buffer has expected capacity.
+        assert!(ring.capacity() == MESSAGE_RING_CAPACITY);
+        assert!(ring.max_message_size() == MESSAGE_RING_CAPACITY - MESSAGE_HEADER_SIZE);
+
+        // Check if buffer state is consistent.
+        assert!(ring.is_empty() == true);
+
+        ring
+    }
+
+    /// Pops a message from a message ring.
+    fn do_pop(ring: &MessageRing) -> Option<(Vec<u8>, MessageKind)> {
+        ring.try_pop(|len| vec![0; len])
+    }
+
+    /// Tests if we succeed to create a message ring with a valid capacity.
+    #[test]
+    fn new() {
+        do_new();
+    }
+
+    /// Tests if we fail to create message ring with an invalid capacity.
+    #[test]
+    fn bad_new() {
+        match MessageRing::new(MESSAGE_RING_CAPACITY - 1) {
+            Ok(_) => panic!("creating a message ring with invalid capacity should fail"),
+            Err(_) => {},
+        };
+    }
+
+    /// Tests if we succeed to sequentially push and pop messages to/from a message ring.
+    #[test]
+    fn push_pop_sequential() {
+        let ring: MessageRing = do_new();
+
+        // Fill in the ring with messages of varying length, so that they wrap around the end of the buffer.
+        for round in 0..16 {
+            let mut messages: Vec<Vec<u8>> = Vec::new();
+            let mut len: usize = round + 1;
+            loop {
+                let message: Vec<u8> = vec![(len & 255) as u8; len];
+                if ring.try_push(&message).is_err() {
+                    break;
+                }
+                messages.push(message);
+                len = (len * 7) % 1021 + 1;
+            }
+            assert!(!messages.is_empty());
+
+            // Check if messages come out in order and intact.
+            for message in messages {
+                let (buf, kind): (Vec<u8>, MessageKind) = do_pop(&ring).expect("ring should not be empty");
+                assert_eq!(buf, message);
+                assert_eq!(kind, MessageKind::Data);
+            }
+            assert!(ring.is_empty() == true);
+            assert!(do_pop(&ring).is_none());
+        }
+    }
+
+    /// Tests if we succeed to push and pop end of file.
+    #[test]
+    fn push_pop_eof() {
+        let ring: MessageRing = do_new();
+
+        assert!(ring.try_push(&[1, 2, 3]).is_ok());
+        assert!(ring.try_push_eof().is_ok());
+
+        assert_eq!(do_pop(&ring), Some((vec![1, 2, 3], MessageKind::Data)));
+        assert_eq!(do_pop(&ring), Some((vec![], MessageKind::Eof)));
+        assert!(do_pop(&ring).is_none());
+    }
+
+    /// Tests if we succeed to push and pop descriptors interleaved with regular data.
+    #[test]
+    fn push_pop_descriptor() {
+        let ring: MessageRing = do_new();
+
+        assert!(ring.try_push(&[1, 2, 3]).is_ok());
+        assert!(ring.try_push_descriptor(&[4, 5, 6, 7, 8, 9, 10, 11]).is_ok());
+        assert!(ring.try_push(&[12]).is_ok());
+
+        assert_eq!(do_pop(&ring), Some((vec![1, 2, 3], MessageKind::Data)));
+        assert_eq!(
+            do_pop(&ring),
+            Some((vec![4, 5, 6, 7, 8, 9, 10, 11], MessageKind::Descriptor))
+        );
+        assert_eq!(do_pop(&ring), Some((vec![12], MessageKind::Data)));
+        assert!(do_pop(&ring).is_none());
+    }
+
+    /// Tests if we fail to push messages that do not fit in a message ring.
+    #[test]
+    fn bad_push() {
+        let ring: MessageRing = do_new();
+
+        let message: Vec<u8> = vec![0; ring.max_message_size() + 1];
+        assert!(ring.try_push(&message).is_err());
+
+        // The largest message fits, but only in an empty ring.
+        let message: Vec<u8> = vec![0; ring.max_message_size()];
+        assert!(ring.try_push(&message).is_ok());
+        assert!(ring.try_push(&[0]).is_err());
+        assert_eq!(do_pop(&ring), Some((message, MessageKind::Data)));
+        assert!(ring.try_push(&[0]).is_ok());
+    }
+
+    /// Tests if we succeed to access a message ring concurrently.
+    #[test]
+    fn push_pop_concurrent() {
+        const NMESSAGES: usize = 16 * 1024;
+        let ring: MessageRing = do_new();
+
+        thread::scope(|s| {
+            let writer: thread::ScopedJoinHandle<()> = s.spawn(|| {
+                for i in 0..NMESSAGES {
+                    let message: Vec<u8> = vec![(i & 255) as u8; i % 512];
+                    while ring.try_push(&message).is_err() {}
+                }
+                while ring.try_push_eof().is_err() {}
+            });
+            let reader: thread::ScopedJoinHandle<()> = s.spawn(|| {
+                for i in 0..NMESSAGES {
+                    let (buf, kind): (Vec<u8>, MessageKind) = loop {
+                        if let Some(message) = do_pop(&ring) {
+                            break message;
+                        }
+                    };
+                    assert_eq!(buf, vec![(i & 255) as u8; i % 512]);
+                    assert_eq!(kind, MessageKind::Data);
+                }
+                let (buf, kind): (Vec<u8>, MessageKind) = loop {
+                    if let Some(message) = do_pop(&ring) {
+                        break message;
+                    }
+                };
+                assert!(buf.is_empty());
+                assert_eq!(kind, MessageKind::Eof);
+            });
+
+            writer.join().unwrap();
+            reader.join().unwrap();
+        });
+    }
+}
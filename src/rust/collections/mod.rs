@@ -5,8 +5,10 @@ pub mod intrusive;
 
 cfg_if! {
     if #[cfg(feature = "catmem-libos")] {
+        pub mod message_ring;
         pub mod raw_array;
         pub mod ring;
+        pub mod shared_message_ring;
         pub mod shared_ring;
     }
 }
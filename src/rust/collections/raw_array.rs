@@ -65,6 +65,7 @@ impl<T> RawArray<T> {
     }
 
     /// Constructs an unmanaged raw array from a pointer and a length.
+    #[allow(unused)]
     pub fn from_raw_parts(ptr: *mut T, len: usize) -> Result<RawArray<T>, Fail> {
         // Check if capacity is invalid.
         if len == 0 {
@@ -89,6 +89,7 @@ where
     }
 
     /// Constructs a ring buffer from raw parts.
+    #[allow(unused)]
     pub fn from_raw_parts(init: bool, mut ptr: *mut u8, size: usize) -> Result<RingBuffer<T>, Fail> {
         // Check if we have a valid pointer.
         if ptr.is_null() {
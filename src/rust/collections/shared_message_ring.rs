@@ -0,0 +1,123 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::{
+    collections::message_ring::MessageRing,
+    pal::linux::shm::SharedMemory,
+    runtime::fail::Fail,
+};
+use ::std::ops::Deref;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// A message ring that may be shared across processes.
+///
+/// This structure resides on a shared memory region and it is lock-free.
+/// This abstraction ensures the correct concurrent access by a single writer and a single reader.
+pub struct SharedMessageRing {
+    #[allow(unused)]
+    shm: SharedMemory,
+    ring: MessageRing,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Associated functions for shared message rings.
+impl SharedMessageRing {
+    /// Creates a new shared message ring.
+    pub fn create(name: &str, capacity: usize) -> Result<SharedMessageRing, Fail> {
+        let mut shm: SharedMemory = SharedMemory::create(&name, MessageRing::region_size(capacity))?;
+        let ring: MessageRing = MessageRing::from_raw_parts(true, shm.as_mut_ptr(), shm.len())?;
+        Ok(SharedMessageRing { shm, ring })
+    }
+
+    /// Opens an existing shared message ring.
+    pub fn open(name: &str, capacity: usize) -> Result<SharedMessageRing, Fail> {
+        let mut shm: SharedMemory = SharedMemory::open(&name, MessageRing::region_size(capacity))?;
+        let ring: MessageRing = MessageRing::from_raw_parts(false, shm.as_mut_ptr(), shm.len())?;
+        Ok(SharedMessageRing { shm, ring })
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Dereference trait implementation for shared message rings.
+impl Deref for SharedMessageRing {
+    type Target = MessageRing;
+
+    fn deref(&self) -> &Self::Target {
+        &self.ring
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod test {
+    use super::SharedMessageRing;
+    use crate::collections::message_ring::MessageKind;
+    use std::{
+        thread::{
+            self,
+            ScopedJoinHandle,
+        },
+        time::Duration,
+    };
+
+    const MESSAGE_RING_CAPACITY: usize = 4096;
+
+    /// Tests if we succeed to perform concurrent accesses to a shared message ring.
+    #[ignore]
+    #[test]
+    fn message_ring_on_shm_concurrent() {
+        let shm_name: String = "shm-test-message-ring-concurrent".to_string();
+
+        thread::scope(|s| {
+            let writer: ScopedJoinHandle<()> = s.spawn(|| {
+                let ring: SharedMessageRing = match SharedMessageRing::create(&shm_name, MESSAGE_RING_CAPACITY) {
+                    Ok(ring) => ring,
+                    Err(_) => panic!("creating a shared message ring should be possible"),
+                };
+
+                for i in 0..1024 {
+                    while ring.try_push(&[(i & 255) as u8; 64]).is_err() {}
+                }
+
+                while !ring.is_empty() {}
+            });
+
+            let reader: ScopedJoinHandle<()> = s.spawn(|| {
+                thread::sleep(Duration::from_millis(100));
+
+                let ring: SharedMessageRing = match SharedMessageRing::open(&shm_name, MESSAGE_RING_CAPACITY) {
+                    Ok(ring) => ring,
+                    Err(_) => panic!("openining a shared message ring should be possible"),
+                };
+                for i in 0..1024 {
+                    let (buf, kind): (Vec<u8>, MessageKind) = loop {
+                        if let Some(message) = ring.try_pop(|len| vec![0; len]) {
+                            break message;
+                        }
+                    };
+                    assert!(buf == vec![(i & 255) as u8; 64]);
+                    assert_eq!(kind, MessageKind::Data);
+                }
+            });
+
+            writer.join().unwrap();
+            reader.join().unwrap();
+        });
+    }
+}
@@ -21,6 +21,7 @@ use ::std::ops::Deref;
 ///
 /// This structure resides on a shared memory region and it is lock-free.
 /// This abstraction ensures the correct concurrent access by a single writer and a single reader.
+#[allow(unused)]
 pub struct SharedRingBuffer<T: Copy> {
     #[allow(unused)]
     shm: SharedMemory,
@@ -32,6 +33,7 @@ pub struct SharedRingBuffer<T: Copy> {
 //======================================================================================================================
 
 /// Associated functions for shared ring buffers.
+#[allow(unused)]
 impl<T: Copy> SharedRingBuffer<T> {
     /// Creates a new shared ring buffer.
     pub fn create(name: &str, capacity: usize) -> Result<SharedRingBuffer<T>, Fail> {
@@ -13,22 +13,31 @@ use crate::{
         LibOS,
     },
     pal::{
-        constants::AF_INET,
+        constants::{
+            AF_INET,
+            IPPROTO_TCP,
+            TCP_NODELAY,
+        },
         data_structures::{
             SockAddrIn,
             Socklen,
         },
         functions::get_addr_from_sock_addr_in,
     },
+    perftools::stats,
     runtime::{
         fail::Fail,
         logging,
+        network::types::SocketOption,
         types::{
             demi_qresult_t,
             demi_qtoken_t,
             demi_sgarray_t,
             demi_sgaseg_t,
+            demi_stats_t,
+            DEMI_SGARRAY_MAXLEN,
         },
+        QDesc,
         QToken,
     },
 };
@@ -467,6 +476,88 @@ pub extern "C" fn demi_pop(qtok_out: *mut demi_qtoken_t, qd: c_int) -> c_int {
     }
 }
 
+//======================================================================================================================
+// push_batch
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_push_batch(
+    qts_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    sgas: *const demi_sgarray_t,
+    n: c_int,
+    nr_out: *mut c_int,
+) -> c_int {
+    trace!("demi_push_batch() {:?}", n);
+
+    // Check arguments.
+    if qts_out.is_null() || qds.is_null() || sgas.is_null() || nr_out.is_null() || n <= 0 {
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing arrays of (at least) `n` elements.
+    let qds: Vec<QDesc> = unsafe { slice::from_raw_parts(qds, n as usize) }
+        .iter()
+        .map(|&qd| QDesc::from(qd))
+        .collect();
+    let sgas: &[demi_sgarray_t] = unsafe { slice::from_raw_parts(sgas, n as usize) };
+    let qts_out: &mut [demi_qtoken_t] = unsafe { slice::from_raw_parts_mut(qts_out, n as usize) };
+
+    // Issue push operations.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.push_batch(&qds, sgas) {
+        Ok(qts) => store_qtokens(qts_out, &qts, nr_out),
+        Err(e) => {
+            trace!("demi_push_batch() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
+//======================================================================================================================
+// pop_batch
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_pop_batch(
+    qts_out: *mut demi_qtoken_t,
+    qds: *const c_int,
+    n: c_int,
+    nr_out: *mut c_int,
+) -> c_int {
+    trace!("demi_pop_batch() {:?}", n);
+
+    // Check arguments.
+    if qts_out.is_null() || qds.is_null() || nr_out.is_null() || n <= 0 {
+        return libc::EINVAL;
+    }
+
+    // Safety: We have to trust that our user is providing arrays of (at least) `n` elements.
+    let qds: Vec<QDesc> = unsafe { slice::from_raw_parts(qds, n as usize) }
+        .iter()
+        .map(|&qd| QDesc::from(qd))
+        .collect();
+    let qts_out: &mut [demi_qtoken_t] = unsafe { slice::from_raw_parts_mut(qts_out, n as usize) };
+
+    // Issue pop operations.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.pop_batch(&qds) {
+        Ok(qts) => store_qtokens(qts_out, &qts, nr_out),
+        Err(e) => {
+            trace!("demi_pop_batch() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 //======================================================================================================================
 // timedwait
 //======================================================================================================================
@@ -613,6 +704,53 @@ pub extern "C" fn demi_wait_any(
     }
 }
 
+//======================================================================================================================
+// wait_next_n
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_wait_next_n(
+    qr_out: *mut demi_qresult_t,
+    n: c_int,
+    nr_out: *mut c_int,
+    timeout: *const libc::timespec,
+) -> c_int {
+    trace!("demi_wait_next_n() {:?} {:?} {:?} {:?}", qr_out, n, nr_out, timeout);
+
+    // Check arguments.
+    if qr_out.is_null() || nr_out.is_null() || n <= 0 {
+        return libc::EINVAL;
+    }
+
+    // Get store location for results.
+    let qrs: &mut [demi_qresult_t] = unsafe { slice::from_raw_parts_mut(qr_out, n as usize) };
+
+    // Convert timespec to Duration.
+    let duration: Option<Duration> = if timeout.is_null() {
+        None
+    } else {
+        // Safety: We have to trust that our user is providing a valid timeout pointer for us to dereference.
+        Some(unsafe { Duration::new((*timeout).tv_sec as u64, (*timeout).tv_nsec as u32) })
+    };
+
+    // Issue wait_next_n operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.wait_next_n(qrs, duration) {
+        Ok(nr) => {
+            unsafe { *nr_out = nr as c_int };
+            0
+        },
+        Err(e) => {
+            trace!("demi_wait_next_n() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
+}
+
 //======================================================================================================================
 // sgaalloc
 //======================================================================================================================
@@ -628,7 +766,7 @@ pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
             sga_segs: [demi_sgaseg_t {
                 sgaseg_buf: ptr::null_mut() as *mut c_void,
                 sgaseg_len: 0,
-            }; 1],
+            }; DEMI_SGARRAY_MAXLEN],
             sga_addr: unsafe { mem::zeroed() },
         }
     };
@@ -653,6 +791,46 @@ pub extern "C" fn demi_sgaalloc(size: libc::size_t) -> demi_sgarray_t {
     }
 }
 
+//======================================================================================================================
+// sgaalloc_qd
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_sgaalloc_qd(qd: c_int, size: libc::size_t) -> demi_sgarray_t {
+    trace!("demi_sgaalloc_qd()");
+
+    let null_sga: demi_sgarray_t = {
+        demi_sgarray_t {
+            sga_buf: ptr::null_mut() as *mut _,
+            sga_numsegs: 0,
+            sga_segs: [demi_sgaseg_t {
+                sgaseg_buf: ptr::null_mut() as *mut c_void,
+                sgaseg_len: 0,
+            }; DEMI_SGARRAY_MAXLEN],
+            sga_addr: unsafe { mem::zeroed() },
+        }
+    };
+
+    // Issue sgaalloc operation.
+    let ret: Result<demi_sgarray_t, Fail> = do_syscall(|libos| -> demi_sgarray_t {
+        match libos.sgaalloc_qd(qd.into(), size) {
+            Ok(sga) => sga,
+            Err(e) => {
+                trace!("demi_sgaalloc_qd() failed: {:?}", e);
+                null_sga
+            },
+        }
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => {
+            trace!("demi_sgaalloc_qd() failed: {:?}", e);
+            null_sga
+        },
+    }
+}
+
 //======================================================================================================================
 // sgafree
 //======================================================================================================================
@@ -681,6 +859,25 @@ pub extern "C" fn demi_sgafree(sga: *mut demi_sgarray_t) -> c_int {
     }
 }
 
+//======================================================================================================================
+// get_stats
+//======================================================================================================================
+
+#[no_mangle]
+pub extern "C" fn demi_get_stats(stats_out: *mut demi_stats_t) -> c_int {
+    trace!("demi_get_stats()");
+
+    // Check if output is invalid.
+    if stats_out.is_null() {
+        return libc::EINVAL;
+    }
+
+    // Statistics are kept apart from the LibOS, so that any thread may read them, even while others use it.
+    let stats: demi_stats_t = (&stats::snapshot()).into();
+    unsafe { *stats_out = stats };
+    0
+}
+
 //======================================================================================================================
 // getsockname
 //======================================================================================================================
@@ -696,7 +893,6 @@ pub extern "C" fn demi_getsockname(qd: c_int, saddr: *mut sockaddr, size: *mut S
 // setsockopt
 //======================================================================================================================
 
-#[allow(unused)]
 #[no_mangle]
 pub extern "C" fn demi_setsockopt(
     qd: c_int,
@@ -705,8 +901,30 @@ pub extern "C" fn demi_setsockopt(
     optval: *const c_void,
     optlen: Socklen,
 ) -> c_int {
-    // TODO: Implement this system call.
-    libc::ENOSYS
+    trace!("demi_setsockopt() qd={:?} level={:?} optname={:?}", qd, level, optname);
+
+    // Check if option is invalid.
+    let option: SocketOption = match socket_option_from_raw(level, optname, optval, optlen) {
+        Ok(option) => option,
+        Err(e) => {
+            trace!("demi_setsockopt() failed: {:?}", e);
+            return e.errno;
+        },
+    };
+
+    // Issue setsockopt operation.
+    let ret: Result<i32, Fail> = do_syscall(|libos| match libos.setsockopt(qd.into(), option) {
+        Ok(()) => 0,
+        Err(e) => {
+            trace!("demi_setsockopt() failed: {:?}", e);
+            e.errno
+        },
+    });
+
+    match ret {
+        Ok(ret) => ret,
+        Err(e) => e.errno,
+    }
 }
 
 //======================================================================================================================
@@ -741,6 +959,36 @@ fn do_syscall<T>(f: impl FnOnce(&mut LibOS) -> T) -> Result<T, Fail> {
     }
 }
 
+/// Stores the queue tokens of a batch of operations in `qts_out`, and their number in `nr_out`.
+fn store_qtokens(qts_out: &mut [demi_qtoken_t], qts: &[QToken], nr_out: *mut c_int) -> c_int {
+    for (qt_out, qt) in qts_out.iter_mut().zip(qts) {
+        *qt_out = (*qt).into();
+    }
+    unsafe { *nr_out = qts.len() as c_int };
+    0
+}
+
+/// Converts a socket option from its C representation, where boolean options are stored as an int.
+fn socket_option_from_raw(
+    level: c_int,
+    optname: c_int,
+    optval: *const c_void,
+    optlen: Socklen,
+) -> Result<SocketOption, Fail> {
+    if optval.is_null() || optlen < mem::size_of::<c_int>() as Socklen {
+        return Err(Fail::new(libc::EINVAL, "invalid option value"));
+    }
+    // Safety: The option value is not null and large enough to hold an int, as checked above.
+    let enabled: bool = unsafe { ptr::read_unaligned(optval as *const c_int) } != 0;
+
+    match (level, optname) {
+        (IPPROTO_TCP, TCP_NODELAY) => Ok(SocketOption::TcpNoDelay(enabled)),
+        #[cfg(target_os = "linux")]
+        (IPPROTO_TCP, crate::pal::constants::TCP_CORK) => Ok(SocketOption::TcpCork(enabled)),
+        _ => Err(Fail::new(libc::ENOPROTOOPT, "unsupported socket option")),
+    }
+}
+
 /// Converts a [sockaddr] into a [SocketAddrV4].
 fn sockaddr_to_socketaddrv4(saddr: *const sockaddr) -> Result<SocketAddrV4, Fail> {
     // TODO: Change the logic bellow and rename this function once we support V6 addresses as well.
@@ -5,9 +5,15 @@
 // Imports
 //======================================================================================================================
 
+use crate::demikernel::libos::idle::{
+    IdlePolicy,
+    DEFAULT_IDLE_BACKOFF_DURATION,
+    DEFAULT_IDLE_POLL_DURATION,
+};
 use ::std::{
     fs::File,
     io::Read,
+    time::Duration,
 };
 use ::yaml_rust::{
     Yaml,
@@ -59,4 +65,34 @@ impl Config {
         }
         local_ipv4_addr
     }
+
+    /// Reads the "timer granularity" parameter (in microseconds) from the underlying configuration file.
+    #[cfg(any(feature = "catnip-libos", feature = "catpowder-libos"))]
+    pub fn timer_granularity(&self) -> ::std::time::Duration {
+        // FIXME: this function should return a Result.
+        use crate::runtime::timer::DEFAULT_TIMER_GRANULARITY;
+        use ::std::time::Duration;
+
+        match self.0["catnip"]["timer_granularity_us"].as_i64() {
+            Some(granularity) if granularity > 0 => Duration::from_micros(granularity as u64),
+            Some(granularity) => panic!("invalid timer granularity ({:?})", granularity),
+            None => DEFAULT_TIMER_GRANULARITY,
+        }
+    }
+
+    /// Reads the idle policy of waits (see [IdlePolicy]) from the underlying configuration file.
+    pub fn idle_policy(&self) -> IdlePolicy {
+        // FIXME: this function should return a Result.
+        let read = |key: &str, default: Duration| -> Duration {
+            match self.0["idle"][key].as_i64() {
+                Some(duration) if duration >= 0 => Duration::from_micros(duration as u64),
+                Some(duration) => panic!("invalid idle {} ({:?})", key, duration),
+                None => default,
+            }
+        };
+        IdlePolicy::new(
+            read("poll_us", DEFAULT_IDLE_POLL_DURATION),
+            read("backoff_us", DEFAULT_IDLE_BACKOFF_DURATION),
+        )
+    }
 }
@@ -0,0 +1,202 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use ::std::{
+    hint,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+//======================================================================================================================
+// Constants
+//======================================================================================================================
+
+/// Default time to busy-poll after the last event.
+pub const DEFAULT_IDLE_POLL_DURATION: Duration = Duration::from_micros(50);
+
+/// Default time to back off after busy-polling, before blocking.
+pub const DEFAULT_IDLE_BACKOFF_DURATION: Duration = Duration::from_micros(1000);
+
+/// Maximum number of spin-loop hints between two polls, while backing off. This is in the order of tens of
+/// microseconds on current processors.
+pub const MAX_PAUSES: u32 = 1024;
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Idle Policy
+///
+/// Decides how to wait for I/O once polling found nothing to do. Waits busy-poll for a while after the last event, so
+/// that latency under load matches the one of pure polling. Then, they back off, pausing the core for longer and
+/// longer between polls. Eventually, they block until some I/O queue may make progress, on LibOSes that support it.
+#[derive(Clone, Copy, Debug)]
+pub struct IdlePolicy {
+    /// How long to busy-poll after the last event.
+    poll_duration: Duration,
+    /// How long to back off after busy-polling, before blocking.
+    backoff_duration: Duration,
+}
+
+/// State of a wait in its idle policy.
+pub struct IdleState {
+    /// Policy being followed.
+    policy: IdlePolicy,
+    /// Time of the last event.
+    last_event: Instant,
+    /// Number of spin-loop hints that were issued between the last two polls.
+    pauses: u32,
+}
+
+/// What to do after a poll found nothing to do.
+#[derive(Debug, PartialEq, Eq)]
+pub enum IdleAction {
+    /// Poll again right away.
+    Poll,
+    /// Issue a number of spin-loop hints, and then poll again.
+    Pause(u32),
+    /// Block until some I/O queue may make progress.
+    Block,
+}
+
+//======================================================================================================================
+// Associated Functions
+//======================================================================================================================
+
+/// Associated functions for idle policies.
+impl IdlePolicy {
+    /// Creates an idle policy.
+    pub fn new(poll_duration: Duration, backoff_duration: Duration) -> Self {
+        Self {
+            poll_duration,
+            backoff_duration,
+        }
+    }
+
+    /// Starts a wait that follows the target idle policy. The start of the wait counts as an event, as applications
+    /// usually wait right after they issued new operations.
+    pub fn start(&self) -> IdleState {
+        IdleState {
+            policy: *self,
+            last_event: Instant::now(),
+            pauses: 0,
+        }
+    }
+}
+
+/// Associated functions for idle states.
+impl IdleState {
+    /// Decides what to do, given that a poll at time `now` found nothing to do.
+    pub fn next(&mut self, now: Instant) -> IdleAction {
+        let idle: Duration = now.saturating_duration_since(self.last_event);
+        if idle < self.policy.poll_duration {
+            IdleAction::Poll
+        } else if idle < self.policy.poll_duration + self.policy.backoff_duration {
+            self.pauses = (2 * self.pauses).clamp(1, MAX_PAUSES);
+            IdleAction::Pause(self.pauses)
+        } else {
+            IdleAction::Block
+        }
+    }
+
+    /// Records that a poll at time `now` made progress, which counts as an event. Waits keep busy-polling as long as
+    /// some progress is made, even if they do not complete yet.
+    pub fn reset(&mut self, now: Instant) {
+        self.last_event = now;
+        self.pauses = 0;
+    }
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Default Trait Implementation for Idle Policies
+impl Default for IdlePolicy {
+    fn default() -> Self {
+        Self::new(DEFAULT_IDLE_POLL_DURATION, DEFAULT_IDLE_BACKOFF_DURATION)
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Issues `n` spin-loop hints (i.e. `pause` instructions on x86), which lets the core save power and yield its
+/// resources to a sibling hyperthread, without giving up the time slice of the calling thread.
+pub fn pause(n: u32) {
+    for _ in 0..n {
+        hint::spin_loop();
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        IdleAction,
+        IdlePolicy,
+        IdleState,
+        MAX_PAUSES,
+    };
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    #[test]
+    fn idle_phases() {
+        let policy: IdlePolicy = IdlePolicy::new(Duration::from_micros(10), Duration::from_micros(100));
+        let mut state: IdleState = policy.start();
+        let start: Instant = state.last_event;
+
+        // Busy-poll right after the last event.
+        assert_eq!(state.next(start), IdleAction::Poll);
+        assert_eq!(state.next(start + Duration::from_micros(9)), IdleAction::Poll);
+
+        // Then back off for longer and longer.
+        assert_eq!(state.next(start + Duration::from_micros(10)), IdleAction::Pause(1));
+        assert_eq!(state.next(start + Duration::from_micros(20)), IdleAction::Pause(2));
+        for _ in 0..32 {
+            state.next(start + Duration::from_micros(30));
+        }
+        assert_eq!(
+            state.next(start + Duration::from_micros(40)),
+            IdleAction::Pause(MAX_PAUSES)
+        );
+
+        // And eventually block.
+        assert_eq!(state.next(start + Duration::from_micros(110)), IdleAction::Block);
+    }
+
+    #[test]
+    fn idle_reset() {
+        let policy: IdlePolicy = IdlePolicy::new(Duration::from_micros(10), Duration::from_micros(100));
+        let mut state: IdleState = policy.start();
+        let start: Instant = state.last_event;
+        assert_eq!(state.next(start + Duration::from_micros(10)), IdleAction::Pause(1));
+        assert_eq!(state.next(start + Duration::from_micros(20)), IdleAction::Pause(2));
+
+        // Progress brings the wait back to busy-polling.
+        let now: Instant = start + Duration::from_micros(30);
+        state.reset(now);
+        assert_eq!(state.next(now), IdleAction::Poll);
+        assert_eq!(state.next(now + Duration::from_micros(9)), IdleAction::Poll);
+
+        // And backing off starts over from the shortest pause.
+        assert_eq!(state.next(now + Duration::from_micros(10)), IdleAction::Pause(1));
+
+        // Without progress, it blocks as late as it would after an event at the time of the progress.
+        assert_eq!(state.next(start + Duration::from_micros(110)), IdleAction::Pause(2));
+        assert_eq!(state.next(now + Duration::from_micros(110)), IdleAction::Block);
+    }
+}
@@ -8,6 +8,7 @@
 use crate::{
     runtime::{
         fail::Fail,
+        queue::issue_batch,
         types::{
             demi_qresult_t,
             demi_sgarray_t,
@@ -87,6 +88,17 @@ impl MemoryLibOS {
         }
     }
 
+    /// Pushes a batch of scatter-gather arrays to memory queues, one per queue. See [issue_batch] for the handling of
+    /// failures.
+    pub fn push_batch(&mut self, memqds: &[QDesc], sgas: &[demi_sgarray_t]) -> Result<Vec<QToken>, Fail> {
+        issue_batch(memqds.len(), |i| self.push(memqds[i], &sgas[i]))
+    }
+
+    /// Pops data from a batch of memory queues. See [issue_batch] for the handling of failures.
+    pub fn pop_batch(&mut self, memqds: &[QDesc]) -> Result<Vec<QToken>, Fail> {
+        issue_batch(memqds.len(), |i| self.pop(memqds[i]))
+    }
+
     /// Allocates a scatter-gather array.
     #[allow(unreachable_patterns, unused_variables)]
     pub fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
@@ -97,6 +109,16 @@ impl MemoryLibOS {
         }
     }
 
+    /// Allocates a scatter-gather array in the shared memory of a memory queue.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn sgaalloc_qd(&self, memqd: QDesc, size: usize) -> Result<demi_sgarray_t, Fail> {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem(libos) => libos.alloc_shared_sgarray(memqd, size),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
     /// Releases a scatter-gather array.
     #[allow(unreachable_patterns, unused_variables)]
     pub fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
@@ -117,6 +139,16 @@ impl MemoryLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion.
+    #[allow(unreachable_patterns, unused_variables)]
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        match self {
+            #[cfg(feature = "catmem-libos")]
+            MemoryLibOS::Catmem(libos) => libos.for_each_completed(visitor),
+            _ => unreachable!("unknown memory libos"),
+        }
+    }
+
     #[allow(unreachable_patterns, unused_variables)]
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         match self {
@@ -128,7 +160,7 @@ impl MemoryLibOS {
 
     /// Waits for any operation in an I/O queue.
     #[allow(unreachable_patterns, unused_variables)]
-    pub fn poll(&mut self) {
+    pub fn poll(&mut self) -> bool {
         match self {
             #[cfg(feature = "catmem-libos")]
             MemoryLibOS::Catmem(libos) => libos.poll(),
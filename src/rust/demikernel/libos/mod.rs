@@ -1,6 +1,7 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+pub mod idle;
 pub mod memory;
 pub mod name;
 pub mod network;
@@ -10,16 +11,24 @@ pub mod network;
 //======================================================================================================================
 
 use self::{
+    idle::{
+        IdleAction,
+        IdlePolicy,
+        IdleState,
+    },
     memory::MemoryLibOS,
     name::LibOSName,
     network::NetworkLibOS,
 };
 use crate::{
     demikernel::config::Config,
+    perftools::stats,
     runtime::{
         fail::Fail,
         logging,
+        network::types::SocketOption,
         types::{
+            demi_opcode_t,
             demi_qresult_t,
             demi_sgarray_t,
         },
@@ -29,6 +38,7 @@ use crate::{
     scheduler::SchedulerHandle,
 };
 use ::std::{
+    collections::HashMap,
     env,
     net::SocketAddrV4,
     time::{
@@ -58,7 +68,18 @@ use crate::catpowder::CatpowderLibOS;
 //======================================================================================================================
 
 /// LibOS
-pub enum LibOS {
+pub struct LibOS {
+    /// Underlying LibOS.
+    libos: LibOSKind,
+    /// Policy of waits, once polling found nothing to do.
+    idle: IdlePolicy,
+    /// Kind and issue time of pending operations, indexed by queue token, whose latency is recorded once their result
+    /// is packed. Queue tokens are keys of scheduler slots, which get reused, so this stays as large as the scheduler.
+    issued: Vec<Option<(demi_opcode_t, Instant)>>,
+}
+
+/// Kinds of LibOS
+pub enum LibOSKind {
     /// Network LibOS
     NetworkLibOS(NetworkLibOS),
     /// Memory LibOS
@@ -89,46 +110,50 @@ impl LibOS {
 
         // Instantiate LibOS.
         #[allow(unreachable_patterns)]
-        let libos: LibOS = match libos_name {
+        let libos: LibOSKind = match libos_name {
             #[cfg(all(feature = "catnap-libos", target_os = "linux"))]
-            LibOSName::Catnap => Self::NetworkLibOS(NetworkLibOS::Catnap(CatnapLibOS::new(&config))),
+            LibOSName::Catnap => LibOSKind::NetworkLibOS(NetworkLibOS::Catnap(CatnapLibOS::new(&config))),
             #[cfg(all(feature = "catnapw-libos", target_os = "windows"))]
-            LibOSName::CatnapW => Self::NetworkLibOS(NetworkLibOS::CatnapW(CatnapWLibOS::new(&config))),
+            LibOSName::CatnapW => LibOSKind::NetworkLibOS(NetworkLibOS::CatnapW(CatnapWLibOS::new(&config))),
             #[cfg(feature = "catcollar-libos")]
-            LibOSName::Catcollar => Self::NetworkLibOS(NetworkLibOS::Catcollar(CatcollarLibOS::new(&config))),
+            LibOSName::Catcollar => LibOSKind::NetworkLibOS(NetworkLibOS::Catcollar(CatcollarLibOS::new(&config))),
             #[cfg(feature = "catpowder-libos")]
-            LibOSName::Catpowder => Self::NetworkLibOS(NetworkLibOS::Catpowder(CatpowderLibOS::new(&config))),
+            LibOSName::Catpowder => LibOSKind::NetworkLibOS(NetworkLibOS::Catpowder(CatpowderLibOS::new(&config))),
             #[cfg(feature = "catnip-libos")]
-            LibOSName::Catnip => Self::NetworkLibOS(NetworkLibOS::Catnip(CatnipLibOS::new(&config))),
+            LibOSName::Catnip => LibOSKind::NetworkLibOS(NetworkLibOS::Catnip(CatnipLibOS::new(&config))),
             #[cfg(feature = "catmem-libos")]
-            LibOSName::Catmem => Self::MemoryLibOS(MemoryLibOS::Catmem(CatmemLibOS::new())),
+            LibOSName::Catmem => LibOSKind::MemoryLibOS(MemoryLibOS::Catmem(CatmemLibOS::new())),
             #[cfg(feature = "catloop-libos")]
-            LibOSName::Catloop => Self::NetworkLibOS(NetworkLibOS::Catloop(CatloopLibOS::new())),
+            LibOSName::Catloop => LibOSKind::NetworkLibOS(NetworkLibOS::Catloop(CatloopLibOS::new())),
             _ => panic!("unsupported libos"),
         };
 
-        Ok(libos)
+        Ok(Self {
+            libos,
+            idle: config.idle_policy(),
+            issued: Vec::new(),
+        })
     }
 
     /// Creates a new memory queue.
     pub fn create_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
-        match self {
-            LibOS::NetworkLibOS(_) => Err(Fail::new(
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(_) => Err(Fail::new(
                 libc::ENOTSUP,
                 "create_pipe() is not supported on network liboses",
             )),
-            LibOS::MemoryLibOS(libos) => libos.create_pipe(name),
+            LibOSKind::MemoryLibOS(libos) => libos.create_pipe(name),
         }
     }
 
     /// Opens an existing memory queue.
     pub fn open_pipe(&mut self, name: &str) -> Result<QDesc, Fail> {
-        match self {
-            LibOS::NetworkLibOS(_) => Err(Fail::new(
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(_) => Err(Fail::new(
                 libc::ENOTSUP,
                 "open_pipe() is not supported on network liboses",
             )),
-            LibOS::MemoryLibOS(libos) => libos.open_pipe(name),
+            LibOSKind::MemoryLibOS(libos) => libos.open_pipe(name),
         }
     }
 
@@ -139,80 +164,123 @@ impl LibOS {
         socket_type: libc::c_int,
         protocol: libc::c_int,
     ) -> Result<QDesc, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.socket(domain, socket_type, protocol),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "socket() is not supported on memory liboses")),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.socket(domain, socket_type, protocol),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "socket() is not supported on memory liboses")),
         }
     }
 
     /// Binds a socket to a local address.
     pub fn bind(&mut self, sockqd: QDesc, local: SocketAddrV4) -> Result<(), Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.bind(sockqd, local),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "bind() is not supported on memory liboses")),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.bind(sockqd, local),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "bind() is not supported on memory liboses")),
         }
     }
 
     /// Marks a socket as a passive one.
     pub fn listen(&mut self, sockqd: QDesc, backlog: usize) -> Result<(), Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.listen(sockqd, backlog),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "listen() is not supported on memory liboses")),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.listen(sockqd, backlog),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "listen() is not supported on memory liboses")),
         }
     }
 
     /// Accepts an incoming connection on a TCP socket.
     pub fn accept(&mut self, sockqd: QDesc) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.accept(sockqd),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "accept() is not supported on memory liboses")),
-        }
+        let qt: Result<QToken, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.accept(sockqd),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "accept() is not supported on memory liboses")),
+        };
+        self.issued(demi_opcode_t::DEMI_OPC_ACCEPT, qt)
     }
 
     /// Initiates a connection with a remote TCP socket.
     pub fn connect(&mut self, sockqd: QDesc, remote: SocketAddrV4) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.connect(sockqd, remote),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "connect() is not supported on memory liboses")),
-        }
+        let qt: Result<QToken, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.connect(sockqd, remote),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "connect() is not supported on memory liboses")),
+        };
+        self.issued(demi_opcode_t::DEMI_OPC_CONNECT, qt)
     }
 
     /// Closes an I/O queue.
     pub fn close(&mut self, qd: QDesc) -> Result<(), Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.close(qd),
-            LibOS::MemoryLibOS(libos) => libos.close(qd),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.close(qd),
+            LibOSKind::MemoryLibOS(libos) => libos.close(qd),
         }
     }
 
     pub fn async_close(&mut self, qd: QDesc) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.async_close(qd),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.async_close(qd),
             _ => unimplemented!("No async close for memory libOSes"),
         }
     }
 
     /// Pushes a scatter-gather array to an I/O queue.
     pub fn push(&mut self, qd: QDesc, sga: &demi_sgarray_t) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.push(qd, sga),
-            LibOS::MemoryLibOS(libos) => libos.push(qd, sga),
-        }
+        let qt: Result<QToken, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.push(qd, sga),
+            LibOSKind::MemoryLibOS(libos) => libos.push(qd, sga),
+        };
+        self.issued(demi_opcode_t::DEMI_OPC_PUSH, qt)
     }
 
     /// Pushes a scatter-gather array to a UDP socket.
     pub fn pushto(&mut self, qd: QDesc, sga: &demi_sgarray_t, to: SocketAddrV4) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.pushto(qd, sga, to),
-            LibOS::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "pushto() is not supported on memory liboses")),
-        }
+        let qt: Result<QToken, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.pushto(qd, sga, to),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(libc::ENOTSUP, "pushto() is not supported on memory liboses")),
+        };
+        self.issued(demi_opcode_t::DEMI_OPC_PUSH, qt)
     }
 
     /// Pops data from a an I/O queue.
     pub fn pop(&mut self, qd: QDesc) -> Result<QToken, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.pop(qd),
-            LibOS::MemoryLibOS(libos) => libos.pop(qd),
+        let qt: Result<QToken, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.pop(qd),
+            LibOSKind::MemoryLibOS(libos) => libos.pop(qd),
+        };
+        self.issued(demi_opcode_t::DEMI_OPC_POP, qt)
+    }
+
+    /// Pushes a batch of scatter-gather arrays to I/O queues, one per queue descriptor, and returns the queue tokens of
+    /// the operations that were issued. Issuing stops at the first operation that fails, whose error is only returned
+    /// if no operation was issued at all.
+    pub fn push_batch(&mut self, qds: &[QDesc], sgas: &[demi_sgarray_t]) -> Result<Vec<QToken>, Fail> {
+        if qds.len() != sgas.len() {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "mismatched number of queue descriptors and scatter-gather arrays",
+            ));
+        }
+        let qts: Result<Vec<QToken>, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.push_batch(qds, sgas),
+            LibOSKind::MemoryLibOS(libos) => libos.push_batch(qds, sgas),
+        };
+        self.issued_batch(demi_opcode_t::DEMI_OPC_PUSH, qts)
+    }
+
+    /// Pops data from a batch of I/O queues, and returns the queue tokens of the operations that were issued. Issuing
+    /// stops at the first operation that fails, whose error is only returned if no operation was issued at all.
+    pub fn pop_batch(&mut self, qds: &[QDesc]) -> Result<Vec<QToken>, Fail> {
+        let qts: Result<Vec<QToken>, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.pop_batch(qds),
+            LibOSKind::MemoryLibOS(libos) => libos.pop_batch(qds),
+        };
+        self.issued_batch(demi_opcode_t::DEMI_OPC_POP, qts)
+    }
+
+    /// Sets an option of a socket.
+    pub fn setsockopt(&mut self, sockqd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.setsockopt(sockqd, option),
+            LibOSKind::MemoryLibOS(_) => Err(Fail::new(
+                libc::ENOTSUP,
+                "setsockopt() is not supported on memory liboses",
+            )),
         }
     }
 
@@ -236,10 +304,13 @@ impl LibOS {
 
         // Retrieve associated schedule handle.
         let mut handle: SchedulerHandle = self.schedule(qt)?;
+        let mut idle: IdleState = self.idle.start();
 
         loop {
             // Poll first, so as to give pending operations a chance to complete.
-            self.poll();
+            if self.poll() {
+                idle.reset(Instant::now());
+            }
 
             // The operation has completed, so extract the result and return.
             if handle.has_completed() {
@@ -252,6 +323,11 @@ impl LibOS {
                 handle.take_key();
                 return Err(Fail::new(libc::ETIMEDOUT, "timer expired"));
             }
+
+            // Nothing completed, so back off, or block until some I/O queue may make progress or the timeout expires.
+            let remaining: Option<Duration> =
+                abstime.map(|abstime| abstime.duration_since(SystemTime::now()).unwrap_or(Duration::ZERO));
+            self.idle(&mut idle, remaining);
         }
     }
 
@@ -262,24 +338,36 @@ impl LibOS {
         // Get the wait start time, but only if we have a timeout.  We don't care when we started if we wait forever.
         let start: Option<Instant> = if timeout.is_none() { None } else { Some(Instant::now()) };
 
+        // Check if all queue tokens are valid, and index them. This is the only step that scans over all of them.
+        let mut offsets: HashMap<QToken, usize> = HashMap::with_capacity(qts.len());
+        for (i, &qt) in qts.iter().enumerate() {
+            // Return this operation to the scheduling queue by removing the associated key
+            // (which would otherwise cause the operation to be freed).
+            self.schedule(qt)?.take_key();
+            offsets.entry(qt).or_insert(i);
+        }
+        let mut idle: IdleState = self.idle.start();
+
         loop {
             // Poll first, so as to give pending operations a chance to complete.
-            self.poll();
-
-            // Search for any operation that has completed.
-            for (i, &qt) in qts.iter().enumerate() {
-                // Retrieve associated schedule handle.
-                // TODO: move this out of the loop.
-                let mut handle: SchedulerHandle = self.schedule(qt)?;
+            if self.poll() {
+                idle.reset(Instant::now());
+            }
 
-                // Found one, so extract the result and return.
-                if handle.has_completed() {
-                    return Ok((i, self.pack_result(handle, qt)?));
+            // Search for any operation that has completed. Only operations that completed are visited.
+            let mut ready: Option<QToken> = None;
+            self.for_each_completed(&mut |qt| {
+                if ready.is_none() && offsets.contains_key(&qt) {
+                    ready = Some(qt);
+                    return true;
                 }
+                false
+            });
 
-                // Return this operation to the scheduling queue by removing the associated key
-                // (which would otherwise cause the operation to be freed).
-                handle.take_key();
+            // Found one, so extract the result and return.
+            if let Some(qt) = ready {
+                let handle: SchedulerHandle = self.schedule(qt)?;
+                return Ok((offsets[&qt], self.pack_result(handle, qt)?));
             }
 
             // If we have a timeout, check for expiration.
@@ -289,44 +377,198 @@ impl LibOS {
             {
                 return Err(Fail::new(libc::ETIMEDOUT, "timer expired"));
             }
+
+            // Nothing completed, so back off, or block until some I/O queue may make progress or the timeout expires.
+            let remaining: Option<Duration> = timeout
+                .map(|timeout| timeout.saturating_sub(start.expect("start should be set if timeout is").elapsed()));
+            self.idle(&mut idle, remaining);
+        }
+    }
+
+    /// Waits for the next pending I/O operations to complete or a timeout to expire. On success, results of up to
+    /// `qrs.len()` completed operations are stored in `qrs`, in order of completion, and their number is returned.
+    /// Results that cannot be extracted are skipped, and their error is only returned if no result was stored.
+    pub fn wait_next_n(&mut self, qrs: &mut [demi_qresult_t], timeout: Option<Duration>) -> Result<usize, Fail> {
+        trace!("wait_next_n(): n={:?}, timeout={:?}", qrs.len(), timeout);
+
+        if qrs.is_empty() {
+            return Err(Fail::new(libc::EINVAL, "cannot wait for zero operations"));
+        }
+
+        // Get the wait start time, but only if we have a timeout.  We don't care when we started if we wait forever.
+        let start: Option<Instant> = if timeout.is_none() { None } else { Some(Instant::now()) };
+        let mut idle: IdleState = self.idle.start();
+
+        loop {
+            // Poll first, so as to give pending operations a chance to complete.
+            if self.poll() {
+                idle.reset(Instant::now());
+            }
+
+            // Take out up to n completed operations.
+            let mut ready: Vec<QToken> = Vec::new();
+            self.for_each_completed(&mut |qt| {
+                if ready.len() < qrs.len() {
+                    ready.push(qt);
+                    return true;
+                }
+                false
+            });
+
+            // Found some, so extract their results and return. Those operations are gone from the scheduler once their
+            // results are packed, so these results are returned even if packing another one fails.
+            if !ready.is_empty() {
+                let mut n: usize = 0;
+                let mut error: Option<Fail> = None;
+                for &qt in &ready {
+                    match self.schedule(qt).and_then(|handle| self.pack_result(handle, qt)) {
+                        Ok(qr) => {
+                            qrs[n] = qr;
+                            n += 1;
+                        },
+                        Err(e) => {
+                            warn!("wait_next_n(): failed to pack result (qt={:?}, error={:?})", qt, e);
+                            error.get_or_insert(e);
+                        },
+                    }
+                }
+                return match error {
+                    Some(e) if n == 0 => Err(e),
+                    _ => Ok(n),
+                };
+            }
+
+            // If we have a timeout, check for expiration.
+            if timeout.is_some()
+                && Instant::now().duration_since(start.expect("start should be set if timeout is"))
+                    > timeout.expect("timeout should still be set")
+            {
+                return Err(Fail::new(libc::ETIMEDOUT, "timer expired"));
+            }
+
+            // Nothing completed, so back off, or block until some I/O queue may make progress or the timeout expires.
+            let remaining: Option<Duration> = timeout
+                .map(|timeout| timeout.saturating_sub(start.expect("start should be set if timeout is").elapsed()));
+            self.idle(&mut idle, remaining);
         }
     }
 
     /// Allocates a scatter-gather array.
     pub fn sgaalloc(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.sgaalloc(size),
-            LibOS::MemoryLibOS(libos) => libos.sgaalloc(size),
+        match &self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.sgaalloc(size),
+            LibOSKind::MemoryLibOS(libos) => libos.sgaalloc(size),
+        }
+    }
+
+    /// Allocates a scatter-gather array for an I/O queue. Network LibOSes do not have per-queue memory, so this is
+    /// the same as [LibOS::sgaalloc] for them.
+    pub fn sgaalloc_qd(&self, qd: QDesc, size: usize) -> Result<demi_sgarray_t, Fail> {
+        match &self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.sgaalloc(size),
+            LibOSKind::MemoryLibOS(libos) => libos.sgaalloc_qd(qd, size),
         }
     }
 
     /// Releases a scatter-gather array.
     pub fn sgafree(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.sgafree(sga),
-            LibOS::MemoryLibOS(libos) => libos.sgafree(sga),
+        match &self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.sgafree(sga),
+            LibOSKind::MemoryLibOS(libos) => libos.sgafree(sga),
+        }
+    }
+
+    /// Visits completed operations, in order of completion.
+    fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        match &self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.for_each_completed(visitor),
+            LibOSKind::MemoryLibOS(libos) => libos.for_each_completed(visitor),
         }
     }
 
     /// Waits for any operation in an I/O queue.
     fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.schedule(qt),
-            LibOS::MemoryLibOS(libos) => libos.schedule(qt),
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.schedule(qt),
+            LibOSKind::MemoryLibOS(libos) => libos.schedule(qt),
         }
     }
 
     fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.pack_result(handle, qt),
-            LibOS::MemoryLibOS(libos) => libos.pack_result(handle, qt),
+        let qr: Result<demi_qresult_t, Fail> = match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.pack_result(handle, qt),
+            LibOSKind::MemoryLibOS(libos) => libos.pack_result(handle, qt),
+        };
+        if let Some((opcode, issued_at)) = self.issued.get_mut(u64::from(qt) as usize).and_then(Option::take) {
+            let latency: u64 = issued_at.elapsed().as_nanos() as u64;
+            stats::record(|stats| match opcode {
+                demi_opcode_t::DEMI_OPC_PUSH => stats.push_latency.record(latency),
+                demi_opcode_t::DEMI_OPC_POP => stats.pop_latency.record(latency),
+                demi_opcode_t::DEMI_OPC_ACCEPT => stats.accept_latency.record(latency),
+                demi_opcode_t::DEMI_OPC_CONNECT => stats.connect_latency.record(latency),
+                _ => (),
+            });
+        }
+        qr
+    }
+
+    /// Remembers when an operation of kind `opcode` was issued, if it was.
+    fn issued(&mut self, opcode: demi_opcode_t, qt: Result<QToken, Fail>) -> Result<QToken, Fail> {
+        if let Ok(qt) = qt {
+            self.track_issue(qt, opcode, Instant::now());
+        }
+        qt
+    }
+
+    /// Remembers when a batch of operations of kind `opcode` was issued.
+    fn issued_batch(&mut self, opcode: demi_opcode_t, qts: Result<Vec<QToken>, Fail>) -> Result<Vec<QToken>, Fail> {
+        if let Ok(ref qts) = qts {
+            let now: Instant = Instant::now();
+            for &qt in qts {
+                self.track_issue(qt, opcode, now);
+            }
+        }
+        qts
+    }
+
+    /// Records the kind and issue time of an operation.
+    fn track_issue(&mut self, qt: QToken, opcode: demi_opcode_t, now: Instant) {
+        let ix: usize = u64::from(qt) as usize;
+        if ix >= self.issued.len() {
+            self.issued.resize(ix + 1, None);
+        }
+        self.issued[ix] = Some((opcode, now));
+    }
+
+    /// Polls the target LibOS. Returns whether any progress was made.
+    fn poll(&mut self) -> bool {
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.poll(),
+            LibOSKind::MemoryLibOS(libos) => libos.poll(),
+        }
+    }
+
+    /// Waits before the next poll, following the idle policy of the target LibOS. `timeout` bounds how long the
+    /// caller may block.
+    fn idle(&mut self, state: &mut IdleState, timeout: Option<Duration>) {
+        match state.next(Instant::now()) {
+            IdleAction::Poll => (),
+            IdleAction::Pause(n) => idle::pause(n),
+            IdleAction::Block => {
+                // LibOSes that cannot block keep backing off at the slowest pace instead.
+                if !self.park(timeout) {
+                    idle::pause(idle::MAX_PAUSES);
+                }
+            },
         }
     }
 
-    fn poll(&mut self) {
-        match self {
-            LibOS::NetworkLibOS(libos) => libos.poll(),
-            LibOS::MemoryLibOS(libos) => libos.poll(),
+    /// Blocks until some I/O queue may make progress or `timeout` expires, if the LibOS supports it. Returns whether
+    /// it did.
+    fn park(&mut self, timeout: Option<Duration>) -> bool {
+        match &mut self.libos {
+            LibOSKind::NetworkLibOS(libos) => libos.park(timeout),
+            LibOSKind::MemoryLibOS(_) => false,
         }
     }
 }
@@ -8,6 +8,8 @@
 use crate::{
     runtime::{
         fail::Fail,
+        network::types::SocketOption,
+        queue::issue_batch,
         types::{
             demi_qresult_t,
             demi_sgarray_t,
@@ -17,7 +19,10 @@ use crate::{
     },
     scheduler::SchedulerHandle,
 };
-use ::std::net::SocketAddrV4;
+use ::std::{
+    net::SocketAddrV4,
+    time::Duration,
+};
 
 #[cfg(feature = "catcollar-libos")]
 use crate::catcollar::CatcollarLibOS;
@@ -242,11 +247,40 @@ impl NetworkLibOS {
         }
     }
 
-    /// Waits for any operation in an I/O queue.
-    pub fn poll(&mut self) {
+    /// Pushes a batch of scatter-gather arrays to TCP sockets, one per socket. See [issue_batch] for the handling of
+    /// failures.
+    pub fn push_batch(&mut self, sockqds: &[QDesc], sgas: &[demi_sgarray_t]) -> Result<Vec<QToken>, Fail> {
+        match self {
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOS::Catnip(libos) => libos.push_batch(sockqds, sgas),
+            #[allow(unreachable_patterns)]
+            _ => issue_batch(sockqds.len(), |i| self.push(sockqds[i], &sgas[i])),
+        }
+    }
+
+    /// Pops data from a batch of sockets. See [issue_batch] for the handling of failures.
+    pub fn pop_batch(&mut self, sockqds: &[QDesc]) -> Result<Vec<QToken>, Fail> {
+        issue_batch(sockqds.len(), |i| self.pop(sockqds[i]))
+    }
+
+    /// Sets an option of a socket. Only LibOSes that run their own network stack support this.
+    #[allow(unused_variables)]
+    pub fn setsockopt(&mut self, sockqd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOS::Catpowder(libos) => libos.setsockopt(sockqd, option),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOS::Catnip(libos) => libos.setsockopt(sockqd, option),
+            #[allow(unreachable_patterns)]
+            _ => Err(Fail::new(libc::ENOTSUP, "setsockopt() is not supported on this libos")),
+        }
+    }
+
+    /// Waits for any operation in an I/O queue. Returns whether any progress was made.
+    pub fn poll(&mut self) -> bool {
         match self {
             #[cfg(feature = "catpowder-libos")]
-            NetworkLibOS::Catpowder(libos) => libos.poll_bg_work(),
+            NetworkLibOS::Catpowder(libos) => libos.poll(),
             #[cfg(all(feature = "catnap-libos", target_os = "linux"))]
             NetworkLibOS::Catnap(libos) => libos.poll(),
             #[cfg(all(feature = "catnapw-libos", target_os = "windows"))]
@@ -254,12 +288,34 @@ impl NetworkLibOS {
             #[cfg(feature = "catcollar-libos")]
             NetworkLibOS::Catcollar(libos) => libos.poll(),
             #[cfg(feature = "catnip-libos")]
-            NetworkLibOS::Catnip(libos) => libos.poll_bg_work(),
+            NetworkLibOS::Catnip(libos) => libos.poll(),
             #[cfg(feature = "catloop-libos")]
             NetworkLibOS::Catloop(libos) => libos.poll(),
         }
     }
 
+    /// Blocks until some I/O queue may make progress or `timeout` expires. Returns whether the LibOS supports this.
+    /// LibOSes that cannot block on their I/O queues return right away, so callers keep polling them.
+    #[allow(unused_variables)]
+    pub fn park(&mut self, timeout: Option<Duration>) -> bool {
+        match self {
+            #[cfg(all(feature = "catnap-libos", target_os = "linux"))]
+            NetworkLibOS::Catnap(libos) => {
+                libos.park(timeout);
+                true
+            },
+            #[cfg(feature = "catcollar-libos")]
+            NetworkLibOS::Catcollar(libos) => {
+                libos.park(timeout);
+                true
+            },
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOS::Catnip(libos) => libos.park(timeout),
+            #[allow(unreachable_patterns)]
+            _ => false,
+        }
+    }
+
     /// Waits for any operation in an I/O queue.
     pub fn schedule(&mut self, qt: QToken) -> Result<SchedulerHandle, Fail> {
         match self {
@@ -278,6 +334,24 @@ impl NetworkLibOS {
         }
     }
 
+    /// Visits completed operations, in order of completion.
+    pub fn for_each_completed(&self, visitor: &mut dyn FnMut(QToken) -> bool) {
+        match self {
+            #[cfg(feature = "catpowder-libos")]
+            NetworkLibOS::Catpowder(libos) => libos.for_each_completed(visitor),
+            #[cfg(all(feature = "catnap-libos", target_os = "linux"))]
+            NetworkLibOS::Catnap(libos) => libos.for_each_completed(visitor),
+            #[cfg(all(feature = "catnapw-libos", target_os = "windows"))]
+            NetworkLibOS::CatnapW(libos) => libos.for_each_completed(visitor),
+            #[cfg(feature = "catcollar-libos")]
+            NetworkLibOS::Catcollar(libos) => libos.for_each_completed(visitor),
+            #[cfg(feature = "catnip-libos")]
+            NetworkLibOS::Catnip(libos) => libos.for_each_completed(visitor),
+            #[cfg(feature = "catloop-libos")]
+            NetworkLibOS::Catloop(libos) => libos.for_each_completed(visitor),
+        }
+    }
+
     pub fn pack_result(&mut self, handle: SchedulerHandle, qt: QToken) -> Result<demi_qresult_t, Fail> {
         match self {
             #[cfg(feature = "catpowder-libos")]
@@ -15,7 +15,10 @@ use crate::{
                 Ethernet2Header,
             },
             queue::InetQueue,
-            tcp::operations::ConnectFuture,
+            tcp::{
+                operations::ConnectFuture,
+                ControlBlock,
+            },
             udp::UdpOperation,
             Peer,
         },
@@ -34,7 +37,11 @@ use crate::{
                 TcpConfig,
                 UdpConfig,
             },
-            types::MacAddress,
+            consts::RECEIVE_BATCH_SIZE,
+            types::{
+                MacAddress,
+                SocketOption,
+            },
             NetworkRuntime,
         },
         queue::{
@@ -53,9 +60,9 @@ use crate::{
         SchedulerHandle,
     },
 };
+use ::arrayvec::ArrayVec;
 use ::libc::c_int;
 use ::std::{
-    any::Any,
     cell::RefCell,
     net::{
         Ipv4Addr,
@@ -72,7 +79,7 @@ use crate::timer;
 // Exports
 //==============================================================================
 
-#[cfg(test)]
+#[cfg(any(test, feature = "test-helpers"))]
 pub mod test_helpers;
 
 pub mod collections;
@@ -474,6 +481,27 @@ impl InetStack {
         Ok(qt)
     }
 
+    ///
+    /// **Brief**
+    ///
+    /// Sets an option of the socket referred to by `qd`.
+    ///
+    /// **Return Value**
+    ///
+    /// Upon successful completion, `Ok(())` is returned. Upon failure, `Fail` is
+    /// returned instead.
+    ///
+    pub fn setsockopt(&mut self, qd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        #[cfg(feature = "profiler")]
+        timer!("inetstack::setsockopt");
+        trace!("setsockopt(): qd={:?} option={:?}", qd, option);
+        match self.lookup_qtype(&qd) {
+            Some(QType::TcpSocket) => self.ipv4.tcp.setsockopt(qd, option),
+            Some(_) => Err(Fail::new(libc::ENOPROTOOPT, "invalid option for queue type")),
+            None => Err(Fail::new(libc::EBADF, "bad queue descriptor")),
+        }
+    }
+
     /// Waits for an operation to complete.
     #[deprecated]
     pub fn wait2(&mut self, qt: QToken) -> Result<(QDesc, OperationResult), Fail> {
@@ -537,10 +565,9 @@ impl InetStack {
     ///
     /// This function will panic if the specified future had not completed or is _background_ future.
     pub fn take_operation(&mut self, handle: SchedulerHandle) -> (QDesc, OperationResult) {
-        let boxed_future: Box<dyn Any> = self.scheduler.take(handle).as_any();
-        let boxed_concrete_type: FutureOperation = *boxed_future.downcast::<FutureOperation>().expect("Wrong type!");
+        let operation: FutureOperation = self.scheduler.take(handle);
 
-        match boxed_concrete_type {
+        match operation {
             FutureOperation::Tcp(f) => f.expect_result(),
             FutureOperation::Udp(f) => f.get_result(),
             FutureOperation::Background(..) => {
@@ -549,10 +576,9 @@ impl InetStack {
         }
     }
 
-    /// New incoming data has arrived. Route it to the correct parse out the Ethernet header and
-    /// allow the correct protocol to handle it. The underlying protocol will futher parse the data
-    /// and inform the correct task that its data has arrived.
-    fn do_receive(&mut self, bytes: DemiBuffer) -> Result<(), Fail> {
+    /// Parses the Ethernet header of an incoming frame and routes its payload to the protocol that handles it.
+    /// `flow` is the established TCP connection that the frame belongs to, if it was found by [InetStack::demux].
+    fn do_receive(&mut self, bytes: DemiBuffer, flow: Option<Rc<ControlBlock>>) -> Result<(), Fail> {
         #[cfg(feature = "profiler")]
         timer!("inetstack::engine::receive");
         let (header, payload) = Ethernet2Header::parse(bytes)?;
@@ -565,22 +591,32 @@ impl InetStack {
         }
         match header.ether_type() {
             EtherType2::Arp => self.arp.receive(payload),
-            EtherType2::Ipv4 => self.ipv4.receive(payload),
+            EtherType2::Ipv4 => self.ipv4.receive(payload, flow),
             EtherType2::Ipv6 => Ok(()), // Ignore for now.
         }
     }
 
+    /// Looks up the established TCP connection that each frame of a batch belongs to, if any, and prefetches its
+    /// state. Connections are only set up and torn down by the scheduler, so they stay valid until it runs.
+    fn demux(&self, batch: &[DemiBuffer]) -> ArrayVec<Option<Rc<ControlBlock>>, RECEIVE_BATCH_SIZE> {
+        let datagrams = batch.iter().map(|bytes| match Ethernet2Header::peek(bytes) {
+            Some((ether_type, datagram)) if ether_type == EtherType2::Ipv4 as u16 => Some(datagram),
+            _ => None,
+        });
+        self.ipv4.demux(datagrams)
+    }
+
     /// Scheduler will poll all futures that are ready to make progress.
     /// Then ask the runtime to receive new data which we will forward to the engine to parse and
-    /// route to the correct protocol.
-    pub fn poll_bg_work(&mut self) {
+    /// route to the correct protocol. Returns whether any task ran or any packet was received.
+    pub fn poll_bg_work(&mut self) -> bool {
         #[cfg(feature = "profiler")]
         timer!("inetstack::poll_bg_work");
-        {
+        let mut progress: bool = {
             #[cfg(feature = "profiler")]
             timer!("inetstack::poll_bg_work::poll");
-            self.scheduler.poll();
-        }
+            self.scheduler.poll()
+        };
 
         {
             #[cfg(feature = "profiler")]
@@ -601,21 +637,45 @@ impl InetStack {
                     if batch.is_empty() {
                         break;
                     }
-
-                    for pkt in batch {
-                        if let Err(e) = self.do_receive(pkt) {
+                    progress = true;
+
+                    // Demultiplex the whole batch ahead of processing it, so that fetching the state of the connections
+                    // that it belongs to into the cache overlaps.
+                    let flows: ArrayVec<Option<Rc<ControlBlock>>, RECEIVE_BATCH_SIZE> = self.demux(&batch);
+
+                    // Process the whole batch before running the scheduler, so that its cost is amortized. A handshake
+                    // completes only once the scheduler runs, though, so run it right after a handshake segment lest
+                    // the data that follows in the batch finds the connection still opening. Connections may then have
+                    // been set up or torn down, so the rest of the batch is looked up again as it is processed.
+                    let mut demuxed: bool = true;
+                    for (pkt, flow) in batch.into_iter().zip(flows) {
+                        let flow: Option<Rc<ControlBlock>> = if demuxed { flow } else { None };
+                        if let Err(e) = self.do_receive(pkt, flow) {
                             warn!("Dropped packet: {:?}", e);
                         }
-                        // TODO: This is a workaround for https://github.com/demikernel/inetstack/issues/149.
-                        self.scheduler.poll();
+                        if self.ipv4.tcp.take_handshake() {
+                            self.scheduler.poll();
+                            demuxed = false;
+                        }
                     }
+                    self.scheduler.poll();
                 }
             }
         }
 
+        // Send what corked connections held back during this poll.
+        self.ipv4.tcp.flush();
+
         if self.ts_iters == 0 {
             self.clock.advance_clock(Instant::now());
         }
         self.ts_iters = (self.ts_iters + 1) % TIMER_RESOLUTION;
+        progress
+    }
+
+    /// Advances the clock to the current time right away. The clock is otherwise advanced once every few polls, which
+    /// lags behind when polls are far apart, as it happens once the LibOS blocks.
+    pub fn advance_clock(&mut self) {
+        self.clock.advance_clock(Instant::now());
     }
 }
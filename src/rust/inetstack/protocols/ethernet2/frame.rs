@@ -18,6 +18,9 @@ use ::std::convert::{
 pub const ETHERNET2_HEADER_SIZE: usize = 14;
 pub const MIN_PAYLOAD_SIZE: usize = 46;
 
+/// Offset of the EtherType field in an Ethernet header (in bytes).
+const ETHER_TYPE_OFFSET: usize = 12;
+
 #[derive(Clone, Debug)]
 pub struct Ethernet2Header {
     // Bytes 0..6
@@ -60,6 +63,16 @@ impl Ethernet2Header {
         Ok((hdr, buf))
     }
 
+    /// Peeks at the EtherType of a frame, without validating its header. Returns it along with the payload of the frame,
+    /// if the frame is large enough to hold a header.
+    pub fn peek(buf: &[u8]) -> Option<(u16, &[u8])> {
+        if buf.len() < ETHERNET2_HEADER_SIZE {
+            return None;
+        }
+        let ether_type: u16 = u16::from_be_bytes([buf[ETHER_TYPE_OFFSET], buf[ETHER_TYPE_OFFSET + 1]]);
+        Some((ether_type, &buf[ETHERNET2_HEADER_SIZE..]))
+    }
+
     pub fn serialize(&self, buf: &mut [u8]) {
         let buf: &mut [u8; ETHERNET2_HEADER_SIZE] = buf.try_into().unwrap();
         buf[0..6].copy_from_slice(&self.dst_addr.octets());
@@ -2,9 +2,12 @@
 // Licensed under the MIT license.
 
 use super::protocol::Icmpv4Type2;
-use crate::runtime::{
-    fail::Fail,
-    memory::DemiBuffer,
+use crate::{
+    inetstack::protocols::ip::checksum::Checksum,
+    runtime::{
+        fail::Fail,
+        memory::DemiBuffer,
+    },
 };
 use ::libc::EBADMSG;
 use ::std::convert::TryInto;
@@ -71,25 +74,12 @@ impl Icmpv4Header {
     }
 
     fn checksum(buf: &[u8; ICMPV4_HEADER_SIZE], body: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
-        state += u16::from_be_bytes([buf[0], buf[1]]) as u32;
+        let mut checksum: Checksum = Checksum::new();
+        checksum.add_bytes(&buf[0..2]);
         // Skip the checksum.
-        state += 0;
-        state += u16::from_be_bytes([buf[4], buf[5]]) as u32;
-        state += u16::from_be_bytes([buf[6], buf[7]]) as u32;
-
-        let mut chunks_iter = body.chunks_exact(2);
-        while let Some(chunk) = chunks_iter.next() {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-        if let Some(&b) = chunks_iter.remainder().get(0) {
-            state += u16::from_be_bytes([b, 0]) as u32;
-        }
-
-        while state > 0xFFFF {
-            state -= 0xFFFF;
-        }
-        !state as u16
+        checksum.add_bytes(&buf[4..8]);
+        checksum.add_bytes(body);
+        checksum.finish()
     }
 
     pub fn get_protocol(&self) -> Icmpv4Type2 {
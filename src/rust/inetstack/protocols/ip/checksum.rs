@@ -0,0 +1,298 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Internet checksum (RFC 1071), shared by IPv4, ICMPv4, TCP and UDP.
+//!
+//! Data is summed 32 bits at a time into a 64-bit accumulator, in native byte order. One's complement sums do not
+//! depend on byte order (RFC 1071, Section 2), so the result is only swapped once, when folding it. The summing loop
+//! is written so that the compiler vectorizes it, and on x86-64 it is also compiled for AVX2, which is picked at
+//! runtime if the CPU supports it. On AArch64, NEON is part of the baseline, so the portable loop already uses it.
+//!
+//! Checksums may also be updated incrementally (RFC 1624) when a few header fields change, without summing the data
+//! they cover again.
+
+//======================================================================================================================
+// Imports
+//======================================================================================================================
+
+use crate::inetstack::protocols::ip::IpProtocol;
+use ::std::{
+    convert::TryInto,
+    net::Ipv4Addr,
+};
+
+//======================================================================================================================
+// Structures
+//======================================================================================================================
+
+/// Internet Checksum
+///
+/// Accumulates the one's complement sum of 16-bit big-endian words. As everywhere else in the stack, the sum is
+/// seeded with `0xffff` (i.e. negative zero), so the sum never folds to zero, and the checksum is never `0xffff`.
+#[derive(Clone, Copy, Debug)]
+pub struct Checksum {
+    /// Running sum, in native byte order.
+    state: u64,
+}
+
+//======================================================================================================================
+// Associate Functions
+//======================================================================================================================
+
+/// Associate Functions for Internet Checksums
+impl Checksum {
+    /// Creates an empty checksum.
+    pub fn new() -> Self {
+        Self { state: 0xffff }
+    }
+
+    /// Adds a 16-bit word to the target checksum.
+    pub fn add_u16(&mut self, value: u16) {
+        self.state += u16::from_ne_bytes(value.to_be_bytes()) as u64;
+    }
+
+    /// Adds a 32-bit word to the target checksum.
+    pub fn add_u32(&mut self, value: u32) {
+        self.state += u32::from_ne_bytes(value.to_be_bytes()) as u64;
+    }
+
+    /// Adds `bytes` to the target checksum. If `bytes` has an odd length, it is padded with a zero octet, so only the
+    /// last bytes added to a checksum may have an odd length.
+    pub fn add_bytes(&mut self, bytes: &[u8]) {
+        self.state += sum_words(bytes);
+    }
+
+    /// Adds the TCP/UDP pseudo-header of an IPv4 datagram to the target checksum. The `length` field covers the
+    /// transport header and its payload.
+    pub fn add_ipv4_pseudo_header(
+        &mut self,
+        src_addr: Ipv4Addr,
+        dst_addr: Ipv4Addr,
+        protocol: IpProtocol,
+        length: u16,
+    ) {
+        self.add_u32(u32::from(src_addr));
+        self.add_u32(u32::from(dst_addr));
+        self.add_u16(protocol as u16);
+        self.add_u16(length);
+    }
+
+    /// Returns the one's complement sum of the target checksum, without complementing it.
+    pub fn fold(&self) -> u16 {
+        u16::from_be_bytes(fold(self.state).to_ne_bytes())
+    }
+
+    /// Returns the value of the target checksum.
+    pub fn finish(&self) -> u16 {
+        !self.fold()
+    }
+}
+
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Computes the checksum of `bytes`.
+pub fn checksum(bytes: &[u8]) -> u16 {
+    let mut checksum: Checksum = Checksum::new();
+    checksum.add_bytes(bytes);
+    checksum.finish()
+}
+
+/// Updates `checksum` after a 16-bit word that it covers changes from `old` to `new` (RFC 1624, Equation 3).
+pub fn update_u16(checksum: u16, old: u16, new: u16) -> u16 {
+    let state: u64 = (!checksum) as u64 + (!old) as u64 + new as u64;
+    !fold(state)
+}
+
+/// Updates `checksum` after a 32-bit word that it covers changes from `old` to `new` (RFC 1624, Equation 3).
+pub fn update_u32(checksum: u16, old: u32, new: u32) -> u16 {
+    let state: u64 =
+        (!checksum) as u64 + (!old >> 16) as u64 + (!old & 0xffff) as u64 + (new >> 16) as u64 + (new & 0xffff) as u64;
+    !fold(state)
+}
+
+/// Folds a 64-bit one's complement sum into 16 bits. A non-zero sum never folds to zero.
+#[inline]
+fn fold(mut state: u64) -> u16 {
+    state = (state & 0xffff_ffff) + (state >> 32);
+    state = (state & 0xffff_ffff) + (state >> 32);
+    state = (state & 0xffff) + (state >> 16);
+    state = (state & 0xffff) + (state >> 16);
+    state = (state & 0xffff) + (state >> 16);
+    state as u16
+}
+
+/// Sums `bytes` as 16-bit words in native byte order, picking the fastest kernel that the CPU supports.
+#[inline]
+fn sum_words(bytes: &[u8]) -> u64 {
+    #[cfg(target_arch = "x86_64")]
+    if is_x86_feature_detected!("avx2") {
+        // Safety: the CPU supports AVX2.
+        return unsafe { sum_words_avx2(bytes) };
+    }
+    sum_words_portable(bytes)
+}
+
+/// Sums `bytes` as 16-bit words in native byte order, using AVX2.
+#[cfg(target_arch = "x86_64")]
+#[target_feature(enable = "avx2")]
+unsafe fn sum_words_avx2(bytes: &[u8]) -> u64 {
+    sum_words_portable(bytes)
+}
+
+/// Sums `bytes` as 16-bit words in native byte order.
+// Note: 32-bit words are summed instead, which is equivalent modulo 0xffff. A 64-bit accumulator cannot overflow for
+// any input shorter than 16 GiB, so carries are only folded once, at the end.
+#[inline(always)]
+fn sum_words_portable(bytes: &[u8]) -> u64 {
+    let mut state: u64 = 0;
+    let mut chunks_iter: ::std::slice::ChunksExact<u8> = bytes.chunks_exact(4);
+    for chunk in &mut chunks_iter {
+        state += u32::from_ne_bytes(chunk.try_into().unwrap()) as u64;
+    }
+    let remainder: &[u8] = chunks_iter.remainder();
+    if remainder.len() >= 2 {
+        state += u16::from_ne_bytes([remainder[0], remainder[1]]) as u64;
+    }
+    // Pad the last byte with zero if the data has an odd number of bytes.
+    if remainder.len() % 2 == 1 {
+        state += u16::from_ne_bytes([remainder[remainder.len() - 1], 0]) as u64;
+    }
+    state
+}
+
+//======================================================================================================================
+// Trait Implementations
+//======================================================================================================================
+
+/// Default Trait Implementation for Internet Checksums
+impl Default for Checksum {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+//======================================================================================================================
+// Unit Tests
+//======================================================================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        checksum,
+        update_u16,
+        update_u32,
+        Checksum,
+    };
+    use ::test::{
+        black_box,
+        Bencher,
+    };
+
+    /// Computes the checksum of `bytes` the straightforward way, 16 bits at a time.
+    fn reference_checksum(bytes: &[u8]) -> u16 {
+        let mut state: u32 = 0xffff;
+        for chunk in bytes.chunks(2) {
+            state += u16::from_be_bytes([chunk[0], *chunk.get(1).unwrap_or(&0)]) as u32;
+            while state > 0xffff {
+                state -= 0xffff;
+            }
+        }
+        !state as u16
+    }
+
+    /// Builds a buffer of `len` pseudo-random bytes.
+    fn build_bytes(len: usize) -> Vec<u8> {
+        let mut x: u32 = 0x1234_5678;
+        (0..len)
+            .map(|_| {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                x as u8
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_checksum() {
+        // RFC 1071, Section 3.
+        assert_eq!(checksum(&[0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7]), !0xddf2);
+
+        for len in 0..300 {
+            let bytes: Vec<u8> = build_bytes(len);
+            assert_eq!(checksum(&bytes), reference_checksum(&bytes), "len={:?}", len);
+        }
+        for len in [1500, 9000, 65535] {
+            let bytes: Vec<u8> = vec![0xff; len];
+            assert_eq!(checksum(&bytes), reference_checksum(&bytes), "len={:?}", len);
+        }
+        assert_eq!(checksum(&[0; 20]), reference_checksum(&[0; 20]));
+    }
+
+    #[test]
+    fn test_checksum_words() {
+        let bytes: Vec<u8> = build_bytes(64);
+        let mut checksum: Checksum = Checksum::new();
+        checksum.add_u16(u16::from_be_bytes([bytes[0], bytes[1]]));
+        checksum.add_u32(u32::from_be_bytes([bytes[2], bytes[3], bytes[4], bytes[5]]));
+        checksum.add_bytes(&bytes[6..]);
+        assert_eq!(checksum.finish(), reference_checksum(&bytes));
+    }
+
+    #[test]
+    fn test_update() {
+        for len in [20, 64, 1500] {
+            let mut bytes: Vec<u8> = build_bytes(len);
+            let mut sum: u16 = checksum(&bytes);
+
+            // Rewrite a 16-bit word.
+            let old: u16 = u16::from_be_bytes([bytes[2], bytes[3]]);
+            let new: u16 = old.wrapping_add(0x1234);
+            bytes[2..4].copy_from_slice(&new.to_be_bytes());
+            sum = update_u16(sum, old, new);
+            assert_eq!(sum, checksum(&bytes));
+
+            // Rewrite a 32-bit word, including values that fold to negative zero.
+            for new in [0u32, 0xffff_ffff, 0xdead_beef] {
+                let old: u32 = u32::from_be_bytes(bytes[4..8].try_into().unwrap());
+                bytes[4..8].copy_from_slice(&new.to_be_bytes());
+                sum = update_u32(sum, old, new);
+                assert_eq!(sum, checksum(&bytes));
+            }
+        }
+    }
+
+    /// Benchmarks the checksum of `len` bytes.
+    fn bench_checksum(b: &mut Bencher, len: usize) {
+        let bytes: Vec<u8> = build_bytes(len);
+        b.bytes = len as u64;
+        b.iter(|| checksum(black_box(&bytes)));
+    }
+
+    #[bench]
+    fn bench_checksum_64(b: &mut Bencher) {
+        bench_checksum(b, 64);
+    }
+
+    #[bench]
+    fn bench_checksum_512(b: &mut Bencher) {
+        bench_checksum(b, 512);
+    }
+
+    #[bench]
+    fn bench_checksum_1500(b: &mut Bencher) {
+        bench_checksum(b, 1500);
+    }
+
+    #[bench]
+    fn bench_checksum_9000(b: &mut Bencher) {
+        bench_checksum(b, 9000);
+    }
+
+    #[bench]
+    fn bench_checksum_update(b: &mut Bencher) {
+        b.iter(|| update_u32(black_box(0x1234), black_box(0xdead_beef), black_box(0xcafe_f00d)));
+    }
+}
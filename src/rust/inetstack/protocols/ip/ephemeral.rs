@@ -51,6 +51,17 @@ impl EphemeralPorts {
         ))
     }
 
+    /// Allocates any port from the pool for which `accept` holds.
+    pub fn alloc_if<F: FnMut(u16) -> bool>(&mut self, mut accept: F) -> Result<u16, Fail> {
+        match self.ports.iter().rposition(|&port| accept(port)) {
+            Some(index) => Ok(self.ports.swap_remove(index)),
+            None => Err(Fail::new(
+                libc::EADDRINUSE,
+                "all suitable port numbers in the ephemeral port range are currently in use",
+            )),
+        }
+    }
+
     /// Allocates the specified port from the pool.
     pub fn alloc_port(&mut self, port: u16) -> Result<(), Fail> {
         // Check if port is not in the pool.
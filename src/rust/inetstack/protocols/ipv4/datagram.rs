@@ -6,7 +6,10 @@
 //==============================================================================
 
 use crate::{
-    inetstack::protocols::ip::IpProtocol,
+    inetstack::protocols::ip::{
+        checksum::Checksum,
+        IpProtocol,
+    },
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
@@ -40,6 +43,15 @@ const IPV4_HEADER_MIN_SIZE: u16 = IPV4_DATAGRAM_MIN_SIZE;
 /// IPv4 header length when no options are present (in 32-bit words).
 const IPV4_IHL_NO_OPTIONS: u8 = (IPV4_HEADER_MIN_SIZE as u8) / 4;
 
+/// Offset of the protocol field in an IPv4 header (in bytes).
+const IPV4_PROTOCOL_OFFSET: usize = 9;
+
+/// Offset of the source address in an IPv4 header (in bytes).
+const IPV4_SRC_ADDR_OFFSET: usize = 12;
+
+/// Offset of the destination address in an IPv4 header (in bytes).
+const IPV4_DST_ADDR_OFFSET: usize = 16;
+
 /// Default time to live value.
 const DEFAULT_IPV4_TTL: u8 = 255;
 
@@ -122,6 +134,25 @@ impl Ipv4Header {
         IPV4_HEADER_MIN_SIZE as usize
     }
 
+    /// Peeks at the protocol and addresses of a datagram, without validating its header. Returns them along with the
+    /// payload of the datagram, if the datagram is large enough to hold the header.
+    pub fn peek(buf: &[u8]) -> Option<(u8, Ipv4Addr, Ipv4Addr, &[u8])> {
+        if buf.len() < IPV4_HEADER_MIN_SIZE as usize {
+            return None;
+        }
+        let hdr_size: usize = ((buf[0] & 0xF) as usize) << 2;
+        if hdr_size < IPV4_HEADER_MIN_SIZE as usize || buf.len() < hdr_size {
+            return None;
+        }
+        let addr = |offset: usize| Ipv4Addr::new(buf[offset], buf[offset + 1], buf[offset + 2], buf[offset + 3]);
+        Some((
+            buf[IPV4_PROTOCOL_OFFSET],
+            addr(IPV4_SRC_ADDR_OFFSET),
+            addr(IPV4_DST_ADDR_OFFSET),
+            &buf[hdr_size..],
+        ))
+    }
+
     /// Parses a buffer into an IPv4 header and payload.
     pub fn parse(mut buf: DemiBuffer) -> Result<(Self, DemiBuffer), Fail> {
         // The datagram should be as big as the header.
@@ -307,18 +338,10 @@ impl Ipv4Header {
 
     /// Computes the checksum of the target IPv4 header.
     pub fn compute_checksum(buf: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
-        for i in 0..5 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        // Skip the 5th u16 since octets 10-12 are the header checksum, whose value should be zero when
-        // computing a checksum.
-        for i in 6..10 {
-            state += u16::from_be_bytes([buf[2 * i], buf[2 * i + 1]]) as u32;
-        }
-        while state > 0xffff {
-            state -= 0xffff;
-        }
-        !state as u16
+        let mut checksum: Checksum = Checksum::new();
+        // Skip octets 10-12, which are the header checksum, whose value should be zero when computing a checksum.
+        checksum.add_bytes(&buf[..10]);
+        checksum.add_bytes(&buf[12..20]);
+        checksum.finish()
     }
 }
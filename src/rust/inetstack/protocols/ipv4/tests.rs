@@ -113,6 +113,17 @@ fn test_ipv4_header_parse_good() {
         // Payload
         buf[header_size..datagram_size].copy_from_slice(&data);
 
+        // Peeking at the header agrees with parsing it.
+        match Ipv4Header::peek(&buf[..datagram_size]) {
+            Some((protocol, src_addr, dst_addr, payload)) => {
+                assert_eq!(protocol, IpProtocol::UDP as u8);
+                assert_eq!(src_addr, ALICE_IPV4);
+                assert_eq!(dst_addr, BOB_IPV4);
+                assert_eq!(payload, &data[..]);
+            },
+            None => assert!(false, "peek should succeed"),
+        }
+
         // Do it.
         let buf_bytes: DemiBuffer = DemiBuffer::from_slice(&buf[..datagram_size]).expect("'buf' should fit");
         match Ipv4Header::parse(buf_bytes) {
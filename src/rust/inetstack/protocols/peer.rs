@@ -8,7 +8,11 @@ use crate::{
         ip::IpProtocol,
         ipv4::Ipv4Header,
         queue::InetQueue,
-        tcp::TcpPeer,
+        tcp::{
+            segment::TcpHeader,
+            ControlBlock,
+            TcpPeer,
+        },
         udp::UdpPeer,
     },
     runtime::{
@@ -19,6 +23,7 @@ use crate::{
                 TcpConfig,
                 UdpConfig,
             },
+            consts::RECEIVE_BATCH_SIZE,
             types::MacAddress,
             NetworkRuntime,
         },
@@ -27,11 +32,15 @@ use crate::{
     },
     scheduler::scheduler::Scheduler,
 };
+use ::arrayvec::ArrayVec;
 use ::libc::ENOTCONN;
 use ::std::{
     cell::RefCell,
     future::Future,
-    net::Ipv4Addr,
+    net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    },
     rc::Rc,
     time::Duration,
 };
@@ -99,7 +108,8 @@ impl Peer {
         })
     }
 
-    pub fn receive(&mut self, buf: DemiBuffer) -> Result<(), Fail> {
+    /// Processes a datagram. `flow` is the established TCP connection it belongs to, if it was found by [Peer::demux].
+    pub fn receive(&mut self, buf: DemiBuffer, flow: Option<Rc<ControlBlock>>) -> Result<(), Fail> {
         let (header, payload) = Ipv4Header::parse(buf)?;
         debug!("Ipv4 received {:?}", header);
         if header.get_dest_addr() != self.local_ipv4_addr && !header.get_dest_addr().is_broadcast() {
@@ -107,11 +117,34 @@ impl Peer {
         }
         match header.get_protocol() {
             IpProtocol::ICMPv4 => self.icmpv4.receive(&header, payload),
-            IpProtocol::TCP => self.tcp.receive(&header, payload),
+            IpProtocol::TCP => self.tcp.receive(&header, payload, flow),
             IpProtocol::UDP => self.udp.do_receive(&header, payload),
         }
     }
 
+    /// Looks up the established TCP connection that each datagram of a batch belongs to, if any, and prefetches its
+    /// state. Headers are only peeked at, and not validated, as datagrams go through [Peer::receive] afterwards.
+    pub fn demux<'a, I: Iterator<Item = Option<&'a [u8]>>>(
+        &self,
+        datagrams: I,
+    ) -> ArrayVec<Option<Rc<ControlBlock>>, RECEIVE_BATCH_SIZE> {
+        self.tcp
+            .demux(datagrams.map(|datagram| datagram.and_then(Self::peek_tcp_flow)))
+    }
+
+    /// Peeks at the local and remote endpoints of the TCP segment in a datagram, if it holds one.
+    fn peek_tcp_flow(buf: &[u8]) -> Option<(SocketAddrV4, SocketAddrV4)> {
+        let (protocol, src_addr, dst_addr, segment): (u8, Ipv4Addr, Ipv4Addr, &[u8]) = Ipv4Header::peek(buf)?;
+        if protocol != IpProtocol::TCP as u8 {
+            return None;
+        }
+        let (src_port, dst_port): (u16, u16) = TcpHeader::peek_ports(segment)?;
+        Some((
+            SocketAddrV4::new(dst_addr, dst_port),
+            SocketAddrV4::new(src_addr, src_port),
+        ))
+    }
+
     pub fn ping(
         &mut self,
         dest_ipv4_addr: Ipv4Addr,
@@ -15,10 +15,7 @@ use crate::{
             tcp::{
                 constants::FALLBACK_MSS,
                 established::{
-                    congestion_control::{
-                        self,
-                        CongestionControl,
-                    },
+                    congestion_control,
                     ControlBlock,
                 },
                 segment::{
@@ -33,7 +30,10 @@ use crate::{
     runtime::{
         fail::Fail,
         network::{
-            config::TcpConfig,
+            config::{
+                TcpConfig,
+                TcpLossRecovery,
+            },
             types::MacAddress,
             NetworkRuntime,
         },
@@ -200,6 +200,7 @@ impl ActiveOpenSocket {
 
         let mut remote_window_scale = None;
         let mut mss = FALLBACK_MSS;
+        let mut sack_permitted: bool = false;
         for option in header.iter_options() {
             match option {
                 TcpOptions2::WindowScale(w) => {
@@ -210,6 +211,10 @@ impl ActiveOpenSocket {
                     info!("Received advertised MSS: {}", m);
                     mss = *m as usize;
                 },
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_permitted = true;
+                },
                 _ => continue,
             }
         }
@@ -222,11 +227,9 @@ impl ActiveOpenSocket {
         // TODO(RFC1323): Clamp the scale to 14 instead of panicking.
         assert!(local_window_scale <= 14 && remote_window_scale <= 14);
 
-        let rx_window_size: u32 = (self.tcp_config.get_receive_window_size())
-            .checked_shl(local_window_scale as u32)
-            .expect("TODO: Window size overflow")
-            .try_into()
-            .expect("TODO: Window size overflow");
+        let rx_window_size: u32 = self
+            .tcp_config
+            .get_initial_receive_buffer_size(local_window_scale as u8);
 
         let tx_window_size: u32 = (header.window_size)
             .checked_shl(remote_window_scale as u32)
@@ -257,7 +260,8 @@ impl ActiveOpenSocket {
             tx_window_size,
             remote_window_scale,
             mss,
-            congestion_control::None::new,
+            sack_permitted,
+            congestion_control::constructor(self.tcp_config.get_congestion_control()),
             None,
         );
         self.set_result(Ok(cb));
@@ -299,6 +303,11 @@ impl ActiveOpenSocket {
                 tcp_hdr.push_option(TcpOptions2::WindowScale(tcp_config.get_window_scale()));
                 info!("Advertising window scale: {}", tcp_config.get_window_scale());
 
+                if tcp_config.get_loss_recovery() != TcpLossRecovery::Rto {
+                    tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+                    info!("Advertising SACK permitted");
+                }
+
                 debug!("Sending SYN {:?}", tcp_hdr);
                 let segment = TcpSegment {
                     ethernet2_hdr: Ethernet2Header::new(remote_link_addr, local_link_addr, EtherType2::Ipv4),
@@ -0,0 +1,198 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use crate::inetstack::protocols::tcp::SeqNumber;
+use ::std::{
+    cmp,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+// TCP Receive Buffer Autotuning.
+//
+// This is Dynamic Right-Sizing (DRS), as done by Linux: once per round-trip time, we measure how much data the
+// application consumed, and if that is more than in the previous round trip, we grow the receive buffer to twice that
+// (plus some headroom) so that the sender is never limited by our window.  The buffer is never shrunk, as that would
+// require retracting a window that we've already advertised.
+//
+// The round-trip time is measured on the receive side (see RFC 7323 Appendix C): a full window after receive_next is
+// expected to arrive one round trip later, if the sender is limited by our window.  Otherwise, this over-estimates the
+// round-trip time, so we keep the smallest sample.
+
+// Number of segments of headroom added to the receive buffer when it grows.
+const GROWTH_HEADROOM_SEGMENTS: u64 = 16;
+
+// Number of segments that the sender is initially expected to send in a round trip (RFC 6928 initial window).
+const INITIAL_WINDOW_SEGMENTS: u32 = 10;
+
+#[derive(Debug)]
+pub struct ReceiveBufferTuner {
+    // Largest size to which the receive buffer may grow.
+    max_size: u32,
+
+    // Our maximum segment size.
+    mss: u32,
+
+    // Receive-side estimate of the round-trip time, if we've taken a sample yet.
+    rtt: Option<Duration>,
+
+    // Sequence number whose reception ends the current round-trip time measurement, along with the start time of
+    // that measurement.
+    rtt_end: Option<(SeqNumber, Instant)>,
+
+    // Number of bytes consumed by the application in the last round trip in which consumption increased.
+    space: u32,
+
+    // Value of reader_next when the current consumption measurement started.
+    space_start: SeqNumber,
+
+    // Time at which the current consumption measurement started.
+    space_time: Instant,
+}
+
+impl ReceiveBufferTuner {
+    /// Initializes a receive buffer tuner.
+    pub fn new(initial_size: u32, max_size: u32, mss: u32, reader_next: SeqNumber, now: Instant) -> Self {
+        Self {
+            max_size,
+            mss,
+            rtt: None,
+            rtt_end: None,
+            space: cmp::max(cmp::min(initial_size, INITIAL_WINDOW_SEGMENTS * mss), 1),
+            space_start: reader_next,
+            space_time: now,
+        }
+    }
+
+    /// Gets the receive-side estimate of the round-trip time.
+    pub fn rtt(&self) -> Option<Duration> {
+        self.rtt
+    }
+
+    /// Takes a round-trip time sample, if due, after in-order data has been received.  `window` is the receive window
+    /// that we're currently advertising.
+    pub fn on_receive(&mut self, receive_next: SeqNumber, window: u32, now: Instant) {
+        if let Some((end, start)) = self.rtt_end {
+            if receive_next < end {
+                return;
+            }
+            let sample: Duration = now - start;
+            self.rtt = Some(match self.rtt {
+                Some(rtt) => cmp::min(rtt, sample),
+                None => sample,
+            });
+        }
+
+        // A closed window does not let the sender send, so it tells us nothing about the round-trip time.
+        self.rtt_end = match window {
+            0 => None,
+            _ => Some((receive_next + SeqNumber::from(window), now)),
+        };
+    }
+
+    /// Measures the rate at which the application consumes data after it has read some.  `srtt` is the sender's
+    /// estimate of the round-trip time, which is used until we have our own.  Returns the new size of the receive
+    /// buffer, if it should grow.
+    pub fn on_read(&mut self, reader_next: SeqNumber, size: u32, srtt: Option<Duration>, now: Instant) -> Option<u32> {
+        let rtt: Duration = self.rtt.or(srtt)?;
+        if now - self.space_time < rtt {
+            return None;
+        }
+
+        let copied: u32 = (reader_next - self.space_start).into();
+        let mut new_size: Option<u32> = None;
+        if copied > self.space {
+            // Leave room for twice what was consumed in the last round trip, so that the sender may double its rate
+            // while slow starting, and grow faster if consumption is increasing quickly.
+            let mut target: u64 = 2 * copied as u64 + GROWTH_HEADROOM_SEGMENTS * self.mss as u64;
+            target += 2 * target * (copied - self.space) as u64 / self.space as u64;
+            let target: u32 = cmp::min(target, self.max_size as u64) as u32;
+            if target > size {
+                new_size = Some(target);
+            }
+            self.space = copied;
+        }
+
+        self.space_start = reader_next;
+        self.space_time = now;
+        new_size
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::ReceiveBufferTuner;
+    use crate::inetstack::protocols::tcp::SeqNumber;
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    #[test]
+    fn receive_side_rtt() {
+        let start: Instant = Instant::now();
+        let ms = |n: u64| start + Duration::from_millis(n);
+        let mut tuner: ReceiveBufferTuner = ReceiveBufferTuner::new(65535, 1 << 24, 1460, SeqNumber::from(0), start);
+
+        // The first segment starts a measurement, which ends when a full window has been received.
+        tuner.on_receive(SeqNumber::from(1000), 10000, ms(0));
+        assert_eq!(tuner.rtt(), None);
+        tuner.on_receive(SeqNumber::from(6000), 10000, ms(15));
+        assert_eq!(tuner.rtt(), None);
+        tuner.on_receive(SeqNumber::from(11000), 10000, ms(20));
+        assert_eq!(tuner.rtt(), Some(Duration::from_millis(20)));
+
+        // Larger samples are ignored, smaller ones are kept.
+        tuner.on_receive(SeqNumber::from(21000), 10000, ms(50));
+        assert_eq!(tuner.rtt(), Some(Duration::from_millis(20)));
+        tuner.on_receive(SeqNumber::from(31000), 10000, ms(60));
+        assert_eq!(tuner.rtt(), Some(Duration::from_millis(10)));
+
+        // A closed window doesn't start a measurement.
+        tuner.on_receive(SeqNumber::from(41000), 0, ms(70));
+        tuner.on_receive(SeqNumber::from(42000), 10000, ms(200));
+        tuner.on_receive(SeqNumber::from(52000), 10000, ms(201));
+        assert_eq!(tuner.rtt(), Some(Duration::from_millis(1)));
+    }
+
+    #[test]
+    fn grows_with_consumption() {
+        let start: Instant = Instant::now();
+        let ms = |n: u64| start + Duration::from_millis(n);
+        let max_size: u32 = 1 << 24;
+        let mut tuner: ReceiveBufferTuner = ReceiveBufferTuner::new(65535, max_size, 1000, SeqNumber::from(0), start);
+        let rtt: Option<Duration> = Some(Duration::from_millis(10));
+
+        // Nothing happens without a round-trip time estimate, or within a round trip.
+        assert_eq!(tuner.on_read(SeqNumber::from(20000), 65535, None, ms(10)), None);
+        assert_eq!(tuner.on_read(SeqNumber::from(20000), 65535, rtt, ms(5)), None);
+
+        // The application consumed 20 kB in a round trip, twice the initial window, so the buffer grows to twice that
+        // plus headroom, and more since consumption doubled.
+        let size: u32 = tuner.on_read(SeqNumber::from(20000), 65535, rtt, ms(10)).unwrap();
+        assert_eq!(size, (2 * 20000 + 16 * 1000) * 3);
+
+        // Consuming less than in the last round trip doesn't grow the buffer, nor does it shrink it.
+        assert_eq!(tuner.on_read(SeqNumber::from(30000), size, rtt, ms(20)), None);
+
+        // Consumption keeps growing, but the buffer doesn't grow past its maximum size.
+        let mut reader_next: u32 = 30000;
+        let mut size: u32 = size;
+        let mut copied: u32 = 40000;
+        for i in 3..20 {
+            reader_next += copied;
+            if let Some(new_size) = tuner.on_read(SeqNumber::from(reader_next), size, rtt, ms(10 * i)) {
+                assert!(new_size > size);
+                size = new_size;
+            }
+            copied = size;
+        }
+        assert_eq!(size, max_size);
+    }
+}
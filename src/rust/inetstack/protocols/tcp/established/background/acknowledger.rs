@@ -32,7 +32,11 @@ pub async fn acknowledger(cb: Rc<ControlBlock>) -> Result<!, Fail> {
         futures::select_biased! {
             _ = ack_deadline_changed => continue,
             _ = ack_future => {
-                cb.send_ack();
+                // Corked data would go out at the end of this poll anyway, so it carries the ACK instead of a segment
+                // of its own.
+                if !(cb.is_corked() && cb.flush_unsent()) {
+                    cb.send_ack();
+                }
             },
         }
     }
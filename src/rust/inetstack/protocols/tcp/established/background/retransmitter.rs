@@ -29,6 +29,15 @@ pub async fn retransmitter(cb: Rc<ControlBlock>) -> Result<!, Fail> {
         };
         futures::pin_mut!(rtx_future);
 
+        // Pin future for loss recovery (RACK reordering and tail loss probe) timeouts.
+        let (recovery_deadline, recovery_deadline_changed) = cb.watch_recovery_deadline();
+        futures::pin_mut!(recovery_deadline_changed);
+        let recovery_future = match recovery_deadline {
+            Some(t) => Either::Left(cb.clock.wait_until(cb.clock.clone(), t).fuse()),
+            None => Either::Right(future::pending()),
+        };
+        futures::pin_mut!(recovery_future);
+
         // Pin future for fast retransmission.
         let (rtx_fast_retransmit, rtx_fast_retransmit_changed) = cb.congestion_control_watch_retransmit_now_flag();
         if rtx_fast_retransmit {
@@ -44,6 +53,11 @@ pub async fn retransmitter(cb: Rc<ControlBlock>) -> Result<!, Fail> {
         futures::select_biased! {
             _ = rtx_deadline_changed => continue,
             _ = rtx_fast_retransmit_changed => continue,
+            _ = recovery_deadline_changed => continue,
+            _ = recovery_future => {
+                trace!("Loss Recovery Timer Expired");
+                cb.loss_recovery_on_timeout();
+            },
             _ = rtx_future => {
                 trace!("Retransmission Timer Expired");
                 // Notify congestion control about RTO.
@@ -51,6 +65,7 @@ pub async fn retransmitter(cb: Rc<ControlBlock>) -> Result<!, Fail> {
                 // ToDo: Why call into ControlBlock to get SND.UNA when congestion_control_on_rto() has access to it?
                 let (send_unacknowledged, _) = cb.get_send_unacked();
                 cb.congestion_control_on_rto(send_unacknowledged);
+                cb.loss_recovery_on_rto();
 
                 // RFC 6298 Section 5.4: Retransmit earliest unacknowledged segment.
                 cb.retransmit();
@@ -19,7 +19,10 @@ use ::futures::FutureExt;
 use ::std::{
     cmp,
     rc::Rc,
-    time::Duration,
+    time::{
+        Duration,
+        Instant,
+    },
 };
 
 pub async fn sender(cb: Rc<ControlBlock>) -> Result<!, Fail> {
@@ -33,6 +36,8 @@ pub async fn sender(cb: Rc<ControlBlock>) -> Result<!, Fail> {
         futures::pin_mut!(send_next_changed);
 
         if send_next == unsent_seq {
+            // We ran out of data to send, so delivery rate samples no longer reflect what the network may deliver.
+            cb.rate_sampler_on_app_limited();
             futures::select_biased! {
                 _ = unsent_seq_changed => continue 'top,
                 _ = send_next_changed => continue 'top,
@@ -57,9 +62,12 @@ pub async fn sender(cb: Rc<ControlBlock>) -> Result<!, Fail> {
             cb.modify_send_next(|s| s + SeqNumber::from(1));
 
             // Add the probe byte (as a new separate buffer) to our unacknowledged queue.
+            let now: Instant = cb.clock.now();
             let unacked_segment = UnackedSegment {
                 bytes: buf.clone(),
-                initial_tx: Some(cb.clock.now()),
+                initial_tx: Some(now),
+                last_tx: now,
+                rate: cb.rate_snapshot(now),
             };
             cb.push_unacked_segment(unacked_segment);
 
@@ -114,55 +122,38 @@ pub async fn sender(cb: Rc<ControlBlock>) -> Result<!, Fail> {
             }
         }
 
+        // If congestion control paces our data, wait until the next segment is due.  Segments that are due within the
+        // granularity of our timer are sent right away, as we couldn't wait for them any more precisely.
+        if let Some(pacing_deadline) = cb.get_pacing_deadline() {
+            if pacing_deadline > cb.clock.now() + cb.clock.granularity() {
+                cb.clock.wait_until(cb.clock.clone(), pacing_deadline).await;
+                continue 'top;
+            }
+        }
+
+        // Hold back segments that are smaller than the MSS, so that they get coalesced with later data, if Nagle's
+        // algorithm or corking tell us to.  The end of the stream is never held back.
+        let unsent_bytes: u32 = (unsent_seq - send_next).into();
+        if (unsent_bytes as usize) < cb.get_mss() && !cb.user_is_done_sending.get() && !cb.may_send_partial(sent_data) {
+            futures::select_biased! {
+                _ = send_unacked_changed => continue 'top,
+                _ = send_next_changed => continue 'top,
+                _ = unsent_seq_changed => continue 'top,
+            }
+        }
+
         // Past this point we have data to send and it's valid to send it!
 
-        // TODO: Nagle's algorithm - We need to coalese small buffers together to send MSS sized packets.
         // TODO: Silly window syndrome - See RFC 1122's discussion of the SWS avoidance algorithm.
 
         // ToDo: Link-level concerns don't belong here, we should call an IP-level send routine below.
         let remote_link_addr = cb.arp().query(cb.get_remote().ip().clone()).await?;
 
-        // Form an outgoing packet.
+        // Form an outgoing packet. This may be larger than the MSS, in which case it gets split further down the stack.
         let max_size: usize = cmp::min(
-            cmp::min((win_sz - sent_data) as usize, cb.get_mss()),
+            cmp::min((win_sz - sent_data) as usize, cb.get_large_send_size()),
             (effective_cwnd - sent_data) as usize,
         );
-        let segment_data: DemiBuffer = cb
-            .pop_unsent_segment(max_size)
-            .expect("No unsent data with sequence number gap?");
-        let mut segment_data_len: u32 = segment_data.len() as u32;
-
-        let rto: Duration = cb.rto();
-        cb.congestion_control_on_send(rto, sent_data);
-
-        // Prepare the segment and send it.
-        let mut header: TcpHeader = cb.tcp_header();
-        header.seq_num = send_next;
-        if segment_data_len == 0 {
-            // This buffer is the end-of-send marker.
-            debug_assert!(cb.user_is_done_sending.get());
-            // Set FIN and adjust sequence number consumption accordingly.
-            header.fin = true;
-            segment_data_len = 1;
-        }
-        cb.emit(header, Some(segment_data.clone()), remote_link_addr);
-
-        // Update SND.NXT.
-        cb.modify_send_next(|s| s + SeqNumber::from(segment_data_len));
-
-        // Put this segment on the unacknowledged list.
-        let unacked_segment = UnackedSegment {
-            bytes: segment_data,
-            initial_tx: Some(cb.clock.now()),
-        };
-        cb.push_unacked_segment(unacked_segment);
-
-        // Set the retransmit timer.
-        // ToDo: Fix how the retransmit timer works.
-        let retransmit_deadline = cb.get_retransmit_deadline();
-        if retransmit_deadline.is_none() {
-            let rto: Duration = cb.rto();
-            cb.set_retransmit_deadline(Some(cb.clock.now() + rto));
-        }
+        cb.send_unsent_segment(send_next, sent_data, max_size, remote_link_addr);
     }
 }
@@ -0,0 +1,631 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This is an implementation of BBR ("Bottleneck Bandwidth and Round-trip propagation time") congestion control, as
+// described in draft-cardwell-iccrg-bbr-congestion-control.  Rather than reacting to losses, BBR builds a model of the
+// path from delivery rate and RTT samples, paces data at the estimated bottleneck bandwidth, and caps the amount of data
+// in flight to a small multiple of the bandwidth-delay product (BDP).
+//
+// The state machine and the model are the ones of BBRv1.  From BBRv2, we take the reaction to losses: a loss caps the
+// amount of data in flight (inflight_hi) below what was in flight when it happened, and the cap is only raised again,
+// exponentially, while probing for more bandwidth.
+// ToDo: Use the ECN and loss rate signals of BBRv2, and its separate short-term model (bw_lo/inflight_lo).
+
+use super::{
+    CongestionControl,
+    FastRetransmitRecovery,
+    LimitedTransmit,
+    Options,
+    Pacing,
+    SlowStartCongestionAvoidance,
+};
+use crate::{
+    inetstack::protocols::tcp::{
+        established::rto::RateSample,
+        SeqNumber,
+    },
+    runtime::watched::{
+        WatchFuture,
+        WatchedValue,
+    },
+};
+use ::std::{
+    cell::{
+        Cell,
+        RefCell,
+    },
+    cmp::{
+        max,
+        min,
+    },
+    convert::TryInto,
+    fmt::Debug,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+enum Mode {
+    // Rapidly fills the pipe, doubling the sending rate every round trip.
+    Startup,
+    // Drains the queue that was built up during startup.
+    Drain,
+    // Cruises at the estimated bandwidth, periodically probing for more.
+    ProbeBw,
+    // Briefly drains the pipe to measure the round-trip propagation time.
+    ProbeRtt,
+}
+
+#[derive(Debug)]
+pub struct Bbr {
+    pub mss: u32, // Just for convenience, otherwise we have `as u32` or `.try_into().unwrap()` scattered everywhere...
+    pub cwnd: WatchedValue<u32>, // Congestion window: Max number of bytes that may be in flight.
+    mode: Cell<Mode>, // Current state of the state machine.
+    pacing_rate: Cell<f64>, // Rate (in bytes per second) at which data is sent, or zero before the first sample.
+    pacing_gain: Cell<f64>, // Multiplier of the estimated bandwidth, used to compute the pacing rate.
+    cwnd_gain: Cell<f64>, // Multiplier of the estimated BDP, used to compute the congestion window.
+
+    // Path Model.
+    bw_samples: RefCell<[f64; Self::BW_FILTER_ROUNDS]>, // Highest delivery rate seen in each of the last rounds.
+    min_rtt: Cell<Option<Duration>>,                    // Lowest RTT seen in the last MIN_RTT_FILTER_LENGTH.
+    min_rtt_stamp: Cell<Instant>,                       // The time at which min_rtt was last measured.
+
+    // Round Counting.
+    round_count: Cell<u64>,          // Number of round trips since the connection started.
+    next_round_delivered: Cell<u64>, // Amount of delivered data which, once acknowledged, ends the current round.
+
+    // Startup State.
+    filled_pipe: Cell<bool>, // Whether the bandwidth estimate has stopped growing during startup.
+    full_bw: Cell<f64>,      // The bandwidth estimate when it last grew significantly.
+    full_bw_count: Cell<u32>, // Number of rounds without significant growth of the bandwidth estimate.
+
+    // ProbeBW State.
+    cycle_index: Cell<usize>,   // Current phase of the gain cycle.
+    cycle_stamp: Cell<Instant>, // The time at which the current phase started.
+
+    // ProbeRTT State.
+    probe_rtt_done_stamp: Cell<Option<Instant>>, // The time at which ProbeRTT may end.
+    prior_cwnd: Cell<u32>,                       // The congestion window before ProbeRTT or a timeout.
+
+    // Loss Response.
+    inflight_hi: Cell<u32>,        // Upper bound of data in flight, set on loss.
+    loss_in_round: Cell<bool>,     // Whether a loss was detected in the current round.
+    probe_up_increment: Cell<u32>, // Amount by which inflight_hi is raised in the next round of bandwidth probing.
+
+    // Fast Recovery / Fast Retransmit State
+    pub duplicate_ack_count: Cell<u32>, // The number of consecutive duplicate ACKs we've received.
+    pub fast_retransmit_now: WatchedValue<bool>, // Flag to cause the retransmitter to retransmit a segment now.
+    pub in_fast_recovery: Cell<bool>,   // Are we currently in the `fast recovery` algorithm.
+    pub recover: Cell<SeqNumber>,       // Highest sequence number sent when fast recovery was entered.
+}
+
+impl CongestionControl for Bbr {
+    fn new(mss: usize, seq_no: SeqNumber, _options: Option<Options>) -> Box<dyn CongestionControl> {
+        Box::new(Self::with_mss(mss.try_into().unwrap(), seq_no, Instant::now()))
+    }
+}
+
+impl Bbr {
+    // Multiplicative decrease of the data in flight on loss (BBRv2's beta).
+    const BETA: f64 = 0.7;
+    // Number of rounds over which the bandwidth estimate is the highest delivery rate.
+    const BW_FILTER_ROUNDS: usize = 10;
+    // Gain applied to the BDP to compute the congestion window in ProbeBW, to tolerate delayed and stretched ACKs.
+    const CWND_GAIN: f64 = 2.0;
+    const DUP_ACK_THRESHOLD: u32 = 3;
+    // Number of rounds without significant growth of the bandwidth estimate, after which the pipe is deemed full.
+    const FULL_BW_ROUNDS: u32 = 3;
+    // Growth of the bandwidth estimate which is deemed significant.
+    const FULL_BW_THRESHOLD: f64 = 1.25;
+    // Gain used in startup, to double the sending rate every round trip (2/ln(2)).
+    const HIGH_GAIN: f64 = 2.885;
+    // Initial congestion window (in segments), as in RFC 6928.
+    const INITIAL_CWND_SEGMENTS: u32 = 10;
+    // Minimal congestion window (in segments), which is used in ProbeRTT.
+    const MIN_CWND_SEGMENTS: u32 = 4;
+    // Period over which the RTT estimate is the lowest RTT.
+    const MIN_RTT_FILTER_LENGTH: Duration = Duration::from_secs(10);
+    // Gains of the phases of ProbeBW: probe for more bandwidth, drain the resulting queue, then cruise.
+    const PACING_GAIN_CYCLE: [f64; 8] = [1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0];
+    // Time spent with a minimal window in ProbeRTT.
+    const PROBE_RTT_DURATION: Duration = Duration::from_millis(200);
+
+    fn with_mss(mss: u32, seq_no: SeqNumber, now: Instant) -> Self {
+        Self {
+            mss,
+            cwnd: WatchedValue::new(Self::INITIAL_CWND_SEGMENTS * mss),
+            mode: Cell::new(Mode::Startup),
+            pacing_rate: Cell::new(0.0),
+            pacing_gain: Cell::new(Self::HIGH_GAIN),
+            cwnd_gain: Cell::new(Self::HIGH_GAIN),
+
+            bw_samples: RefCell::new([0.0; Self::BW_FILTER_ROUNDS]),
+            min_rtt: Cell::new(None),
+            min_rtt_stamp: Cell::new(now),
+
+            round_count: Cell::new(0),
+            next_round_delivered: Cell::new(0),
+
+            filled_pipe: Cell::new(false),
+            full_bw: Cell::new(0.0),
+            full_bw_count: Cell::new(0),
+
+            cycle_index: Cell::new(0),
+            cycle_stamp: Cell::new(now),
+
+            probe_rtt_done_stamp: Cell::new(None),
+            prior_cwnd: Cell::new(0),
+
+            inflight_hi: Cell::new(u32::MAX),
+            loss_in_round: Cell::new(false),
+            probe_up_increment: Cell::new(mss),
+
+            duplicate_ack_count: Cell::new(0),
+            fast_retransmit_now: WatchedValue::new(false),
+            in_fast_recovery: Cell::new(false),
+            recover: Cell::new(seq_no), // Like in RFC6582, so the first dup ACKs may trigger fast recovery.
+        }
+    }
+
+    // Returns the estimated bottleneck bandwidth (in bytes per second).
+    fn max_bw(&self) -> f64 {
+        self.bw_samples.borrow().iter().cloned().fold(0.0, f64::max)
+    }
+
+    // Returns `gain` times the estimated BDP (in bytes), or the initial window while we know nothing about the path.
+    fn bdp(&self, gain: f64) -> u32 {
+        match self.min_rtt.get() {
+            Some(min_rtt) if self.max_bw() > 0.0 => (gain * self.max_bw() * min_rtt.as_secs_f64()) as u32,
+            _ => (gain * (Self::INITIAL_CWND_SEGMENTS * self.mss) as f64) as u32,
+        }
+    }
+
+    fn min_cwnd(&self) -> u32 {
+        Self::MIN_CWND_SEGMENTS * self.mss
+    }
+
+    // Starts a new round when the data sent at the start of the current one gets delivered.
+    fn update_round(&self, sample: &RateSample) -> bool {
+        if sample.prior_delivered < self.next_round_delivered.get() {
+            return false;
+        }
+        self.next_round_delivered.set(sample.total_delivered);
+        let round_count: u64 = self.round_count.get() + 1;
+        self.round_count.set(round_count);
+        self.bw_samples.borrow_mut()[round_count as usize % Self::BW_FILTER_ROUNDS] = 0.0;
+        true
+    }
+
+    fn update_bw(&self, sample: &RateSample) {
+        // Application-limited samples underestimate the bandwidth, so they only count when they show more of it.
+        if !sample.is_app_limited || sample.delivery_rate >= self.max_bw() {
+            let mut bw_samples = self.bw_samples.borrow_mut();
+            let slot: &mut f64 = &mut bw_samples[self.round_count.get() as usize % Self::BW_FILTER_ROUNDS];
+            *slot = slot.max(sample.delivery_rate);
+        }
+    }
+
+    // Updates the RTT estimate, and returns whether it expired.
+    fn update_min_rtt(&self, sample: &RateSample, now: Instant) -> bool {
+        let expired: bool = now > self.min_rtt_stamp.get() + Self::MIN_RTT_FILTER_LENGTH;
+        if let Some(rtt) = sample.rtt {
+            if expired || self.min_rtt.get().map_or(true, |min_rtt| rtt <= min_rtt) {
+                self.min_rtt.set(Some(rtt));
+                self.min_rtt_stamp.set(now);
+            }
+        }
+        expired
+    }
+
+    fn check_full_pipe(&self, sample: &RateSample, round_start: bool) {
+        if self.filled_pipe.get() || !round_start || sample.is_app_limited {
+            return;
+        }
+        let max_bw: f64 = self.max_bw();
+        if max_bw >= self.full_bw.get() * Self::FULL_BW_THRESHOLD {
+            // Still growing.
+            self.full_bw.set(max_bw);
+            self.full_bw_count.set(0);
+            return;
+        }
+        let full_bw_count: u32 = self.full_bw_count.get() + 1;
+        self.full_bw_count.set(full_bw_count);
+        if full_bw_count >= Self::FULL_BW_ROUNDS {
+            self.filled_pipe.set(true);
+        }
+    }
+
+    fn enter_probe_bw(&self, now: Instant) {
+        self.mode.set(Mode::ProbeBw);
+        self.cwnd_gain.set(Self::CWND_GAIN);
+        // Start cruising, as the queue built up before (if any) was just drained.
+        // ToDo: Pick the starting phase at random, so that flows sharing a bottleneck don't probe in lockstep.
+        self.cycle_index.set(2);
+        self.cycle_stamp.set(now);
+        self.pacing_gain.set(Self::PACING_GAIN_CYCLE[2]);
+    }
+
+    fn advance_cycle_phase(&self, sample: &RateSample, now: Instant) {
+        let pacing_gain: f64 = self.pacing_gain.get();
+        let min_rtt: Duration = self.min_rtt.get().unwrap_or(Duration::ZERO);
+        let is_full_length: bool = now.saturating_duration_since(self.cycle_stamp.get()) >= min_rtt;
+        let advance: bool = if pacing_gain > 1.0 {
+            // Probe for at least a round trip, until either the pipe or our window is full, or losses show up.
+            is_full_length
+                && (self.loss_in_round.get()
+                    || sample.in_flight >= self.bdp(pacing_gain)
+                    || sample.in_flight >= self.inflight_hi.get())
+        } else if pacing_gain < 1.0 {
+            // Drain the queue built up while probing, for up to a round trip.
+            is_full_length || sample.in_flight <= self.bdp(1.0)
+        } else {
+            is_full_length
+        };
+        if advance {
+            let cycle_index: usize = (self.cycle_index.get() + 1) % Self::PACING_GAIN_CYCLE.len();
+            self.cycle_index.set(cycle_index);
+            self.cycle_stamp.set(now);
+            self.pacing_gain.set(Self::PACING_GAIN_CYCLE[cycle_index]);
+            self.probe_up_increment.set(self.mss);
+        }
+    }
+
+    fn enter_probe_rtt(&self) {
+        self.mode.set(Mode::ProbeRtt);
+        self.pacing_gain.set(1.0);
+        self.cwnd_gain.set(1.0);
+        self.prior_cwnd.set(max(self.prior_cwnd.get(), self.cwnd.get()));
+        self.probe_rtt_done_stamp.set(None);
+    }
+
+    fn handle_probe_rtt(&self, sample: &RateSample, now: Instant) {
+        match self.probe_rtt_done_stamp.get() {
+            None if sample.in_flight <= self.min_cwnd() => {
+                self.probe_rtt_done_stamp.set(Some(now + Self::PROBE_RTT_DURATION));
+            },
+            Some(done_stamp) if now >= done_stamp => {
+                // The pipe was drained long enough to measure the round-trip propagation time.
+                self.min_rtt_stamp.set(now);
+                self.set_cwnd(max(self.cwnd.get(), self.prior_cwnd.get()));
+                self.prior_cwnd.set(0);
+                if self.filled_pipe.get() {
+                    self.enter_probe_bw(now);
+                } else {
+                    self.mode.set(Mode::Startup);
+                    self.pacing_gain.set(Self::HIGH_GAIN);
+                    self.cwnd_gain.set(Self::HIGH_GAIN);
+                }
+            },
+            _ => (),
+        }
+    }
+
+    fn update_state(&self, sample: &RateSample, round_start: bool, min_rtt_expired: bool, now: Instant) {
+        self.check_full_pipe(sample, round_start);
+        match self.mode.get() {
+            Mode::Startup if self.filled_pipe.get() => {
+                self.mode.set(Mode::Drain);
+                self.pacing_gain.set(1.0 / Self::HIGH_GAIN);
+                self.cwnd_gain.set(Self::HIGH_GAIN);
+            },
+            Mode::ProbeBw => self.advance_cycle_phase(sample, now),
+            _ => (),
+        }
+        if self.mode.get() == Mode::Drain && sample.in_flight <= self.bdp(1.0) {
+            self.enter_probe_bw(now);
+        }
+
+        if min_rtt_expired && self.mode.get() != Mode::ProbeRtt {
+            self.enter_probe_rtt();
+        }
+        if self.mode.get() == Mode::ProbeRtt {
+            self.handle_probe_rtt(sample, now);
+        }
+    }
+
+    fn set_cwnd(&self, cwnd: u32) {
+        // Avoid waking up the sender when nothing changes.
+        if self.cwnd.get() != cwnd {
+            self.cwnd.set(cwnd);
+        }
+    }
+
+    fn update_pacing_rate(&self) {
+        let rate: f64 = self.pacing_gain.get() * self.max_bw();
+        // Don't slow down during startup just because a sample was low.
+        if self.filled_pipe.get() || rate > self.pacing_rate.get() {
+            self.pacing_rate.set(rate);
+        }
+    }
+
+    // Raises the cap on data in flight while probing for bandwidth without losses, doubling the increase every round.
+    fn probe_inflight_hi_upward(&self, round_start: bool) {
+        if !round_start || self.loss_in_round.get() || self.inflight_hi.get() == u32::MAX {
+            return;
+        }
+        if self.mode.get() == Mode::ProbeBw && self.pacing_gain.get() > 1.0 {
+            let increment: u32 = self.probe_up_increment.get();
+            self.inflight_hi.set(self.inflight_hi.get().saturating_add(increment));
+            self.probe_up_increment.set(increment.saturating_mul(2));
+        }
+    }
+
+    fn update_cwnd(&self, sample: &RateSample) {
+        let target: u32 = self.bdp(self.cwnd_gain.get()).saturating_add(3 * self.mss);
+        let cwnd: u32 = self.cwnd.get();
+        let newly_delivered: u32 = sample.newly_delivered.try_into().unwrap_or(u32::MAX);
+        let mut cwnd: u32 = if self.filled_pipe.get() {
+            min(cwnd.saturating_add(newly_delivered), target)
+        } else if cwnd < target || sample.total_delivered < (Self::INITIAL_CWND_SEGMENTS * self.mss) as u64 {
+            cwnd.saturating_add(newly_delivered)
+        } else {
+            cwnd
+        };
+        cwnd = max(min(cwnd, self.inflight_hi.get()), self.min_cwnd());
+        if self.mode.get() == Mode::ProbeRtt {
+            cwnd = min(cwnd, self.min_cwnd());
+        }
+        self.set_cwnd(cwnd);
+    }
+
+    // Caps the data in flight below what was in flight when a loss happened (BBRv2).
+    fn on_loss(&self, in_flight: u32) {
+        let inflight_hi: u32 = max((in_flight as f64 * Self::BETA) as u32, self.min_cwnd());
+        self.inflight_hi.set(min(self.inflight_hi.get(), inflight_hi));
+        self.loss_in_round.set(true);
+        self.probe_up_increment.set(self.mss);
+        self.set_cwnd(max(min(self.cwnd.get(), inflight_hi), self.min_cwnd()));
+    }
+
+    fn on_dup_ack_received(&self, send_unacked: SeqNumber, send_next: SeqNumber, ack_seq_no: SeqNumber) {
+        let duplicate_ack_count: u32 = self.duplicate_ack_count.get() + 1;
+        self.duplicate_ack_count.set(duplicate_ack_count);
+        // Check against recover specified in RFC6582, so we don't react twice to losses in the same flight.
+        if duplicate_ack_count == Self::DUP_ACK_THRESHOLD
+            && !self.in_fast_recovery.get()
+            && ack_seq_no >= self.recover.get()
+        {
+            self.in_fast_recovery.set(true);
+            self.recover.set(send_next);
+            self.on_loss((send_next - send_unacked).into());
+            self.fast_retransmit_now.set(true);
+        }
+    }
+}
+
+impl SlowStartCongestionAvoidance for Bbr {
+    fn get_cwnd(&self) -> u32 {
+        self.cwnd.get()
+    }
+
+    fn watch_cwnd(&self) -> (u32, WatchFuture<'_, u32>) {
+        self.cwnd.watch()
+    }
+
+    fn on_ack_received(&self, _rto: Duration, send_unacked: SeqNumber, send_next: SeqNumber, ack_seq_no: SeqNumber) {
+        if ack_seq_no == send_unacked {
+            // ACK is a duplicate, if we have some data in flight.
+            if send_next != send_unacked {
+                self.on_dup_ack_received(send_unacked, send_next, ack_seq_no);
+            }
+        } else {
+            self.duplicate_ack_count.set(0);
+            if self.in_fast_recovery.get() {
+                if ack_seq_no >= self.recover.get() {
+                    // Full acknowledgement.
+                    self.in_fast_recovery.set(false);
+                } else {
+                    // Partial acknowledgement: retransmit the next hole.
+                    self.fast_retransmit_now.set(true);
+                }
+            }
+        }
+    }
+
+    fn on_rto(&self, send_unacked: SeqNumber) {
+        // Everything in flight is deemed lost.  Start over from a minimal window, which grows back as data gets
+        // delivered again.
+        self.prior_cwnd.set(max(self.prior_cwnd.get(), self.cwnd.get()));
+        self.on_loss(self.cwnd.get());
+        self.set_cwnd(self.mss);
+        self.recover.set(send_unacked);
+        self.in_fast_recovery.set(false);
+    }
+
+    fn on_rate_sample(&self, sample: &RateSample, now: Instant) {
+        let round_start: bool = self.update_round(sample);
+        if round_start {
+            self.probe_inflight_hi_upward(round_start);
+            self.loss_in_round.set(false);
+        }
+        self.update_bw(sample);
+        let min_rtt_expired: bool = self.update_min_rtt(sample, now);
+        self.update_state(sample, round_start, min_rtt_expired, now);
+        self.update_pacing_rate();
+        self.update_cwnd(sample);
+    }
+}
+
+impl FastRetransmitRecovery for Bbr {
+    fn get_duplicate_ack_count(&self) -> u32 {
+        self.duplicate_ack_count.get()
+    }
+
+    fn get_retransmit_now_flag(&self) -> bool {
+        self.fast_retransmit_now.get()
+    }
+
+    fn watch_retransmit_now_flag(&self) -> (bool, WatchFuture<'_, bool>) {
+        self.fast_retransmit_now.watch()
+    }
+
+    fn on_fast_retransmit(&self) {
+        self.fast_retransmit_now.set_without_notify(false);
+    }
+}
+
+impl LimitedTransmit for Bbr {}
+
+impl Pacing for Bbr {
+    fn get_pacing_rate(&self) -> Option<f64> {
+        let pacing_rate: f64 = self.pacing_rate.get();
+        if pacing_rate > 0.0 {
+            Some(pacing_rate)
+        } else {
+            None
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        Bbr,
+        Mode,
+    };
+    use crate::inetstack::protocols::tcp::{
+        established::{
+            congestion_control::{
+                FastRetransmitRecovery,
+                Pacing,
+                SlowStartCongestionAvoidance,
+            },
+            rto::RateSample,
+        },
+        SeqNumber,
+    };
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    const MSS: u32 = 1000;
+    const RTT: Duration = Duration::from_millis(10);
+    // Bottleneck bandwidth (in bytes per second), i.e. a BDP of 100 segments.
+    const BW: f64 = 10_000_000.0;
+
+    // Path between a BBR sender and its peer, through a bottleneck of BW bytes per second.
+    struct Path {
+        now: Instant,
+        delivered: u64,
+    }
+
+    impl Path {
+        // Delivers a full flight of data in a round trip, with `in_flight` bytes left in flight at the end of it.
+        fn deliver_round(&mut self, bbr: &Bbr, in_flight: u32) {
+            let flight: u32 = bbr.get_cwnd();
+            self.now += RTT;
+            let sample: RateSample = RateSample {
+                delivery_rate: BW.min(flight as f64 / RTT.as_secs_f64()),
+                rtt: Some(RTT),
+                delivered: flight as u64,
+                prior_delivered: self.delivered,
+                total_delivered: self.delivered + flight as u64,
+                newly_delivered: flight as u64,
+                in_flight,
+                is_app_limited: false,
+                interval: RTT,
+            };
+            self.delivered += flight as u64;
+            bbr.on_rate_sample(&sample, self.now);
+        }
+    }
+
+    // Runs startup until it fills the pipe, then drains the queue.
+    fn fill_pipe(bbr: &Bbr, path: &mut Path) {
+        for _ in 0..20 {
+            path.deliver_round(bbr, bbr.get_cwnd());
+            if bbr.mode.get() != Mode::Startup {
+                break;
+            }
+        }
+        assert_eq!(bbr.mode.get(), Mode::Drain);
+        assert_eq!(bbr.max_bw(), BW);
+        assert_eq!(bbr.min_rtt.get(), Some(RTT));
+        assert!(bbr.get_pacing_rate().unwrap() < BW);
+
+        path.deliver_round(bbr, 50 * MSS);
+        assert_eq!(bbr.mode.get(), Mode::ProbeBw);
+    }
+
+    #[test]
+    fn startup_fills_pipe_then_cruises() {
+        let now: Instant = Instant::now();
+        let bbr: Bbr = Bbr::with_mss(MSS, SeqNumber::from(0), now);
+        let mut path: Path = Path { now, delivered: 0 };
+        assert_eq!(bbr.get_cwnd(), Bbr::INITIAL_CWND_SEGMENTS * MSS);
+        assert_eq!(bbr.get_pacing_rate(), None);
+
+        fill_pipe(&bbr, &mut path);
+
+        // Cruise at the bottleneck bandwidth, with twice the BDP in flight.
+        assert_eq!(bbr.get_pacing_rate(), Some(BW));
+        path.deliver_round(&bbr, 100 * MSS);
+        assert_eq!(bbr.get_cwnd(), 203 * MSS);
+
+        // Probe for more bandwidth once in a while.
+        let mut probed: bool = false;
+        for _ in 0..8 {
+            path.deliver_round(&bbr, 130 * MSS);
+            probed |= bbr.get_pacing_rate() == Some(1.25 * BW);
+        }
+        assert!(probed);
+    }
+
+    #[test]
+    fn loss_caps_inflight() {
+        let now: Instant = Instant::now();
+        let bbr: Bbr = Bbr::with_mss(MSS, SeqNumber::from(0), now);
+        let rto: Duration = Duration::from_secs(1);
+        let send_unacked: SeqNumber = SeqNumber::from(0);
+        let send_next: SeqNumber = SeqNumber::from(8 * MSS);
+
+        // Three duplicate ACKs trigger a fast retransmit, and cut the data in flight.
+        for _ in 0..3 {
+            assert!(!bbr.get_retransmit_now_flag());
+            bbr.on_ack_received(rto, send_unacked, send_next, send_unacked);
+        }
+        assert!(bbr.get_retransmit_now_flag());
+        assert_eq!(bbr.inflight_hi.get(), (8.0 * MSS as f64 * Bbr::BETA) as u32);
+        assert_eq!(bbr.get_cwnd(), bbr.inflight_hi.get());
+        bbr.on_fast_retransmit();
+        assert!(!bbr.get_retransmit_now_flag());
+
+        // More duplicate ACKs don't cut it again, and a full acknowledgement ends recovery.
+        bbr.on_ack_received(rto, send_unacked, send_next, send_unacked);
+        assert!(!bbr.get_retransmit_now_flag());
+        bbr.on_ack_received(rto, send_unacked, send_next, send_next);
+        assert!(!bbr.in_fast_recovery.get());
+
+        // The window doesn't grow beyond the cap, until we probe for more bandwidth without further losses.
+        let mut path: Path = Path { now, delivered: 0 };
+        for _ in 0..5 {
+            path.deliver_round(&bbr, bbr.get_cwnd());
+            assert!(bbr.get_cwnd() <= bbr.inflight_hi.get());
+        }
+    }
+
+    #[test]
+    fn probe_rtt_after_min_rtt_expires() {
+        let now: Instant = Instant::now();
+        let bbr: Bbr = Bbr::with_mss(MSS, SeqNumber::from(0), now);
+        let mut path: Path = Path { now, delivered: 0 };
+        fill_pipe(&bbr, &mut path);
+        let cwnd: u32 = bbr.get_cwnd();
+
+        // Without a lower RTT for a while, drain the pipe to measure it again.
+        path.now += Bbr::MIN_RTT_FILTER_LENGTH;
+        path.deliver_round(&bbr, 100 * MSS);
+        assert_eq!(bbr.mode.get(), Mode::ProbeRtt);
+        assert_eq!(bbr.get_cwnd(), Bbr::MIN_CWND_SEGMENTS * MSS);
+
+        path.deliver_round(&bbr, 4 * MSS);
+        assert_eq!(bbr.mode.get(), Mode::ProbeRtt);
+        path.now += Bbr::PROBE_RTT_DURATION;
+        path.deliver_round(&bbr, 4 * MSS);
+        assert_eq!(bbr.mode.get(), Mode::ProbeBw);
+        assert!(bbr.get_cwnd() >= cwnd);
+    }
+}
@@ -14,6 +14,7 @@ use super::{
     FastRetransmitRecovery,
     LimitedTransmit,
     Options,
+    Pacing,
     SlowStartCongestionAvoidance,
 };
 use crate::{
@@ -360,3 +361,5 @@ impl LimitedTransmit for Cubic {
         self.limited_transmit_cwnd_increase.watch()
     }
 }
+
+impl Pacing for Cubic {}
@@ -1,20 +1,29 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod bbr;
 mod cubic;
 mod none;
 mod options;
 
+use super::rto::RateSample;
 use crate::{
     inetstack::protocols::tcp::SeqNumber,
-    runtime::watched::WatchFuture,
+    runtime::{
+        network::config::TcpCongestionControl,
+        watched::WatchFuture,
+    },
 };
 use ::std::{
     fmt::Debug,
-    time::Duration,
+    time::{
+        Duration,
+        Instant,
+    },
 };
 
 pub use self::{
+    bbr::Bbr,
     cubic::Cubic,
     none::None,
     options::{
@@ -42,6 +51,9 @@ pub trait SlowStartCongestionAvoidance {
 
     // Called immediately before a segment is sent for the 1st time.
     fn on_send(&self, _rto: Duration, _num_sent_bytes: u32) {}
+
+    // Called after an ACK that delivered new data has been processed, with a sample of the delivery rate.
+    fn on_rate_sample(&self, _sample: &RateSample, _now: Instant) {}
 }
 
 pub trait FastRetransmitRecovery
@@ -74,10 +86,31 @@ where
     }
 }
 
-pub trait CongestionControl: SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Debug {
+pub trait Pacing
+where
+    Self: SlowStartCongestionAvoidance,
+{
+    // Rate (in bytes per second) at which data should be sent, or `None` if sending should not be paced.
+    fn get_pacing_rate(&self) -> Option<f64> {
+        Option::None
+    }
+}
+
+pub trait CongestionControl:
+    SlowStartCongestionAvoidance + FastRetransmitRecovery + LimitedTransmit + Pacing + Debug
+{
     fn new(mss: usize, seq_no: SeqNumber, options: Option<options::Options>) -> Box<dyn CongestionControl>
     where
         Self: Sized;
 }
 
 pub type CongestionControlConstructor = fn(usize, SeqNumber, Option<options::Options>) -> Box<dyn CongestionControl>;
+
+/// Returns the constructor of the congestion control algorithm `algorithm`.
+pub fn constructor(algorithm: TcpCongestionControl) -> CongestionControlConstructor {
+    match algorithm {
+        TcpCongestionControl::None => None::new,
+        TcpCongestionControl::Cubic => Cubic::new,
+        TcpCongestionControl::Bbr => Bbr::new,
+    }
+}
@@ -6,6 +6,7 @@ use super::{
     FastRetransmitRecovery,
     LimitedTransmit,
     Options,
+    Pacing,
     SlowStartCongestionAvoidance,
 };
 use crate::inetstack::protocols::tcp::SeqNumber;
@@ -24,3 +25,4 @@ impl CongestionControl for None {
 impl SlowStartCongestionAvoidance for None {}
 impl FastRetransmitRecovery for None {}
 impl LimitedTransmit for None {}
+impl Pacing for None {}
@@ -2,11 +2,19 @@
 // Licensed under the MIT license.
 
 use super::{
+    autotune::ReceiveBufferTuner,
     congestion_control::{
         self,
         CongestionControlConstructor,
     },
-    rto::RtoCalculator,
+    reassembly::{
+        ReassemblyQueue,
+        MAX_SACK_BLOCKS,
+    },
+    rto::{
+        RateSnapshot,
+        RtoCalculator,
+    },
     sender::{
         Sender,
         UnackedSegment,
@@ -22,22 +30,36 @@ use crate::{
         ip::IpProtocol,
         ipv4::Ipv4Header,
         tcp::{
+            large_segment::{
+                self,
+                TcpTsoSegment,
+            },
             segment::{
+                SelectiveAcknowlegement,
                 TcpHeader,
+                TcpOptions2,
                 TcpSegment,
             },
             SeqNumber,
         },
     },
+    pal::arch,
+    perftools::stats,
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
         network::{
             config::TcpConfig,
-            types::MacAddress,
+            consts::MAX_LARGE_SEND_SIZE,
+            types::{
+                MacAddress,
+                SocketOption,
+            },
             NetworkRuntime,
+            PacketBuf,
         },
         timer::TimerRc,
+        types::DEMI_SGARRAY_MAXLEN,
         watched::{
             WatchFuture,
             WatchedValue,
@@ -50,6 +72,7 @@ use ::std::{
         Cell,
         RefCell,
     },
+    cmp,
     collections::VecDeque,
     convert::TryInto,
     net::SocketAddrV4,
@@ -71,11 +94,6 @@ use ::std::{
 // mechanism used to manage the receive queue (a VecDeque) than anything else.
 const RECV_QUEUE_SZ: usize = 2048;
 
-// ToDo: Review this value (and its purpose).  It (16 segments) seems awfully small (would make fast retransmit less
-// useful), and this mechanism isn't the best way to protect ourselves against deliberate out-of-order segment attacks.
-// Ideally, we'd limit out-of-order data to that which (along with the unread data) will fit in the receive window.
-const MAX_OUT_OF_ORDER: usize = 16;
-
 // TCP Connection State.
 // Note: This ControlBlock structure is only used after we've reached the ESTABLISHED state, so states LISTEN,
 // SYN_RCVD, and SYN_SENT aren't included here.
@@ -91,7 +109,9 @@ pub enum State {
     Closed,
 }
 
+// Receive-side state that is read or written for every segment that we receive, packed in a cache line of its own.
 // ToDo: Consider incorporating this directly into ControlBlock.
+#[repr(align(64))]
 struct Receiver {
     //
     // Receive Sequence Space:
@@ -113,15 +133,34 @@ struct Receiver {
     // Sequence number of the next byte of data (or FIN) that we expect to receive.  In RFC 793 terms, this is RCV.NXT.
     pub receive_next: Cell<SeqNumber>,
 
+    // This is our receive buffer size, which is also the maximum size of our receive window.
+    // Note: The maximum possible advertised window is 1 GiB with window scaling and 64 KiB without.
+    pub receive_buffer_size: Cell<u32>,
+
+    // ToDo: Review how this is used.  We could have separate window scale factors, so there should be one for the
+    // receiver and one for the sender.
+    // This is the receive-side window scale factor.
+    // This is the number of bits to shift to convert to/from the scaled value, and has a maximum value of 14.
+    // ToDo: Keep this as a u8?
+    pub window_scale: u32,
+
     // Receive queue.  Contains in-order received (and acknowledged) data ready for the application to read.
     recv_queue: RefCell<VecDeque<DemiBuffer>>,
 }
 
+// Check at compile time that the receive-side state fits in a single cache line.  Note that alignment must be specified
+// via a literal value in #[repr(align(64))] above, so if the alignment assert is firing, change the value in the
+// align() to match CPU_DATA_CACHE_LINE_SIZE.
+const _: () = assert!(std::mem::align_of::<Receiver>() == arch::CPU_DATA_CACHE_LINE_SIZE);
+const _: () = assert!(std::mem::size_of::<Receiver>() == arch::CPU_DATA_CACHE_LINE_SIZE);
+
 impl Receiver {
-    pub fn new(reader_next: SeqNumber, receive_next: SeqNumber) -> Self {
+    pub fn new(reader_next: SeqNumber, receive_next: SeqNumber, receive_buffer_size: u32, window_scale: u32) -> Self {
         Self {
             reader_next: Cell::new(reader_next),
             receive_next: Cell::new(receive_next),
+            receive_buffer_size: Cell::new(receive_buffer_size),
+            window_scale,
             recv_queue: RefCell::new(VecDeque::with_capacity(RECV_QUEUE_SZ)),
         }
     }
@@ -134,6 +173,14 @@ impl Receiver {
         Some(buf)
     }
 
+    // Pops the buffer at the front of the receive queue, if it meets the given condition.
+    pub fn pop_if<F: FnOnce(&DemiBuffer) -> bool>(&self, condition: F) -> Option<DemiBuffer> {
+        if !condition(self.recv_queue.borrow().front()?) {
+            return None;
+        }
+        self.pop()
+    }
+
     pub fn push(&self, buf: DemiBuffer) {
         let buf_len: u32 = buf.len() as u32;
         self.recv_queue.borrow_mut().push_back(buf);
@@ -143,6 +190,11 @@ impl Receiver {
 }
 
 /// Transmission control block for representing our TCP connection.
+///
+/// Every segment that we send or receive goes through this structure, so keep it compact: settings are copied out of
+/// the [TcpConfig] when they are needed on the data path, rather than keeping the whole configuration around, and
+/// state that is only used on some connections is kept out of line.  The receive-side state that is touched by every
+/// segment sits in a cache line of its own (see [ControlBlock::prefetch]).
 // ToDo: Make all public fields in this structure private.
 pub struct ControlBlock {
     local: SocketAddrV4,
@@ -152,7 +204,18 @@ pub struct ControlBlock {
     pub scheduler: Scheduler,
     pub clock: TimerRc,
     local_link_addr: MacAddress,
-    tcp_config: TcpConfig,
+
+    // Whether the NIC computes the checksum of the segments that we send.
+    tx_checksum_offload: bool,
+
+    // Whether the NIC splits the segments that we send into MSS-sized ones.
+    tx_segmentation_offload: bool,
+
+    // Whether a pop hands over everything that has been received at once (see TcpConfig::get_multi_segment_pop).
+    multi_segment_pop: bool,
+
+    // Maximum amount of data that may be handed down to emit at once (see TcpConfig::get_large_send_size).
+    large_send_size: usize,
 
     // ToDo: We shouldn't be keeping anything datalink-layer specific at this level.  The IP layer should be holding
     // this along with other remote IP information (such as routing, path MTU, etc).
@@ -168,24 +231,20 @@ pub struct ControlBlock {
 
     ack_deadline: WatchedValue<Option<Instant>>,
 
-    // This is our receive buffer size, which is also the maximum size of our receive window.
-    // Note: The maximum possible advertised window is 1 GiB with window scaling and 64 KiB without.
-    receive_buffer_size: u32,
+    // Receive buffer autotuning, if enabled.  This grows receive_buffer_size as the application consumes data faster.
+    // It is disabled by default, so it is kept out of line.
+    receive_buffer_tuner: Option<Box<RefCell<ReceiveBufferTuner>>>,
 
-    // ToDo: Review how this is used.  We could have separate window scale factors, so there should be one for the
-    // receiver and one for the sender.
-    // This is the receive-side window scale factor.
-    // This is the number of bits to shift to convert to/from the scaled value, and has a maximum value of 14.
-    // ToDo: Keep this as a u8?
-    window_scale: u32,
+    // Whether our peer sent the SACK-permitted option in its SYN, i.e. whether we may send SACK blocks to it.
+    sack_permitted: bool,
 
     waker: RefCell<Option<Waker>>,
 
     // Queue of out-of-order segments.  This is where we hold onto data that we've received (because it was within our
     // receive window) but can't yet present to the user because we're missing some other data that comes between this
-    // and what we've already presented to the user.
+    // and what we've already presented to the user.  We also describe this data to our peer in SACK blocks.
     //
-    out_of_order: RefCell<VecDeque<(SeqNumber, DemiBuffer)>>,
+    out_of_order: RefCell<ReassemblyQueue>,
 
     // The sequence number of the FIN, if we received it out-of-order.
     // Note: This could just be a boolean to remember if we got a FIN; the sequence number is for checking correctness.
@@ -207,6 +266,19 @@ pub struct ControlBlock {
 
     // Retransmission Timeout (RTO) calculator.
     rto_calculator: RefCell<RtoCalculator>,
+
+    // Expiration time of the loss recovery timer, which is either the RACK reordering timer or the tail loss probe
+    // timer (see recovery.rs).
+    recovery_deadline: WatchedValue<Option<Instant>>,
+
+    // Earliest time at which the next segment may be sent, if congestion control paces our data.
+    pacing_deadline: Cell<Option<Instant>>,
+
+    // Whether small segments are sent right away (TCP_NODELAY), instead of following Nagle's algorithm.
+    nodelay: Cell<bool>,
+
+    // Whether small segments are held back until the connection is flushed (TCP_CORK).
+    cork: Cell<bool>,
 }
 
 //==============================================================================
@@ -229,10 +301,35 @@ impl ControlBlock {
         sender_window_size: u32,
         sender_window_scale: u8,
         sender_mss: usize,
+        sack_permitted: bool,
         cc_constructor: CongestionControlConstructor,
         congestion_control_options: Option<congestion_control::Options>,
     ) -> Self {
-        let sender = Sender::new(sender_seq_no, sender_window_size, sender_window_scale, sender_mss);
+        // Each extra bit of window scale doubles the largest window that we can advertise.
+        let receive_buffer_max_size: u32 = cmp::min(
+            tcp_config.get_receive_buffer_max_size(),
+            (u16::max_value() as u32) << receiver_window_scale,
+        );
+        let receive_buffer_tuner: Option<Box<RefCell<ReceiveBufferTuner>>> =
+            if tcp_config.get_receive_buffer_autotuning() && receive_buffer_max_size > receiver_window_size {
+                Some(Box::new(RefCell::new(ReceiveBufferTuner::new(
+                    receiver_window_size,
+                    receive_buffer_max_size,
+                    tcp_config.get_advertised_mss() as u32,
+                    receiver_seq_no,
+                    clock.now(),
+                ))))
+            } else {
+                None
+            };
+        let sender = Sender::new(
+            sender_seq_no,
+            sender_window_size,
+            sender_window_scale,
+            sender_mss,
+            tcp_config.get_loss_recovery(),
+            clock.now(),
+        );
         Self {
             local,
             remote,
@@ -240,22 +337,34 @@ impl ControlBlock {
             scheduler,
             clock,
             local_link_addr,
-            tcp_config,
+            tx_checksum_offload: tcp_config.get_tx_checksum_offload(),
+            tx_segmentation_offload: tcp_config.get_tx_segmentation_offload(),
+            multi_segment_pop: tcp_config.get_multi_segment_pop(),
+            large_send_size: tcp_config.get_large_send_size(),
             arp: Rc::new(arp),
             sender: sender,
             state: Cell::new(State::Established),
             ack_delay_timeout,
             ack_deadline: WatchedValue::new(None),
-            receive_buffer_size: receiver_window_size,
-            window_scale: receiver_window_scale,
+            receive_buffer_tuner,
+            sack_permitted,
             waker: RefCell::new(None),
-            out_of_order: RefCell::new(VecDeque::new()),
+            out_of_order: RefCell::new(ReassemblyQueue::new(receiver_seq_no)),
             out_of_order_fin: Cell::new(Option::None),
-            receiver: Receiver::new(receiver_seq_no, receiver_seq_no),
+            receiver: Receiver::new(
+                receiver_seq_no,
+                receiver_seq_no,
+                receiver_window_size,
+                receiver_window_scale,
+            ),
             user_is_done_sending: Cell::new(false),
             cc: cc_constructor(sender_mss, sender_seq_no, congestion_control_options),
             retransmit_deadline: WatchedValue::new(None),
             rto_calculator: RefCell::new(RtoCalculator::new()),
+            recovery_deadline: WatchedValue::new(None),
+            pacing_deadline: Cell::new(None),
+            nodelay: Cell::new(true),
+            cork: Cell::new(false),
         }
     }
 
@@ -267,6 +376,14 @@ impl ControlBlock {
         self.remote
     }
 
+    /// Prefetches the state that is needed to process an incoming segment, so that the cache misses of several
+    /// connections overlap when a batch of segments is demultiplexed ahead of being processed.
+    pub fn prefetch(&self) {
+        arch::prefetch(self as *const Self);
+        arch::prefetch(&self.receiver as *const Receiver);
+        self.sender.prefetch();
+    }
+
     // ToDo: Remove this.  ARP doesn't belong at this layer.
     pub fn arp(&self) -> Rc<ArpPeer> {
         self.arp.clone()
@@ -276,10 +393,22 @@ impl ControlBlock {
         self.sender.send(buf, self)
     }
 
+    pub fn check_send(&self, nb_segs: usize) -> Result<(), Fail> {
+        self.sender.check_send(nb_segs, self)
+    }
+
     pub fn retransmit(&self) {
         self.sender.retransmit(self)
     }
 
+    pub fn loss_recovery_on_timeout(&self) {
+        self.sender.on_recovery_timeout(self)
+    }
+
+    pub fn loss_recovery_on_rto(&self) {
+        self.sender.on_retransmit_timeout(self)
+    }
+
     pub fn congestion_control_watch_retransmit_now_flag(&self) -> (bool, WatchFuture<bool>) {
         self.cc.watch_retransmit_now_flag()
     }
@@ -292,8 +421,24 @@ impl ControlBlock {
         self.cc.on_rto(send_unacknowledged)
     }
 
-    pub fn congestion_control_on_send(&self, rto: Duration, num_sent_bytes: u32) {
-        self.cc.on_send(rto, num_sent_bytes)
+    // Notifies congestion control that `segment_len` bytes are about to be sent, while `num_sent_bytes` are already in
+    // flight.  If congestion control paces our data, this also pushes back the time at which the next segment may go.
+    pub fn congestion_control_on_send(&self, rto: Duration, num_sent_bytes: u32, segment_len: u32) {
+        self.cc.on_send(rto, num_sent_bytes);
+        let pacing_deadline: Option<Instant> = match self.cc.get_pacing_rate() {
+            Some(rate) if rate > 0.0 => {
+                // Don't let an idle period build up credit for a burst.
+                let now: Instant = self.clock.now();
+                let start: Instant = cmp::max(now, self.pacing_deadline.get().unwrap_or(now));
+                Some(start + Duration::from_secs_f64(segment_len as f64 / rate))
+            },
+            _ => None,
+        };
+        self.pacing_deadline.set(pacing_deadline);
+    }
+
+    pub fn get_pacing_deadline(&self) -> Option<Instant> {
+        self.pacing_deadline.get()
     }
 
     pub fn congestion_control_on_cwnd_check_before_send(&self) {
@@ -320,6 +465,11 @@ impl ControlBlock {
         self.sender.get_mss()
     }
 
+    /// Returns the maximum amount of data that may be handed down to [ControlBlock::emit] at once.
+    pub fn get_large_send_size(&self) -> usize {
+        cmp::max(self.get_mss(), self.large_send_size)
+    }
+
     pub fn get_send_window(&self) -> (u32, WatchFuture<u32>) {
         self.sender.get_send_window()
     }
@@ -352,8 +502,27 @@ impl ControlBlock {
         self.retransmit_deadline.watch()
     }
 
+    pub fn set_recovery_deadline(&self, when: Option<Instant>) {
+        // Avoid waking up the retransmitter on every ACK when the deadline stays the same.
+        if self.recovery_deadline.get() != when {
+            self.recovery_deadline.set(when);
+        }
+    }
+
+    pub fn watch_recovery_deadline(&self) -> (Option<Instant>, WatchFuture<Option<Instant>>) {
+        self.recovery_deadline.watch()
+    }
+
+    pub fn rate_snapshot(&self, now: Instant) -> RateSnapshot {
+        self.sender.rate_snapshot(now)
+    }
+
+    pub fn rate_sampler_on_app_limited(&self) {
+        self.sender.on_app_limited(self.cc.get_cwnd())
+    }
+
     pub fn push_unacked_segment(&self, segment: UnackedSegment) {
-        self.sender.push_unacked_segment(segment)
+        self.sender.push_unacked_segment(segment, self)
     }
 
     pub fn rto_add_sample(&self, rtt: Duration) {
@@ -364,16 +533,143 @@ impl ControlBlock {
         self.rto_calculator.borrow().rto()
     }
 
+    pub fn srtt(&self) -> Option<Duration> {
+        self.rto_calculator.borrow().srtt()
+    }
+
     pub fn rto_back_off(&self) {
         self.rto_calculator.borrow_mut().back_off()
     }
 
+    /// Sets a socket option that controls how data is coalesced into segments.  Data that was held back is sent if the
+    /// new option allows it.
+    pub fn set_option(&self, option: SocketOption) {
+        match option {
+            SocketOption::TcpNoDelay(nodelay) => self.nodelay.set(nodelay),
+            SocketOption::TcpCork(cork) => self.cork.set(cork),
+        }
+        let sent_data: u32 = (self.get_send_next().0 - self.get_send_unacked().0).into();
+        if self.may_send_partial(sent_data) {
+            self.flush_unsent();
+        }
+    }
+
+    pub fn is_corked(&self) -> bool {
+        self.cork.get()
+    }
+
+    /// Checks whether a segment smaller than the MSS may be sent, given the amount of data in flight.  Corked
+    /// connections wait until they are flushed, whereas Nagle's algorithm (RFC 896) waits until all data in flight is
+    /// acknowledged, so that small writes are coalesced in the meantime.
+    pub fn may_send_partial(&self, sent_data: u32) -> bool {
+        if self.cork.get() {
+            false
+        } else {
+            self.nodelay.get() || sent_data == 0
+        }
+    }
+
+    /// Sends a segment of up to `max_size` bytes from the unsent queue.  Returns the sequence number space consumed.
+    pub fn send_unsent_segment(
+        &self,
+        send_next: SeqNumber,
+        sent_data: u32,
+        max_size: usize,
+        remote_link_addr: MacAddress,
+    ) -> u32 {
+        let segment_data: DemiBuffer = self
+            .pop_unsent_segment(max_size)
+            .expect("No unsent data with sequence number gap?");
+        let mut segment_data_len: u32 = segment_data.len() as u32;
+
+        let rto: Duration = self.rto();
+        self.congestion_control_on_send(rto, sent_data, segment_data_len);
+
+        // Prepare the segment and send it.
+        let mut header: TcpHeader = self.tcp_header();
+        header.seq_num = send_next;
+        if segment_data_len == 0 {
+            // This buffer is the end-of-send marker.
+            debug_assert!(self.user_is_done_sending.get());
+            // Set FIN and adjust sequence number consumption accordingly.
+            header.fin = true;
+            segment_data_len = 1;
+        }
+        self.emit(header, Some(segment_data.clone()), remote_link_addr);
+
+        // Update SND.NXT.
+        self.modify_send_next(|s| s + SeqNumber::from(segment_data_len));
+
+        // Put this segment on the unacknowledged list.
+        let now: Instant = self.clock.now();
+        let unacked_segment = UnackedSegment {
+            bytes: segment_data,
+            initial_tx: Some(now),
+            last_tx: now,
+            rate: self.rate_snapshot(now),
+        };
+        self.push_unacked_segment(unacked_segment);
+
+        // Set the retransmit timer.
+        // ToDo: Fix how the retransmit timer works.
+        if self.get_retransmit_deadline().is_none() {
+            let rto: Duration = self.rto();
+            self.set_retransmit_deadline(Some(self.clock.now() + rto));
+        }
+
+        segment_data_len
+    }
+
+    /// Sends as much unsent data as the send window and congestion control allow, including segments smaller than the
+    /// MSS that are otherwise held back.  Returns true if some segment was sent.
+    ///
+    /// Note: Zero window probes, pacing and ARP resolution are left to the background sender.
+    pub fn flush_unsent(&self) -> bool {
+        let remote_link_addr: MacAddress = match self.arp().try_query(self.remote.ip().clone()) {
+            Some(remote_link_addr) => remote_link_addr,
+            None => return false,
+        };
+
+        let mut sent: bool = false;
+        loop {
+            let send_next: SeqNumber = self.get_send_next().0;
+            if send_next == self.get_unsent_seq_no().0 {
+                break;
+            }
+            let sent_data: u32 = (send_next - self.get_send_unacked().0).into();
+            let win_sz: u32 = self.get_send_window().0;
+
+            self.congestion_control_on_cwnd_check_before_send();
+            let effective_cwnd: u32 =
+                self.congestion_control_get_cwnd() + self.congestion_control_get_limited_transmit_cwnd_increase();
+            if win_sz <= sent_data || effective_cwnd <= sent_data {
+                break;
+            }
+            if let Some(pacing_deadline) = self.get_pacing_deadline() {
+                if pacing_deadline > self.clock.now() + self.clock.granularity() {
+                    break;
+                }
+            }
+
+            let max_size: usize = cmp::min(
+                cmp::min((win_sz - sent_data) as usize, self.get_large_send_size()),
+                (effective_cwnd - sent_data) as usize,
+            );
+            self.send_unsent_segment(send_next, sent_data, max_size, remote_link_addr);
+            sent = true;
+        }
+        sent
+    }
+
     pub fn unsent_top_size(&self) -> Option<usize> {
         self.sender.top_size_unsent()
     }
 
     pub fn pop_unsent_segment(&self, max_bytes: usize) -> Option<DemiBuffer> {
-        self.sender.pop_unsent(max_bytes)
+        // Small writes are only coalesced if Nagle's algorithm or corking is asked for, as they are otherwise expected
+        // to go out as they are.
+        let coalesce: bool = self.cork.get() || !self.nodelay.get();
+        self.sender.pop_unsent(max_bytes, coalesce)
     }
 
     pub fn pop_one_unsent_byte(&self) -> Option<DemiBuffer> {
@@ -655,6 +951,15 @@ impl ControlBlock {
             // ToDo: Implement fast-retransmit.  In which case, we'd increment our dup-ack counter here.
         }
 
+        // Remember which data our peer has selectively acknowledged, and retransmit the data it is now missing.
+        let advanced: bool = self.sender.send_unacked.get() != send_unacknowledged;
+        self.sender.on_ack_received(self, header, advanced, now);
+
+        // Let congestion control know how fast data is being delivered.
+        if let Some(sample) = self.sender.take_rate_sample() {
+            self.cc.on_rate_sample(&sample, now);
+        }
+
         // ToDo: Check the URG bit.  If we decide to support this, how should we do it?
         if header.urg {
             warn!("Got packet with URG bit set!");
@@ -826,6 +1131,24 @@ impl ControlBlock {
         let (seq_num, _): (SeqNumber, _) = self.get_send_next();
         header.seq_num = seq_num;
 
+        // Describe any out-of-order data that we hold, so our peer only needs to retransmit the holes (RFC 2018).
+        // Note: We only do this on pure ACKs, as the MSS of data segments doesn't leave room for the option.
+        if self.sack_permitted {
+            let out_of_order = self.out_of_order.borrow();
+            if !out_of_order.is_empty() {
+                let mut sacks: [SelectiveAcknowlegement; MAX_SACK_BLOCKS] = [SelectiveAcknowlegement {
+                    begin: SeqNumber::from(0),
+                    end: SeqNumber::from(0),
+                }; MAX_SACK_BLOCKS];
+                let mut num_sacks: usize = 0;
+                for (begin, end) in out_of_order.sack_blocks() {
+                    sacks[num_sacks] = SelectiveAcknowlegement { begin, end };
+                    num_sacks += 1;
+                }
+                header.push_option(TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks });
+            }
+        }
+
         // ToDo: Remove this if clause once emit() is fixed to not require the remote hardware addr (this should be
         // left to the ARP layer and not exposed to TCP).
         if let Some(remote_link_addr) = self.arp().try_query(self.remote.ip().clone()) {
@@ -856,11 +1179,20 @@ impl ControlBlock {
             ipv4_hdr: Ipv4Header::new(self.local.ip().clone(), self.remote.ip().clone(), IpProtocol::TCP),
             tcp_hdr: header,
             data: body,
-            tx_checksum_offload: self.tcp_config.get_tx_checksum_offload(),
+            tx_checksum_offload: self.tx_checksum_offload,
         };
 
-        // Call the runtime to send the segment.
-        self.rt.transmit(Box::new(segment));
+        // Call the runtime to send the segment. Segments that are larger than the MSS are either split by the NIC, if
+        // it supports segmentation offload, or by ourselves, otherwise.
+        let mss: usize = self.get_mss();
+        let body_size: usize = segment.body_size();
+        if body_size <= mss {
+            self.rt.transmit(Box::new(segment));
+        } else if self.tx_segmentation_offload && body_size <= MAX_LARGE_SEND_SIZE {
+            self.rt.transmit(Box::new(TcpTsoSegment::new(segment, mss)));
+        } else {
+            large_segment::segment(segment, mss, |pkt| self.rt.transmit(pkt));
+        }
 
         // Post-send operations follow.
         // Review: We perform these after the send, in order to keep send latency as low as possible.
@@ -897,19 +1229,19 @@ impl ControlBlock {
 
     pub fn get_receive_window_size(&self) -> u32 {
         let bytes_unread: u32 = (self.receiver.receive_next.get() - self.receiver.reader_next.get()).into();
-        self.receive_buffer_size - bytes_unread
+        self.receiver.receive_buffer_size.get() - bytes_unread
     }
 
     pub fn hdr_window_size(&self) -> u16 {
         let window_size: u32 = self.get_receive_window_size();
-        let hdr_window_size: u16 = (window_size >> self.window_scale)
+        let hdr_window_size: u16 = (window_size >> self.receiver.window_scale)
             .try_into()
             .expect("Window size overflow");
         debug!(
             "Window size -> {} (hdr {}, scale {})",
-            (hdr_window_size as u32) << self.window_scale,
+            (hdr_window_size as u32) << self.receiver.window_scale,
             hdr_window_size,
-            self.window_scale
+            self.receiver.window_scale
         );
         hdr_window_size
     }
@@ -927,11 +1259,38 @@ impl ControlBlock {
             return Poll::Pending;
         }
 
-        let segment: DemiBuffer = self
+        let mut segment: DemiBuffer = self
             .receiver
             .pop()
             .expect("poll_recv failed to pop data from receive queue");
 
+        // Hand over everything that has been received at once, chaining as many segments as a scatter-gather array
+        // holds.  The empty buffer that marks the end of the stream is left for the next pop, so that the application
+        // still sees it.
+        if self.multi_segment_pop {
+            while let Some(next) = self.receiver.pop_if(|next: &DemiBuffer| {
+                next.is_heap_allocated() == segment.is_heap_allocated()
+                    && segment.nb_segs() + next.nb_segs() <= DEMI_SGARRAY_MAXLEN
+                    && !next.is_empty()
+            }) {
+                segment
+                    .append(next)
+                    .expect("poll_recv failed to chain segments from receive queue");
+            }
+        }
+
+        if let Some(tuner) = self.receive_buffer_tuner.as_ref() {
+            let size: u32 = self.receiver.receive_buffer_size.get();
+            let now: Instant = self.clock.now();
+            if let Some(new_size) = tuner
+                .borrow_mut()
+                .on_read(self.receiver.reader_next.get(), size, self.srtt(), now)
+            {
+                debug!("Receive buffer size {} -> {}", size, new_size);
+                self.receiver.receive_buffer_size.set(new_size);
+            }
+        }
+
         Poll::Ready(Ok(segment))
     }
 
@@ -943,102 +1302,16 @@ impl ControlBlock {
 
     // This routine takes an incoming TCP segment and adds it to the out-of-order receive queue.
     // If the new segment had a FIN it has been removed prior to this routine being called.
-    // Note: Since this is not the "fast path", this is written for clarity over efficiency.
+    // Note: The out-of-order queue trims off any data it already holds, so the new segment may be stored partially.
     //
-    pub fn store_out_of_order_segment(&self, mut new_start: SeqNumber, mut new_end: SeqNumber, mut buf: DemiBuffer) {
+    pub fn store_out_of_order_segment(&self, new_start: SeqNumber, new_end: SeqNumber, buf: DemiBuffer) {
+        debug_assert_eq!(
+            new_end - new_start + SeqNumber::from(1),
+            SeqNumber::from(buf.len() as u32)
+        );
         let mut out_of_order = self.out_of_order.borrow_mut();
-        let mut action_index: usize = out_of_order.len();
-        let mut another_pass_neeeded: bool = true;
-
-        while another_pass_neeeded {
-            another_pass_neeeded = false;
-
-            // Find the new segment's place in the out-of-order store.
-            // The out-of-order store is sorted by starting sequence number, and contains no duplicate data.
-            action_index = out_of_order.len();
-            for index in 0..out_of_order.len() {
-                let stored_segment: &(SeqNumber, DemiBuffer) = &out_of_order[index];
-
-                // Properties of the segment stored at this index.
-                let stored_start: SeqNumber = stored_segment.0;
-                let stored_len: u32 = stored_segment.1.len() as u32;
-                debug_assert_ne!(stored_len, 0);
-                let stored_end: SeqNumber = stored_start + SeqNumber::from(stored_len - 1);
-
-                //
-                // The new data segment has six possibilites when compared to an existing out-of-order segment:
-                //
-                //                                |<- out-of-order segment ->|
-                //
-                // |<- new before->|    |<- new front overlap ->|    |<- new end overlap ->|    |<- new after ->|
-                //                                   |<- new duplicate ->|
-                //                            |<- new completely encompassing ->|
-                //
-                if new_start < stored_start {
-                    // The new segment starts before the start of this out-of-order segment.
-                    if new_end < stored_start {
-                        // The new segment comes completely before this out-of-order segment.
-                        // Since the out-of-order store is sorted, we don't need to check for overlap with any more.
-                        action_index = index;
-                        break;
-                    }
-                    // The end of the new segment overlaps with the start of this out-of-order segment.
-                    if stored_end < new_end {
-                        // The new segment ends after the end of this out-of-order segment.  In other words, the new
-                        // segment completely encompasses the out-of-order segment.
-
-                        // Set flags to remove the currently stored segment and re-run the insertion loop, as the
-                        // new segment may completely encompass even more segments.
-                        another_pass_neeeded = true;
-                        action_index = index;
-                        break;
-                    }
-                    // We have some data overlap between the new segment and the front of the out-of-order segment.
-                    // Trim the end of the new segment and stop checking for out-of-order overlap.
-                    let excess: u32 = u32::from(new_end - stored_start) + 1;
-                    new_end = new_end - SeqNumber::from(excess);
-                    buf.trim(excess as usize)
-                        .expect("'buf' should contain at least 'excess' bytes");
-                    break;
-                } else {
-                    // The new segment starts at or after the start of this out-of-order segment.
-                    // This is the stored_start <= new_start case.
-                    if new_end <= stored_end {
-                        // And the new segment ends at or before this out-of-order segment.
-                        // The new segment's data is a complete duplicate of this out-of-order segment's data.
-                        // Just drop the new segment.
-                        return;
-                    }
-                    if stored_end < new_start {
-                        // The new segment comes entirely after this out-of-order segment.
-                        // Continue to check the next out-of-order segment for potential overlap.
-                        continue;
-                    }
-                    // We have some data overlap between the new segment and the end of the out-of-order segment.
-                    // Adjust the beginning of the new segment and continue on to check the next out-of-order segment.
-                    let duplicate: u32 = u32::from(stored_end - new_start);
-                    new_start = new_start + SeqNumber::from(duplicate);
-                    buf.adjust(duplicate as usize)
-                        .expect("'buf' should contain at least 'duplicate' bytes");
-                    continue;
-                }
-            }
-
-            if another_pass_neeeded {
-                // The new segment completely encompassed an existing segment, which we will now remove.
-                out_of_order.remove(action_index);
-            }
-        }
-
-        // Insert the new segment into the correct position.
-        out_of_order.insert(action_index, (new_start, buf));
-
-        // If the out-of-order store now contains too many entries, delete the later entries.
-        // ToDo: The out-of-order store is already limited (in size) by our receive window, while the below check
-        // imposes a limit on the number of entries.  Do we need this?  Presumably for attack mitigation?
-        while out_of_order.len() > MAX_OUT_OF_ORDER {
-            out_of_order.pop_back();
-        }
+        out_of_order.insert(new_start, buf);
+        stats::record(|stats| stats.ooo_depth.record(out_of_order.len() as u64));
     }
 
     // This routine takes an incoming in-order TCP segment and adds the data to the user's receive queue.  If the new
@@ -1063,22 +1336,18 @@ impl ControlBlock {
         // the out-of-order queue is now in-order.  If so, we can move it to the receive queue.
         let mut added_out_of_order: bool = false;
         let mut out_of_order = self.out_of_order.borrow_mut();
-        while !out_of_order.is_empty() {
-            if let Some(stored_entry) = out_of_order.front() {
-                if stored_entry.0 == recv_next {
-                    // Move this entry's buffer from the out-of-order store to the receive queue.
-                    // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
-                    debug!("Recovering out-of-order packet at {}", recv_next);
-                    if let Some(temp) = out_of_order.pop_front() {
-                        recv_next = recv_next + SeqNumber::from(temp.1.len() as u32);
-                        self.receiver.push(temp.1);
-                        added_out_of_order = true;
-                    }
-                } else {
-                    // Since our out-of-order list is sorted, we can stop when the next segment is not in sequence.
-                    break;
-                }
-            }
+        while let Some(stored_buf) = out_of_order.pop(recv_next) {
+            // Move this buffer from the out-of-order store to the receive queue.
+            // This data is now considered to be "received" by TCP, and included in our RCV.NXT calculation.
+            debug!("Recovering out-of-order packet at {}", recv_next);
+            recv_next = recv_next + SeqNumber::from(stored_buf.len() as u32);
+            self.receiver.push(stored_buf);
+            added_out_of_order = true;
+        }
+
+        if let Some(tuner) = self.receive_buffer_tuner.as_ref() {
+            let window: u32 = self.get_receive_window_size();
+            tuner.borrow_mut().on_receive(recv_next, window, self.clock.now());
         }
 
         // ToDo: Review recent change to update control block copy of recv_next upon each push to the receiver.
@@ -1096,18 +1365,8 @@ impl ControlBlock {
             w.wake()
         }
 
-        // This is a lot of effort just to check the FIN sequence number is correct in debug builds.
-        // ToDo: Consider changing all this to "return added_out_of_order && self.out_of_order_fin.get().is_some()".
-        if added_out_of_order {
-            match self.out_of_order_fin.get() {
-                Some(fin) => {
-                    debug_assert_eq!(fin, recv_next);
-                    return true;
-                },
-                _ => (),
-            }
-        }
-
-        false
+        // An out-of-order FIN is now in order only if all of the data before it has been received.  The out-of-order
+        // queue may still hold data past a remaining hole, in which case the FIN has to wait for that too.
+        added_out_of_order && self.out_of_order_fin.get() == Some(recv_next)
     }
 }
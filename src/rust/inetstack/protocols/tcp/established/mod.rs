@@ -1,9 +1,13 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+mod autotune;
 mod background;
 pub mod congestion_control;
 mod ctrlblk;
+mod ranges;
+mod reassembly;
+mod recovery;
 mod rto;
 mod sender;
 
@@ -70,6 +74,10 @@ impl EstablishedSocket {
         self.cb.send(buf)
     }
 
+    pub fn check_send(&self, nb_segs: usize) -> Result<(), Fail> {
+        self.cb.check_send(nb_segs)
+    }
+
     pub fn poll_recv(&self, ctx: &mut Context) -> Poll<Result<DemiBuffer, Fail>> {
         self.cb.poll_recv(ctx)
     }
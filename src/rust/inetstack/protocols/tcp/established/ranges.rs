@@ -0,0 +1,268 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use crate::inetstack::protocols::tcp::SeqNumber;
+use ::std::collections::BTreeMap;
+
+// Set of Disjoint Sequence Number Ranges.
+//
+// Tracks which parts of the sequence number space at or after a (moving) base have been seen.  The receive side uses
+// this to describe out-of-order data in SACK blocks, and the send side to remember what the peer has SACK'd.
+//
+// Sequence numbers wrap around, so they can't be used as keys of an ordered map directly.  Instead, ranges are keyed by
+// their distance from where the set started, as a 64-bit number that never wraps.  Since all ranges lie within a window
+// above the base, converting between the two is a single subtraction.
+//
+// Ranges are half-open, i.e. [start, end), and adjacent or overlapping ranges are merged on insertion.
+//
+#[derive(Debug)]
+pub struct SeqRanges {
+    // Lowest sequence number that may be covered by a range.
+    base: SeqNumber,
+
+    // Position of `base` since the set was created.
+    base_position: u64,
+
+    // Disjoint, non-adjacent ranges, as a map from start to end position.
+    ranges: BTreeMap<u64, u64>,
+}
+
+impl SeqRanges {
+    /// Creates an empty set, whose base is `base`.
+    pub fn new(base: SeqNumber) -> Self {
+        Self {
+            base,
+            base_position: 0,
+            ranges: BTreeMap::new(),
+        }
+    }
+
+    /// Returns the number of disjoint ranges in the set.
+    #[cfg(test)]
+    pub fn len(&self) -> usize {
+        self.ranges.len()
+    }
+
+    /// Returns true if no ranges are in the set.
+    pub fn is_empty(&self) -> bool {
+        self.ranges.is_empty()
+    }
+
+    /// Returns the end of the highest range in the set.
+    pub fn highest(&self) -> Option<SeqNumber> {
+        let (_, &end): (_, &u64) = self.ranges.iter().next_back()?;
+        Some(self.to_seq(end))
+    }
+
+    /// Moves the base of the set forward to `base`, dropping ranges and parts of ranges that fall below it.
+    pub fn advance(&mut self, base: SeqNumber) {
+        if base <= self.base {
+            return;
+        }
+        self.base_position += u32::from(base - self.base) as u64;
+        self.base = base;
+
+        while let Some((&start, &end)) = self.ranges.iter().next() {
+            if start >= self.base_position {
+                break;
+            }
+            self.ranges.remove(&start);
+            if end > self.base_position {
+                self.ranges.insert(self.base_position, end);
+                break;
+            }
+        }
+    }
+
+    /// Adds [start, end) to the set.  Returns the range of the set that now covers it, or `None` if it falls entirely
+    /// below the base.
+    pub fn insert(&mut self, start: SeqNumber, end: SeqNumber) -> Option<(SeqNumber, SeqNumber)> {
+        let (mut start, mut end): (u64, u64) = self.to_positions(start, end)?;
+
+        // Merge with the range that starts at or before the new one, if they overlap or touch.
+        if let Some((&prev_start, &prev_end)) = self.ranges.range(..=start).next_back() {
+            if prev_end >= start {
+                if prev_end >= end {
+                    return Some((self.to_seq(prev_start), self.to_seq(prev_end)));
+                }
+                start = prev_start;
+            }
+        }
+
+        // Merge with all ranges that start within or right after the new one.
+        while let Some((&next_start, &next_end)) = self.ranges.range(start..).next() {
+            if next_start > end {
+                break;
+            }
+            self.ranges.remove(&next_start);
+            end = end.max(next_end);
+        }
+
+        self.ranges.insert(start, end);
+        Some((self.to_seq(start), self.to_seq(end)))
+    }
+
+    /// Removes [start, end) from the set.
+    pub fn remove(&mut self, start: SeqNumber, end: SeqNumber) {
+        let (start, end): (u64, u64) = match self.to_positions(start, end) {
+            Some(positions) => positions,
+            None => return,
+        };
+
+        // Collect the ranges that overlap with the removed one.  The first of them may start before it.
+        let first: u64 = match self.ranges.range(..=start).next_back() {
+            Some((&prev_start, &prev_end)) if prev_end > start => prev_start,
+            _ => start,
+        };
+        let overlapping: Vec<(u64, u64)> = self
+            .ranges
+            .range(first..end)
+            .map(|(&range_start, &range_end)| (range_start, range_end))
+            .collect();
+
+        // Put back the parts of these ranges that lie outside of the removed one.
+        for (range_start, range_end) in overlapping {
+            self.ranges.remove(&range_start);
+            if range_start < start {
+                self.ranges.insert(range_start, start);
+            }
+            if range_end > end {
+                self.ranges.insert(end, range_end);
+            }
+        }
+    }
+
+    /// Returns true if [start, end) is entirely covered by the set.
+    pub fn contains(&self, start: SeqNumber, end: SeqNumber) -> bool {
+        match self.to_positions(start, end) {
+            Some((start, end)) => match self.ranges.range(..=start).next_back() {
+                Some((_, &range_end)) => range_end >= end,
+                None => false,
+            },
+            None => false,
+        }
+    }
+
+    /// Returns the range of the set that covers `seq`, if any.
+    pub fn get(&self, seq: SeqNumber) -> Option<(SeqNumber, SeqNumber)> {
+        let (position, _): (u64, u64) = self.to_positions(seq, seq + SeqNumber::from(1))?;
+        match self.ranges.range(..=position).next_back() {
+            Some((&start, &end)) if end > position => Some((self.to_seq(start), self.to_seq(end))),
+            _ => None,
+        }
+    }
+
+    /// Iterates over the ranges of the set, from lowest to highest.
+    pub fn iter(&self) -> impl Iterator<Item = (SeqNumber, SeqNumber)> + '_ {
+        self.ranges
+            .iter()
+            .map(|(&start, &end)| (self.to_seq(start), self.to_seq(end)))
+    }
+
+    /// Returns the position of `seq`, counted from where the set started.  Sequence numbers below the base are clipped
+    /// to it.
+    pub fn position(&self, seq: SeqNumber) -> u64 {
+        if seq < self.base {
+            self.base_position
+        } else {
+            self.base_position + u32::from(seq - self.base) as u64
+        }
+    }
+
+    // Converts [start, end) into positions, clipping it to the base.  Returns `None` if the range is empty after that.
+    fn to_positions(&self, start: SeqNumber, end: SeqNumber) -> Option<(u64, u64)> {
+        if end <= self.base || end <= start {
+            return None;
+        }
+        Some((self.position(start), self.position(end)))
+    }
+
+    /// Converts a position back into a sequence number.
+    pub fn to_seq(&self, position: u64) -> SeqNumber {
+        self.base + SeqNumber::from((position - self.base_position) as u32)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::SeqRanges;
+    use crate::inetstack::protocols::tcp::SeqNumber;
+
+    fn seq(value: u32) -> SeqNumber {
+        SeqNumber::from(value)
+    }
+
+    fn ranges(set: &SeqRanges) -> Vec<(u32, u32)> {
+        set.iter()
+            .map(|(start, end)| (u32::from(start), u32::from(end)))
+            .collect()
+    }
+
+    #[test]
+    fn insert_merges_ranges() {
+        let mut set: SeqRanges = SeqRanges::new(seq(100));
+        set.insert(seq(200), seq(300));
+        set.insert(seq(400), seq(500));
+        set.insert(seq(600), seq(700));
+        assert_eq!(ranges(&set), vec![(200, 300), (400, 500), (600, 700)]);
+
+        // Duplicate.
+        assert_eq!(set.insert(seq(420), seq(480)), Some((seq(400), seq(500))));
+        assert_eq!(set.len(), 3);
+
+        // Adjacent to one range, overlapping with another.
+        assert_eq!(set.insert(seq(300), seq(450)), Some((seq(200), seq(500))));
+        assert_eq!(ranges(&set), vec![(200, 500), (600, 700)]);
+
+        // Encompassing everything.
+        assert_eq!(set.insert(seq(150), seq(800)), Some((seq(150), seq(800))));
+        assert_eq!(ranges(&set), vec![(150, 800)]);
+
+        // Below the base.
+        assert_eq!(set.insert(seq(50), seq(100)), None);
+        assert_eq!(set.insert(seq(50), seq(120)), Some((seq(100), seq(120))));
+        assert_eq!(ranges(&set), vec![(100, 120), (150, 800)]);
+    }
+
+    #[test]
+    fn remove_splits_ranges() {
+        let mut set: SeqRanges = SeqRanges::new(seq(0));
+        set.insert(seq(100), seq(200));
+        set.insert(seq(300), seq(400));
+        set.remove(seq(150), seq(350));
+        assert_eq!(ranges(&set), vec![(100, 150), (350, 400)]);
+        set.remove(seq(120), seq(130));
+        assert_eq!(ranges(&set), vec![(100, 120), (130, 150), (350, 400)]);
+        set.remove(seq(0), seq(1000));
+        assert!(set.is_empty());
+    }
+
+    #[test]
+    fn advance_and_wrap_around() {
+        let base: SeqNumber = seq(u32::MAX - 1000);
+        let mut set: SeqRanges = SeqRanges::new(base);
+        set.insert(base + seq(500), base + seq(1500));
+        set.insert(base + seq(2000), base + seq(3000));
+        assert_eq!(set.highest(), Some(base + seq(3000)));
+        assert!(set.contains(base + seq(600), base + seq(1500)));
+        assert!(!set.contains(base + seq(600), base + seq(1600)));
+        assert_eq!(set.get(base + seq(1000)), Some((base + seq(500), base + seq(1500))));
+        assert_eq!(set.get(base + seq(1500)), None);
+
+        set.advance(base + seq(1000));
+        assert_eq!(
+            set.iter().collect::<Vec<(SeqNumber, SeqNumber)>>(),
+            vec![
+                (base + seq(1000), base + seq(1500)),
+                (base + seq(2000), base + seq(3000))
+            ]
+        );
+        set.advance(base + seq(2500));
+        assert_eq!(
+            set.iter().collect::<Vec<(SeqNumber, SeqNumber)>>(),
+            vec![(base + seq(2500), base + seq(3000))]
+        );
+        set.advance(base + seq(4000));
+        assert!(set.is_empty());
+    }
+}
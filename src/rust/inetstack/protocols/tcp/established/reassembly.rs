@@ -0,0 +1,270 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use super::ranges::SeqRanges;
+use crate::{
+    inetstack::protocols::tcp::SeqNumber,
+    runtime::memory::DemiBuffer,
+};
+use ::arrayvec::ArrayVec;
+use ::std::collections::{
+    BTreeMap,
+    VecDeque,
+};
+
+// Maximum number of out-of-order segments that we hold on to.  Beyond this, the highest ones are dropped.
+// Note: The amount of out-of-order data is also limited by our receive window.  This limit bounds the bookkeeping
+// overhead of many tiny segments, e.g. in case of a deliberate out-of-order segment attack.
+const MAX_OUT_OF_ORDER: usize = 1024;
+
+// Maximum number of SACK blocks that fit in a TCP header (RFC 2018, Section 3).
+pub const MAX_SACK_BLOCKS: usize = 4;
+
+// TCP Reassembly Queue.
+//
+// Holds data that was received out of order, until the holes in front of it are filled.  Segments are kept sorted by
+// starting sequence number and never overlap, so both storing a segment and finding its neighbors take O(log n).  The
+// ranges of sequence number space that the queue covers are tracked separately, to describe them in SACK blocks.
+//
+pub struct ReassemblyQueue {
+    // Out-of-order segments, keyed by the position of their first byte (see SeqRanges).
+    segments: BTreeMap<u64, DemiBuffer>,
+
+    // Ranges of sequence number space covered by the segments.  Its base is the next in-order sequence number.
+    ranges: SeqRanges,
+
+    // Starting sequence numbers of the most recently received segments, most recent first.  RFC 2018 requires the
+    // first SACK block to report the most recently received segment, and further blocks to repeat the most recently
+    // reported ones.
+    recent: VecDeque<SeqNumber>,
+}
+
+impl ReassemblyQueue {
+    /// Creates an empty queue, where `receive_next` is the next in-order sequence number.
+    pub fn new(receive_next: SeqNumber) -> Self {
+        Self {
+            segments: BTreeMap::new(),
+            ranges: SeqRanges::new(receive_next),
+            recent: VecDeque::with_capacity(MAX_SACK_BLOCKS),
+        }
+    }
+
+    /// Returns true if no out-of-order data is stored.
+    pub fn is_empty(&self) -> bool {
+        self.segments.is_empty()
+    }
+
+    /// Returns the number of out-of-order segments stored.
+    pub fn len(&self) -> usize {
+        self.segments.len()
+    }
+
+    /// Stores `buf`, which starts at sequence number `start`.  Data that is already stored is trimmed off.
+    pub fn insert(&mut self, start: SeqNumber, mut buf: DemiBuffer) {
+        let end: SeqNumber = start + SeqNumber::from(buf.len() as u32);
+        let mut start_position: u64 = self.ranges.position(start);
+        let mut end_position: u64 = self.ranges.position(end);
+        if start_position >= end_position {
+            // Empty, or entirely below the next in-order sequence number.
+            return;
+        }
+
+        // Trim data that falls below the next in-order sequence number.
+        let below: usize = buf.len() - (end_position - start_position) as usize;
+        if below > 0 {
+            buf.adjust(below).expect("'buf' should contain at least 'below' bytes");
+        }
+
+        // Trim the front of the new segment if it overlaps with the one stored before it.
+        if let Some((&prev_start, prev_buf)) = self.segments.range(..=start_position).next_back() {
+            let prev_end: u64 = prev_start + prev_buf.len() as u64;
+            if prev_end >= end_position {
+                // The new segment's data is a complete duplicate of this segment's data.  Just drop the new segment.
+                self.touch(start);
+                return;
+            }
+            if prev_end > start_position {
+                buf.adjust((prev_end - start_position) as usize)
+                    .expect("'buf' should contain at least 'duplicate' bytes");
+                start_position = prev_end;
+            }
+        }
+
+        // Drop stored segments that the new segment encompasses, and trim its end if it overlaps with the next one.
+        while let Some((&next_start, next_buf)) = self.segments.range(start_position..).next() {
+            if next_start >= end_position {
+                break;
+            }
+            let next_end: u64 = next_start + next_buf.len() as u64;
+            if next_end <= end_position {
+                self.segments.remove(&next_start);
+                continue;
+            }
+            buf.trim((end_position - next_start) as usize)
+                .expect("'buf' should contain at least 'excess' bytes");
+            end_position = next_start;
+            break;
+        }
+
+        debug_assert_eq!(buf.len() as u64, end_position - start_position);
+        self.segments.insert(start_position, buf);
+        self.ranges.insert(start, end);
+        self.touch(start);
+
+        // If the queue now holds too many segments, drop the highest ones.
+        while self.segments.len() > MAX_OUT_OF_ORDER {
+            if let Some((last_start, last_buf)) = self.segments.pop_last() {
+                let last_end: u64 = last_start + last_buf.len() as u64;
+                self.ranges
+                    .remove(self.ranges.to_seq(last_start), self.ranges.to_seq(last_end));
+            }
+        }
+    }
+
+    /// Moves the next in-order sequence number forward to `receive_next`, dropping data that falls below it.  Then pops
+    /// the next segment if it is now in order.
+    pub fn pop(&mut self, receive_next: SeqNumber) -> Option<DemiBuffer> {
+        self.ranges.advance(receive_next);
+        let base_position: u64 = self.ranges.position(receive_next);
+
+        loop {
+            let (&start, buf): (&u64, &DemiBuffer) = self.segments.iter().next()?;
+            if start > base_position {
+                return None;
+            }
+            let end: u64 = start + buf.len() as u64;
+            let mut buf: DemiBuffer = self.segments.remove(&start).expect("segment should be stored");
+            if end <= base_position {
+                // This segment was entirely covered by in-order data, drop it.
+                continue;
+            }
+            if start < base_position {
+                buf.adjust((base_position - start) as usize)
+                    .expect("'buf' should contain at least the overlapping bytes");
+            }
+            return Some(buf);
+        }
+    }
+
+    /// Returns up to `MAX_SACK_BLOCKS` ranges of stored data, reporting the most recently received data first.
+    pub fn sack_blocks(&self) -> ArrayVec<(SeqNumber, SeqNumber), MAX_SACK_BLOCKS> {
+        let mut blocks: ArrayVec<(SeqNumber, SeqNumber), MAX_SACK_BLOCKS> = ArrayVec::new();
+        for &seq in self.recent.iter() {
+            if let Some(block) = self.ranges.get(seq) {
+                if !blocks.contains(&block) {
+                    blocks.push(block);
+                }
+            }
+        }
+        blocks
+    }
+
+    // Remembers that data starting at `seq` was just received.
+    fn touch(&mut self, seq: SeqNumber) {
+        if let Some(index) = self.recent.iter().position(|&s| s == seq) {
+            self.recent.remove(index);
+        }
+        if self.recent.len() == MAX_SACK_BLOCKS {
+            self.recent.pop_back();
+        }
+        self.recent.push_front(seq);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        ReassemblyQueue,
+        MAX_OUT_OF_ORDER,
+    };
+    use crate::{
+        inetstack::protocols::tcp::SeqNumber,
+        runtime::memory::DemiBuffer,
+    };
+
+    fn seq(value: u32) -> SeqNumber {
+        SeqNumber::from(value)
+    }
+
+    // Builds a segment that holds bytes [start, end), where each byte is the low octet of its sequence number.
+    fn segment(start: u32, end: u32) -> DemiBuffer {
+        let bytes: Vec<u8> = (start..end).map(|value| value as u8).collect();
+        DemiBuffer::from_slice(&bytes).expect("slice should be a valid length")
+    }
+
+    // Pops all in-order data from the queue, and checks that it holds the expected bytes.
+    fn pop_all(queue: &mut ReassemblyQueue, mut receive_next: u32) -> u32 {
+        while let Some(buf) = queue.pop(seq(receive_next)) {
+            for &byte in buf[..].iter() {
+                assert_eq!(byte, receive_next as u8);
+                receive_next += 1;
+            }
+        }
+        receive_next
+    }
+
+    #[test]
+    fn reassemble_overlapping_segments() {
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(seq(100));
+        queue.insert(seq(300), segment(300, 400));
+        queue.insert(seq(200), segment(200, 250));
+        queue.insert(seq(350), segment(350, 450));
+        queue.insert(seq(210), segment(210, 220));
+        queue.insert(seq(190), segment(190, 460));
+        assert!(queue.pop(seq(100)).is_none());
+
+        // Data below the next in-order sequence number is dropped.
+        queue.insert(seq(50), segment(50, 120));
+        assert_eq!(pop_all(&mut queue, 100), 120);
+        assert!(queue.pop(seq(120)).is_none());
+        assert_eq!(pop_all(&mut queue, 190), 460);
+        assert!(queue.is_empty());
+    }
+
+    #[test]
+    fn sack_blocks_report_recent_data_first() {
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(seq(0));
+        for start in [100, 300, 500, 700, 900] {
+            queue.insert(seq(start), segment(start, start + 50));
+        }
+        let blocks: Vec<(SeqNumber, SeqNumber)> = queue.sack_blocks().into_iter().collect();
+        assert_eq!(
+            blocks,
+            vec![
+                (seq(900), seq(950)),
+                (seq(700), seq(750)),
+                (seq(500), seq(550)),
+                (seq(300), seq(350))
+            ]
+        );
+
+        // Filling a hole merges blocks.
+        queue.insert(seq(150), segment(150, 300));
+        let blocks: Vec<(SeqNumber, SeqNumber)> = queue.sack_blocks().into_iter().collect();
+        assert_eq!(
+            blocks,
+            vec![
+                (seq(100), seq(350)),
+                (seq(900), seq(950)),
+                (seq(700), seq(750)),
+                (seq(500), seq(550))
+            ]
+        );
+
+        // Blocks below the next in-order sequence number are no longer reported.
+        assert!(queue.pop(seq(0)).is_none());
+        assert!(queue.pop(seq(600)).is_none());
+        let blocks: Vec<(SeqNumber, SeqNumber)> = queue.sack_blocks().into_iter().collect();
+        assert_eq!(blocks, vec![(seq(900), seq(950)), (seq(700), seq(750))]);
+    }
+
+    #[test]
+    fn memory_is_bounded() {
+        let mut queue: ReassemblyQueue = ReassemblyQueue::new(seq(0));
+        for i in 0..(2 * MAX_OUT_OF_ORDER as u32) {
+            queue.insert(seq(10 * i + 1), segment(10 * i + 1, 10 * i + 2));
+        }
+        assert_eq!(queue.len(), MAX_OUT_OF_ORDER);
+        assert_eq!(pop_all(&mut queue, 0), 0);
+    }
+}
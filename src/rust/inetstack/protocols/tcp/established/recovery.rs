@@ -0,0 +1,297 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use crate::{
+    inetstack::protocols::tcp::SeqNumber,
+    runtime::network::config::TcpLossRecovery,
+};
+use ::std::{
+    cmp,
+    time::{
+        Duration,
+        Instant,
+    },
+};
+
+// Number of segments' worth of data SACK'd above a hole that makes us deem the hole lost (RFC 6675, DupThresh).
+pub const DUP_THRESH: u32 = 3;
+
+// Worst case delayed ACK timer of our peer, used when only a single segment is in flight (RFC 8985, WCDelAckT).
+const WORST_CASE_DELAYED_ACK: Duration = Duration::from_millis(200);
+
+// Probe timeout to use before we have an RTT sample (RFC 8985, Section 7.2).
+const INITIAL_PROBE_TIMEOUT: Duration = Duration::from_secs(1);
+
+// TCP Loss Recovery State.
+//
+// The send side uses this to decide which unacknowledged segments are lost before the retransmission timer expires.
+// In SACK mode, a segment is lost once enough data above it has been SACK'd (RFC 6675).  In RACK-TLP mode, a segment
+// is lost once a segment that was sent sufficiently later has been delivered (RFC 8985), and a tail loss probe is sent
+// if a flight ends without any ACK, so that losses at the tail of a flight are detected without waiting for the RTO.
+//
+// The unacknowledged segments themselves live in the Sender, which walks them and asks this structure about each.
+//
+#[derive(Debug)]
+pub struct LossRecovery {
+    mode: TcpLossRecovery,
+
+    // SND.NXT at the time we entered loss recovery, if we are in loss recovery (RFC 6675, RecoveryPoint).
+    recovery_point: Option<SeqNumber>,
+
+    // End of the highest segment retransmitted since (RFC 6675, HighRxt).
+    high_retransmitted: SeqNumber,
+
+    // Most recent transmission time of the most recently sent segment that has been delivered (RACK.xmit_ts).
+    rack_xmit_ts: Option<Instant>,
+
+    // End of that segment, used to break ties between segments sent at the same time (RACK.end_seq).
+    rack_end_seq: SeqNumber,
+
+    // Round-trip time measured on that segment (RACK.rtt).
+    rack_rtt: Duration,
+
+    // Minimum round-trip time seen on this connection, which scales the reordering window.
+    min_rtt: Option<Duration>,
+
+    // When to look for lost segments again, as segments that are not yet deemed lost may be later (RACK.reo_timeout).
+    reorder_deadline: Option<Instant>,
+
+    // When to send a tail loss probe (TLP.PTO).
+    probe_deadline: Option<Instant>,
+
+    // SND.NXT at the time we sent a tail loss probe, while the probe is outstanding (TLP.end_seq).
+    probe_end_seq: Option<SeqNumber>,
+}
+
+impl LossRecovery {
+    pub fn new(mode: TcpLossRecovery, seq_no: SeqNumber) -> Self {
+        Self {
+            mode,
+            recovery_point: None,
+            high_retransmitted: seq_no,
+            rack_xmit_ts: None,
+            rack_end_seq: seq_no,
+            rack_rtt: Duration::ZERO,
+            min_rtt: None,
+            reorder_deadline: None,
+            probe_deadline: None,
+            probe_end_seq: None,
+        }
+    }
+
+    pub fn mode(&self) -> TcpLossRecovery {
+        self.mode
+    }
+
+    pub fn in_recovery(&self) -> bool {
+        self.recovery_point.is_some()
+    }
+
+    // Enters loss recovery, unless we're already in it.  We stay in it until `send_next` is acknowledged.
+    pub fn enter_recovery(&mut self, send_next: SeqNumber) {
+        if self.recovery_point.is_none() {
+            self.recovery_point = Some(send_next);
+        }
+    }
+
+    pub fn high_retransmitted(&self) -> SeqNumber {
+        self.high_retransmitted
+    }
+
+    // Remembers that the segment ending at `seg_end` has been retransmitted.
+    pub fn on_retransmit(&mut self, seg_end: SeqNumber) {
+        if seg_end > self.high_retransmitted {
+            self.high_retransmitted = seg_end;
+        }
+    }
+
+    // Updates the recovery state after an ACK moved SND.UNA forward to `send_unacked`.
+    pub fn on_cumulative_ack(&mut self, send_unacked: SeqNumber) {
+        if let Some(recovery_point) = self.recovery_point {
+            if send_unacked >= recovery_point {
+                self.recovery_point = None;
+            }
+        }
+        if let Some(probe_end_seq) = self.probe_end_seq {
+            if send_unacked >= probe_end_seq {
+                self.probe_end_seq = None;
+            }
+        }
+        if self.high_retransmitted < send_unacked {
+            self.high_retransmitted = send_unacked;
+        }
+    }
+
+    // Forgets about loss recovery after the retransmission timer expired, as we then start over from SND.UNA.
+    pub fn on_rto(&mut self) {
+        self.recovery_point = None;
+        self.reorder_deadline = None;
+        self.probe_deadline = None;
+        self.probe_end_seq = None;
+    }
+
+    // Updates RACK after the delivery (by cumulative ACK or SACK) of a segment ending at `seg_end` and last sent at
+    // `xmit_ts` (RFC 8985, Section 6.2, Step 2).  If the segment was retransmitted, `ambiguous` is true, and we can't
+    // tell which transmission was delivered.
+    pub fn on_delivered(&mut self, xmit_ts: Instant, seg_end: SeqNumber, ambiguous: bool, now: Instant) {
+        let rtt: Duration = now - xmit_ts;
+        if ambiguous {
+            // Ignore the delivery if it may have been of the original transmission, or we'd measure too short an RTT.
+            match self.min_rtt {
+                Some(min_rtt) if rtt >= min_rtt => (),
+                _ => return,
+            }
+        } else {
+            self.min_rtt = Some(self.min_rtt.map_or(rtt, |min_rtt| cmp::min(min_rtt, rtt)));
+        }
+        if !self.sent_before_delivered(xmit_ts, seg_end) {
+            self.rack_xmit_ts = Some(xmit_ts);
+            self.rack_end_seq = seg_end;
+            self.rack_rtt = rtt;
+        }
+    }
+
+    // Returns true if the segment ending at `seg_end` and last sent at `xmit_ts` was sent before the most recently
+    // sent segment that has been delivered (RFC 8985, RACK_sent_after).
+    pub fn sent_before_delivered(&self, xmit_ts: Instant, seg_end: SeqNumber) -> bool {
+        match self.rack_xmit_ts {
+            Some(rack_xmit_ts) => rack_xmit_ts > xmit_ts || (rack_xmit_ts == xmit_ts && self.rack_end_seq > seg_end),
+            None => false,
+        }
+    }
+
+    // Returns when a segment last sent at `xmit_ts`, before the most recently sent segment that has been delivered,
+    // is deemed lost.  The reordering window allows for a quarter of the minimum RTT (RFC 8985, Section 6.2, Step 4).
+    pub fn loss_deadline(&self, xmit_ts: Instant, srtt: Option<Duration>) -> Instant {
+        let mut reorder_window: Duration = self.min_rtt.unwrap_or(Duration::ZERO) / 4;
+        if let Some(srtt) = srtt {
+            reorder_window = cmp::min(reorder_window, srtt);
+        }
+        xmit_ts + self.rack_rtt + reorder_window
+    }
+
+    pub fn set_reorder_deadline(&mut self, deadline: Option<Instant>) {
+        self.reorder_deadline = deadline;
+    }
+
+    pub fn probe_due(&self, now: Instant) -> bool {
+        match self.probe_deadline {
+            Some(deadline) => deadline <= now,
+            None => false,
+        }
+    }
+
+    // (Re)starts the tail loss probe timer, if a probe is allowed (RFC 8985, Section 7.2).
+    pub fn arm_probe(&mut self, now: Instant, srtt: Option<Duration>, rto: Duration, single_segment: bool) {
+        self.probe_deadline =
+            if self.mode == TcpLossRecovery::RackTlp && !self.in_recovery() && self.probe_end_seq.is_none() {
+                Some(now + probe_timeout(srtt, rto, single_segment))
+            } else {
+                None
+            };
+    }
+
+    pub fn disarm_probe(&mut self) {
+        self.probe_deadline = None;
+    }
+
+    // Remembers that we sent a tail loss probe while SND.NXT was `send_next`.
+    pub fn on_probe_sent(&mut self, send_next: SeqNumber) {
+        self.probe_deadline = None;
+        self.probe_end_seq = Some(send_next);
+    }
+
+    // Returns when the loss recovery timer should next expire.
+    pub fn deadline(&self) -> Option<Instant> {
+        match (self.reorder_deadline, self.probe_deadline) {
+            (Some(reorder_deadline), Some(probe_deadline)) => Some(cmp::min(reorder_deadline, probe_deadline)),
+            (reorder_deadline, probe_deadline) => reorder_deadline.or(probe_deadline),
+        }
+    }
+}
+
+// Computes the probe timeout (RFC 8985, Section 7.2).  It is twice the smoothed RTT, plus our peer's worst case
+// delayed ACK timeout if only a single segment is in flight, but never more than the retransmission timeout.
+fn probe_timeout(srtt: Option<Duration>, rto: Duration, single_segment: bool) -> Duration {
+    let mut timeout: Duration = match srtt {
+        Some(srtt) => 2 * srtt,
+        None => INITIAL_PROBE_TIMEOUT,
+    };
+    if single_segment {
+        timeout += WORST_CASE_DELAYED_ACK;
+    }
+    cmp::min(timeout, rto)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        probe_timeout,
+        LossRecovery,
+    };
+    use crate::{
+        inetstack::protocols::tcp::SeqNumber,
+        runtime::network::config::TcpLossRecovery,
+    };
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    #[test]
+    fn rack_detects_reordering_and_loss() {
+        let start: Instant = Instant::now();
+        let ms = |value: u64| Duration::from_millis(value);
+        let mut recovery: LossRecovery = LossRecovery::new(TcpLossRecovery::RackTlp, SeqNumber::from(0));
+
+        // Segments [0, 100), [100, 200) and [200, 300) are sent 1 ms apart, and the last one is delivered first.
+        recovery.on_delivered(start + ms(2), SeqNumber::from(300), false, start + ms(42));
+        assert!(recovery.sent_before_delivered(start, SeqNumber::from(100)));
+        assert!(recovery.sent_before_delivered(start + ms(1), SeqNumber::from(200)));
+        assert!(!recovery.sent_before_delivered(start + ms(2), SeqNumber::from(300)));
+
+        // The earlier segments may only be reordered for a quarter of the minimum RTT.
+        assert_eq!(recovery.loss_deadline(start, Some(ms(40))), start + ms(50));
+        assert_eq!(recovery.loss_deadline(start, Some(ms(5))), start + ms(45));
+
+        // Deliveries of retransmissions that came back faster than the minimum RTT are ignored.
+        recovery.on_delivered(start + ms(30), SeqNumber::from(100), true, start + ms(45));
+        assert!(recovery.sent_before_delivered(start + ms(1), SeqNumber::from(200)));
+        assert!(!recovery.sent_before_delivered(start + ms(30), SeqNumber::from(100)));
+        recovery.on_delivered(start + ms(30), SeqNumber::from(100), true, start + ms(75));
+        assert!(recovery.sent_before_delivered(start + ms(30), SeqNumber::from(99)));
+    }
+
+    #[test]
+    fn probe_timeout_is_bounded_by_rto() {
+        let ms = |value: u64| Duration::from_millis(value);
+        assert_eq!(probe_timeout(Some(ms(10)), ms(200), false), ms(20));
+        assert_eq!(probe_timeout(Some(ms(10)), ms(1000), true), ms(220));
+        assert_eq!(probe_timeout(Some(ms(10)), ms(200), true), ms(200));
+        assert_eq!(probe_timeout(None, ms(3000), false), ms(1000));
+    }
+
+    #[test]
+    fn probe_is_not_armed_during_recovery() {
+        let now: Instant = Instant::now();
+        let rto: Duration = Duration::from_secs(1);
+        let mut recovery: LossRecovery = LossRecovery::new(TcpLossRecovery::RackTlp, SeqNumber::from(0));
+        recovery.arm_probe(now, None, rto, false);
+        assert_eq!(recovery.deadline(), Some(now + rto));
+
+        recovery.enter_recovery(SeqNumber::from(1000));
+        recovery.arm_probe(now, None, rto, false);
+        assert_eq!(recovery.deadline(), None);
+
+        recovery.on_cumulative_ack(SeqNumber::from(1000));
+        assert!(!recovery.in_recovery());
+        recovery.on_probe_sent(SeqNumber::from(2000));
+        recovery.arm_probe(now, None, rto, false);
+        assert_eq!(recovery.deadline(), None);
+
+        // No probes in SACK mode.
+        let mut recovery: LossRecovery = LossRecovery::new(TcpLossRecovery::Sack, SeqNumber::from(0));
+        recovery.arm_probe(now, None, rto, false);
+        assert_eq!(recovery.deadline(), None);
+    }
+}
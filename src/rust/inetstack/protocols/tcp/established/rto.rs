@@ -1,7 +1,13 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-use std::time::Duration;
+use std::{
+    cmp,
+    time::{
+        Duration,
+        Instant,
+    },
+};
 
 // TCP Retransmission Timeout (RTO) Calculator.
 // See RFC 6298 for details.
@@ -87,4 +93,234 @@ impl RtoCalculator {
     pub fn rto(&self) -> Duration {
         Duration::from_secs_f64(self.rto)
     }
+
+    /// Gets the smoothed RTT, if a RTT sample has been received yet.
+    pub fn srtt(&self) -> Option<Duration> {
+        if self.received_sample {
+            Some(Duration::from_secs_f64(self.srtt))
+        } else {
+            None
+        }
+    }
+}
+
+// Delivery Rate Sampler.
+// See draft-cheng-iccrg-delivery-rate-estimation for details.
+//
+// Every transmission of a segment takes a snapshot of how much data had been delivered to our peer at that time.  When
+// the segment gets acknowledged, the amount of data delivered since then, over the time it took, is a sample of the
+// rate at which the path delivers data.  Alongside the RTT samples fed into the RtoCalculator, these samples drive
+// model-based congestion control (e.g. BBR).
+
+// Delivery state at the time a segment was (re)transmitted.
+#[derive(Clone, Copy, Debug)]
+pub struct RateSnapshot {
+    // Amount of data delivered when the segment was sent.
+    delivered: u64,
+
+    // Time of the most recent delivery when the segment was sent.
+    delivered_time: Instant,
+
+    // Time at which the first segment of the flight that this segment belongs to was sent.
+    first_sent_time: Instant,
+
+    // Whether sending was limited by the application (rather than the network) when the segment was sent.
+    is_app_limited: bool,
+
+    // Time at which the segment was sent.
+    sent_time: Instant,
+}
+
+// Delivery rate sample, generated for every ACK that delivers new data.
+#[derive(Clone, Copy, Debug)]
+pub struct RateSample {
+    // Delivery rate (in bytes per second).
+    pub delivery_rate: f64,
+
+    // Round-trip time of the most recently sent segment that got delivered, unless that segment was retransmitted.
+    pub rtt: Option<Duration>,
+
+    // Amount of data delivered over the sampling interval.
+    pub delivered: u64,
+
+    // Amount of data that had been delivered when the sampling interval started.
+    pub prior_delivered: u64,
+
+    // Amount of data delivered since the connection started, including this ACK.
+    pub total_delivered: u64,
+
+    // Amount of data newly delivered by this ACK.
+    pub newly_delivered: u64,
+
+    // Amount of data still in flight after this ACK.
+    pub in_flight: u32,
+
+    // Whether the segments delivered over the sampling interval were sent while the application was not keeping the
+    // network busy.  If so, the delivery rate is an underestimate of what the path may deliver.
+    pub is_app_limited: bool,
+
+    // Length of the sampling interval.
+    pub interval: Duration,
+}
+
+#[derive(Debug)]
+pub struct RateSampler {
+    // Amount of data delivered since the connection started.
+    delivered: u64,
+
+    // Time of the most recent delivery.
+    delivered_time: Instant,
+
+    // Time at which the first segment of the current flight was sent.
+    first_sent_time: Instant,
+
+    // If not zero, the amount of delivered data beyond which samples are no longer application-limited.
+    app_limited: u64,
+
+    // Snapshot of the most recently sent segment that was delivered by the ACK being processed.
+    newest: Option<RateSnapshot>,
+
+    // Round-trip time of that segment.
+    rtt: Option<Duration>,
+
+    // Amount of data delivered by the ACK being processed.
+    newly_delivered: u64,
+}
+
+impl RateSampler {
+    /// Initializes a Delivery Rate Sampler.
+    pub fn new(now: Instant) -> Self {
+        Self {
+            delivered: 0,
+            delivered_time: now,
+            first_sent_time: now,
+            app_limited: 0,
+            newest: None,
+            rtt: None,
+            newly_delivered: 0,
+        }
+    }
+
+    /// Takes a snapshot of the delivery state for a segment that is being (re)transmitted at `now`.
+    pub fn on_send(&mut self, now: Instant, nothing_in_flight: bool) -> RateSnapshot {
+        // A new flight starts when nothing is in flight.  Don't count the idle time into the sampling interval.
+        if nothing_in_flight {
+            self.first_sent_time = now;
+            self.delivered_time = now;
+        }
+        RateSnapshot {
+            delivered: self.delivered,
+            delivered_time: self.delivered_time,
+            first_sent_time: self.first_sent_time,
+            is_app_limited: self.app_limited != 0,
+            sent_time: now,
+        }
+    }
+
+    /// Records that the application has no more data to send, while `in_flight` bytes are in flight.
+    pub fn on_app_limited(&mut self, in_flight: u32) {
+        self.app_limited = cmp::max(self.delivered + in_flight as u64, 1);
+    }
+
+    /// Records the delivery of `bytes` of a segment sent with `snapshot`, whose round-trip time was `rtt` (if known).
+    pub fn on_delivered(&mut self, snapshot: &RateSnapshot, bytes: u32, rtt: Option<Duration>, now: Instant) {
+        self.delivered += bytes as u64;
+        self.delivered_time = now;
+        self.newly_delivered += bytes as u64;
+
+        // Sample the most recently sent segment, as it gives the most up to date view of the path.
+        let is_newest: bool = match self.newest {
+            Some(newest) => snapshot.sent_time >= newest.sent_time && snapshot.delivered >= newest.delivered,
+            None => true,
+        };
+        if is_newest {
+            self.newest = Some(*snapshot);
+            self.rtt = rtt;
+            self.first_sent_time = snapshot.sent_time;
+        }
+    }
+
+    /// Generates a sample for the ACK being processed, if it delivered some data.  `in_flight` is the amount of data
+    /// still in flight after this ACK.
+    pub fn generate(&mut self, in_flight: u32) -> Option<RateSample> {
+        let newest: RateSnapshot = self.newest.take()?;
+        let newly_delivered: u64 = self.newly_delivered;
+        self.newly_delivered = 0;
+
+        // Once the data sent while application-limited has been delivered, samples reflect the network again.
+        if self.app_limited != 0 && self.delivered > self.app_limited {
+            self.app_limited = 0;
+        }
+
+        // The sampling interval is the longer of the send and ACK intervals, as the rate at which data is delivered
+        // can't exceed the rate at which it was sent, and ACK compression may make the ACK interval too short.
+        let send_elapsed: Duration = newest.sent_time.saturating_duration_since(newest.first_sent_time);
+        let ack_elapsed: Duration = self.delivered_time.saturating_duration_since(newest.delivered_time);
+        let interval: Duration = cmp::max(send_elapsed, ack_elapsed);
+        if interval.is_zero() {
+            return None;
+        }
+
+        let delivered: u64 = self.delivered - newest.delivered;
+        Some(RateSample {
+            delivery_rate: delivered as f64 / interval.as_secs_f64(),
+            rtt: self.rtt.take(),
+            delivered,
+            prior_delivered: newest.delivered,
+            total_delivered: self.delivered,
+            newly_delivered,
+            in_flight,
+            is_app_limited: newest.is_app_limited,
+            interval,
+        })
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        RateSample,
+        RateSampler,
+        RateSnapshot,
+    };
+    use ::std::time::{
+        Duration,
+        Instant,
+    };
+
+    #[test]
+    fn delivery_rate_sample() {
+        let start: Instant = Instant::now();
+        let ms = |n: u64| start + Duration::from_millis(n);
+        let mut sampler: RateSampler = RateSampler::new(start);
+
+        // Send ten 1000-byte segments, one every millisecond, and get each of them delivered 10 ms later.
+        let snapshots: Vec<RateSnapshot> = (0..10).map(|i| sampler.on_send(ms(i), i == 0)).collect();
+        for (i, snapshot) in snapshots.iter().enumerate() {
+            let now: Instant = ms(i as u64 + 10);
+            sampler.on_delivered(snapshot, 1000, Some(Duration::from_millis(10)), now);
+            if let Some(sample) = sampler.generate(9000 - 1000 * i as u32) {
+                assert_eq!(sample.rtt, Some(Duration::from_millis(10)));
+                assert_eq!(sample.newly_delivered, 1000);
+                assert!(!sample.is_app_limited);
+            }
+        }
+
+        // A segment sent later is sampled from the delivery state when it was sent: 1 kB over 11 ms.
+        let snapshot: RateSnapshot = sampler.on_send(ms(20), false);
+        sampler.on_delivered(&snapshot, 1000, None, ms(30));
+        let sample: RateSample = sampler.generate(0).expect("ACK should generate a sample");
+        assert_eq!(sample.prior_delivered, 10000);
+        assert_eq!(sample.total_delivered, 11000);
+        assert_eq!(sample.rtt, None);
+        assert_eq!(sample.interval, Duration::from_millis(11));
+        assert!((sample.delivery_rate - 1000.0 / 0.011).abs() < 1e-6);
+
+        // Data sent while the application has nothing to send yields application-limited samples.
+        sampler.on_app_limited(0);
+        let snapshot: RateSnapshot = sampler.on_send(ms(100), true);
+        sampler.on_delivered(&snapshot, 500, None, ms(110));
+        let sample: RateSample = sampler.generate(0).expect("ACK should generate a sample");
+        assert!(sample.is_app_limited);
+    }
 }
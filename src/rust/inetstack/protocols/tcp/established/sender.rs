@@ -1,15 +1,36 @@
 // Copyright (c) Microsoft Corporation.
 // Licensed under the MIT license.
 
-use super::ControlBlock;
+use super::{
+    ranges::SeqRanges,
+    recovery::{
+        LossRecovery,
+        DUP_THRESH,
+    },
+    rto::{
+        RateSample,
+        RateSampler,
+        RateSnapshot,
+    },
+    ControlBlock,
+};
 use crate::{
     inetstack::protocols::tcp::{
-        segment::TcpHeader,
+        segment::{
+            TcpHeader,
+            TcpOptions2,
+        },
         SeqNumber,
     },
+    pal::arch,
+    perftools::stats,
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
+        network::{
+            config::TcpLossRecovery,
+            types::MacAddress,
+        },
         watched::{
             WatchFuture,
             WatchedValue,
@@ -25,6 +46,7 @@ use ::std::{
         Cell,
         RefCell,
     },
+    cmp,
     collections::VecDeque,
     convert::TryInto,
     fmt,
@@ -42,6 +64,10 @@ pub struct UnackedSegment {
     pub bytes: DemiBuffer,
     // Set to `None` on retransmission to implement Karn's algorithm.
     pub initial_tx: Option<Instant>,
+    // Time of the most recent (re)transmission, used by RACK to detect lost segments.
+    pub last_tx: Instant,
+    // Delivery state at the most recent (re)transmission, used to sample the delivery rate.
+    pub rate: RateSnapshot,
 }
 
 /// Hard limit for unsent queue.
@@ -71,6 +97,15 @@ pub struct Sender {
     // Queue of unacknowledged sent data.  RFC 793 calls this the "retransmission queue".
     unacked_queue: RefCell<VecDeque<UnackedSegment>>,
 
+    // Unacknowledged sent data that our peer has reported in SACK blocks (RFC 2018), i.e. the SACK scoreboard.
+    sacked: RefCell<SeqRanges>,
+
+    // Loss recovery state, to retransmit lost segments before the retransmission timer expires.
+    recovery: RefCell<LossRecovery>,
+
+    // Delivery rate sampler, fed with the segments that get acknowledged.
+    rate_sampler: RefCell<RateSampler>,
+
     // Sequence Number of the next data to be sent.  In RFC 793 terms, this is SND.NXT.
     send_next: WatchedValue<SeqNumber>,
 
@@ -107,10 +142,20 @@ impl fmt::Debug for Sender {
 }
 
 impl Sender {
-    pub fn new(seq_no: SeqNumber, send_window: u32, window_scale: u8, mss: usize) -> Self {
+    pub fn new(
+        seq_no: SeqNumber,
+        send_window: u32,
+        window_scale: u8,
+        mss: usize,
+        loss_recovery: TcpLossRecovery,
+        now: Instant,
+    ) -> Self {
         Self {
             send_unacked: WatchedValue::new(seq_no),
             unacked_queue: RefCell::new(VecDeque::new()),
+            sacked: RefCell::new(SeqRanges::new(seq_no)),
+            recovery: RefCell::new(LossRecovery::new(loss_recovery, seq_no)),
+            rate_sampler: RefCell::new(RateSampler::new(now)),
             send_next: WatchedValue::new(seq_no),
             unsent_queue: RefCell::new(VecDeque::new()),
             unsent_seq_no: WatchedValue::new(seq_no),
@@ -128,6 +173,13 @@ impl Sender {
         self.mss
     }
 
+    // Prefetches the state that is updated when an ACK arrives.
+    pub fn prefetch(&self) {
+        arch::prefetch(&self.send_unacked as *const WatchedValue<SeqNumber>);
+        arch::prefetch(&self.send_window as *const WatchedValue<u32>);
+        arch::prefetch(&self.unacked_queue as *const RefCell<VecDeque<UnackedSegment>>);
+    }
+
     pub fn get_send_window(&self) -> (u32, WatchFuture<u32>) {
         self.send_window.watch()
     }
@@ -148,8 +200,47 @@ impl Sender {
         self.unsent_seq_no.watch()
     }
 
-    pub fn push_unacked_segment(&self, segment: UnackedSegment) {
-        self.unacked_queue.borrow_mut().push_back(segment)
+    // Takes a snapshot of the delivery state for a segment that is about to be put on the unacknowledged queue.
+    pub fn rate_snapshot(&self, now: Instant) -> RateSnapshot {
+        let nothing_in_flight: bool = self.unacked_queue.borrow().is_empty();
+        self.rate_sampler.borrow_mut().on_send(now, nothing_in_flight)
+    }
+
+    // Records that we ran out of data to send.  Unless the congestion window is already full, delivery rate samples
+    // then reflect how fast the application sends, rather than what the network may deliver.
+    pub fn on_app_limited(&self, cwnd: u32) {
+        let in_flight: u32 = (self.send_next.get() - self.send_unacked.get()).into();
+        if in_flight < cwnd {
+            self.rate_sampler.borrow_mut().on_app_limited(in_flight);
+        }
+    }
+
+    // Generates a delivery rate sample for the ACK that was just processed, if it delivered new data.
+    pub fn take_rate_sample(&self) -> Option<RateSample> {
+        let in_flight: u32 = (self.send_next.get() - self.send_unacked.get()).into();
+        self.rate_sampler.borrow_mut().generate(in_flight)
+    }
+
+    pub fn push_unacked_segment(&self, segment: UnackedSegment, cb: &ControlBlock) {
+        self.unacked_queue.borrow_mut().push_back(segment);
+        self.arm_loss_probe(cb);
+    }
+
+    /// Checks that `nb_segs` buffers can be handed to [Sender::send] in a row without any of them being refused, so
+    /// a buffer chain is either queued as a whole or not at all. Buffer segments are at most 64 KiB long, so they
+    /// never exceed the size limit of a single send.
+    pub fn check_send(&self, nb_segs: usize, cb: &ControlBlock) -> Result<(), Fail> {
+        if cb.user_is_done_sending.get() {
+            return Err(Fail::new(EINVAL, "Connection is closing"));
+        }
+
+        // Every buffer but the last one may end up on the unsent queue, and the last one must still fit under the
+        // cutoff (see below).
+        if self.unsent_queue.borrow().len() + nb_segs > UNSENT_QUEUE_CUTOFF + 1 {
+            return Err(Fail::new(EBUSY, "too many packets to send"));
+        }
+
+        Ok(())
     }
 
     // This is the main TCP send routine.
@@ -210,12 +301,26 @@ impl Sender {
 
             let win_sz: u32 = self.send_window.get();
 
-            if win_sz > 0 && win_sz >= in_flight_after_send && effective_cwnd >= in_flight_after_send {
+            // If congestion control paces our data and it is too early to send more, let the background sender wait.
+            let paced: bool = match cb.get_pacing_deadline() {
+                Some(deadline) => deadline > cb.clock.now() + cb.clock.granularity(),
+                None => false,
+            };
+
+            // Small segments may be held back to be coalesced with later data (see ControlBlock::may_send_partial()).
+            let coalesced: bool = buf_len > 0 && (buf_len as usize) < self.mss && !cb.may_send_partial(sent_data);
+
+            if win_sz > 0
+                && win_sz >= in_flight_after_send
+                && effective_cwnd >= in_flight_after_send
+                && !paced
+                && !coalesced
+            {
                 if let Some(remote_link_addr) = cb.arp().try_query(cb.get_remote().ip().clone()) {
                     // This hook is primarily intended to record the last time we sent data, so we can later tell if
                     // the connection has been idle.
                     let rto: Duration = cb.rto();
-                    cb.congestion_control_on_send(rto, sent_data);
+                    cb.congestion_control_on_send(rto, sent_data, buf_len);
 
                     // Prepare the segment and send it.
                     let mut header: TcpHeader = cb.tcp_header();
@@ -236,11 +341,14 @@ impl Sender {
                     self.unsent_seq_no.modify(|s| s + SeqNumber::from(buf_len));
 
                     // Put the segment we just sent on the retransmission queue.
+                    let now: Instant = cb.clock.now();
                     let unacked_segment = UnackedSegment {
                         bytes: buf,
-                        initial_tx: Some(cb.clock.now()),
+                        initial_tx: Some(now),
+                        last_tx: now,
+                        rate: self.rate_snapshot(now),
                     };
-                    self.unacked_queue.borrow_mut().push_back(unacked_segment);
+                    self.push_unacked_segment(unacked_segment, cb);
 
                     // Start the retransmission timer if it isn't already running.
                     if cb.get_retransmit_deadline().is_none() {
@@ -269,34 +377,269 @@ impl Sender {
         Ok(())
     }
 
-    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer.
+    /// Retransmits the earliest segment that has not (yet) been acknowledged by our peer.  If our peer has reported
+    /// data beyond it in SACK blocks, also retransmits the other holes below that data, as far as the congestion
+    /// window allows.
     pub fn retransmit(&self, cb: &ControlBlock) {
+        let mut unacked_queue = self.unacked_queue.borrow_mut();
+
         // Check that we have an unacknowledged segment.
-        if let Some(segment) = self.unacked_queue.borrow_mut().front_mut() {
-            // We're retransmitting this, so we can no longer use an ACK for it as an RTT measurement (as we can't tell
-            // if the ACK is for the original or the retransmission).  Remove the transmission timestamp from the entry.
-            segment.initial_tx.take();
+        if unacked_queue.is_empty() {
+            // We shouldn't enter the retransmit routine with an empty unacknowledged queue.  So maybe we should assert
+            // here?  But this is relatively benign if it happens, and could be the result of a race-condition or a
+            // mismanaged retransmission timer, so asserting would be over-reacting.
+            warn!("Retransmission with empty unacknowledged queue?");
+            return;
+        }
+
+        // ToDo: Remove this if clause once emit() is fixed to not require the remote hardware addr.
+        let first_hop_link_addr: MacAddress = match cb.arp().try_query(cb.get_remote().ip().clone()) {
+            Some(link_addr) => link_addr,
+            None => return,
+        };
+
+        let sacked = self.sacked.borrow();
+        let mut recovery = self.recovery.borrow_mut();
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let highest_sacked: SeqNumber = sacked.highest().unwrap_or(send_unacked);
+        let cwnd: usize = cb.congestion_control_get_cwnd() as usize;
+        let now: Instant = cb.clock.now();
+        let mut seq_num: SeqNumber = send_unacked;
+        let mut bytes_retransmitted: usize = 0;
+
+        for (index, segment) in unacked_queue.iter_mut().enumerate() {
+            let seg_end: SeqNumber = seq_num + SeqNumber::from(sequence_length(segment));
+
+            // The earliest segment is always retransmitted.  Later ones only if they lie in a hole below SACK'd data.
+            if index > 0 {
+                if seq_num >= highest_sacked || bytes_retransmitted >= cwnd {
+                    break;
+                }
+                if sacked.contains(seq_num, seg_end) {
+                    seq_num = seg_end;
+                    continue;
+                }
+            }
+
+            bytes_retransmitted += segment.bytes.len();
+            self.retransmit_segment(cb, segment, seq_num, now, first_hop_link_addr);
+            recovery.on_retransmit(seg_end);
+            seq_num = seg_end;
+        }
+    }
+
+    // Retransmits `segment`, which starts at `seq_num`.
+    //
+    fn retransmit_segment(
+        &self,
+        cb: &ControlBlock,
+        segment: &mut UnackedSegment,
+        seq_num: SeqNumber,
+        now: Instant,
+        first_hop_link_addr: MacAddress,
+    ) {
+        // We're retransmitting this, so we can no longer use an ACK for it as an RTT measurement (as we can't tell
+        // if the ACK is for the original or the retransmission).  Remove the transmission timestamp from the entry.
+        segment.initial_tx.take();
+        segment.last_tx = now;
+        stats::record(|stats| stats.retransmits.add(1));
+        segment.rate = self.rate_sampler.borrow_mut().on_send(now, false);
+
+        // Clone the segment data for retransmission.
+        let data: DemiBuffer = segment.bytes.clone();
+
+        // ToDo: Issue #198 Repacketization - we should send a full MSS (and set the FIN flag if applicable).
+
+        // Prepare and send the segment.
+        let mut header: TcpHeader = cb.tcp_header();
+        header.seq_num = seq_num;
+        if data.len() == 0 {
+            // This buffer is the end-of-send marker.  Retransmit the FIN.
+            header.fin = true;
+        }
+        cb.emit(header, Some(data), first_hop_link_addr);
+    }
+
+    // Processes an incoming ACK for loss recovery, after the acknowledged data has been removed from the
+    // unacknowledged queue.  Updates the SACK scoreboard, then looks for lost segments and retransmits them.
+    //
+    pub fn on_ack_received(&self, cb: &ControlBlock, header: &TcpHeader, advanced: bool, now: Instant) {
+        self.receive_sack_blocks(header);
+
+        let mut recovery = self.recovery.borrow_mut();
+        recovery.on_cumulative_ack(self.send_unacked.get());
+        if recovery.mode() == TcpLossRecovery::Rto {
+            return;
+        }
+        self.recover_losses(cb, &mut recovery, now);
+
+        // RFC 8985 Section 7.2: Restart the probe timer when an ACK acknowledges new data.
+        if advanced {
+            self.arm_probe(cb, &mut recovery, now);
+        }
+        cb.set_recovery_deadline(recovery.deadline());
+    }
 
-            // Clone the segment data for retransmission.
-            let data: DemiBuffer = segment.bytes.clone();
+    // Handles the expiration of the loss recovery timer.  This either means that segments that we suspected to be
+    // reordered are now deemed lost, or that it's time for a tail loss probe.
+    //
+    pub fn on_recovery_timeout(&self, cb: &ControlBlock) {
+        let now: Instant = cb.clock.now();
+        let mut recovery = self.recovery.borrow_mut();
+        let probe_due: bool = recovery.probe_due(now);
+        self.recover_losses(cb, &mut recovery, now);
+        if probe_due {
+            recovery.disarm_probe();
+            self.send_loss_probe(cb, &mut recovery, now);
+        }
+        cb.set_recovery_deadline(recovery.deadline());
+    }
+
+    // Forgets about loss recovery after the retransmission timer expired.
+    //
+    pub fn on_retransmit_timeout(&self, cb: &ControlBlock) {
+        self.recovery.borrow_mut().on_rto();
+        cb.set_recovery_deadline(None);
+    }
+
+    // Walks the unacknowledged queue, and retransmits the segments that are deemed lost, as far as the congestion
+    // window allows.  In SACK mode, this is RFC 6675's IsLost(), with SACK'd bytes standing in for SACK'd segments.
+    // In RACK-TLP mode, this is RFC 8985's RACK_detect_loss(), and also arms the reordering timer.
+    //
+    fn recover_losses(&self, cb: &ControlBlock, recovery: &mut LossRecovery, now: Instant) {
+        let mut unacked_queue = self.unacked_queue.borrow_mut();
+        let sacked = self.sacked.borrow();
+        recovery.set_reorder_deadline(None);
+        if unacked_queue.is_empty() || sacked.is_empty() {
+            // Without SACK information, we can't tell a lost segment from one that is still in flight.
+            return;
+        }
+
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let send_next: SeqNumber = self.send_next.get();
+        let srtt: Option<Duration> = cb.srtt();
+
+        // Let RACK know about the delivery of SACK'd segments, and count how much data was SACK'd.
+        let mut seq_num: SeqNumber = send_unacked;
+        for segment in unacked_queue.iter() {
+            let seg_end: SeqNumber = seq_num + SeqNumber::from(sequence_length(segment));
+            if sacked.contains(seq_num, seg_end) {
+                recovery.on_delivered(segment.last_tx, seg_end, segment.initial_tx.is_none(), now);
+            }
+            seq_num = seg_end;
+        }
+        let sacked_bytes: u32 = sacked.iter().map(|(start, end)| u32::from(end - start)).sum();
+
+        // Retransmit no more than the congestion window allows, given the data that is still in the network.  But
+        // always allow for one segment, so recovery makes progress.
+        let in_network: u32 = u32::from(send_next - send_unacked).saturating_sub(sacked_bytes);
+        let mut budget: u32 = cmp::max(
+            cb.congestion_control_get_cwnd().saturating_sub(in_network),
+            self.mss as u32,
+        );
+
+        let first_hop_link_addr: MacAddress = match cb.arp().try_query(cb.get_remote().ip().clone()) {
+            Some(link_addr) => link_addr,
+            None => return,
+        };
+
+        let mut sacked_bytes_above: u32 = sacked_bytes;
+        let mut reorder_deadline: Option<Instant> = None;
+        let mut seq_num: SeqNumber = send_unacked;
+        for segment in unacked_queue.iter_mut() {
+            let seg_len: u32 = sequence_length(segment);
+            let seg_end: SeqNumber = seq_num + SeqNumber::from(seg_len);
+            if sacked.contains(seq_num, seg_end) {
+                sacked_bytes_above = sacked_bytes_above.saturating_sub(seg_len);
+                seq_num = seg_end;
+                continue;
+            }
 
-            // ToDo: Issue #198 Repacketization - we should send a full MSS (and set the FIN flag if applicable).
+            let lost: bool = match recovery.mode() {
+                TcpLossRecovery::Rto => false,
+                TcpLossRecovery::Sack => {
+                    seq_num >= recovery.high_retransmitted() && sacked_bytes_above >= DUP_THRESH * self.mss as u32
+                },
+                TcpLossRecovery::RackTlp => {
+                    if recovery.sent_before_delivered(segment.last_tx, seg_end) {
+                        let deadline: Instant = recovery.loss_deadline(segment.last_tx, srtt);
+                        if deadline <= now {
+                            true
+                        } else {
+                            reorder_deadline = cmp::max(reorder_deadline, Some(deadline));
+                            false
+                        }
+                    } else {
+                        false
+                    }
+                },
+            };
+
+            if lost && budget > 0 {
+                debug!("Retransmitting lost segment at {}", seq_num);
+                recovery.enter_recovery(send_next);
+                self.retransmit_segment(cb, segment, seq_num, now, first_hop_link_addr);
+                recovery.on_retransmit(seg_end);
+                budget = budget.saturating_sub(seg_len);
+            }
+            seq_num = seg_end;
+        }
+        recovery.set_reorder_deadline(reorder_deadline);
+    }
 
-            // Prepare and send the segment.
+    // Sends a tail loss probe, to elicit an ACK (possibly with SACK blocks) that reveals losses at the tail of the
+    // current flight of data.  As new data is sent by the background sender whenever it can be, we retransmit the
+    // last segment instead (RFC 8985, Section 7.3).
+    //
+    fn send_loss_probe(&self, cb: &ControlBlock, recovery: &mut LossRecovery, now: Instant) {
+        let mut unacked_queue = self.unacked_queue.borrow_mut();
+        let send_next: SeqNumber = self.send_next.get();
+        if let Some(segment) = unacked_queue.back_mut() {
             if let Some(first_hop_link_addr) = cb.arp().try_query(cb.get_remote().ip().clone()) {
-                let mut header: TcpHeader = cb.tcp_header();
-                header.seq_num = self.send_unacked.get();
-                if data.len() == 0 {
-                    // This buffer is the end-of-send marker.  Retransmit the FIN.
-                    header.fin = true;
-                }
-                cb.emit(header, Some(data), first_hop_link_addr);
+                trace!("Sending tail loss probe");
+                let seq_num: SeqNumber = send_next - SeqNumber::from(sequence_length(segment));
+                self.retransmit_segment(cb, segment, seq_num, now, first_hop_link_addr);
+                recovery.on_probe_sent(send_next);
             }
+        }
+    }
+
+    // (Re)starts the tail loss probe timer after new data has been sent.
+    //
+    fn arm_loss_probe(&self, cb: &ControlBlock) {
+        let mut recovery = self.recovery.borrow_mut();
+        if recovery.mode() == TcpLossRecovery::RackTlp {
+            self.arm_probe(cb, &mut recovery, cb.clock.now());
+            cb.set_recovery_deadline(recovery.deadline());
+        }
+    }
+
+    fn arm_probe(&self, cb: &ControlBlock, recovery: &mut LossRecovery, now: Instant) {
+        let unacked_queue = self.unacked_queue.borrow();
+        if unacked_queue.is_empty() {
+            recovery.disarm_probe();
         } else {
-            // We shouldn't enter the retransmit routine with an empty unacknowledged queue.  So maybe we should assert
-            // here?  But this is relatively benign if it happens, and could be the result of a race-condition or a
-            // mismanaged retransmission timer, so asserting would be over-reacting.
-            warn!("Retransmission with empty unacknowledged queue?");
+            recovery.arm_probe(now, cb.srtt(), cb.rto(), unacked_queue.len() == 1);
+        }
+    }
+
+    // Update the SACK scoreboard with the SACK blocks (if any) of an incoming ACK.  Blocks that don't lie within the
+    // unacknowledged sequence space are bogus, and ignored.
+    //
+    fn receive_sack_blocks(&self, header: &TcpHeader) {
+        let mut sacked = self.sacked.borrow_mut();
+        let send_unacked: SeqNumber = self.send_unacked.get();
+        let send_next: SeqNumber = self.send_next.get();
+        sacked.advance(send_unacked);
+
+        for option in header.iter_options() {
+            if let TcpOptions2::SelectiveAcknowlegement { num_sacks, sacks } = option {
+                for sack in sacks.iter().take(*num_sacks) {
+                    if send_unacked < sack.begin && sack.begin < sack.end && sack.end <= send_next {
+                        sacked.insert(sack.begin, sack.end);
+                    }
+                }
+            }
         }
     }
 
@@ -304,16 +647,25 @@ impl Sender {
     //
     pub fn remove_acknowledged_data(&self, cb: &ControlBlock, bytes_acknowledged: u32, now: Instant) {
         let mut bytes_remaining: usize = bytes_acknowledged as usize;
+        let mut recovery = self.recovery.borrow_mut();
+        let mut rate_sampler = self.rate_sampler.borrow_mut();
+        let mut seq_num: SeqNumber = self.send_unacked.get();
 
         while bytes_remaining != 0 {
             if let Some(segment) = self.unacked_queue.borrow_mut().front_mut() {
                 // Add sample for RTO if we have an initial transmit time.
                 // Note that in the case of repacketization, an ack for the first byte is enough for the time sample.
                 // ToDo: TCP timestamp support.
-                if let Some(initial_tx) = segment.initial_tx {
-                    cb.rto_add_sample(now - initial_tx);
+                let rtt: Option<Duration> = segment.initial_tx.map(|initial_tx| now - initial_tx);
+                if let Some(rtt) = rtt {
+                    cb.rto_add_sample(rtt);
                 }
 
+                // Count the acknowledged data as delivered.  Data that our peer has SACK'd is only counted once it is
+                // cumulatively acknowledged.
+                let bytes_delivered: u32 = cmp::min(sequence_length(segment) as usize, bytes_remaining) as u32;
+                rate_sampler.on_delivered(&segment.rate, bytes_delivered, rtt, now);
+
                 if segment.bytes.len() > bytes_remaining {
                     // Only some of the data in this segment has been acked.  Remove just the acked amount.
                     segment
@@ -334,6 +686,10 @@ impl Sender {
                 }
 
                 bytes_remaining -= segment.bytes.len();
+
+                // Let RACK know about the delivery of this segment.
+                seq_num = seq_num + SeqNumber::from(sequence_length(segment));
+                recovery.on_delivered(segment.last_tx, seq_num, segment.initial_tx.is_none(), now);
             } else {
                 debug_assert!(false); // Shouldn't have bytes_remaining with no segments remaining in unacked_queue.
             }
@@ -360,12 +716,42 @@ impl Sender {
         Some(cloned_buf)
     }
 
-    pub fn pop_unsent(&self, max_bytes: usize) -> Option<DemiBuffer> {
-        // TODO: Use a scatter/gather array to coalesce multiple buffers into a single segment.
+    pub fn pop_unsent(&self, max_bytes: usize, coalesce: bool) -> Option<DemiBuffer> {
         let mut unsent_queue = self.unsent_queue.borrow_mut();
         let mut buf: DemiBuffer = unsent_queue.pop_front()?;
         let buf_len: usize = buf.len();
 
+        // If asked to, coalesce small buffers into a single segment of up to one MSS, rather than sending a segment for
+        // each of them.  Buffers that are larger are sent as they are, to avoid the copy.  Empty buffers mark the end
+        // of the stream, so they are never coalesced.
+        let coalesce_size: usize = cmp::min(max_bytes, self.mss);
+        if coalesce && buf_len > 0 && buf_len < coalesce_size {
+            let mut segment_len: usize = buf_len;
+            for next in unsent_queue.iter() {
+                if next.is_empty() || segment_len >= coalesce_size {
+                    break;
+                }
+                segment_len = cmp::min(segment_len + next.len(), coalesce_size);
+            }
+            if segment_len > buf_len {
+                let mut segment: DemiBuffer = DemiBuffer::new(segment_len as u16);
+                segment[..buf_len].copy_from_slice(&buf);
+                let mut offset: usize = buf_len;
+                while offset < segment_len {
+                    let next: &mut DemiBuffer = unsent_queue.front_mut().expect("coalesced buffer should be queued");
+                    let len: usize = cmp::min(next.len(), segment_len - offset);
+                    segment[offset..offset + len].copy_from_slice(&next[..len]);
+                    if len == next.len() {
+                        unsent_queue.pop_front();
+                    } else {
+                        next.adjust(len).expect("'next' should contain at least 'len' bytes");
+                    }
+                    offset += len;
+                }
+                return Some(segment);
+            }
+        }
+
         if buf_len > max_bytes {
             let mut cloned_buf: DemiBuffer = buf.clone();
 
@@ -412,3 +798,9 @@ impl Sender {
         self.mss
     }
 }
+
+// Returns the amount of sequence number space that `segment` consumes.  The end-of-send marker holds no data, but
+// consumes one sequence number (for the FIN).
+fn sequence_length(segment: &UnackedSegment) -> u32 {
+    cmp::max(segment.bytes.len() as u32, 1)
+}
@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use ::std::{
+    cell::{
+        RefCell,
+        RefMut,
+    },
+    collections::HashMap,
+    hash::{
+        BuildHasherDefault,
+        Hash,
+        Hasher,
+    },
+    net::SocketAddrV4,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Multiplier of [FlowHasher] (the one of FxHash).
+const FLOW_HASH_SEED: u64 = 0x51_7c_c1_b7_27_22_0a_95;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Four-tuple of a connection, from the point of view of the local host.
+#[derive(Clone, Copy, PartialEq, Eq)]
+pub struct FlowKey {
+    local: SocketAddrV4,
+    remote: SocketAddrV4,
+}
+
+/// Non-cryptographic hasher for flow keys. Remote hosts cannot pick four-tuples freely (they do not choose the local
+/// address, and connections are only set up on listening ports), so flooding attacks on the hash are not a concern
+/// here, and SipHash is needlessly slow.
+#[derive(Default)]
+pub struct FlowHasher {
+    hash: u64,
+}
+
+/// Flow Table
+///
+/// Maps the four-tuple of each connection straight to its state, so that inbound segments can be demultiplexed with a
+/// single lookup. Streaming workloads tend to receive bursts of segments of the same flow, so the last flow that was
+/// looked up is kept aside, and checked before the table itself.
+pub struct FlowTable<T: Clone> {
+    /// Flows, indexed by four-tuple.
+    flows: HashMap<FlowKey, T, BuildHasherDefault<FlowHasher>>,
+    /// Last flow that was looked up.
+    last: RefCell<Option<(FlowKey, T)>>,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Flow Keys
+impl FlowKey {
+    /// Creates the flow key of a connection between `local` and `remote`.
+    pub fn new(local: SocketAddrV4, remote: SocketAddrV4) -> Self {
+        Self { local, remote }
+    }
+}
+
+/// Associate Functions for Flow Tables
+impl<T: Clone> FlowTable<T> {
+    /// Creates an empty flow table.
+    pub fn new() -> Self {
+        Self {
+            flows: HashMap::default(),
+            last: RefCell::new(None),
+        }
+    }
+
+    /// Adds a flow, replacing any existing one with the same four-tuple.
+    pub fn insert(&mut self, key: FlowKey, flow: T) {
+        self.evict(&key);
+        self.flows.insert(key, flow);
+    }
+
+    /// Removes a flow.
+    pub fn remove(&mut self, key: &FlowKey) -> Option<T> {
+        self.evict(key);
+        self.flows.remove(key)
+    }
+
+    /// Looks up a flow.
+    pub fn get(&self, key: &FlowKey) -> Option<T> {
+        if let Some((last_key, last_flow)) = self.last.borrow().as_ref() {
+            if last_key == key {
+                return Some(last_flow.clone());
+            }
+        }
+        let flow: T = self.flows.get(key)?.clone();
+        *self.last.borrow_mut() = Some((*key, flow.clone()));
+        Some(flow)
+    }
+
+    /// Looks up a flow without remembering it as the last one, e.g. to prefetch its state ahead of processing a batch
+    /// of segments, which would otherwise thrash the last-flow cache.
+    pub fn peek(&self, key: &FlowKey) -> Option<&T> {
+        self.flows.get(key)
+    }
+
+    /// Drops the last flow that was looked up, if it is the one of `key`.
+    fn evict(&self, key: &FlowKey) {
+        let mut last: RefMut<Option<(FlowKey, T)>> = self.last.borrow_mut();
+        if matches!(last.as_ref(), Some((last_key, _)) if last_key == key) {
+            *last = None;
+        }
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Hash Trait Implementation for Flow Keys
+impl Hash for FlowKey {
+    fn hash<H: Hasher>(&self, state: &mut H) {
+        // Pack the four-tuple into two words, so that it is hashed in two steps.
+        let ports: u64 = (self.local.port() as u64) << 16 | self.remote.port() as u64;
+        state.write_u64((u32::from(*self.local.ip()) as u64) << 32 | ports);
+        state.write_u64(u32::from(*self.remote.ip()) as u64);
+    }
+}
+
+/// Hasher Trait Implementation for Flow Hashers
+impl Hasher for FlowHasher {
+    fn write(&mut self, bytes: &[u8]) {
+        for &byte in bytes {
+            self.write_u64(byte as u64);
+        }
+    }
+
+    fn write_u64(&mut self, word: u64) {
+        self.hash = (self.hash.rotate_left(5) ^ word).wrapping_mul(FLOW_HASH_SEED);
+    }
+
+    fn finish(&self) -> u64 {
+        // The multiplication leaves the entropy in the upper bits, whereas buckets are picked with the lower ones.
+        self.hash.rotate_left(26)
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        FlowKey,
+        FlowTable,
+    };
+    use ::std::net::{
+        Ipv4Addr,
+        SocketAddrV4,
+    };
+
+    /// Builds the flow key of a connection from the local host to the `i`-th port of a remote host.
+    fn key(i: u16) -> FlowKey {
+        FlowKey::new(
+            SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 1), 80),
+            SocketAddrV4::new(Ipv4Addr::new(192, 168, 1, 2), 1024 + i),
+        )
+    }
+
+    #[test]
+    fn lookup_flows() {
+        let mut table: FlowTable<u32> = FlowTable::new();
+        for i in 0..1000 {
+            table.insert(key(i), i as u32);
+        }
+
+        // Repeated lookups of the same flow are served by the last-flow cache, which tracks removals.
+        assert_eq!(table.get(&key(7)), Some(7));
+        assert_eq!(table.get(&key(7)), Some(7));
+        assert_eq!(table.remove(&key(7)), Some(7));
+        assert_eq!(table.get(&key(7)), None);
+
+        // Replacing a flow replaces the cached one too.
+        assert_eq!(table.get(&key(8)), Some(8));
+        table.insert(key(8), 42);
+        assert_eq!(table.get(&key(8)), Some(42));
+
+        assert_eq!(table.get(&key(999)), Some(999));
+        assert_eq!(table.get(&key(1000)), None);
+    }
+
+    #[test]
+    fn peek_flows() {
+        let mut table: FlowTable<u32> = FlowTable::new();
+        for i in 0..4 {
+            table.insert(key(i), i as u32);
+        }
+
+        // Peeks don't disturb the last-flow cache, even if the flow is replaced in between.
+        assert_eq!(table.get(&key(1)), Some(1));
+        assert_eq!(table.peek(&key(2)), Some(&2));
+        assert_eq!(table.peek(&key(4)), None);
+        table.insert(key(1), 42);
+        assert_eq!(table.peek(&key(1)), Some(&42));
+        assert_eq!(table.get(&key(1)), Some(42));
+    }
+}
@@ -0,0 +1,343 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//! Large TCP segments.
+//!
+//! The sender hands down segments that carry more than one MSS worth of data. If the NIC supports TCP segmentation
+//! offload (TSO), these are handed out as is, along with the description of how to split them. Otherwise, they are
+//! split in software (GSO) in a single pass over the data: headers are serialized once into a template, and each
+//! segment only patches the few fields that change from one segment to the next.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::{
+    inetstack::protocols::{
+        ethernet2::ETHERNET2_HEADER_SIZE,
+        ip::{
+            checksum::{
+                self,
+                Checksum,
+            },
+            IpProtocol,
+        },
+        ipv4::{
+            Ipv4Header,
+            IPV4_HEADER_DEFAULT_SIZE,
+        },
+        tcp::segment::{
+            tcp_checksum,
+            TcpSegment,
+            MAX_TCP_HEADER_SIZE,
+        },
+    },
+    runtime::{
+        memory::DemiBuffer,
+        network::{
+            PacketBuf,
+            SegmentationOffload,
+        },
+    },
+};
+use ::std::cmp;
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Maximum size of the headers of a TCP segment.
+const MAX_HEADER_SIZE: usize = ETHERNET2_HEADER_SIZE + IPV4_HEADER_DEFAULT_SIZE + MAX_TCP_HEADER_SIZE;
+
+/// PSH and FIN flags in octet 13 of a TCP header. Only the last segment of a large segment carries them.
+const TCP_FLAGS_LAST_ONLY: u8 = (1 << 3) | (1 << 0);
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// TCP Segment for Segmentation Offload
+///
+/// Carries a payload larger than the MSS, which the NIC splits in segments of at most `mss` bytes.
+pub struct TcpTsoSegment {
+    segment: TcpSegment,
+    mss: usize,
+}
+
+/// Pre-Serialized TCP Segment
+///
+/// One of the segments that a large segment is split into by software segmentation.
+struct TcpGsoSegment {
+    header: [u8; MAX_HEADER_SIZE],
+    header_size: usize,
+    body: DemiBuffer,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for TCP Segments for Segmentation Offload
+impl TcpTsoSegment {
+    /// Creates a segment that the NIC splits in segments of at most `mss` bytes.
+    pub fn new(segment: TcpSegment, mss: usize) -> Self {
+        Self { segment, mss }
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Packet Buffer Trait Implementation for TCP Segments for Segmentation Offload
+impl PacketBuf for TcpTsoSegment {
+    fn header_size(&self) -> usize {
+        self.segment.header_size()
+    }
+
+    fn body_size(&self) -> usize {
+        self.segment.body_size()
+    }
+
+    fn write_header(&self, buf: &mut [u8]) {
+        let eth_hdr_size: usize = self.segment.ethernet2_hdr.compute_size();
+        let ipv4_hdr_size: usize = self.segment.ipv4_hdr.compute_size();
+        let tcp_hdr_size: usize = self.segment.tcp_hdr.compute_size();
+        let tcp_offset: usize = eth_hdr_size + ipv4_hdr_size;
+
+        self.segment.ethernet2_hdr.serialize(&mut buf[..eth_hdr_size]);
+        self.segment
+            .ipv4_hdr
+            .serialize(&mut buf[eth_hdr_size..tcp_offset], tcp_hdr_size + self.body_size());
+        self.segment.tcp_hdr.serialize(
+            &mut buf[tcp_offset..(tcp_offset + tcp_hdr_size)],
+            &self.segment.ipv4_hdr,
+            &[],
+            true,
+        );
+
+        // The NIC computes checksums of each segment. It expects the IPv4 checksum to be zeroed, and the TCP checksum
+        // to be seeded with the pseudo-header checksum without the length.
+        buf[(eth_hdr_size + 10)..(eth_hdr_size + 12)].copy_from_slice(&[0, 0]);
+        let seed: u16 = pseudo_header_checksum(&self.segment.ipv4_hdr);
+        buf[(tcp_offset + 16)..(tcp_offset + 18)].copy_from_slice(&seed.to_be_bytes());
+    }
+
+    fn take_body(&self) -> Option<DemiBuffer> {
+        self.segment.take_body()
+    }
+
+    fn segmentation_offload(&self) -> Option<SegmentationOffload> {
+        Some(SegmentationOffload {
+            l2_len: self.segment.ethernet2_hdr.compute_size(),
+            l3_len: self.segment.ipv4_hdr.compute_size(),
+            l4_len: self.segment.tcp_hdr.compute_size(),
+            segment_size: self.mss,
+        })
+    }
+}
+
+/// Packet Buffer Trait Implementation for Pre-Serialized TCP Segments
+impl PacketBuf for TcpGsoSegment {
+    fn header_size(&self) -> usize {
+        self.header_size
+    }
+
+    fn body_size(&self) -> usize {
+        self.body.len()
+    }
+
+    fn write_header(&self, buf: &mut [u8]) {
+        buf.copy_from_slice(&self.header[..self.header_size]);
+    }
+
+    fn take_body(&self) -> Option<DemiBuffer> {
+        Some(self.body.clone())
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Splits `segment` in segments that carry at most `mss` bytes each, and hands them to `transmit` in order.
+pub fn segment<F: FnMut(Box<dyn PacketBuf>)>(mut segment: TcpSegment, mss: usize, mut transmit: F) {
+    let body: DemiBuffer = match segment.data.take() {
+        Some(body) => body,
+        None => return transmit(Box::new(segment)),
+    };
+    let eth_hdr_size: usize = segment.ethernet2_hdr.compute_size();
+    let ipv4_hdr_size: usize = segment.ipv4_hdr.compute_size();
+    let tcp_hdr_size: usize = segment.tcp_hdr.compute_size();
+    let tcp_offset: usize = eth_hdr_size + ipv4_hdr_size;
+    let header_size: usize = tcp_offset + tcp_hdr_size;
+    debug_assert!(header_size <= MAX_HEADER_SIZE);
+
+    // Serialize the header template once. Checksums are filled in later, for each segment.
+    let tx_checksum_offload: bool = segment.tx_checksum_offload;
+    segment.tx_checksum_offload = true;
+    let mut template: [u8; MAX_HEADER_SIZE] = [0; MAX_HEADER_SIZE];
+    segment.write_header(&mut template[..header_size]);
+    let seq_num: u32 = u32::from(segment.tcp_hdr.seq_num);
+    let flags: u8 = template[tcp_offset + 13];
+    let template_total_length: u16 = u16::from_be_bytes([template[eth_hdr_size + 2], template[eth_hdr_size + 3]]);
+    let ipv4_checksum: u16 = u16::from_be_bytes([template[eth_hdr_size + 10], template[eth_hdr_size + 11]]);
+
+    let mut offset: usize = 0;
+    while offset < body.len() {
+        let len: usize = cmp::min(mss, body.len() - offset);
+        let is_last: bool = offset + len == body.len();
+
+        let mut chunk: DemiBuffer = body.clone();
+        chunk
+            .adjust(offset)
+            .expect("body should contain at least 'offset' bytes");
+        chunk
+            .trim(chunk.len() - len)
+            .expect("chunk should contain at least 'len' bytes");
+
+        let mut header: [u8; MAX_HEADER_SIZE] = template;
+
+        // Patch the IPv4 header. Only the total length changes, so its checksum is updated incrementally.
+        let ipv4_hdr: &mut [u8] = &mut header[eth_hdr_size..tcp_offset];
+        let total_length: u16 = (ipv4_hdr_size + tcp_hdr_size + len) as u16;
+        ipv4_hdr[2..4].copy_from_slice(&total_length.to_be_bytes());
+        let ipv4_checksum: u16 = checksum::update_u16(ipv4_checksum, template_total_length, total_length);
+        ipv4_hdr[10..12].copy_from_slice(&ipv4_checksum.to_be_bytes());
+
+        // Patch the TCP header.
+        let tcp_hdr: &mut [u8] = &mut header[tcp_offset..header_size];
+        tcp_hdr[4..8].copy_from_slice(&seq_num.wrapping_add(offset as u32).to_be_bytes());
+        if !is_last {
+            tcp_hdr[13] = flags & !TCP_FLAGS_LAST_ONLY;
+        }
+        if !tx_checksum_offload {
+            let tcp_checksum: u16 = tcp_checksum(&segment.ipv4_hdr, tcp_hdr, &chunk[..]);
+            tcp_hdr[16..18].copy_from_slice(&tcp_checksum.to_be_bytes());
+        }
+
+        transmit(Box::new(TcpGsoSegment {
+            header,
+            header_size,
+            body: chunk,
+        }));
+        offset += len;
+    }
+}
+
+/// Computes the checksum of the TCP pseudo-header of `ipv4_hdr`, without the length field and without complementing
+/// it. This is the seed that NICs expect when offloading segmentation.
+fn pseudo_header_checksum(ipv4_hdr: &Ipv4Header) -> u16 {
+    let mut checksum: Checksum = Checksum::new();
+    checksum.add_u32(u32::from(ipv4_hdr.get_src_addr()));
+    checksum.add_u32(u32::from(ipv4_hdr.get_dest_addr()));
+    checksum.add_u16(IpProtocol::TCP as u16);
+    checksum.fold()
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::segment;
+    use crate::{
+        inetstack::{
+            protocols::{
+                ethernet2::{
+                    EtherType2,
+                    Ethernet2Header,
+                },
+                ip::IpProtocol,
+                ipv4::Ipv4Header,
+                tcp::{
+                    segment::{
+                        TcpHeader,
+                        TcpSegment,
+                    },
+                    SeqNumber,
+                },
+            },
+            test_helpers::{
+                ALICE_IPV4,
+                ALICE_MAC,
+                BOB_IPV4,
+                BOB_MAC,
+            },
+        },
+        runtime::{
+            memory::DemiBuffer,
+            network::PacketBuf,
+        },
+    };
+
+    /// Builds a TCP segment that carries `body`.
+    fn build_segment(seq_num: u32, psh: bool, fin: bool, body: &[u8], tx_checksum_offload: bool) -> TcpSegment {
+        let mut tcp_hdr: TcpHeader = TcpHeader::new(80, 8080);
+        tcp_hdr.seq_num = SeqNumber::from(seq_num);
+        tcp_hdr.ack_num = SeqNumber::from(7);
+        tcp_hdr.ack = true;
+        tcp_hdr.psh = psh;
+        tcp_hdr.fin = fin;
+        tcp_hdr.window_size = 1024;
+        TcpSegment {
+            ethernet2_hdr: Ethernet2Header::new(BOB_MAC, ALICE_MAC, EtherType2::Ipv4),
+            ipv4_hdr: Ipv4Header::new(ALICE_IPV4, BOB_IPV4, IpProtocol::TCP),
+            tcp_hdr,
+            data: Some(DemiBuffer::from_slice(body).expect("body should fit in a buffer")),
+            tx_checksum_offload,
+        }
+    }
+
+    /// Serializes `pkt` into a byte vector.
+    fn serialize(pkt: &dyn PacketBuf) -> Vec<u8> {
+        let mut bytes: Vec<u8> = vec![0; pkt.header_size()];
+        pkt.write_header(&mut bytes[..]);
+        if let Some(body) = pkt.take_body() {
+            bytes.extend_from_slice(&body[..]);
+        }
+        bytes
+    }
+
+    /// Checks that software segmentation yields the same packets as building each segment by hand.
+    fn check_segment(mss: usize, body_size: usize, tx_checksum_offload: bool) {
+        let body: Vec<u8> = (0..body_size).map(|i| i as u8).collect();
+        let seq_num: u32 = u32::MAX - 100;
+
+        let mut pkts: Vec<Vec<u8>> = Vec::new();
+        segment(
+            build_segment(seq_num, true, true, &body, tx_checksum_offload),
+            mss,
+            |pkt| pkts.push(serialize(&*pkt)),
+        );
+
+        let chunks: Vec<&[u8]> = body.chunks(mss).collect();
+        assert_eq!(pkts.len(), chunks.len());
+        for (i, chunk) in chunks.iter().enumerate() {
+            let is_last: bool = i == chunks.len() - 1;
+            let expected: TcpSegment = build_segment(
+                seq_num.wrapping_add((i * mss) as u32),
+                is_last,
+                is_last,
+                chunk,
+                tx_checksum_offload,
+            );
+            assert_eq!(pkts[i], serialize(&expected));
+        }
+    }
+
+    #[test]
+    fn test_segment() {
+        check_segment(1000, 3000, false);
+        check_segment(1000, 2999, false);
+        check_segment(1000, 3001, true);
+        check_segment(1460, 65000, false);
+    }
+
+    #[test]
+    fn test_segment_small() {
+        check_segment(1000, 1, false);
+        check_segment(1000, 1000, false);
+    }
+}
@@ -4,7 +4,9 @@
 mod active_open;
 pub mod constants;
 mod established;
+mod flow_table;
 mod isn_generator;
+mod large_segment;
 pub mod operations;
 mod passive_open;
 pub mod peer;
@@ -16,7 +18,10 @@ mod sequence_number;
 mod tests;
 
 pub use self::{
-    established::congestion_control,
+    established::{
+        congestion_control,
+        ControlBlock,
+    },
     peer::TcpPeer,
     segment::{
         MAX_TCP_HEADER_SIZE,
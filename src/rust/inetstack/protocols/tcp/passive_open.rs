@@ -18,10 +18,7 @@ use crate::{
             ip::IpProtocol,
             ipv4::Ipv4Header,
             tcp::{
-                established::{
-                    congestion_control,
-                    congestion_control::CongestionControl,
-                },
+                established::congestion_control,
                 segment::{
                     TcpHeader,
                     TcpOptions2,
@@ -34,7 +31,10 @@ use crate::{
     runtime::{
         fail::Fail,
         network::{
-            config::TcpConfig,
+            config::{
+                TcpConfig,
+                TcpLossRecovery,
+            },
             types::MacAddress,
             NetworkRuntime,
         },
@@ -76,6 +76,7 @@ struct InflightAccept {
     header_window_size: u16,
     remote_window_scale: Option<u8>,
     mss: usize,
+    sack_permitted: bool,
 
     #[allow(unused)]
     handle: SchedulerHandle,
@@ -200,6 +201,7 @@ impl PassiveSocket {
                 header_window_size,
                 remote_window_scale,
                 mss,
+                sack_permitted,
                 ..
             } = self.inflight.get(&remote).unwrap();
             if header.ack_num != local_isn + SeqNumber::from(1) {
@@ -215,9 +217,9 @@ impl PassiveSocket {
                 .expect("TODO: Window size overflow")
                 .try_into()
                 .expect("TODO: Window size overflow");
-            let local_window_size = (self.tcp_config.get_receive_window_size() as u32)
-                .checked_shl(local_window_scale as u32)
-                .expect("TODO: Window size overflow");
+            let local_window_size: u32 = self
+                .tcp_config
+                .get_initial_receive_buffer_size(local_window_scale as u8);
             info!(
                 "Window sizes: local {}, remote {}",
                 local_window_size, remote_window_size
@@ -245,7 +247,8 @@ impl PassiveSocket {
                 remote_window_size,
                 remote_window_scale,
                 mss,
-                congestion_control::None::new,
+                sack_permitted,
+                congestion_control::constructor(self.tcp_config.get_congestion_control()),
                 None,
             );
             self.ready.borrow_mut().push_ok(cb);
@@ -263,6 +266,30 @@ impl PassiveSocket {
         }
         let local_isn = self.isn_generator.generate(&self.local, &remote);
         let remote_isn = header.seq_num;
+
+        let mut remote_window_scale = None;
+        let mut mss = FALLBACK_MSS;
+        let mut sack_permitted: bool = false;
+        for option in header.iter_options() {
+            match option {
+                TcpOptions2::WindowScale(w) => {
+                    info!("Received window scale: {:?}", w);
+                    remote_window_scale = Some(*w);
+                },
+                TcpOptions2::MaximumSegmentSize(m) => {
+                    info!("Received advertised MSS: {}", m);
+                    mss = *m as usize;
+                },
+                TcpOptions2::SelectiveAcknowlegementPermitted => {
+                    info!("Received SACK permitted");
+                    sack_permitted = true;
+                },
+                _ => continue,
+            }
+        }
+        // We don't negotiate SACK if we don't use it for loss recovery.
+        let sack_permitted: bool = sack_permitted && self.tcp_config.get_loss_recovery() != TcpLossRecovery::Rto;
+
         let future = Self::background(
             local_isn,
             remote_isn,
@@ -274,33 +301,20 @@ impl PassiveSocket {
             self.local_link_addr,
             self.arp.clone(),
             self.ready.clone(),
+            sack_permitted,
         );
         let handle: SchedulerHandle = match self.scheduler.insert(FutureOperation::Background(future.boxed_local())) {
             Some(handle) => handle,
             None => panic!("failed to insert task in the scheduler"),
         };
 
-        let mut remote_window_scale = None;
-        let mut mss = FALLBACK_MSS;
-        for option in header.iter_options() {
-            match option {
-                TcpOptions2::WindowScale(w) => {
-                    info!("Received window scale: {:?}", w);
-                    remote_window_scale = Some(*w);
-                },
-                TcpOptions2::MaximumSegmentSize(m) => {
-                    info!("Received advertised MSS: {}", m);
-                    mss = *m as usize;
-                },
-                _ => continue,
-            }
-        }
         let accept = InflightAccept {
             local_isn,
             remote_isn,
             header_window_size: header.window_size,
             remote_window_scale,
             mss,
+            sack_permitted,
             handle,
         };
         self.inflight.insert(remote, accept);
@@ -318,6 +332,7 @@ impl PassiveSocket {
         local_link_addr: MacAddress,
         arp: ArpPeer,
         ready: Rc<RefCell<ReadySockets>>,
+        sack_permitted: bool,
     ) -> impl Future<Output = ()> {
         let handshake_retries: usize = tcp_config.get_handshake_retries();
         let handshake_timeout: Duration = tcp_config.get_handshake_timeout();
@@ -345,6 +360,12 @@ impl PassiveSocket {
                 tcp_hdr.push_option(TcpOptions2::WindowScale(tcp_config.get_window_scale()));
                 info!("Advertising window scale: {}", tcp_config.get_window_scale());
 
+                // Only offer SACK if our peer offered it too (RFC 2018, Section 2).
+                if sack_permitted {
+                    tcp_hdr.push_option(TcpOptions2::SelectiveAcknowlegementPermitted);
+                    info!("Advertising SACK permitted");
+                }
+
                 debug!("Sending SYN+ACK: {:?}", tcp_hdr);
                 let segment = TcpSegment {
                     ethernet2_hdr: Ethernet2Header::new(remote_link_addr, local_link_addr, EtherType2::Ipv4),
@@ -8,6 +8,10 @@
 use super::{
     active_open::ActiveOpenSocket,
     established::EstablishedSocket,
+    flow_table::{
+        FlowKey,
+        FlowTable,
+    },
     isn_generator::IsnGenerator,
     passive_open::PassiveSocket,
     queue::TcpQueue,
@@ -46,7 +50,11 @@ use crate::{
         memory::DemiBuffer,
         network::{
             config::TcpConfig,
-            types::MacAddress,
+            consts::RECEIVE_BATCH_SIZE,
+            types::{
+                MacAddress,
+                SocketOption,
+            },
             NetworkRuntime,
         },
         queue::IoQueueTable,
@@ -55,6 +63,7 @@ use crate::{
     },
     scheduler::scheduler::Scheduler,
 };
+use ::arrayvec::ArrayVec;
 use ::futures::channel::mpsc;
 use ::rand::{
     prelude::SmallRng,
@@ -64,6 +73,7 @@ use ::rand::{
 
 use ::std::{
     cell::{
+        Cell,
         Ref,
         RefCell,
         RefMut,
@@ -113,6 +123,12 @@ pub struct Inner {
     qtable: Rc<RefCell<IoQueueTable<InetQueue>>>,
     // Connection or socket identifier for mapping incoming packets to the Demikernel queue
     addresses: HashMap<SocketId, QDesc>,
+    // Four-tuple -> control block of established and closing connections, for the fast path of incoming packets
+    flows: FlowTable<Rc<ControlBlock>>,
+    // queue descriptor -> control block of corked connections, which are flushed at the end of each poll
+    corked: HashMap<QDesc, Rc<ControlBlock>>,
+    // Whether a segment was routed to a connecting or listening socket since the last call to take_handshake()
+    handshake: Cell<bool>,
     rt: Rc<dyn NetworkRuntime>,
     scheduler: Scheduler,
     clock: TimerRc,
@@ -230,8 +246,27 @@ impl TcpPeer {
         }
     }
 
-    pub fn receive(&self, ip_header: &Ipv4Header, buf: DemiBuffer) -> Result<(), Fail> {
-        self.inner.borrow().receive(ip_header, buf)
+    /// Processes a segment. `flow` is the established connection it belongs to, if it was found by [TcpPeer::demux],
+    /// which spares looking it up again.
+    pub fn receive(&self, ip_header: &Ipv4Header, buf: DemiBuffer, flow: Option<Rc<ControlBlock>>) -> Result<(), Fail> {
+        self.inner.borrow().receive(ip_header, buf, flow)
+    }
+
+    /// Looks up the established connection between each pair of local and remote endpoints, if any, and prefetches
+    /// its state.
+    pub fn demux<I: Iterator<Item = Option<(SocketAddrV4, SocketAddrV4)>>>(
+        &self,
+        endpoints: I,
+    ) -> ArrayVec<Option<Rc<ControlBlock>>, RECEIVE_BATCH_SIZE> {
+        let inner: Ref<Inner> = self.inner.borrow();
+        endpoints
+            .map(|endpoints| {
+                let (local, remote): (SocketAddrV4, SocketAddrV4) = endpoints?;
+                let cb: &Rc<ControlBlock> = inner.flows.peek(&FlowKey::new(local, remote))?;
+                cb.prefetch();
+                Some(cb.clone())
+            })
+            .collect()
     }
 
     // Marks the target socket as passive.
@@ -301,12 +336,13 @@ impl TcpPeer {
     ) -> Poll<Result<(QDesc, SocketAddrV4), Fail>> {
         let mut inner: RefMut<Inner> = self.inner.borrow_mut();
 
-        let cb: ControlBlock = match inner.qtable.borrow_mut().get_mut(&qd) {
+        // Accepted connections inherit the options of the listening socket.
+        let (cb, options): (ControlBlock, [SocketOption; 2]) = match inner.qtable.borrow_mut().get_mut(&qd) {
             Some(InetQueue::Tcp(queue)) => match queue.get_mut_socket() {
                 Socket::Listening(socket) => match socket.poll_accept(ctx) {
                     Poll::Pending => return Poll::Pending,
                     Poll::Ready(result) => match result {
-                        Ok(cb) => cb,
+                        Ok(cb) => (cb, queue.get_options()),
                         Err(err) => {
                             inner.qtable.borrow_mut().free(&new_qd);
                             return Poll::Ready(Err(err));
@@ -321,8 +357,15 @@ impl TcpPeer {
         let established: EstablishedSocket = EstablishedSocket::new(cb, new_qd, inner.dead_socket_tx.clone());
         let local: SocketAddrV4 = established.cb.get_local();
         let remote: SocketAddrV4 = established.cb.get_remote();
+        inner.flows.insert(FlowKey::new(local, remote), established.cb.clone());
+        Inner::apply_options(&mut inner.corked, new_qd, &established.cb, &options);
         match inner.qtable.borrow_mut().get_mut(&new_qd) {
-            Some(InetQueue::Tcp(queue)) => queue.set_socket(Socket::Established(established)),
+            Some(InetQueue::Tcp(queue)) => {
+                for option in options {
+                    queue.set_option(option);
+                }
+                queue.set_socket(Socket::Established(established))
+            },
             _ => panic!("Should have been pre-allocated!"),
         };
         if inner
@@ -348,9 +391,15 @@ impl TcpPeer {
                     let local: SocketAddrV4 = match local_socket {
                         Some(local) => local.clone(),
                         None => {
+                            // Pick a port for which replies are received by this stack, as the NIC may be shared with
+                            // other stacks that steer flows among themselves.
                             // TODO: we should free this when closing.
-                            let local_port: u16 = inner.ephemeral_ports.alloc_any()?;
-                            SocketAddrV4::new(inner.local_ipv4_addr, local_port)
+                            let local_ipv4_addr: Ipv4Addr = inner.local_ipv4_addr;
+                            let rt: &Rc<dyn NetworkRuntime> = &inner.rt;
+                            let local_port: u16 = inner.ephemeral_ports.alloc_if(|port: u16| {
+                                rt.receives_flow(SocketAddrV4::new(local_ipv4_addr, port), remote)
+                            })?;
+                            SocketAddrV4::new(local_ipv4_addr, local_port)
                         },
                     };
 
@@ -422,7 +471,24 @@ impl TcpPeer {
         let qtable = inner.qtable.borrow();
         match qtable.get(&qd) {
             Some(InetQueue::Tcp(ref queue)) => match queue.get_socket() {
-                Socket::Established(ref socket) => socket.send(buf),
+                Socket::Established(ref socket) => {
+                    // Chains that fit in a single TCP segment go out in one packet. Larger ones are queued one buffer
+                    // segment at a time, so their data is not copied.
+                    if buf.nb_segs() > 1 && buf.pkt_len() <= socket.remote_mss() {
+                        return socket.send(buf.coalesce()?);
+                    }
+                    // Check up front that every segment will be accepted, so a failed send queues nothing.
+                    socket.check_send(buf.nb_segs())?;
+                    let mut next: Option<DemiBuffer> = Some(buf);
+                    while let Some(mut segment) = next {
+                        next = segment.unchain();
+                        // Empty buffers mark the end of the stream, so skip empty segments.
+                        if !segment.is_empty() {
+                            socket.send(segment)?;
+                        }
+                    }
+                    Ok(())
+                },
                 _ => Err(Fail::new(libc::ENOTCONN, "connection not established")),
             },
             _ => Err(Fail::new(libc::EBADF, "bad queue descriptor")),
@@ -432,6 +498,8 @@ impl TcpPeer {
     /// Closes a TCP socket.
     pub fn do_close(&self, qd: QDesc) -> Result<(), Fail> {
         let mut inner: RefMut<Inner> = self.inner.borrow_mut();
+        // Data is no longer held back once the user is done sending, so closed connections need not be flushed.
+        inner.corked.remove(&qd);
         // TODO: Currently we do not handle close correctly because we continue to receive packets at this point to finish the TCP close protocol.
         // 1. We do not remove the endpoint from the addresses table
         // 2. We do not remove the queue from the queue table.
@@ -481,6 +549,7 @@ impl TcpPeer {
 
     /// Closes a TCP socket.
     pub fn do_async_close(&self, qd: QDesc) -> Result<CloseFuture, Fail> {
+        self.inner.borrow_mut().corked.remove(&qd);
         match self.inner.borrow().qtable.borrow_mut().get_mut(&qd) {
             Some(InetQueue::Tcp(queue)) => {
                 match queue.get_socket() {
@@ -523,6 +592,41 @@ impl TcpPeer {
         })
     }
 
+    /// Sets an option of a TCP socket.  Options of sockets that are not connected yet are applied once their connection
+    /// is established.
+    pub fn setsockopt(&self, qd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        let mut inner_: RefMut<Inner> = self.inner.borrow_mut();
+        let inner: &mut Inner = &mut *inner_;
+        let cb: Option<Rc<ControlBlock>> = match inner.qtable.borrow_mut().get_mut(&qd) {
+            Some(InetQueue::Tcp(queue)) => {
+                queue.set_option(option);
+                match queue.get_socket() {
+                    Socket::Established(socket) => Some(socket.cb.clone()),
+                    _ => None,
+                }
+            },
+            _ => return Err(Fail::new(libc::EBADF, "bad queue descriptor")),
+        };
+        if let Some(cb) = cb {
+            Inner::apply_options(&mut inner.corked, qd, &cb, &[option]);
+        }
+        Ok(())
+    }
+
+    /// Returns whether a segment was routed to a connecting or listening socket since the last call, and clears it.
+    /// Such a segment may have completed a handshake, which only takes effect once the scheduler runs.
+    pub fn take_handshake(&self) -> bool {
+        self.inner.borrow().handshake.replace(false)
+    }
+
+    /// Sends the data that corked connections hold back.
+    pub fn flush(&self) {
+        let inner: Ref<Inner> = self.inner.borrow();
+        for cb in inner.corked.values() {
+            cb.flush_unsent();
+        }
+    }
+
     pub fn remote_mss(&self, qd: QDesc) -> Result<usize, Fail> {
         let inner = self.inner.borrow();
         let qtable: Ref<IoQueueTable<InetQueue>> = inner.qtable.borrow();
@@ -584,6 +688,9 @@ impl Inner {
             scheduler,
             qtable: qtable.clone(),
             addresses: HashMap::<SocketId, QDesc>::new(),
+            flows: FlowTable::new(),
+            corked: HashMap::new(),
+            handshake: Cell::new(false),
             clock: clock,
             local_link_addr: local_link_addr,
             local_ipv4_addr: local_ipv4_addr,
@@ -594,7 +701,24 @@ impl Inner {
         }
     }
 
-    fn receive(&self, ip_hdr: &Ipv4Header, buf: DemiBuffer) -> Result<(), Fail> {
+    /// Applies socket options to an established connection, keeping track of whether it is corked.
+    fn apply_options(
+        corked: &mut HashMap<QDesc, Rc<ControlBlock>>,
+        qd: QDesc,
+        cb: &Rc<ControlBlock>,
+        options: &[SocketOption],
+    ) {
+        for option in options {
+            cb.set_option(*option);
+        }
+        if cb.is_corked() {
+            corked.insert(qd, cb.clone());
+        } else {
+            corked.remove(&qd);
+        }
+    }
+
+    fn receive(&self, ip_hdr: &Ipv4Header, buf: DemiBuffer, flow: Option<Rc<ControlBlock>>) -> Result<(), Fail> {
         let (mut tcp_hdr, data) = TcpHeader::parse(ip_hdr, buf, self.tcp_config.get_rx_checksum_offload())?;
         debug!("TCP received {:?}", tcp_hdr);
         let local = SocketAddrV4::new(ip_hdr.get_dest_addr(), tcp_hdr.dst_port);
@@ -604,6 +728,14 @@ impl Inner {
             return Err(Fail::new(libc::EINVAL, "invalid address type"));
         }
 
+        // Fast path: the packet belongs to an established (or closing) connection.
+        if let Some(cb) = flow.or_else(|| self.flows.get(&FlowKey::new(local, remote))) {
+            debug_assert_eq!((cb.get_local(), cb.get_remote()), (local, remote));
+            debug!("Routing to established connection: {:?}", (local, remote));
+            cb.receive(&mut tcp_hdr, data);
+            return Ok(());
+        }
+
         // grab the queue descriptor based on the incoming.
         let &qd: &QDesc = match self.addresses.get(&SocketId::Active(local, remote)) {
             Some(qdesc) => qdesc,
@@ -623,11 +755,13 @@ impl Inner {
                 },
                 Socket::Connecting(socket) => {
                     debug!("Routing to connecting connection: {:?}", socket.endpoints());
+                    self.handshake.set(true);
                     socket.receive(&tcp_hdr);
                     return Ok(());
                 },
                 Socket::Listening(socket) => {
                     debug!("Routing to passive connection: {:?}", local);
+                    self.handshake.set(true);
                     return socket.receive(ip_hdr, &tcp_hdr);
                 },
                 Socket::Inactive(_) => (),
@@ -679,9 +813,11 @@ impl Inner {
                     };
                     match result {
                         Ok(cb) => {
-                            let new_socket =
-                                Socket::Established(EstablishedSocket::new(cb, qd, self.dead_socket_tx.clone()));
-                            queue.set_socket(new_socket);
+                            let socket: EstablishedSocket = EstablishedSocket::new(cb, qd, self.dead_socket_tx.clone());
+                            let (local, remote): (SocketAddrV4, SocketAddrV4) = socket.endpoints();
+                            self.flows.insert(FlowKey::new(local, remote), socket.cb.clone());
+                            Self::apply_options(&mut self.corked, qd, &socket.cb, &queue.get_options());
+                            queue.set_socket(Socket::Established(socket));
                             Poll::Ready(Ok(()))
                         },
                         Err(fail) => Poll::Ready(Err(fail)),
@@ -722,6 +858,9 @@ impl Inner {
         self.qtable.borrow_mut().free(&qd);
         // Remove address from addresses backmap
         if let Some(addr) = sockid {
+            if let SocketId::Active(local, remote) = &addr {
+                self.flows.remove(&FlowKey::new(*local, *remote));
+            }
             self.addresses.remove(&addr);
         }
         Poll::Ready(Ok(()))
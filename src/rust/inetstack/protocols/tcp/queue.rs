@@ -7,6 +7,7 @@
 
 use super::peer::Socket;
 use crate::runtime::{
+    network::types::SocketOption,
     queue::IoQueue,
     QType,
 };
@@ -18,6 +19,10 @@ use crate::runtime::{
 /// Per-queue metadata for the TCP socket.
 pub struct TcpQueue {
     socket: Socket,
+    /// Send data as soon as possible (TCP_NODELAY)?
+    nodelay: bool,
+    /// Hold back small segments until the end of the next poll (TCP_CORK)?
+    cork: bool,
 }
 
 //======================================================================================================================
@@ -28,6 +33,8 @@ impl TcpQueue {
     pub fn new() -> Self {
         Self {
             socket: Socket::Inactive(None),
+            nodelay: true,
+            cork: false,
         }
     }
 
@@ -45,6 +52,19 @@ impl TcpQueue {
     pub fn set_socket(&mut self, s: Socket) {
         self.socket = s;
     }
+
+    /// Get the socket options, which are handed over to connections once they are established.
+    pub fn get_options(&self) -> [SocketOption; 2] {
+        [SocketOption::TcpNoDelay(self.nodelay), SocketOption::TcpCork(self.cork)]
+    }
+
+    /// Set a socket option.
+    pub fn set_option(&mut self, option: SocketOption) {
+        match option {
+            SocketOption::TcpNoDelay(nodelay) => self.nodelay = nodelay,
+            SocketOption::TcpCork(cork) => self.cork = cork,
+        }
+    }
 }
 
 //======================================================================================================================
@@ -4,7 +4,10 @@
 use crate::{
     inetstack::protocols::{
         ethernet2::Ethernet2Header,
-        ip::IpProtocol,
+        ip::{
+            checksum::Checksum,
+            IpProtocol,
+        },
         ipv4::Ipv4Header,
         tcp::SeqNumber,
     },
@@ -21,13 +24,18 @@ use ::std::{
         Cursor,
         Read,
     },
-    slice::ChunksExact,
 };
 
 pub const MIN_TCP_HEADER_SIZE: usize = 20;
 pub const MAX_TCP_HEADER_SIZE: usize = 60;
 pub const MAX_TCP_OPTIONS: usize = 5;
 
+/// Offset of the source port in a TCP header (in bytes).
+const TCP_SRC_PORT_OFFSET: usize = 0;
+
+/// Offset of the destination port in a TCP header (in bytes).
+const TCP_DST_PORT_OFFSET: usize = 2;
+
 pub struct TcpSegment {
     pub ethernet2_hdr: Ethernet2Header,
     pub ipv4_hdr: Ipv4Header,
@@ -222,6 +230,17 @@ impl TcpHeader {
         }
     }
 
+    /// Peeks at the ports of a segment, without validating its header. Returns the source and destination ports, if the
+    /// segment is large enough to hold them.
+    pub fn peek_ports(buf: &[u8]) -> Option<(u16, u16)> {
+        if buf.len() < TCP_DST_PORT_OFFSET + 2 {
+            return None;
+        }
+        let src_port: u16 = u16::from_be_bytes([buf[TCP_SRC_PORT_OFFSET], buf[TCP_SRC_PORT_OFFSET + 1]]);
+        let dst_port: u16 = u16::from_be_bytes([buf[TCP_DST_PORT_OFFSET], buf[TCP_DST_PORT_OFFSET + 1]]);
+        Some((src_port, dst_port))
+    }
+
     pub fn parse(
         ipv4_header: &Ipv4Header,
         mut buf: DemiBuffer,
@@ -481,80 +500,23 @@ impl TcpHeader {
     }
 }
 
-fn tcp_checksum(ipv4_header: &Ipv4Header, header: &[u8], data: &[u8]) -> u16 {
-    let mut state: u32 = 0xffff;
-
-    // First, fold in a "pseudo-IP" header of...
-    // 1) Source address (4 bytes)
-    let src_octets: [u8; 4] = ipv4_header.get_src_addr().octets();
-    state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-    state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
-
-    // 2) Destination address (4 bytes)
-    let dst_octets: [u8; 4] = ipv4_header.get_dest_addr().octets();
-    state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-    state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-    // 3) 1 byte of zeros and TCP protocol number (1 byte)
-    state += u16::from_be_bytes([0, IpProtocol::TCP as u8]) as u32;
-
-    // 4) TCP segment length (2 bytes)
-    state += (header.len() + data.len()) as u32;
-
-    let fixed_header: &[u8; MIN_TCP_HEADER_SIZE] = header[..MIN_TCP_HEADER_SIZE].try_into().unwrap();
-
-    // Continue to the TCP header. First, for the fixed length parts, we have...
-    // 1) Source port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-    // 2) Destination port (2 bytes)
-    state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
+pub fn tcp_checksum(ipv4_header: &Ipv4Header, header: &[u8], data: &[u8]) -> u16 {
+    let mut checksum: Checksum = Checksum::new();
 
-    // 3) Sequence number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-    state += u16::from_be_bytes([fixed_header[6], fixed_header[7]]) as u32;
+    // First, fold in a "pseudo-IP" header with the source and destination addresses, the TCP protocol number and
+    // the TCP segment length.
+    checksum.add_ipv4_pseudo_header(
+        ipv4_header.get_src_addr(),
+        ipv4_header.get_dest_addr(),
+        IpProtocol::TCP,
+        (header.len() + data.len()) as u16,
+    );
 
-    // 4) Acknowledgement number (4 bytes)
-    state += u16::from_be_bytes([fixed_header[8], fixed_header[9]]) as u32;
-    state += u16::from_be_bytes([fixed_header[10], fixed_header[11]]) as u32;
-
-    // 5) Data offset (4 bits), reserved (4 bits), and flags (1 byte)
-    state += u16::from_be_bytes([fixed_header[12], fixed_header[13]]) as u32;
-
-    // 6) Window (2 bytes)
-    state += u16::from_be_bytes([fixed_header[14], fixed_header[15]]) as u32;
-
-    // 7) Checksum (all zeros, 2 bytes)
-    state += 0;
-
-    // 8) Urgent pointer (2 bytes)
-    state += u16::from_be_bytes([fixed_header[18], fixed_header[19]]) as u32;
-
-    // Next, the variable length part of the header for TCP options. Since `data_offset` is
-    // guaranteed to be aligned to a 32-bit boundary, we don't have to handle remainders.
-    if header.len() > MIN_TCP_HEADER_SIZE {
-        assert_eq!(header.len() % 2, 0);
-        for chunk in header[MIN_TCP_HEADER_SIZE..].chunks_exact(2) {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-    }
+    // Continue to the TCP header, including options, skipping the checksum itself (octets 16-17).
+    checksum.add_bytes(&header[..16]);
+    checksum.add_bytes(&header[18..]);
 
     // Finally, checksum the data itself.
-    let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-    while let Some(chunk) = chunks_iter.next() {
-        state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-    }
-    // Since the data may have an odd number of bytes, pad the last byte with zero if necessary.
-    if let Some(&b) = chunks_iter.remainder().get(0) {
-        state += u16::from_be_bytes([b, 0]) as u32;
-    }
-
-    // NB: We don't need to subtract out 0xFFFF as we accumulate the sum. Since we use a u32 for
-    // intermediate state, we would need 2^16 additions to overflow. This is well beyond the reach
-    // of the largest jumbo frames. The upshot is that the compiler can then optimize this final
-    // loop into a single branchfree code.
-    while state > 0xFFFF {
-        state -= 0xFFFF;
-    }
-    !state as u16
+    checksum.add_bytes(data);
+    checksum.finish()
 }
@@ -22,6 +22,10 @@ use crate::{
     },
     runtime::{
         memory::DemiBuffer,
+        network::{
+            config::TcpConfig,
+            types::SocketOption,
+        },
         QDesc,
     },
 };
@@ -447,3 +451,236 @@ fn test_connect_disconnect() {
 
     connection_hangup(&mut ctx, &mut now, &mut server, &mut client, server_fd, client_fd);
 }
+
+//=============================================================================
+
+/// Tests that Nagle's algorithm holds small buffers back while data is in flight, and coalesces them once it is
+/// acknowledged.
+#[test]
+fn test_send_nagle() {
+    let mut ctx = Context::from_waker(noop_waker_ref());
+    let mut now = Instant::now();
+
+    // Connection parameters
+    let listen_port: u16 = 80;
+    let listen_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, listen_port);
+
+    // Setup peers.
+    let mut server: Engine = test_helpers::new_bob2(now);
+    let mut client: Engine = test_helpers::new_alice2(now);
+    let window_scale: u8 = client.rt.tcp_config.get_window_scale();
+    let max_window_size: u32 = (client.rt.tcp_config.get_receive_window_size() as u32)
+        .checked_shl(window_scale as u32)
+        .unwrap();
+
+    let ((server_fd, _), client_fd): ((QDesc, SocketAddrV4), QDesc) =
+        connection_setup(&mut ctx, &mut now, &mut server, &mut client, listen_port, listen_addr);
+    client
+        .tcp_setsockopt(client_fd, SocketOption::TcpNoDelay(false))
+        .unwrap();
+
+    let bufsize: u32 = 64;
+    let buf: DemiBuffer = cook_buffer(bufsize as usize, None);
+
+    // The first buffer goes out right away, as nothing is in flight.
+    client.tcp_push(client_fd, buf.clone());
+    let bytes: DemiBuffer = client.rt.pop_frame();
+    let len: usize = check_packet_data(
+        bytes.clone(),
+        client.rt.link_addr,
+        server.rt.link_addr,
+        client.rt.ipv4_addr,
+        server.rt.ipv4_addr,
+        max_window_size as u16,
+        SeqNumber::from(1),
+        None,
+    );
+    assert_eq!(len, bufsize as usize);
+
+    // The next ones are held back until the first one is acknowledged.
+    client.tcp_push(client_fd, buf.clone());
+    client.tcp_push(client_fd, buf.clone());
+    client.rt.poll_scheduler();
+    assert!(client.rt.pop_frame_unchecked().is_none());
+
+    recv_data(&mut ctx, &mut server, &mut client, server_fd, bytes);
+    recv_pure_ack(&mut now, &mut server, &mut client, SeqNumber::from(1 + bufsize));
+
+    // They then go out in a single segment.
+    client.rt.poll_scheduler();
+    let bytes: DemiBuffer = client.rt.pop_frame();
+    let len: usize = check_packet_data(
+        bytes,
+        client.rt.link_addr,
+        server.rt.link_addr,
+        client.rt.ipv4_addr,
+        server.rt.ipv4_addr,
+        max_window_size as u16,
+        SeqNumber::from(1 + bufsize),
+        None,
+    );
+    assert_eq!(len, 2 * bufsize as usize);
+}
+
+//=============================================================================
+
+/// Tests that a corked connection sends nothing until it is flushed, and then coalesces all the buffers that were
+/// pushed into a single segment.
+#[test]
+fn test_send_cork() {
+    let mut ctx = Context::from_waker(noop_waker_ref());
+    let mut now = Instant::now();
+
+    // Connection parameters
+    let listen_port: u16 = 80;
+    let listen_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, listen_port);
+
+    // Setup peers.
+    let mut server: Engine = test_helpers::new_bob2(now);
+    let mut client: Engine = test_helpers::new_alice2(now);
+    let window_scale: u8 = client.rt.tcp_config.get_window_scale();
+    let max_window_size: u32 = (client.rt.tcp_config.get_receive_window_size() as u32)
+        .checked_shl(window_scale as u32)
+        .unwrap();
+
+    let (_, client_fd): ((QDesc, SocketAddrV4), QDesc) =
+        connection_setup(&mut ctx, &mut now, &mut server, &mut client, listen_port, listen_addr);
+    client.tcp_setsockopt(client_fd, SocketOption::TcpCork(true)).unwrap();
+
+    let bufsize: u32 = 64;
+    let buf: DemiBuffer = cook_buffer(bufsize as usize, None);
+    for _ in 0..3 {
+        client.tcp_push(client_fd, buf.clone());
+    }
+    client.rt.poll_scheduler();
+    assert!(client.rt.pop_frame_unchecked().is_none());
+
+    // Flushing sends everything that was pushed at once.
+    client.tcp_flush();
+    let bytes: DemiBuffer = client.rt.pop_frame();
+    let len: usize = check_packet_data(
+        bytes,
+        client.rt.link_addr,
+        server.rt.link_addr,
+        client.rt.ipv4_addr,
+        server.rt.ipv4_addr,
+        max_window_size as u16,
+        SeqNumber::from(1),
+        None,
+    );
+    assert_eq!(len, 3 * bufsize as usize);
+    assert!(client.rt.pop_frame_unchecked().is_none());
+}
+
+//=============================================================================
+
+/// Tests that a buffer chain that does not fit on the unsent queue is refused as a whole, rather than having some of
+/// its segments queued.
+#[test]
+fn test_send_chain_all_or_nothing() {
+    let mut ctx = Context::from_waker(noop_waker_ref());
+    let mut now = Instant::now();
+
+    // Connection parameters
+    let listen_port: u16 = 80;
+    let listen_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, listen_port);
+
+    // Setup peers.
+    let mut server: Engine = test_helpers::new_bob2(now);
+    let mut client: Engine = test_helpers::new_alice2(now);
+
+    let (_, client_fd): ((QDesc, SocketAddrV4), QDesc) =
+        connection_setup(&mut ctx, &mut now, &mut server, &mut client, listen_port, listen_addr);
+    client.tcp_setsockopt(client_fd, SocketOption::TcpCork(true)).unwrap();
+
+    // Fill the unsent queue up to its cutoff, which leaves room for a single buffer.
+    let buf: DemiBuffer = cook_buffer(1, None);
+    for _ in 0..1024 {
+        let mut push_future: PushFuture = client.tcp_push(client_fd, buf.clone());
+        assert!(matches!(
+            Future::poll(Pin::new(&mut push_future), &mut ctx),
+            Poll::Ready(Ok(()))
+        ));
+    }
+
+    // A chain of two segments does not fit, and none of its segments is queued.
+    let mut chain: DemiBuffer = cook_buffer(2048, None);
+    chain.append(cook_buffer(2048, None)).unwrap();
+    let mut push_future: PushFuture = client.tcp_push(client_fd, chain);
+    match Future::poll(Pin::new(&mut push_future), &mut ctx) {
+        Poll::Ready(Err(e)) => assert_eq!(e.errno, libc::EBUSY),
+        _ => panic!("chain should have been refused"),
+    }
+
+    // So there is still room for one more buffer.
+    let mut push_future: PushFuture = client.tcp_push(client_fd, buf.clone());
+    assert!(matches!(
+        Future::poll(Pin::new(&mut push_future), &mut ctx),
+        Poll::Ready(Ok(()))
+    ));
+}
+
+//=============================================================================
+
+/// Tests that a multi-segment pop hands over all data received, but leaves the end of the stream to the next pop.
+#[test]
+fn test_multi_segment_pop_end_of_stream() {
+    let mut ctx = Context::from_waker(noop_waker_ref());
+    let mut now = Instant::now();
+
+    // Connection parameters
+    let listen_port: u16 = 80;
+    let listen_addr: SocketAddrV4 = SocketAddrV4::new(test_helpers::BOB_IPV4, listen_port);
+
+    // Setup peers.
+    let tcp_config: TcpConfig = TcpConfig::new(
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        None,
+        Some(true),
+    );
+    let mut server: Engine = test_helpers::new_bob2_with_tcp_config(now, tcp_config);
+    let mut client: Engine = test_helpers::new_alice2(now);
+
+    let ((server_fd, _), client_fd): ((QDesc, SocketAddrV4), QDesc) =
+        connection_setup(&mut ctx, &mut now, &mut server, &mut client, listen_port, listen_addr);
+
+    // Send two buffers, and then close the connection.
+    let bufsize: usize = 64;
+    for _ in 0..2 {
+        client.tcp_push(client_fd, cook_buffer(bufsize, None));
+        let bytes: DemiBuffer = client.rt.pop_frame();
+        server.receive(bytes).unwrap();
+    }
+    client.tcp_close(client_fd).unwrap();
+    client.rt.poll_scheduler();
+    let bytes: DemiBuffer = client.rt.pop_frame();
+    server.receive(bytes).unwrap();
+
+    // The first pop returns both buffers at once.
+    let mut pop_future = server.tcp_pop(server_fd);
+    match Future::poll(Pin::new(&mut pop_future), &mut ctx) {
+        Poll::Ready(Ok(buf)) => {
+            assert_eq!(buf.nb_segs(), 2);
+            assert_eq!(buf.pkt_len(), 2 * bufsize);
+        },
+        _ => panic!("pop should have returned data"),
+    }
+
+    // The next one returns the end of the stream.
+    let mut pop_future = server.tcp_pop(server_fd);
+    match Future::poll(Pin::new(&mut pop_future), &mut ctx) {
+        Poll::Ready(Ok(buf)) => assert!(buf.is_empty()),
+        _ => panic!("pop should have returned the end of the stream"),
+    }
+}
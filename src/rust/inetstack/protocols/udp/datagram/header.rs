@@ -7,7 +7,10 @@
 
 use crate::{
     inetstack::protocols::{
-        ip::IpProtocol,
+        ip::{
+            checksum::Checksum,
+            IpProtocol,
+        },
         ipv4::Ipv4Header,
     },
     runtime::{
@@ -17,7 +20,6 @@ use crate::{
 };
 use ::libc::EBADMSG;
 use ::std::convert::TryInto;
-use std::slice::ChunksExact;
 
 //==============================================================================
 // Constants
@@ -141,58 +143,23 @@ impl UdpHeader {
     ///
     /// TODO: Write a unit test for this function.
     fn checksum(ipv4_hdr: &Ipv4Header, udp_hdr: &[u8], data: &[u8]) -> u16 {
-        let mut state: u32 = 0xffff;
+        let mut checksum: Checksum = Checksum::new();
 
-        // Source address (4 bytes)
-        let src_octets: [u8; 4] = ipv4_hdr.get_src_addr().octets();
-        state += u16::from_be_bytes([src_octets[0], src_octets[1]]) as u32;
-        state += u16::from_be_bytes([src_octets[2], src_octets[3]]) as u32;
+        // Pseudo header: source address, destination address, UDP protocol number and UDP segment length.
+        checksum.add_ipv4_pseudo_header(
+            ipv4_hdr.get_src_addr(),
+            ipv4_hdr.get_dest_addr(),
+            IpProtocol::UDP,
+            (udp_hdr.len() + data.len()) as u16,
+        );
 
-        // Destination address (4 bytes)
-        let dst_octets: [u8; 4] = ipv4_hdr.get_dest_addr().octets();
-        state += u16::from_be_bytes([dst_octets[0], dst_octets[1]]) as u32;
-        state += u16::from_be_bytes([dst_octets[2], dst_octets[3]]) as u32;
-
-        // Padding zeros (1 byte) and UDP protocol number (1 byte)
-        state += u16::from_be_bytes([0, IpProtocol::UDP as u8]) as u32;
-
-        // UDP segment length (2 bytes)
-        state += (udp_hdr.len() + data.len()) as u32;
-
-        // Switch to UDP header.
+        // UDP header, skipping the checksum itself (octets 6-7).
         let fixed_header: &[u8; UDP_HEADER_SIZE] = udp_hdr.try_into().unwrap();
-
-        // Source port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[0], fixed_header[1]]) as u32;
-
-        // Destination port (2 bytes)
-        state += u16::from_be_bytes([fixed_header[2], fixed_header[3]]) as u32;
-
-        // Payload Length (2 bytes)
-        state += u16::from_be_bytes([fixed_header[4], fixed_header[5]]) as u32;
-
-        // Checksum (2 bytes, all zeros)
-        state += 0;
+        checksum.add_bytes(&fixed_header[..6]);
 
         // Payload.
-        let mut chunks_iter: ChunksExact<u8> = data.chunks_exact(2);
-        while let Some(chunk) = chunks_iter.next() {
-            state += u16::from_be_bytes([chunk[0], chunk[1]]) as u32;
-        }
-        // Pad with zeros with payload has an odd number of bytes.
-        if let Some(&b) = chunks_iter.remainder().get(0) {
-            state += u16::from_be_bytes([b, 0]) as u32;
-        }
-
-        // NOTE: We don't need to subtract out 0xFFFF as we accumulate the sum.
-        // Since we use a u32 for intermediate state, we would need 2^16
-        // additions to overflow. This is well beyond the reach of the largest
-        // jumbo frames. The upshot is that the compiler can then optimize this
-        // final loop into a single branch-free code.
-        while state > 0xFFFF {
-            state -= 0xFFFF;
-        }
-        !state as u16
+        checksum.add_bytes(data);
+        checksum.finish()
     }
 }
 
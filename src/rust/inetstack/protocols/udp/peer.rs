@@ -280,6 +280,8 @@ impl UdpPeer {
     pub fn do_pushto(&self, qd: QDesc, data: DemiBuffer, remote: SocketAddrV4) -> Result<(), Fail> {
         #[cfg(feature = "profiler")]
         timer!("udp::pushto");
+        // Datagrams are checksummed and transmitted as a single body, so gather the data of buffer chains.
+        let data: DemiBuffer = if data.nb_segs() > 1 { data.coalesce()? } else { data };
         let qtable: Ref<IoQueueTable<InetQueue>> = self.qtable.borrow();
         // Lookup associated endpoint.
         match qtable.get(&qd) {
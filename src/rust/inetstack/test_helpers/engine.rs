@@ -21,7 +21,10 @@ use crate::{
     runtime::{
         fail::Fail,
         memory::DemiBuffer,
-        network::types::MacAddress,
+        network::types::{
+            MacAddress,
+            SocketOption,
+        },
         queue::IoQueueTable,
         timer::TimerRc,
         QDesc,
@@ -31,7 +34,6 @@ use crate::{
 use ::libc::EBADMSG;
 use ::std::{
     cell::RefCell,
-    collections::HashMap,
     future::Future,
     net::{
         Ipv4Addr,
@@ -41,6 +43,9 @@ use ::std::{
     time::Duration,
 };
 
+#[cfg(test)]
+use ::std::collections::HashMap;
+
 use super::TestRuntime;
 
 pub struct Engine {
@@ -98,7 +103,7 @@ impl Engine {
         }
         match header.ether_type() {
             EtherType2::Arp => self.arp.receive(payload),
-            EtherType2::Ipv4 => self.ipv4.receive(payload),
+            EtherType2::Ipv4 => self.ipv4.receive(payload, None),
             EtherType2::Ipv6 => Ok(()), // Ignore for now.
         }
     }
@@ -163,18 +168,29 @@ impl Engine {
         self.ipv4.tcp.listen(socket_fd, backlog)
     }
 
+    pub fn tcp_setsockopt(&mut self, socket_fd: QDesc, option: SocketOption) -> Result<(), Fail> {
+        self.ipv4.tcp.setsockopt(socket_fd, option)
+    }
+
+    pub fn tcp_flush(&mut self) {
+        self.ipv4.tcp.flush()
+    }
+
     pub fn arp_query(&self, ipv4_addr: Ipv4Addr) -> impl Future<Output = Result<MacAddress, Fail>> {
         self.arp.query(ipv4_addr)
     }
 
+    #[cfg(test)]
     pub fn tcp_mss(&self, handle: QDesc) -> Result<usize, Fail> {
         self.ipv4.tcp_mss(handle)
     }
 
+    #[cfg(test)]
     pub fn tcp_rto(&self, handle: QDesc) -> Result<Duration, Fail> {
         self.ipv4.tcp_rto(handle)
     }
 
+    #[cfg(test)]
     pub fn export_arp_cache(&self) -> HashMap<Ipv4Addr, MacAddress> {
         self.arp.export_cache()
     }
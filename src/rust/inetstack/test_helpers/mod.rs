@@ -98,6 +98,11 @@ pub fn new_alice2(now: Instant) -> Engine {
 }
 
 pub fn new_bob2(now: Instant) -> Engine {
+    new_bob2_with_tcp_config(now, TcpConfig::default())
+}
+
+/// Creates Bob, with a custom TCP configuration.
+pub fn new_bob2_with_tcp_config(now: Instant, tcp_config: TcpConfig) -> Engine {
     let mut arp: HashMap<Ipv4Addr, MacAddress> = HashMap::<Ipv4Addr, MacAddress>::new();
     arp.insert(BOB_IPV4, BOB_MAC);
     arp.insert(ALICE_IPV4, ALICE_MAC);
@@ -109,7 +114,6 @@ pub fn new_bob2(now: Instant) -> Engine {
         Some(false),
     );
     let udp_config = UdpConfig::default();
-    let tcp_config = TcpConfig::default();
     let rt = TestRuntime::new(now, arp_options, udp_config, tcp_config, BOB_MAC, BOB_IPV4);
     let scheduler: Scheduler = rt.scheduler.clone();
     let clock: TimerRc = rt.clock.clone();
@@ -13,10 +13,10 @@
 #![feature(strict_provenance)]
 #![cfg_attr(target_os = "windows", feature(maybe_uninit_uninit_array))]
 
-mod collections;
+pub mod collections;
+
 mod pal;
 
-#[cfg(feature = "profiler")]
 pub mod perftools;
 
 pub mod scheduler;
@@ -8,3 +8,19 @@
 // ------------------------
 #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
 pub const CPU_DATA_CACHE_LINE_SIZE: usize = 64;
+
+// -------------
+// Data Prefetch
+// -------------
+/// Hints the CPU to bring the cache line that holds `ptr` into all levels of the data cache, ahead of an access.  This
+/// is only a hint, so `ptr` needn't be valid.
+#[inline(always)]
+pub fn prefetch<T>(ptr: *const T) {
+    // Safety: Prefetching doesn't access memory, so it doesn't fault on invalid addresses.
+    #[cfg(target_arch = "x86_64")]
+    unsafe {
+        ::core::arch::x86_64::_mm_prefetch::<{ ::core::arch::x86_64::_MM_HINT_T0 }>(ptr as *const i8)
+    };
+    #[cfg(not(target_arch = "x86_64"))]
+    let _ = ptr;
+}
@@ -20,6 +20,12 @@ pub const SOCK_STREAM: i32 = WinSock::SOCK_STREAM as i32;
 #[cfg(target_os = "windows")]
 pub const SOCK_DGRAM: i32 = WinSock::SOCK_DGRAM as i32;
 
+#[cfg(target_os = "windows")]
+pub const IPPROTO_TCP: i32 = WinSock::IPPROTO_TCP.0;
+
+#[cfg(target_os = "windows")]
+pub const TCP_NODELAY: i32 = WinSock::TCP_NODELAY as i32;
+
 //==============================================================================
 // Linux constants
 //==============================================================================
@@ -35,3 +41,12 @@ pub const SOCK_STREAM: i32 = libc::SOCK_STREAM;
 
 #[cfg(target_os = "linux")]
 pub const SOCK_DGRAM: i32 = libc::SOCK_DGRAM;
+
+#[cfg(target_os = "linux")]
+pub const IPPROTO_TCP: i32 = libc::IPPROTO_TCP;
+
+#[cfg(target_os = "linux")]
+pub const TCP_NODELAY: i32 = libc::TCP_NODELAY;
+
+#[cfg(target_os = "linux")]
+pub const TCP_CORK: i32 = libc::TCP_CORK;
@@ -1,4 +1,7 @@
 // Copyright(c) Microsoft Corporation.
 // Licensed under the MIT license.
 
+#[cfg(feature = "profiler")]
 pub mod profiler;
+
+pub mod stats;
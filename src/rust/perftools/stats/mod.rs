@@ -0,0 +1,389 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#[cfg(test)]
+mod tests;
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::runtime::types::{
+    demi_histogram_t,
+    demi_stats_t,
+};
+use ::std::sync::{
+    atomic::{
+        AtomicU64,
+        Ordering,
+    },
+    Arc,
+    Mutex,
+    MutexGuard,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Number of bits below the most significant one that select the bucket of a value. Values are bucketed with a
+/// relative error of at most 1/16.
+const SUB_BUCKET_BITS: u32 = 4;
+
+/// Number of buckets per power of two.
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+
+/// Number of buckets of a histogram. Values below [SUB_BUCKETS] get a bucket each, and each power of two above gets
+/// [SUB_BUCKETS] buckets, up to [u64::MAX].
+const NUM_BUCKETS: usize = (u64::BITS - SUB_BUCKET_BITS + 1) as usize * SUB_BUCKETS;
+
+//==============================================================================
+// Global Variables
+//==============================================================================
+
+thread_local!(
+    /// Statistics of the current thread.
+    static STATS: ThreadStats = ThreadStats::register()
+);
+
+/// Statistics of all live threads that recorded some.
+static REGISTRY: Mutex<Vec<Arc<Stats>>> = Mutex::new(Vec::new());
+
+/// Statistics of threads that exited, added up, so that totals do not go backwards.
+static RETIRED: Mutex<Option<StatsSnapshot>> = Mutex::new(None);
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Counter
+///
+/// Only the thread that owns a counter updates it, so a plain load and store is enough, and spares a locked
+/// instruction on the datapath. Any thread may read it.
+#[derive(Default)]
+pub struct Counter(AtomicU64);
+
+/// Histogram
+///
+/// Log-linear histogram in the fashion of HDR histograms, which records values in constant time and space, with a
+/// bounded relative error. Like [Counter]s, histograms have a single writer and may be read from any thread.
+pub struct Histogram {
+    /// Number of values recorded in each bucket.
+    buckets: Box<[Counter]>,
+    /// Sum of all values recorded.
+    sum: Counter,
+    /// Smallest value recorded.
+    min: AtomicU64,
+    /// Largest value recorded.
+    max: AtomicU64,
+}
+
+/// Statistics
+///
+/// Each thread records its own statistics, without any synchronization. They are registered once, when the thread
+/// first records some, and then they can be read from any thread without stopping the datapath (see [snapshot]).
+#[derive(Default)]
+pub struct Stats {
+    /// Latency of push operations, from issue until their result is handed to the application (in nanoseconds).
+    pub push_latency: Histogram,
+    /// Latency of pop operations (in nanoseconds).
+    pub pop_latency: Histogram,
+    /// Latency of accept operations (in nanoseconds).
+    pub accept_latency: Histogram,
+    /// Latency of connect operations (in nanoseconds).
+    pub connect_latency: Histogram,
+    /// Number of packets in each non-empty receive burst.
+    pub rx_burst: Histogram,
+    /// Number of packets handed over to the NIC in each transmit burst.
+    pub tx_burst: Histogram,
+    /// Number of segments in the out-of-order queue of a TCP connection, each time one is stored there.
+    pub ooo_depth: Histogram,
+    /// Number of TCP segments that were retransmitted.
+    pub retransmits: Counter,
+    /// Number of allocations that missed the free list of a heap pool.
+    pub heap_pool_misses: Counter,
+    /// Number of mbuf allocations that missed the chunk of a DPDK memory pool that served the previous one.
+    pub mbuf_chunk_misses: Counter,
+}
+
+/// Thread Statistics
+///
+/// Registered statistics of a thread, which are retired when the thread exits.
+struct ThreadStats(Arc<Stats>);
+
+/// Histogram Snapshot
+#[derive(Clone)]
+pub struct HistogramSnapshot {
+    /// Number of values recorded in each bucket.
+    buckets: Vec<u64>,
+    /// Sum of all values recorded.
+    sum: u64,
+    /// Smallest value recorded.
+    min: u64,
+    /// Largest value recorded.
+    max: u64,
+}
+
+/// Statistics Snapshot
+#[derive(Clone, Default)]
+pub struct StatsSnapshot {
+    pub push_latency: HistogramSnapshot,
+    pub pop_latency: HistogramSnapshot,
+    pub accept_latency: HistogramSnapshot,
+    pub connect_latency: HistogramSnapshot,
+    pub rx_burst: HistogramSnapshot,
+    pub tx_burst: HistogramSnapshot,
+    pub ooo_depth: HistogramSnapshot,
+    pub retransmits: u64,
+    pub heap_pool_misses: u64,
+    pub mbuf_chunk_misses: u64,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Counters
+impl Counter {
+    /// Adds `n` to the target counter.
+    #[inline]
+    pub fn add(&self, n: u64) {
+        self.0.store(self.get().wrapping_add(n), Ordering::Relaxed);
+    }
+
+    /// Reads the target counter.
+    #[inline]
+    pub fn get(&self) -> u64 {
+        self.0.load(Ordering::Relaxed)
+    }
+}
+
+/// Associate Functions for Histograms
+impl Histogram {
+    /// Records a value.
+    #[inline]
+    pub fn record(&self, value: u64) {
+        self.buckets[bucket_index(value)].add(1);
+        self.sum.add(value);
+        if value < self.min.load(Ordering::Relaxed) {
+            self.min.store(value, Ordering::Relaxed);
+        }
+        if value > self.max.load(Ordering::Relaxed) {
+            self.max.store(value, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Associate Functions for Thread Statistics
+impl ThreadStats {
+    /// Creates the statistics of the current thread, and registers them.
+    fn register() -> Self {
+        let stats: Arc<Stats> = Arc::new(Stats::default());
+        REGISTRY.lock().unwrap_or_else(|e| e.into_inner()).push(stats.clone());
+        Self(stats)
+    }
+}
+
+/// Associate Functions for Histogram Snapshots
+impl HistogramSnapshot {
+    /// Adds the values recorded in a histogram to the target snapshot.
+    fn merge(&mut self, histogram: &Histogram) {
+        for (total, bucket) in self.buckets.iter_mut().zip(histogram.buckets.iter()) {
+            *total += bucket.get();
+        }
+        self.sum += histogram.sum.get();
+        self.min = self.min.min(histogram.min.load(Ordering::Relaxed));
+        self.max = self.max.max(histogram.max.load(Ordering::Relaxed));
+    }
+
+    /// Adds the values of another snapshot to the target snapshot.
+    fn add(&mut self, other: &HistogramSnapshot) {
+        for (total, &n) in self.buckets.iter_mut().zip(other.buckets.iter()) {
+            *total += n;
+        }
+        self.sum += other.sum;
+        self.min = self.min.min(other.min);
+        self.max = self.max.max(other.max);
+    }
+
+    /// Returns the number of values recorded.
+    pub fn count(&self) -> u64 {
+        self.buckets.iter().sum()
+    }
+
+    /// Returns the value below which a fraction `q` of the recorded values lies, up to the resolution of the
+    /// histogram. Returns zero if no value was recorded.
+    pub fn percentile(&self, q: f64) -> u64 {
+        let count: u64 = self.count();
+        if count == 0 {
+            return 0;
+        }
+        let rank: u64 = ((q * count as f64).ceil() as u64).clamp(1, count);
+        let mut seen: u64 = 0;
+        for (index, &n) in self.buckets.iter().enumerate() {
+            seen += n;
+            if seen >= rank {
+                return bucket_upper_bound(index).clamp(self.min, self.max);
+            }
+        }
+        self.max
+    }
+}
+
+/// Associate Functions for Statistics Snapshots
+impl StatsSnapshot {
+    /// Adds the statistics of a thread to the target snapshot.
+    fn merge(&mut self, stats: &Stats) {
+        self.push_latency.merge(&stats.push_latency);
+        self.pop_latency.merge(&stats.pop_latency);
+        self.accept_latency.merge(&stats.accept_latency);
+        self.connect_latency.merge(&stats.connect_latency);
+        self.rx_burst.merge(&stats.rx_burst);
+        self.tx_burst.merge(&stats.tx_burst);
+        self.ooo_depth.merge(&stats.ooo_depth);
+        self.retransmits += stats.retransmits.get();
+        self.heap_pool_misses += stats.heap_pool_misses.get();
+        self.mbuf_chunk_misses += stats.mbuf_chunk_misses.get();
+    }
+
+    /// Adds up two snapshots.
+    fn add(&mut self, other: &StatsSnapshot) {
+        for (total, other) in [
+            (&mut self.push_latency, &other.push_latency),
+            (&mut self.pop_latency, &other.pop_latency),
+            (&mut self.accept_latency, &other.accept_latency),
+            (&mut self.connect_latency, &other.connect_latency),
+            (&mut self.rx_burst, &other.rx_burst),
+            (&mut self.tx_burst, &other.tx_burst),
+            (&mut self.ooo_depth, &other.ooo_depth),
+        ] {
+            total.add(other);
+        }
+        self.retransmits += other.retransmits;
+        self.heap_pool_misses += other.heap_pool_misses;
+        self.mbuf_chunk_misses += other.mbuf_chunk_misses;
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Default Trait Implementation for Histograms
+impl Default for Histogram {
+    fn default() -> Self {
+        Self {
+            buckets: (0..NUM_BUCKETS).map(|_| Counter::default()).collect(),
+            sum: Counter::default(),
+            min: AtomicU64::new(u64::MAX),
+            max: AtomicU64::new(0),
+        }
+    }
+}
+
+/// Default Trait Implementation for Histogram Snapshots
+impl Default for HistogramSnapshot {
+    fn default() -> Self {
+        Self {
+            buckets: vec![0; NUM_BUCKETS],
+            sum: 0,
+            min: u64::MAX,
+            max: 0,
+        }
+    }
+}
+
+/// Conversion Trait Implementation for Histogram Snapshots
+impl From<&HistogramSnapshot> for demi_histogram_t {
+    fn from(histogram: &HistogramSnapshot) -> Self {
+        let count: u64 = histogram.count();
+        Self {
+            count,
+            sum: histogram.sum,
+            min: if count == 0 { 0 } else { histogram.min },
+            max: histogram.max,
+            p50: histogram.percentile(0.5),
+            p90: histogram.percentile(0.9),
+            p99: histogram.percentile(0.99),
+            p999: histogram.percentile(0.999),
+        }
+    }
+}
+
+/// Conversion Trait Implementation for Statistics Snapshots
+impl From<&StatsSnapshot> for demi_stats_t {
+    fn from(stats: &StatsSnapshot) -> Self {
+        Self {
+            push_latency_ns: (&stats.push_latency).into(),
+            pop_latency_ns: (&stats.pop_latency).into(),
+            accept_latency_ns: (&stats.accept_latency).into(),
+            connect_latency_ns: (&stats.connect_latency).into(),
+            rx_burst_size: (&stats.rx_burst).into(),
+            tx_burst_size: (&stats.tx_burst).into(),
+            tcp_ooo_queue_depth: (&stats.ooo_depth).into(),
+            tcp_retransmits: stats.retransmits,
+            heap_pool_misses: stats.heap_pool_misses,
+            mbuf_chunk_misses: stats.mbuf_chunk_misses,
+        }
+    }
+}
+
+/// Drop Trait Implementation for Thread Statistics
+impl Drop for ThreadStats {
+    /// Unregisters the statistics of an exiting thread, and adds them to those of threads that exited before.
+    fn drop(&mut self) {
+        // Take the snapshot lock first, so that concurrent snapshots see these statistics exactly once.
+        let mut retired: MutexGuard<Option<StatsSnapshot>> = RETIRED.lock().unwrap_or_else(|e| e.into_inner());
+        REGISTRY
+            .lock()
+            .unwrap_or_else(|e| e.into_inner())
+            .retain(|stats| !Arc::ptr_eq(stats, &self.0));
+        retired.get_or_insert_with(StatsSnapshot::default).merge(&self.0);
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Records statistics of the current thread. Statistics are dropped if the thread is being torn down.
+#[inline]
+pub fn record<F: FnOnce(&Stats)>(f: F) {
+    let _ = STATS.try_with(|stats| f(&stats.0));
+}
+
+/// Takes a snapshot of the statistics of all threads, added up. Threads keep recording meanwhile, so the snapshot is
+/// not atomic, but each value in it is.
+pub fn snapshot() -> StatsSnapshot {
+    let mut snapshot: StatsSnapshot = StatsSnapshot::default();
+    let retired: MutexGuard<Option<StatsSnapshot>> = RETIRED.lock().unwrap_or_else(|e| e.into_inner());
+    if let Some(ref retired) = *retired {
+        snapshot.add(retired);
+    }
+    for stats in REGISTRY.lock().unwrap_or_else(|e| e.into_inner()).iter() {
+        snapshot.merge(stats);
+    }
+    snapshot
+}
+
+/// Returns the bucket of a value.
+#[inline]
+fn bucket_index(value: u64) -> usize {
+    if value < SUB_BUCKETS as u64 {
+        return value as usize;
+    }
+    let msb: u32 = u64::BITS - 1 - value.leading_zeros();
+    let sub_bucket: u64 = (value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS as u64 - 1);
+    (msb - SUB_BUCKET_BITS + 1) as usize * SUB_BUCKETS + sub_bucket as usize
+}
+
+/// Returns the largest value that falls in a bucket.
+fn bucket_upper_bound(index: usize) -> u64 {
+    if index < SUB_BUCKETS {
+        return index as u64;
+    }
+    let msb: u32 = (index / SUB_BUCKETS) as u32 + SUB_BUCKET_BITS - 1;
+    let sub_bucket: u64 = (index % SUB_BUCKETS) as u64;
+    let width: u64 = 1 << (msb - SUB_BUCKET_BITS);
+    (1 << msb | sub_bucket * width) + (width - 1)
+}
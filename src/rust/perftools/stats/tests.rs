@@ -0,0 +1,95 @@
+// Copyright(c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+use crate::perftools::stats::{
+    self,
+    bucket_index,
+    bucket_upper_bound,
+    Histogram,
+    HistogramSnapshot,
+    Stats,
+    StatsSnapshot,
+    NUM_BUCKETS,
+    REGISTRY,
+    STATS,
+};
+use ::std::{
+    sync::Arc,
+    thread,
+};
+
+#[test]
+fn test_bucket_bounds() {
+    let mut values: Vec<u64> = (0..1024).collect();
+    values.extend((10..64).flat_map(|shift| [(1 << shift) - 1, 1 << shift, (1 << shift) + 12345]));
+    values.push(u64::MAX);
+
+    for value in values {
+        let index: usize = bucket_index(value);
+        assert!(index < NUM_BUCKETS);
+        let upper: u64 = bucket_upper_bound(index);
+        assert!(value <= upper);
+        // The relative error is at most 1/16.
+        assert!(upper - value <= value / 16);
+        if index > 0 {
+            assert!(value > bucket_upper_bound(index - 1));
+        }
+    }
+}
+
+#[test]
+fn test_percentiles() {
+    let histogram: Histogram = Histogram::default();
+    for value in 1..=1000 {
+        histogram.record(value);
+    }
+    let mut snapshot: HistogramSnapshot = HistogramSnapshot::default();
+    snapshot.merge(&histogram);
+
+    assert_eq!(snapshot.count(), 1000);
+    assert_eq!(snapshot.min, 1);
+    assert_eq!(snapshot.max, 1000);
+    assert_eq!(snapshot.sum, 500500);
+    for (q, expected) in [(0.5, 500), (0.9, 900), (0.99, 990), (0.999, 999)] {
+        let p: u64 = snapshot.percentile(q);
+        assert!(p >= expected && p <= expected + expected / 16, "q={:?} p={:?}", q, p);
+    }
+    assert_eq!(snapshot.percentile(1.0), 1000);
+    assert_eq!(HistogramSnapshot::default().percentile(0.5), 0);
+}
+
+#[test]
+fn test_snapshot_threads() {
+    // Each thread records into its own statistics, which still count once the thread exited.
+    let workers: Vec<thread::JoinHandle<()>> = (0..4)
+        .map(|_| {
+            thread::spawn(|| {
+                for value in 0..100 {
+                    stats::record(|s| s.connect_latency.record(value));
+                }
+                stats::record(|s| s.retransmits.add(3));
+            })
+        })
+        .collect();
+    for worker in workers {
+        worker.join().unwrap();
+    }
+
+    // Other tests may record concurrently.
+    let snapshot: StatsSnapshot = stats::snapshot();
+    assert!(snapshot.connect_latency.count() >= 400);
+    assert!(snapshot.retransmits >= 12);
+}
+
+#[test]
+fn test_retire_thread() {
+    // Statistics of a thread are unregistered when it exits.
+    let stats: Arc<Stats> = thread::spawn(|| {
+        stats::record(|s| s.heap_pool_misses.add(1));
+        STATS.with(|stats| stats.0.clone())
+    })
+    .join()
+    .unwrap();
+    assert!(!REGISTRY.lock().unwrap().iter().any(|s| Arc::ptr_eq(s, &stats)));
+    assert!(stats::snapshot().heap_pool_misses >= 1);
+}
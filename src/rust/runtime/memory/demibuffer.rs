@@ -13,10 +13,10 @@
 // Note: if compiled without the "libdpdk" feature defined, the DPDK-specific functionality won't be present.
 
 // Note on buffer chain support:
-// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  While the
-// DemiBuffer routines for heap-allocated buffers also now support this functionality, it isn't yet exposed via the
-// DemiBuffer interface.
-// ToDo: Expose buffer chain support once we have a solid use case.
+// DPDK has a concept of MBuf chaining where multiple MBufs may be linked together to form a "packet".  The DemiBuffer
+// routines for heap-allocated buffers also support this functionality.  Chains are built with append() and taken apart
+// with unchain(), and they back scatter-gather arrays with multiple segments.  Note that len(), the Deref traits, and
+// most other operations only cover the first segment of a chain.  Use pkt_len() and segments() to cover all of them.
 
 // Note on intrusive queueing:
 // Since all DemiBuffer types keep the metadata for each "view" in a separate allocated region, they can be queued
@@ -24,30 +24,33 @@
 // ToDo: Expose calls to get/set a linking field.
 
 // Note on the allocation functions:
-// This code currently uses std::alloc() and std::dealloc() to allocate/free things from the heap.  Note that the Rust
-// documentation says that these functions are expected to be deprecated in favor of their respective methods of the
-// "Global" type when it and the "Allocator" trait become stable.
+// Heap-allocated buffers draw their MetaData (and any directly attached data) from the per-thread size-class pools of
+// the heap_pool module, which fall back to std::alloc() and std::dealloc().  Note that the Rust documentation says that
+// these functions are expected to be deprecated in favor of their respective methods of the "Global" type when it and
+// the "Allocator" trait become stable.
 
 use crate::{
     pal::arch,
-    runtime::fail::Fail,
+    runtime::{
+        fail::Fail,
+        memory::heap_pool::{
+            alloc_heap_block,
+            free_heap_block,
+        },
+    },
 };
 #[cfg(feature = "libdpdk")]
 use ::dpdk_rs::{
     rte_mbuf,
     rte_mempool,
     rte_pktmbuf_adj,
+    rte_pktmbuf_chain,
     rte_pktmbuf_clone,
     rte_pktmbuf_free,
     rte_pktmbuf_trim,
 };
 use ::std::{
-    alloc::{
-        alloc,
-        dealloc,
-        handle_alloc_error,
-        Layout,
-    },
+    iter,
     marker::PhantomData,
     mem::{
         self,
@@ -124,7 +127,7 @@ struct MetaData {
     next: Option<NonNull<MetaData>>,
 
     // Various fields for TX offload.
-    _tx_offload: u64,
+    tx_offload: u64,
 
     // Pointer to shared info (rte_mbuf_ext_shared_info).  DPDK uses this for external MBufs.
     _shinfo: u64,
@@ -149,6 +152,10 @@ const _: () = assert!(std::mem::size_of::<MetaData>() == 2 * arch::CPU_DATA_CACH
 // points to another MetaData's directly attached data.
 const METADATA_F_INDIRECT: u64 = 1 << 62;
 
+// Indicates this MetaData struct has an externally-managed data buffer attached.  We never set this one ourselves, but
+// DPDK may hand us MBufs with it set.
+const METADATA_F_EXTERNAL: u64 = 1 << 61;
+
 impl MetaData {
     // Note on Reference Counts:
     // Since we are currently single-threaded, there is no need to use atomic operations for refcnt manipulations.
@@ -261,8 +268,20 @@ impl DemiBuffer {
     // propagate actual allocation failures outward, if we determine that would be helpful.  For now, we stick to the
     // status quo, and assume this allocation never fails.
     pub fn new(capacity: u16) -> Self {
+        Self::new_with_headroom(0, capacity)
+    }
+
+    /// Creates a new (Heap-allocated) `DemiBuffer` that reserves `headroom` bytes in front of its data area.  These
+    /// bytes may later be claimed with `prepend()` (e.g. to fill in protocol headers without copying the data).
+    pub fn new_with_headroom(headroom: u16, capacity: u16) -> Self {
+        // Both the headroom and the data area must fit in the buffer.
+        let buf_len: u16 = match headroom.checked_add(capacity) {
+            Some(buf_len) => buf_len,
+            None => panic!("headroom plus capacity is larger than a DemiBuffer can hold"),
+        };
+
         // Allocate some memory off the heap.
-        let mut temp: NonNull<MetaData> = allocate_metadata_data(capacity);
+        let mut temp: NonNull<MetaData> = allocate_metadata_data(buf_len);
 
         // Initialize the MetaData.
         {
@@ -270,7 +289,7 @@ impl DemiBuffer {
             let metadata: &mut MetaData = unsafe { temp.as_mut() };
 
             // Point buf_addr at the newly allocated data space (if any).
-            if capacity == 0 {
+            if buf_len == 0 {
                 // No direct data, so don't point buf_addr at anything.
                 metadata.buf_addr = null_mut();
             } else {
@@ -281,13 +300,13 @@ impl DemiBuffer {
             }
 
             // Set field values as appropriate.
-            metadata.data_off = 0;
+            metadata.data_off = headroom;
             metadata.refcnt = 1;
             metadata.nb_segs = 1;
             metadata.ol_flags = 0;
             metadata.pkt_len = capacity as u32;
             metadata.data_len = capacity;
-            metadata.buf_len = capacity;
+            metadata.buf_len = buf_len;
             metadata.next = None;
         }
 
@@ -301,6 +320,19 @@ impl DemiBuffer {
         }
     }
 
+    /// Creates a new (Heap-allocated) `DemiBuffer` chain with a data area of `size` bytes.  The data area is split in as
+    /// few segments as possible.
+    pub fn new_chain(size: usize) -> Result<Self, Fail> {
+        let mut head: DemiBuffer = DemiBuffer::new(size.min(u16::MAX as usize) as u16);
+        let mut remaining: usize = size - head.len();
+        while remaining > 0 {
+            let segment: DemiBuffer = DemiBuffer::new(remaining.min(u16::MAX as usize) as u16);
+            remaining -= segment.len();
+            head.append(segment)?;
+        }
+        Ok(head)
+    }
+
     /// Create a new Heap-allocated `DemiBuffer` from a byte slice.
     pub fn from_slice(slice: &[u8]) -> Result<Self, Fail> {
         // Note: The implementation of the TryFrom trait (see below, under "Trait Implementations") automatically
@@ -353,6 +385,90 @@ impl DemiBuffer {
         self.as_metadata().data_len as usize
     }
 
+    /// Returns the length of the data stored in all segments of the `DemiBuffer` chain.
+    pub fn pkt_len(&self) -> usize {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        self.as_metadata().pkt_len as usize
+    }
+
+    /// Returns the number of segments in the `DemiBuffer` chain.
+    pub fn nb_segs(&self) -> usize {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        self.as_metadata().nb_segs as usize
+    }
+
+    /// Returns an iterator over the data of each segment in the `DemiBuffer` chain.
+    pub fn segments(&self) -> impl Iterator<Item = &[u8]> {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        let mut next_entry: Option<NonNull<MetaData>> = Some(self.get_ptr::<MetaData>());
+        iter::from_fn(move || {
+            // Safety: This is safe, as every entry of the chain is aligned, dereferenceable, initialized, and it lives at
+            // least as long as the borrow of `self`.
+            let metadata: &MetaData = unsafe { next_entry?.as_ref() };
+            next_entry = metadata.next;
+            if metadata.data_len == 0 {
+                // Zero-length segments may not point at any data.
+                return Some(&[][..]);
+            }
+            // Safety: the calls to offset and from_raw_parts are safe, as their arguments refer to a valid readable
+            // memory region of the size specified, contained within a single allocated object.
+            Some(unsafe {
+                slice::from_raw_parts(
+                    metadata.buf_addr.offset(metadata.data_off as isize),
+                    metadata.data_len as usize,
+                )
+            })
+        })
+    }
+
+    /// Returns the number of bytes that are available in front of the data stored in the `DemiBuffer`.
+    pub fn headroom(&self) -> usize {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        self.as_metadata().data_off as usize
+    }
+
+    /// Returns `true` if the data of this `DemiBuffer` is directly attached to it and not shared with any other
+    /// `DemiBuffer` (or MBuf), and `false` otherwise.  Only then it is safe to write into the headroom of the buffer,
+    /// as any other view into the same data could otherwise cover these bytes.
+    pub fn is_exclusive(&self) -> bool {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        let metadata: &mut MetaData = self.as_metadata();
+        metadata.refcnt == 1 && metadata.ol_flags & (METADATA_F_INDIRECT | METADATA_F_EXTERNAL) == 0
+    }
+
+    #[cfg(feature = "libdpdk")]
+    /// Requests offload features from the NIC for the packet that starts with this (DPDK-allocated) `DemiBuffer`.
+    // Note: `ol_flags` are added to the flags that are already set, whereas `tx_offload` replaces the packed header
+    // lengths.  Both follow DPDK's rte_mbuf conventions, and are only meaningful in the first segment of a chain.
+    pub fn set_tx_offload(&mut self, ol_flags: u64, tx_offload: u64) {
+        debug_assert!(self.is_dpdk_allocated());
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        let metadata: &mut MetaData = self.as_metadata();
+        metadata.ol_flags |= ol_flags;
+        metadata.tx_offload = tx_offload;
+    }
+
+    /// Prepends `nbytes` bytes from the headroom to the beginning of the `DemiBuffer` chain.
+    // Note: The prepended bytes are not initialized, and other views into the same data may cover them.  The caller
+    // should ensure the buffer `is_exclusive()` before writing into them.  This matches the behavior of DPDK's
+    // rte_pktmbuf_prepend() routine (which we can't call directly, as it is an inline function).
+    pub fn prepend(&mut self, nbytes: usize) -> Result<(), Fail> {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        let metadata: &mut MetaData = self.as_metadata();
+        if nbytes > metadata.data_off as usize {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "tried to prepend more bytes than the headroom holds",
+            ));
+        }
+        // The above check against data_off also means that nbytes is <= u16::MAX.  So these casts are safe.
+        metadata.data_off -= nbytes as u16;
+        metadata.pkt_len += nbytes as u32;
+        metadata.data_len += nbytes as u16;
+
+        Ok(())
+    }
+
     /// Removes `nbytes` bytes from the beginning of the `DemiBuffer` chain.
     // Note: If `nbytes` is greater than the length of the first segment in the chain, then this function will fail and
     // return an error, rather than remove the remaining bytes from subsequent segments in the chain.  This is to match
@@ -474,6 +590,80 @@ impl DemiBuffer {
         Ok(back_half)
     }
 
+    /// Appends the segments of `tail` to the end of the `DemiBuffer` chain.  Both must be of the same buffer type.
+    pub fn append(&mut self, tail: DemiBuffer) -> Result<(), Fail> {
+        if self.get_tag() != tail.get_tag() {
+            return Err(Fail::new(libc::EINVAL, "tried to chain DemiBuffers of different types"));
+        }
+
+        // ToDo: Review having this "match", since MetaData and MBuf are laid out the same, these are equivalent cases.
+        match self.get_tag() {
+            Tag::Heap => {
+                let md_first: &mut MetaData = self.as_metadata();
+                let md_tail: &mut MetaData = tail.as_metadata();
+                let nb_segs: u16 = match md_first.nb_segs.checked_add(md_tail.nb_segs) {
+                    Some(nb_segs) => nb_segs,
+                    None => return Err(Fail::new(libc::EINVAL, "too many segments in DemiBuffer chain")),
+                };
+                md_first.nb_segs = nb_segs;
+                md_first.pkt_len += md_tail.pkt_len;
+                md_first.get_last_segment().next = Some(tail.get_ptr::<MetaData>());
+            },
+            #[cfg(feature = "libdpdk")]
+            Tag::Dpdk => {
+                // Safety: rte_pktmbuf_chain is a FFI that is safe to call as both of its args are valid MBuf pointers.
+                if unsafe { rte_pktmbuf_chain(self.as_mbuf(), tail.as_mbuf()) } != 0 {
+                    return Err(Fail::new(libc::EINVAL, "too many segments in DemiBuffer chain"));
+                }
+            },
+        }
+
+        // The chain now holds the reference of `tail`.
+        mem::forget(tail);
+        Ok(())
+    }
+
+    /// Detaches all segments but the first one from the `DemiBuffer` chain, and returns them in a `DemiBuffer` chain of
+    /// their own.  Returns `None` if the `DemiBuffer` is a single buffer segment.
+    pub fn unchain(&mut self) -> Option<Self> {
+        // Note: MetaData and MBuf are laid out the same, so this works for both buffer types.
+        let md_first: &mut MetaData = self.as_metadata();
+        let mut temp: NonNull<MetaData> = md_first.next.take()?;
+
+        // The chain and packet lengths are only valid in the first segment of a chain.
+        {
+            // Safety: This is safe, as temp is aligned, dereferenceable, and md_rest isn't aliased in this block.
+            let md_rest: &mut MetaData = unsafe { temp.as_mut() };
+            md_rest.nb_segs = md_first.nb_segs - 1;
+            md_rest.pkt_len = md_first.pkt_len - md_first.data_len as u32;
+        }
+        md_first.nb_segs = 1;
+        md_first.pkt_len = md_first.data_len as u32;
+
+        // Embed the buffer type into the lower bits of the pointer.  All segments of a chain share the same type.
+        let tagged: NonNull<MetaData> = temp.with_addr(temp.addr() | self.get_tag());
+
+        Some(DemiBuffer {
+            tagged_ptr: tagged,
+            _phantom: PhantomData,
+        })
+    }
+
+    /// Copies the data of all segments in the `DemiBuffer` chain into a new (Heap-allocated) single-segment
+    /// `DemiBuffer`.
+    pub fn coalesce(&self) -> Result<Self, Fail> {
+        if self.pkt_len() > u16::MAX as usize {
+            return Err(Fail::new(libc::EINVAL, "chain is larger than a DemiBuffer can hold"));
+        }
+        let mut buf: DemiBuffer = DemiBuffer::new(self.pkt_len() as u16);
+        let mut offset: usize = 0;
+        for segment in self.segments() {
+            buf[offset..(offset + segment.len())].copy_from_slice(segment);
+            offset += segment.len();
+        }
+        Ok(buf)
+    }
+
     /// Provides a raw pointer to the buffer data.
     ///
     /// The reference count is not affected in any way and the DemiBuffer is not consumed.  The pointer is valid for as
@@ -578,16 +768,8 @@ fn allocate_metadata_data(direct_data_size: u16) -> NonNull<MetaData> {
     // We need space for the MetaData struct, plus any extra memory for directly attached data.
     let amount: usize = size_of::<MetaData>() + direct_data_size as usize;
 
-    // Given our limited allocation amount (u16::MAX) and fixed alignment size, this unwrap cannot panic.
-    let layout: Layout = Layout::from_size_align(amount, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
-
-    // Safety: This is safe, as we check for a null return value before dereferencing "allocation".
-    let allocation: *mut u8 = unsafe { alloc(layout) };
-    if allocation.is_null() {
-        handle_alloc_error(layout);
-    }
-
-    let metadata: *mut MetaData = allocation.cast::<MetaData>();
+    // The heap pool hands out cache-line aligned blocks, and takes care of allocation failures.
+    let metadata: *mut MetaData = alloc_heap_block(amount).cast::<MetaData>().as_ptr();
 
     // Initialize select MetaData fields in debug builds for sanity checking.
     // We check in debug builds that they aren't accidentally messed with.
@@ -602,7 +784,7 @@ fn allocate_metadata_data(direct_data_size: u16) -> NonNull<MetaData> {
     }
 
     // Convert to NonNull<MetaData> type and return.
-    // Safety: The call to NonNull::new_unchecked is safe, as `allocation` is known to be non-null.
+    // Safety: The call to NonNull::new_unchecked is safe, as `metadata` is known to be non-null.
     unsafe { NonNull::new_unchecked(metadata) }
 }
 
@@ -618,14 +800,9 @@ fn free_metadata_data(buffer: NonNull<MetaData>) {
     // Note that this code currently assumes we're not using a "private data" feature akin to DPDK's.
     debug_assert_eq!(metadata._priv_size, 0);
     let amount: usize = size_of::<MetaData>() + metadata.buf_len as usize;
-    // This unwrap will never panic, as we pass a known allocation amount and a fixed alignment to from_size_align().
-    let layout: Layout = Layout::from_size_align(amount, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
 
-    // Convert buffer pointer into a raw allocation pointer.
-    let allocation: *mut u8 = buffer.cast::<u8>().as_ptr();
-
-    // Safety: this is safe because we're using the same (de)allocator and Layout used for allocation.
-    unsafe { dealloc(allocation, layout) };
+    // Hand the allocation back to the heap pool, which files it under the same size class as when it was allocated.
+    free_heap_block(buffer.cast::<u8>(), amount);
 }
 
 // ---------------------
@@ -982,6 +1159,44 @@ mod tests {
         assert_eq!(another.len(), 0);
     }
 
+    // Test headroom reservation and prepend.
+    #[test]
+    fn headroom() {
+        // Create a new (heap-allocated) `DemiBuffer` with a 42 byte data area and 16 bytes of headroom.
+        let mut buf: DemiBuffer = DemiBuffer::new_with_headroom(16, 42);
+        assert_eq!(buf.len(), 42);
+        assert_eq!(buf.headroom(), 16);
+        assert!(buf.is_exclusive());
+        buf.copy_from_slice(&[1; 42]);
+
+        // Prepend 10 bytes from the headroom.  Length should now be 52.
+        assert!(buf.prepend(10).is_ok());
+        assert_eq!(buf.len(), 52);
+        assert_eq!(buf.headroom(), 6);
+        buf[..10].copy_from_slice(&[2; 10]);
+        assert_eq!(&buf[10..], &[1; 42]);
+
+        // Verify bad requests actually fail.
+        assert!(buf.prepend(7).is_err());
+        assert_eq!(buf.len(), 52);
+
+        // Buffers without reserved headroom have none.
+        let mut plain: DemiBuffer = DemiBuffer::new(42);
+        assert_eq!(plain.headroom(), 0);
+        assert!(plain.prepend(1).is_err());
+
+        // Removed bytes become headroom again.
+        assert!(buf.adjust(4).is_ok());
+        assert_eq!(buf.headroom(), 10);
+
+        // Clones share their data, so neither of them is exclusive.
+        let clone: DemiBuffer = buf.clone();
+        assert!(!buf.is_exclusive());
+        assert!(!clone.is_exclusive());
+        drop(clone);
+        assert!(buf.is_exclusive());
+    }
+
     // Test split_off (and also allocation from a slice).
     #[test]
     fn split() {
@@ -1036,4 +1251,57 @@ mod tests {
         assert_eq!(&*split_buf, split_str.as_bytes());
         assert_eq!(&*another_buf, another_str.as_bytes());
     }
+
+    // Test buffer chains: append, segments, clone, trim, and unchain.
+    #[test]
+    fn chain() {
+        // Chain three `DemiBuffer`s together.
+        let mut buf: DemiBuffer = DemiBuffer::from_slice(b"header").expect("slice should fit in a DemiBuffer");
+        let body: DemiBuffer = DemiBuffer::from_slice(b"body").expect("slice should fit in a DemiBuffer");
+        let trailer: DemiBuffer = DemiBuffer::from_slice(b"trailer").expect("slice should fit in a DemiBuffer");
+        assert!(buf.append(body).is_ok());
+        assert!(buf.append(trailer).is_ok());
+
+        // Only the first segment is covered by len() and the Deref traits.
+        assert_eq!(buf.nb_segs(), 3);
+        assert_eq!(buf.pkt_len(), 17);
+        assert_eq!(buf.len(), 6);
+        assert_eq!(&*buf, b"header");
+        let segments: Vec<&[u8]> = buf.segments().collect();
+        assert_eq!(segments, [&b"header"[..], &b"body"[..], &b"trailer"[..]]);
+
+        // Clones cover the whole chain, and trim() applies to its last segment.
+        let mut clone: DemiBuffer = buf.clone();
+        assert!(clone.trim(3).is_ok());
+        assert_eq!(clone.pkt_len(), 14);
+        let segments: Vec<&[u8]> = clone.segments().collect();
+        assert_eq!(segments, [&b"header"[..], &b"body"[..], &b"trai"[..]]);
+        drop(clone);
+
+        // Take the chain apart again.
+        let mut rest: DemiBuffer = buf.unchain().expect("buffer should be a chain");
+        assert_eq!(buf.nb_segs(), 1);
+        assert_eq!(buf.pkt_len(), 6);
+        assert!(buf.unchain().is_none());
+        assert_eq!(rest.nb_segs(), 2);
+        assert_eq!(rest.pkt_len(), 11);
+        let last: DemiBuffer = rest.unchain().expect("buffer should be a chain");
+        assert_eq!(&*rest, b"body");
+        assert_eq!(&*last, b"trailer");
+        assert_eq!(last.nb_segs(), 1);
+        assert_eq!(last.pkt_len(), 7);
+
+        // Coalescing a chain copies all of its segments.
+        assert!(rest.append(last).is_ok());
+        let coalesced: DemiBuffer = rest.coalesce().expect("chain should fit in a DemiBuffer");
+        assert_eq!(coalesced.nb_segs(), 1);
+        assert_eq!(&*coalesced, b"bodytrailer");
+
+        // Large chains are split in segments that are as large as possible.
+        let buf: DemiBuffer = DemiBuffer::new_chain(2 * u16::MAX as usize + 1).expect("chain should be allocated");
+        assert_eq!(buf.nb_segs(), 3);
+        assert_eq!(buf.pkt_len(), 2 * u16::MAX as usize + 1);
+        let lengths: Vec<usize> = buf.segments().map(|segment| segment.len()).collect();
+        assert_eq!(lengths, [u16::MAX as usize, u16::MAX as usize, 1]);
+    }
 }
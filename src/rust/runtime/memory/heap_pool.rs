@@ -0,0 +1,325 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+// This heap pool backs the allocations of heap-allocated DemiBuffers.  Every DemiBuffer (and every clone of one) needs
+// a block for its MetaData and any directly attached data, so going through the global allocator each time shows up
+// prominently in profiles.  Instead, blocks are rounded up to a fixed set of size classes, and released blocks are
+// kept on a free list per size class, from which later allocations of the same class are served.  The scheduler keeps
+// its tasks in this pool too, for the same reason.
+//
+// Note on threading:
+// Each thread has its own pool, so neither allocations nor releases need any synchronization.  A block may be released
+// by a thread other than the one that allocated it, in which case it simply lands in the pool of the releasing thread.
+// Since all blocks originally come from the global allocator, this is always safe.  The free lists are bounded, and
+// whatever they hold is handed back to the global allocator when their thread exits.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::{
+    pal::arch,
+    perftools::stats,
+};
+use ::std::{
+    alloc::{
+        alloc,
+        dealloc,
+        handle_alloc_error,
+        Layout,
+    },
+    cell::Cell,
+    ptr::NonNull,
+};
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Number of size classes.
+const NUM_SIZE_CLASSES: usize = 10;
+
+/// Size of the metadata at the start of each block (two cache lines).
+const METADATA_SIZE: usize = 2 * arch::CPU_DATA_CACHE_LINE_SIZE;
+
+/// Block size of each size class.  Blocks hold the metadata plus the data area of a buffer: none for clones, then
+/// typical sizes for headers, MTU-sized and jumbo frames, and so on, up to the largest data area a buffer can hold.
+const BLOCK_SIZES: [usize; NUM_SIZE_CLASSES] = [
+    METADATA_SIZE,
+    METADATA_SIZE + 128,
+    METADATA_SIZE + 512,
+    METADATA_SIZE + 1024,
+    METADATA_SIZE + 2048,
+    METADATA_SIZE + 4096,
+    METADATA_SIZE + 9216,
+    METADATA_SIZE + 16384,
+    METADATA_SIZE + 32768,
+    METADATA_SIZE + 65536,
+];
+
+/// Upper bound on the number of bytes that the free list of a size class holds on to.
+const MAX_CACHED_BYTES: usize = 4 * 1024 * 1024;
+
+/// Lower bound on the number of blocks that the free list of a size class may hold on to.
+const MIN_CACHED_BLOCKS: u64 = 16;
+
+thread_local!(
+    /// Heap pool of the current thread.
+    static HEAP_POOL: HeapPool = const { HeapPool::new() }
+);
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Heap Pool Statistics
+///
+/// These are kept per thread and per size class.
+#[derive(Clone, Copy, Debug, Default)]
+pub struct HeapPoolStats {
+    /// Size of the blocks in this size class (metadata included).
+    pub block_size: usize,
+    /// Number of allocations that were served from the free list.
+    pub hits: u64,
+    /// Number of allocations that went to the global allocator.
+    pub misses: u64,
+    /// Number of blocks that are currently allocated. Blocks released by other threads are not accounted for.
+    pub in_use: u64,
+    /// Highest number of blocks that were allocated at once.
+    pub high_water: u64,
+    /// Number of released blocks that are kept on the free list.
+    pub cached: u64,
+}
+
+/// Header of a released block, which links it into the free list of its size class.
+struct FreeBlock {
+    next: Option<NonNull<FreeBlock>>,
+}
+
+/// Size Class
+struct SizeClass {
+    /// Head of the free list.
+    free: Cell<Option<NonNull<FreeBlock>>>,
+    /// Statistics.
+    stats: Cell<HeapPoolStats>,
+}
+
+/// Heap Pool
+struct HeapPool {
+    classes: [SizeClass; NUM_SIZE_CLASSES],
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Heap Pools
+impl HeapPool {
+    /// Creates an empty heap pool.
+    const fn new() -> Self {
+        // SizeClass is not Copy, so the array is filled with a constant item and then set up in a loop.
+        const EMPTY: SizeClass = SizeClass::new(0);
+        let mut classes: [SizeClass; NUM_SIZE_CLASSES] = [EMPTY; NUM_SIZE_CLASSES];
+        let mut i: usize = 0;
+        while i < NUM_SIZE_CLASSES {
+            classes[i] = SizeClass::new(BLOCK_SIZES[i]);
+            i += 1;
+        }
+        Self { classes }
+    }
+}
+
+/// Associate Functions for Size Classes
+impl SizeClass {
+    /// Creates a size class with an empty free list.
+    const fn new(block_size: usize) -> Self {
+        Self {
+            free: Cell::new(None),
+            stats: Cell::new(HeapPoolStats {
+                block_size,
+                hits: 0,
+                misses: 0,
+                in_use: 0,
+                high_water: 0,
+                cached: 0,
+            }),
+        }
+    }
+
+    /// Allocates a block, from the free list if it has any.
+    fn alloc(&self) -> NonNull<u8> {
+        let mut stats: HeapPoolStats = self.stats.get();
+        let block: NonNull<u8> = match self.free.get() {
+            Some(head) => {
+                // Safety: blocks on the free list are aligned, dereferenceable, and start with an initialized header.
+                self.free.set(unsafe { head.as_ref() }.next);
+                stats.hits += 1;
+                stats.cached -= 1;
+                head.cast::<u8>()
+            },
+            None => {
+                stats.misses += 1;
+                stats::record(|stats| stats.heap_pool_misses.add(1));
+                alloc_block(stats.block_size)
+            },
+        };
+        stats.in_use += 1;
+        stats.high_water = stats.high_water.max(stats.in_use);
+        self.stats.set(stats);
+        block
+    }
+
+    /// Releases a block to the free list, unless it is full already.
+    fn free(&self, block: NonNull<u8>) {
+        let mut stats: HeapPoolStats = self.stats.get();
+        stats.in_use = stats.in_use.saturating_sub(1);
+        if stats.cached < MIN_CACHED_BLOCKS.max((MAX_CACHED_BYTES / stats.block_size) as u64) {
+            let mut head: NonNull<FreeBlock> = block.cast::<FreeBlock>();
+            // Safety: the block is aligned, and large enough to hold the header, and nobody else references it anymore.
+            unsafe { head.as_mut() }.next = self.free.get();
+            self.free.set(Some(head));
+            stats.cached += 1;
+        } else {
+            dealloc_block(block, stats.block_size);
+        }
+        self.stats.set(stats);
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Drop Trait Implementation for Heap Pools
+impl Drop for HeapPool {
+    fn drop(&mut self) {
+        // Hand the blocks on the free lists back to the global allocator.
+        for class in &self.classes {
+            let block_size: usize = class.stats.get().block_size;
+            let mut next: Option<NonNull<FreeBlock>> = class.free.take();
+            while let Some(block) = next {
+                // Safety: blocks on the free list are aligned, dereferenceable, and start with an initialized header.
+                next = unsafe { block.as_ref() }.next;
+                dealloc_block(block.cast::<u8>(), block_size);
+            }
+        }
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Allocates a cache-line aligned block of at least `size` bytes.
+pub fn alloc_heap_block(size: usize) -> NonNull<u8> {
+    match size_class(size) {
+        Some(class) => match HEAP_POOL.try_with(|pool| pool.classes[class].alloc()) {
+            Ok(block) => block,
+            // The pool of this thread is gone already.
+            Err(_) => alloc_block(BLOCK_SIZES[class]),
+        },
+        None => alloc_block(size),
+    }
+}
+
+/// Releases a block that was allocated with [alloc_heap_block] for `size` bytes.
+pub fn free_heap_block(block: NonNull<u8>, size: usize) {
+    match size_class(size) {
+        Some(class) => {
+            if HEAP_POOL.try_with(|pool| pool.classes[class].free(block)).is_err() {
+                // The pool of this thread is gone already.
+                dealloc_block(block, BLOCK_SIZES[class]);
+            }
+        },
+        None => dealloc_block(block, size),
+    }
+}
+
+/// Returns the statistics of each size class of the heap pool of the current thread.
+pub fn heap_pool_stats() -> Vec<HeapPoolStats> {
+    HEAP_POOL
+        .try_with(|pool| pool.classes.iter().map(|class| class.stats.get()).collect())
+        .unwrap_or_default()
+}
+
+/// Returns the index of the smallest size class that holds blocks of `size` bytes, if any.
+fn size_class(size: usize) -> Option<usize> {
+    let class: usize = BLOCK_SIZES.partition_point(|&block_size| block_size < size);
+    if class < NUM_SIZE_CLASSES {
+        Some(class)
+    } else {
+        None
+    }
+}
+
+/// Allocates a cache-line aligned block of `size` bytes from the global allocator.
+fn alloc_block(size: usize) -> NonNull<u8> {
+    // Given our limited allocation sizes and fixed alignment size, this unwrap cannot panic.
+    let layout: Layout = Layout::from_size_align(size, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
+
+    // Safety: This is safe, as we check for a null return value before using the allocation.
+    match NonNull::new(unsafe { alloc(layout) }) {
+        Some(block) => block,
+        None => handle_alloc_error(layout),
+    }
+}
+
+/// Releases a block of `size` bytes to the global allocator.
+fn dealloc_block(block: NonNull<u8>, size: usize) {
+    // This unwrap will never panic, as we pass a known allocation amount and a fixed alignment to from_size_align().
+    let layout: Layout = Layout::from_size_align(size, arch::CPU_DATA_CACHE_LINE_SIZE).unwrap();
+
+    // Safety: this is safe because we're using the same (de)allocator and Layout used for allocation.
+    unsafe { dealloc(block.as_ptr(), layout) };
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        alloc_heap_block,
+        free_heap_block,
+        heap_pool_stats,
+        size_class,
+        HeapPoolStats,
+        BLOCK_SIZES,
+        METADATA_SIZE,
+    };
+    use ::std::ptr::NonNull;
+
+    #[test]
+    fn size_classes() {
+        assert_eq!(size_class(METADATA_SIZE), Some(0));
+        assert_eq!(size_class(METADATA_SIZE + 1), Some(1));
+        assert_eq!(size_class(METADATA_SIZE + 1500), Some(4));
+        assert_eq!(
+            size_class(METADATA_SIZE + u16::MAX as usize),
+            Some(BLOCK_SIZES.len() - 1)
+        );
+        assert_eq!(size_class(BLOCK_SIZES[BLOCK_SIZES.len() - 1] + 1), None);
+    }
+
+    #[test]
+    fn recycle_blocks() {
+        let size: usize = METADATA_SIZE + 1000;
+        let class: usize = size_class(size).expect("size should fit in a size class");
+        let before: HeapPoolStats = heap_pool_stats()[class];
+
+        // Released blocks are handed out again to allocations of the same size class.
+        let block: NonNull<u8> = alloc_heap_block(size);
+        free_heap_block(block, size);
+        let other: NonNull<u8> = alloc_heap_block(size - 100);
+        assert_eq!(block, other);
+
+        let after: HeapPoolStats = heap_pool_stats()[class];
+        assert_eq!(after.hits, before.hits + 1);
+        assert_eq!(after.in_use, before.in_use + 1);
+        assert!(after.high_water >= after.in_use);
+
+        free_heap_block(other, size - 100);
+        assert_eq!(heap_pool_stats()[class].in_use, before.in_use);
+    }
+}
@@ -2,6 +2,7 @@
 // Licensed under the MIT license.
 
 mod demibuffer;
+mod heap_pool;
 
 //==============================================================================
 // Imports
@@ -12,6 +13,7 @@ use crate::runtime::{
     types::{
         demi_sgarray_t,
         demi_sgaseg_t,
+        DEMI_SGARRAY_MAXLEN,
     },
 };
 use ::libc::c_void;
@@ -26,7 +28,15 @@ use ::std::{
 // Exports
 //==============================================================================
 
-pub use self::demibuffer::*;
+pub use self::{
+    demibuffer::*,
+    heap_pool::{
+        alloc_heap_block,
+        free_heap_block,
+        heap_pool_stats,
+        HeapPoolStats,
+    },
+};
 
 //==============================================================================
 // Traits
@@ -37,57 +47,53 @@ pub use self::demibuffer::*;
 /// a Demibuffer from that allocation. Other libOSes may override these functions to allocate memory
 /// specific kernel-bypass memory (e.g., DPDK mbufs or registered RDMA memory).
 pub trait MemoryRuntime {
-    /// Converts a buffer into a scatter-gather array.
+    /// Converts a buffer into a scatter-gather array. Each segment of a buffer chain becomes a segment of the array.
     fn into_sgarray(&self, buf: DemiBuffer) -> Result<demi_sgarray_t, Fail> {
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: buf.len() as u32,
-        };
+        let nb_segs: usize = buf.nb_segs();
+        if nb_segs > DEMI_SGARRAY_MAXLEN {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "DemiBuffer has too many segments for a demi_sgarray_t",
+            ));
+        }
+
+        // Create a scatter-gather segment for each buffer segment to expose the DemiBuffer to the user.
+        let mut sga_segs: [demi_sgaseg_t; DEMI_SGARRAY_MAXLEN] = [demi_sgaseg_t {
+            sgaseg_buf: ptr::null_mut(),
+            sgaseg_len: 0,
+        }; DEMI_SGARRAY_MAXLEN];
+        for (sga_seg, segment) in sga_segs.iter_mut().zip(buf.segments()) {
+            sga_seg.sgaseg_buf = segment.as_ptr() as *mut c_void;
+            sga_seg.sgaseg_len = segment.len() as u32;
+        }
 
         // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
         Ok(demi_sgarray_t {
             sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
+            sga_numsegs: nb_segs as u32,
+            sga_segs,
             sga_addr: unsafe { mem::zeroed() },
         })
     }
 
-    /// Allocates a scatter-gather array.
+    /// Allocates a scatter-gather array. Arrays that are too large for a single buffer are backed by a chain of them.
     fn alloc_sgarray(&self, size: usize) -> Result<demi_sgarray_t, Fail> {
-        // ToDo: Allocate an array of buffers if requested size is too large for a single buffer.
-
-        // We can't allocate more than a single buffer.
-        if size > u16::MAX as usize {
-            return Err(Fail::new(libc::EINVAL, "size too large for a single demi_sgaseg_t"));
+        // We can't allocate more than a buffer per segment.
+        if size > DEMI_SGARRAY_MAXLEN * u16::MAX as usize {
+            return Err(Fail::new(libc::EINVAL, "size too large for a demi_sgarray_t"));
         }
 
         // First allocate the underlying DemiBuffer.
-        let buf: DemiBuffer = DemiBuffer::new(size as u16);
-
-        // Create a scatter-gather segment to expose the DemiBuffer to the user.
-        let data: *const u8 = buf.as_ptr();
-        let sga_seg: demi_sgaseg_t = demi_sgaseg_t {
-            sgaseg_buf: data as *mut c_void,
-            sgaseg_len: size as u32,
-        };
+        let buf: DemiBuffer = DemiBuffer::new_chain(size)?;
 
         // Create and return a new scatter-gather array (which inherits the DemiBuffer's reference).
-        Ok(demi_sgarray_t {
-            sga_buf: buf.into_raw().as_ptr() as *mut c_void,
-            sga_numsegs: 1,
-            sga_segs: [sga_seg],
-            sga_addr: unsafe { mem::zeroed() },
-        })
+        self.into_sgarray(buf)
     }
 
     /// Releases a scatter-gather array.
     fn free_sgarray(&self, sga: demi_sgarray_t) -> Result<(), Fail> {
         // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
+        if sga.sga_numsegs == 0 || sga.sga_numsegs as usize > DEMI_SGARRAY_MAXLEN {
             return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
         }
 
@@ -95,7 +101,7 @@ pub trait MemoryRuntime {
             return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid DemiBuffer token"));
         }
 
-        // Convert back to a DemiBuffer and drop it.
+        // Convert back to a DemiBuffer and drop it (along with all segments of its chain).
         // Safety: The `NonNull::new_unchecked()` call is safe, as we verified `sga.sga_buf` is not null above.
         let token: NonNull<u8> = unsafe { NonNull::new_unchecked(sga.sga_buf as *mut u8) };
         // Safety: The `DemiBuffer::from_raw()` call *should* be safe, as the `sga_buf` field in the `demi_sgarray_t`
@@ -106,11 +112,11 @@ pub trait MemoryRuntime {
         Ok(())
     }
 
-    /// Clones a scatter-gather array.
+    /// Clones a scatter-gather array. Arrays with multiple segments are cloned into a chain of buffers.
     fn clone_sgarray(&self, sga: &demi_sgarray_t) -> Result<DemiBuffer, Fail> {
         // Check arguments.
-        // TODO: Drop this check once we support scatter-gather arrays with multiple segments.
-        if sga.sga_numsegs != 1 {
+        let nb_segs: usize = sga.sga_numsegs as usize;
+        if nb_segs == 0 || nb_segs > DEMI_SGARRAY_MAXLEN {
             return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
         }
 
@@ -129,39 +135,64 @@ pub trait MemoryRuntime {
         // Don't drop buf, as it holds the same reference to the data as the sgarray (which should keep it).
         mem::forget(buf);
 
-        // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
-        // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
-        // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
-        let sga_data: *const u8 = sga.sga_segs[0].sgaseg_buf as *const u8;
-        let sga_len: usize = sga.sga_segs[0].sgaseg_len as usize;
-        let clone_data: *const u8 = clone.as_ptr();
-        let mut clone_len: usize = clone.len();
-        if sga_data != clone_data || sga_len != clone_len {
-            // We need to adjust the DemiBuffer to match the user's changes.
-
-            // First check that the user didn't do something non-sensical, like change the buffer description to
-            // reference address space outside of the DemiBuffer's allocated memory area.
-            if sga_data < clone_data || sga_data.addr() + sga_len > clone_data.addr() + clone_len {
-                return Err(Fail::new(
-                    libc::EINVAL,
-                    "demi_sgarray_t describes data outside backing buffer's allocated region",
-                ));
-            }
-
-            // Calculate the amount the new starting address is ahead of the old.  And then adjust `clone` to match.
-            let adjustment_amount: usize = sga_data.addr() - clone_data.addr();
-            clone.adjust(adjustment_amount)?;
-
-            // An adjustment above would have reduced clone.len() by the adjustment amount.
-            clone_len -= adjustment_amount;
-            debug_assert_eq!(clone_len, clone.len());
-
-            // Trim the clone down to size.
-            let trim_amount: usize = clone_len - sga_len;
-            clone.trim(trim_amount)?;
+        // The user can't add or remove segments, as they don't own the buffers that back them.
+        if clone.nb_segs() != nb_segs {
+            return Err(Fail::new(libc::EINVAL, "demi_sgarray_t has invalid segment count"));
+        }
+
+        // Fit each segment of the clone to the one the user has in the sgarray.
+        let mut rest: Option<DemiBuffer> = clone.unchain();
+        fit_to_sgaseg(&mut clone, &sga.sga_segs[0])?;
+        for sga_seg in &sga.sga_segs[1..nb_segs] {
+            // This unwrap won't panic, as we checked that the clone has as many segments as the sgarray above.
+            let mut segment: DemiBuffer = rest.unwrap();
+            rest = segment.unchain();
+            fit_to_sgaseg(&mut segment, sga_seg)?;
+            clone.append(segment)?;
         }
 
         // Return the clone.
         Ok(clone)
     }
 }
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Adjusts a single buffer segment to match the scatter-gather segment that exposes it to the user.
+fn fit_to_sgaseg(segment: &mut DemiBuffer, sga_seg: &demi_sgaseg_t) -> Result<(), Fail> {
+    // Check to see if the user has reduced the size of the buffer described by the sgarray segment since we
+    // provided it to them.  They could have increased the starting address of the buffer (`sgaseg_buf`),
+    // decreased the ending address of the buffer (`sgaseg_buf + sgaseg_len`), or both.
+    let sga_data: *const u8 = sga_seg.sgaseg_buf as *const u8;
+    let sga_len: usize = sga_seg.sgaseg_len as usize;
+    let segment_data: *const u8 = segment.as_ptr();
+    let mut segment_len: usize = segment.len();
+    if sga_data != segment_data || sga_len != segment_len {
+        // We need to adjust the DemiBuffer to match the user's changes.
+
+        // First check that the user didn't do something non-sensical, like change the buffer description to
+        // reference address space outside of the DemiBuffer's allocated memory area.
+        if sga_data < segment_data || sga_data.addr() + sga_len > segment_data.addr() + segment_len {
+            return Err(Fail::new(
+                libc::EINVAL,
+                "demi_sgarray_t describes data outside backing buffer's allocated region",
+            ));
+        }
+
+        // Calculate the amount the new starting address is ahead of the old.  And then adjust `segment` to match.
+        let adjustment_amount: usize = sga_data.addr() - segment_data.addr();
+        segment.adjust(adjustment_amount)?;
+
+        // An adjustment above would have reduced segment.len() by the adjustment amount.
+        segment_len -= adjustment_amount;
+        debug_assert_eq!(segment_len, segment.len());
+
+        // Trim the segment down to size.
+        let trim_amount: usize = segment_len - sga_len;
+        segment.trim(trim_amount)?;
+    }
+
+    Ok(())
+}
@@ -0,0 +1,123 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::runtime::network::consts::RECEIVE_BATCH_SIZE;
+use ::std::cell::Cell;
+
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Smallest burst size that an adaptive burst shrinks down to.
+pub const MIN_BURST_SIZE: usize = 4;
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Adaptive Burst Size
+///
+/// Tracks how many packets should be requested from a receive queue at once. The burst size doubles while the queue
+/// keeps returning full bursts (i.e. packets are piling up in the ring) and halves when it returns less than half of a
+/// burst, so that an idle queue is polled with small bursts and a busy one is drained quickly.
+#[derive(Debug)]
+pub struct AdaptiveBurstSize {
+    /// Current burst size.
+    current: Cell<usize>,
+    /// Smallest burst size.
+    min: usize,
+    /// Largest burst size.
+    max: usize,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Adaptive Burst Sizes
+impl AdaptiveBurstSize {
+    /// Creates an adaptive burst size that ranges up to `max`.
+    pub fn new(max: usize) -> Self {
+        assert!(max > 0 && max <= RECEIVE_BATCH_SIZE);
+        let min: usize = max.min(MIN_BURST_SIZE);
+        Self {
+            current: Cell::new(min),
+            min,
+            max,
+        }
+    }
+
+    /// Creates a burst size that is fixed to `size`.
+    pub fn fixed(size: usize) -> Self {
+        assert!(size > 0 && size <= RECEIVE_BATCH_SIZE);
+        Self {
+            current: Cell::new(size),
+            min: size,
+            max: size,
+        }
+    }
+
+    /// Returns the current burst size.
+    pub fn get(&self) -> usize {
+        self.current.get()
+    }
+
+    /// Adjusts the burst size given the number of packets that were received in the last burst.
+    pub fn update(&self, nreceived: usize) {
+        let current: usize = self.current.get();
+        if nreceived >= current {
+            self.current.set((current * 2).min(self.max));
+        } else if nreceived < current / 2 {
+            self.current.set((current / 2).max(self.min));
+        }
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::{
+        AdaptiveBurstSize,
+        MIN_BURST_SIZE,
+    };
+
+    /// Tests if an adaptive burst size grows under load and shrinks back when idle.
+    #[test]
+    fn adaptive_burst_size() {
+        let burst: AdaptiveBurstSize = AdaptiveBurstSize::new(32);
+        assert_eq!(burst.get(), MIN_BURST_SIZE);
+
+        // Full bursts double the burst size, up to the maximum.
+        for expected in [8, 16, 32, 32] {
+            burst.update(burst.get());
+            assert_eq!(burst.get(), expected);
+        }
+
+        // Bursts that are at least half full keep the burst size.
+        burst.update(16);
+        assert_eq!(burst.get(), 32);
+
+        // Idle polls halve the burst size, down to the minimum.
+        for expected in [16, 8, 4, 4] {
+            burst.update(0);
+            assert_eq!(burst.get(), expected);
+        }
+    }
+
+    /// Tests if a fixed burst size never changes.
+    #[test]
+    fn fixed_burst_size() {
+        let burst: AdaptiveBurstSize = AdaptiveBurstSize::fixed(16);
+        burst.update(16);
+        assert_eq!(burst.get(), 16);
+        burst.update(0);
+        assert_eq!(burst.get(), 16);
+    }
+}
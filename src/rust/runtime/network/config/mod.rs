@@ -11,6 +11,10 @@ mod udp;
 
 pub use self::{
     arp::ArpConfig,
-    tcp::TcpConfig,
+    tcp::{
+        TcpConfig,
+        TcpCongestionControl,
+        TcpLossRecovery,
+    },
     udp::UdpConfig,
 };
@@ -7,7 +7,10 @@
 
 use crate::runtime::network::consts::{
     DEFAULT_MSS,
+    MAX_LARGE_SEND_SIZE,
     MAX_MSS,
+    MAX_RECEIVE_BUFFER_SIZE,
+    MAX_WINDOW_SCALE,
     MIN_MSS,
 };
 use ::std::time::Duration;
@@ -35,6 +38,40 @@ pub struct TcpConfig {
     rx_checksum_offload: bool,
     /// Offload Checksum to Hardware When Sending?
     tx_checksum_offload: bool,
+    /// Offload Segmentation of Large Segments to Hardware When Sending?
+    tx_segmentation_offload: bool,
+    /// Maximum Payload of Large Segments. Large sends are disabled if this is not greater than the MSS.
+    large_send_size: usize,
+    /// Loss Recovery Algorithm
+    loss_recovery: TcpLossRecovery,
+    /// Congestion Control Algorithm
+    congestion_control: TcpCongestionControl,
+    /// Maximum Size of Autotuned Receive Buffers. Autotuning is disabled if this is not greater than the window size.
+    receive_buffer_max_size: u32,
+    /// Pop All Available Data at Once, as a Multi-Segment Buffer?
+    multi_segment_pop: bool,
+}
+
+/// TCP Loss Recovery Algorithm
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum TcpLossRecovery {
+    /// Retransmission timeouts and duplicate ACK fast retransmit only. SACK is not negotiated.
+    Rto,
+    /// Scoreboard-based loss recovery using SACK information (RFC 6675).
+    Sack,
+    /// SACK scoreboard with RACK time-based loss detection and tail loss probes (RFC 8985).
+    RackTlp,
+}
+
+/// TCP Congestion Control Algorithm
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum TcpCongestionControl {
+    /// No congestion control. Sending is only limited by the peer's receive window.
+    None,
+    /// CUBIC (RFC 8312).
+    Cubic,
+    /// Model-based congestion control, which paces data at the estimated bottleneck bandwidth (BBR).
+    Bbr,
 }
 
 //==============================================================================
@@ -53,6 +90,12 @@ impl TcpConfig {
         ack_delay_timeout: Option<Duration>,
         rx_checksum_offload: Option<bool>,
         tx_checksum_offload: Option<bool>,
+        tx_segmentation_offload: Option<bool>,
+        large_send_size: Option<usize>,
+        loss_recovery: Option<TcpLossRecovery>,
+        congestion_control: Option<TcpCongestionControl>,
+        receive_buffer_max_size: Option<u32>,
+        multi_segment_pop: Option<bool>,
     ) -> Self {
         let mut options = Self::default();
 
@@ -80,6 +123,24 @@ impl TcpConfig {
         if let Some(value) = tx_checksum_offload {
             options.tx_checksum_offload = value;
         }
+        if let Some(value) = tx_segmentation_offload {
+            options.tx_segmentation_offload = value;
+        }
+        if let Some(value) = large_send_size {
+            options = options.set_large_send_size(value);
+        }
+        if let Some(value) = loss_recovery {
+            options.loss_recovery = value;
+        }
+        if let Some(value) = congestion_control {
+            options.congestion_control = value;
+        }
+        if let Some(value) = receive_buffer_max_size {
+            options = options.set_receive_buffer_max_size(value);
+        }
+        if let Some(value) = multi_segment_pop {
+            options.multi_segment_pop = value;
+        }
 
         options
     }
@@ -104,9 +165,17 @@ impl TcpConfig {
         self.receive_window_size
     }
 
-    /// Gets the window scale in the target [TcpConfig]
+    /// Gets the window scale in the target [TcpConfig]. When receive buffers are autotuned, this is at least the scale
+    /// needed to advertise the maximum size of a receive buffer.
     pub fn get_window_scale(&self) -> u8 {
-        self.window_scale
+        if !self.get_receive_buffer_autotuning() {
+            return self.window_scale;
+        }
+        let mut window_scale: u8 = self.window_scale;
+        while (self.receive_buffer_max_size >> window_scale) > u16::max_value() as u32 {
+            window_scale += 1;
+        }
+        window_scale.min(MAX_WINDOW_SCALE)
     }
 
     /// Gets the acknowledgement delay timeout in the target [TcpConfig].
@@ -124,6 +193,54 @@ impl TcpConfig {
         self.rx_checksum_offload
     }
 
+    /// Gets the TX hardware segmentation offload option in the target [TcpConfig].
+    pub fn get_tx_segmentation_offload(&self) -> bool {
+        self.tx_segmentation_offload
+    }
+
+    /// Gets the maximum payload of large segments in the target [TcpConfig].
+    pub fn get_large_send_size(&self) -> usize {
+        self.large_send_size
+    }
+
+    /// Gets the loss recovery algorithm in the target [TcpConfig].
+    pub fn get_loss_recovery(&self) -> TcpLossRecovery {
+        self.loss_recovery
+    }
+
+    /// Gets the congestion control algorithm in the target [TcpConfig].
+    pub fn get_congestion_control(&self) -> TcpCongestionControl {
+        self.congestion_control
+    }
+
+    /// Gets the maximum size of autotuned receive buffers in the target [TcpConfig].
+    pub fn get_receive_buffer_max_size(&self) -> u32 {
+        self.receive_buffer_max_size
+    }
+
+    /// Checks whether receive buffers are autotuned in the target [TcpConfig].
+    pub fn get_receive_buffer_autotuning(&self) -> bool {
+        self.receive_buffer_max_size > self.receive_window_size as u32
+    }
+
+    /// Gets the initial size of receive buffers in the target [TcpConfig], given the window scale that was negotiated
+    /// with the remote peer. Autotuned receive buffers start at the unscaled window size and grow from there.
+    pub fn get_initial_receive_buffer_size(&self, window_scale: u8) -> u32 {
+        let window_size: u32 = self.receive_window_size as u32;
+        if self.get_receive_buffer_autotuning() {
+            window_size
+        } else {
+            window_size
+                .checked_shl(window_scale as u32)
+                .expect("TODO: Window size overflow, try using a smaller window scale")
+        }
+    }
+
+    /// Gets the multi-segment pop option in the target [TcpConfig].
+    pub fn get_multi_segment_pop(&self) -> bool {
+        self.multi_segment_pop
+    }
+
     /// Sets the advertised maximum segment size in the target [TcpConfig].
     fn set_advertised_mss(mut self, value: usize) -> Self {
         assert!(value >= MIN_MSS);
@@ -165,6 +282,20 @@ impl TcpConfig {
         self.ack_delay_timeout = value;
         self
     }
+
+    /// Sets the maximum payload of large segments in the target [TcpConfig].
+    fn set_large_send_size(mut self, value: usize) -> Self {
+        assert!(value <= MAX_LARGE_SEND_SIZE);
+        self.large_send_size = value;
+        self
+    }
+
+    /// Sets the maximum size of autotuned receive buffers in the target [TcpConfig].
+    fn set_receive_buffer_max_size(mut self, value: u32) -> Self {
+        assert!(value <= MAX_RECEIVE_BUFFER_SIZE);
+        self.receive_buffer_max_size = value;
+        self
+    }
 }
 
 //==============================================================================
@@ -184,6 +315,12 @@ impl Default for TcpConfig {
             window_scale: 0,
             rx_checksum_offload: false,
             tx_checksum_offload: false,
+            tx_segmentation_offload: false,
+            large_send_size: MAX_LARGE_SEND_SIZE,
+            loss_recovery: TcpLossRecovery::Sack,
+            congestion_control: TcpCongestionControl::None,
+            receive_buffer_max_size: 0,
+            multi_segment_pop: false,
         }
     }
 }
@@ -195,8 +332,17 @@ impl Default for TcpConfig {
 #[cfg(test)]
 mod tests {
     use crate::runtime::network::{
-        config::TcpConfig,
-        consts::DEFAULT_MSS,
+        config::{
+            TcpConfig,
+            TcpCongestionControl,
+            TcpLossRecovery,
+        },
+        consts::{
+            DEFAULT_MSS,
+            MAX_LARGE_SEND_SIZE,
+            MAX_RECEIVE_BUFFER_SIZE,
+            MAX_WINDOW_SCALE,
+        },
     };
     use ::std::time::Duration;
 
@@ -211,5 +357,76 @@ mod tests {
         assert_eq!(config.get_window_scale(), 0);
         assert_eq!(config.get_rx_checksum_offload(), false);
         assert_eq!(config.get_tx_checksum_offload(), false);
+        assert_eq!(config.get_tx_segmentation_offload(), false);
+        assert_eq!(config.get_large_send_size(), MAX_LARGE_SEND_SIZE);
+        assert_eq!(config.get_loss_recovery(), TcpLossRecovery::Sack);
+        assert_eq!(config.get_congestion_control(), TcpCongestionControl::None);
+        assert_eq!(config.get_receive_buffer_autotuning(), false);
+        assert_eq!(config.get_initial_receive_buffer_size(0), 0xffff);
+        assert_eq!(config.get_multi_segment_pop(), false);
+    }
+
+    /// Tests that the window scale covers the maximum size of autotuned receive buffers.
+    #[test]
+    fn test_tcp_config_receive_buffer_autotuning() {
+        let config: TcpConfig = TcpConfig::new(
+            None,
+            None,
+            None,
+            None,
+            Some(2),
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            Some(16 * 1024 * 1024),
+            None,
+        );
+        assert_eq!(config.get_receive_buffer_autotuning(), true);
+        assert_eq!(config.get_window_scale(), 9);
+        // Autotuned buffers start unscaled.
+        assert_eq!(config.get_initial_receive_buffer_size(9), 0xffff);
+
+        let config: TcpConfig = TcpConfig::new(
+            None,
+            None,
+            None,
+            None,
+            Some(2),
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            Some(MAX_RECEIVE_BUFFER_SIZE),
+            None,
+        );
+        assert_eq!(config.get_window_scale(), MAX_WINDOW_SCALE);
+        assert_eq!(config.get_initial_receive_buffer_size(2), 0xffff);
+
+        // Without autotuning, the configured window scale is used as is.
+        let config: TcpConfig = TcpConfig::new(
+            None,
+            None,
+            None,
+            None,
+            Some(2),
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+            None,
+        );
+        assert_eq!(config.get_window_scale(), 2);
+        assert_eq!(config.get_initial_receive_buffer_size(2), 0xffff << 2);
     }
 }
@@ -19,7 +19,21 @@ pub const MAX_MSS: usize = u16::max_value() as usize;
 /// TODO: Auto-Discovery MTU Size
 pub const DEFAULT_MSS: usize = 1450;
 
-/// Length of a [crate::memory::DemiBuffer] batch.
+/// Maximum Payload of a Large TCP Segment
+///
+/// Large segments are split in MSS-sized segments either by the NIC or in software, but they still have to fit in the
+/// 16-bit length field of an IPv4 header (minus room for IPv4 and TCP headers with options).
+pub const MAX_LARGE_SEND_SIZE: usize = u16::max_value() as usize - 60 - 60;
+
+/// Maximum Window Scale Option for TCP (RFC 7323)
+pub const MAX_WINDOW_SCALE: u8 = 14;
+
+/// Maximum Size of a TCP Receive Buffer
+///
+/// This is the largest window that can be advertised with the maximum window scale (almost 1 GB).
+pub const MAX_RECEIVE_BUFFER_SIZE: u32 = (u16::max_value() as u32) << MAX_WINDOW_SCALE;
+
+/// Maximum length of a [crate::memory::DemiBuffer] batch.
 ///
 /// TODO: This Should be Generic
-pub const RECEIVE_BATCH_SIZE: usize = 4;
+pub const RECEIVE_BATCH_SIZE: usize = 64;
@@ -10,15 +10,36 @@ use crate::runtime::{
     network::consts::RECEIVE_BATCH_SIZE,
 };
 use ::arrayvec::ArrayVec;
+use ::std::net::SocketAddrV4;
 
 //==============================================================================
 // Exports
 //==============================================================================
 
+pub mod burst;
 pub mod config;
 pub mod consts;
 pub mod types;
 
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Segmentation Offload Descriptor
+///
+/// Describes how the NIC should split a [PacketBuf] whose body does not fit in a single segment.
+#[derive(Clone, Copy, Debug)]
+pub struct SegmentationOffload {
+    /// Length of the link-layer header.
+    pub l2_len: usize,
+    /// Length of the network-layer header.
+    pub l3_len: usize,
+    /// Length of the transport-layer header.
+    pub l4_len: usize,
+    /// Maximum length of the body of each segment.
+    pub segment_size: usize,
+}
+
 //==============================================================================
 // Traits
 //==============================================================================
@@ -33,6 +54,10 @@ pub trait PacketBuf {
     fn body_size(&self) -> usize;
     /// Consumes and returns the body of the target [PacketBuf].
     fn take_body(&self) -> Option<DemiBuffer>;
+    /// Returns how the target [PacketBuf] should be split by the NIC, if it should be split at all.
+    fn segmentation_offload(&self) -> Option<SegmentationOffload> {
+        None
+    }
 }
 
 /// Network Runtime
@@ -42,4 +67,10 @@ pub trait NetworkRuntime {
 
     /// Receives a batch of [DemiBuffer].
     fn receive(&self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE>;
+
+    /// Checks whether the packets of the flow from `remote` to `local` are received by the target [NetworkRuntime].
+    /// Runtimes that share a NIC with others, through receive side scaling, only see some of the flows.
+    fn receives_flow(&self, _local: SocketAddrV4, _remote: SocketAddrV4) -> bool {
+        true
+    }
 }
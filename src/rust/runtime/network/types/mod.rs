@@ -3,6 +3,7 @@
 
 mod macaddr;
 mod portnum;
+mod sockopt;
 
 //==============================================================================
 // Exports
@@ -11,4 +12,5 @@ mod portnum;
 pub use self::{
     macaddr::MacAddress,
     portnum::Port16,
+    sockopt::SocketOption,
 };
@@ -0,0 +1,17 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Socket Option
+#[derive(Eq, PartialEq, Copy, Clone, Debug)]
+pub enum SocketOption {
+    /// Sends data as soon as possible (TCP_NODELAY), instead of holding back small segments while previously sent data
+    /// is unacknowledged (Nagle's algorithm, RFC 896). Sockets are created with this option enabled.
+    TcpNoDelay(bool),
+    /// Holds back small segments (TCP_CORK) until the end of the next poll, when they are sent together. This takes
+    /// precedence over [SocketOption::TcpNoDelay].
+    TcpCork(bool),
+}
@@ -10,6 +10,7 @@ mod qtype;
 // Imports
 //======================================================================================================================
 
+use crate::runtime::fail::Fail;
 use ::slab::{
     Iter,
     Slab,
@@ -115,6 +116,31 @@ impl<T: IoQueue> IoQueueTable<T> {
     }
 }
 
+//======================================================================================================================
+// Standalone Functions
+//======================================================================================================================
+
+/// Issues a batch of `n` operations, in order, by calling `issue` with the index of each one, and returns the queue
+/// tokens of the operations that were issued.
+///
+/// Much like `sendmmsg()`, issuing stops at the first operation that fails. If that is the first operation of the
+/// batch, its error is returned. Otherwise, the operations issued so far are reported, and the caller may learn about
+/// the error by issuing the remaining ones again.
+pub fn issue_batch<F: FnMut(usize) -> Result<QToken, Fail>>(n: usize, mut issue: F) -> Result<Vec<QToken>, Fail> {
+    let mut qts: Vec<QToken> = Vec::with_capacity(n);
+    for i in 0..n {
+        match issue(i) {
+            Ok(qt) => qts.push(qt),
+            Err(e) if qts.is_empty() => return Err(e),
+            Err(e) => {
+                trace!("issue_batch(): stopping at operation {:?} of {:?} ({:?})", i, n, e);
+                break;
+            },
+        }
+    }
+    Ok(qts)
+}
+
 //======================================================================================================================
 // Unit Tests
 //======================================================================================================================
@@ -122,11 +148,14 @@ impl<T: IoQueue> IoQueueTable<T> {
 #[cfg(test)]
 mod tests {
     use super::{
+        issue_batch,
         IoQueue,
         IoQueueTable,
     };
     use crate::{
+        runtime::fail::Fail,
         QDesc,
+        QToken,
         QType,
     };
     use ::test::{
@@ -142,6 +171,28 @@ mod tests {
         }
     }
 
+    #[test]
+    fn issue_batches() {
+        let issue = |i: usize| -> Result<QToken, Fail> {
+            match i {
+                0..=2 => Ok(QToken::from(i as u64)),
+                _ => Err(Fail::new(libc::EBADF, "bad queue descriptor")),
+            }
+        };
+
+        // Operations are issued in order, up to the first one that fails.
+        let qts: Vec<QToken> = issue_batch(3, issue).expect("batch should be issued");
+        assert_eq!(qts, vec![QToken::from(0), QToken::from(1), QToken::from(2)]);
+        let qts: Vec<QToken> = issue_batch(5, issue).expect("batch should be partially issued");
+        assert_eq!(qts.len(), 3);
+
+        // The error is reported if nothing was issued.
+        match issue_batch(2, |i| issue(i + 3)) {
+            Err(e) => assert_eq!(e.errno, libc::EBADF),
+            Ok(_) => panic!("batch should fail"),
+        }
+    }
+
     #[bench]
     fn bench_alloc_free(b: &mut Bencher) {
         let mut ioqueue_table: IoQueueTable<TestQueue> = IoQueueTable::<TestQueue>::new();
@@ -5,17 +5,20 @@
 // Imports
 //==============================================================================
 
-use crate::collections::intrusive::pairing_heap::{
-    HeapNode,
-    PairingHeap,
+use crate::collections::intrusive::double_linked_list::{
+    LinkedList,
+    ListNode,
 };
 use ::futures::future::FusedFuture;
 use ::std::{
+    array,
     cell::RefCell,
     future::Future,
     marker::PhantomData,
+    mem,
     ops::Deref,
     pin::Pin,
+    ptr::NonNull,
     rc::Rc,
     task::{
         Context,
@@ -28,6 +31,23 @@ use ::std::{
     },
 };
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Default granularity of timers.
+pub const DEFAULT_TIMER_GRANULARITY: Duration = Duration::from_millis(1);
+
+/// Log2 of [SLOTS_PER_LEVEL].
+const SLOTS_PER_LEVEL_SHIFT: usize = 6;
+
+/// Number of slots in each level of the timer wheel.
+const SLOTS_PER_LEVEL: usize = 1 << SLOTS_PER_LEVEL_SHIFT;
+
+/// Number of levels in the timer wheel. With the default granularity, the wheel spans more than two years. Timers that
+/// expire further away are parked in the last level, and they are re-filed whenever their slot is visited.
+const NUM_LEVELS: usize = 6;
+
 //==============================================================================
 // Traits
 //==============================================================================
@@ -54,11 +74,38 @@ struct TimerQueueEntry {
     expiry: Instant,
     task: Option<Waker>,
     state: PollState,
+    /// Level of the timer wheel in which the entry is registered.
+    level: usize,
+    /// Slot of the timer wheel in which the entry is registered.
+    slot: usize,
+}
+
+/// Level of a Timer Wheel
+///
+/// Each slot in the ith level spans `SLOTS_PER_LEVEL^i` ticks.
+struct WheelLevel {
+    /// Flags which slots hold some entry.
+    occupied: u64,
+    /// Entries in each slot.
+    slots: [LinkedList<TimerQueueEntry>; SLOTS_PER_LEVEL],
 }
 
+/// Hierarchical Timer Wheel
+///
+/// Time is split in ticks of a fixed granularity, and entries are filed in the level whose slots are as wide as the
+/// distance to their expiry allows. Arming and cancelling an entry is O(1), and advancing the clock visits only
+/// non-empty slots, cascading entries of upper levels down as their expiry approaches.
 struct TimerInner {
     now: Instant,
-    heap: PairingHeap<TimerQueueEntry>,
+    /// Instant at which tick zero starts.
+    origin: Instant,
+    /// Duration of a tick (in nanoseconds).
+    granularity: u128,
+    /// Ticks that have been processed so far.
+    elapsed: u64,
+    levels: [WheelLevel; NUM_LEVELS],
+    /// Entries that are due in the current tick, but not yet. It is kept around to avoid allocations.
+    deferred: Vec<NonNull<ListNode<TimerQueueEntry>>>,
 }
 
 pub struct Timer<P: TimerPtr> {
@@ -71,18 +118,100 @@ pub struct TimerRc(pub Rc<Timer<TimerRc>>);
 
 pub struct WaitFuture<P: TimerPtr> {
     ptr: Option<P>,
-    wait_node: HeapNode<TimerQueueEntry>,
+    wait_node: ListNode<TimerQueueEntry>,
 }
 
 //==============================================================================
 // Associate Functions
 //==============================================================================
 
+impl WheelLevel {
+    fn new() -> Self {
+        Self {
+            occupied: 0,
+            slots: array::from_fn(|_| LinkedList::new()),
+        }
+    }
+}
+
+impl TimerInner {
+    /// Converts `instant` into a number of ticks since the origin.
+    fn tick_of(&self, instant: Instant) -> u64 {
+        (instant.saturating_duration_since(self.origin).as_nanos() / self.granularity) as u64
+    }
+
+    /// Computes the level in which an entry that expires at tick `when` should be filed.
+    fn level_for(&self, when: u64) -> usize {
+        let masked: u64 = (self.elapsed ^ when) | (SLOTS_PER_LEVEL as u64 - 1);
+        let significant: usize = 63 - masked.leading_zeros() as usize;
+        (significant / SLOTS_PER_LEVEL_SHIFT).min(NUM_LEVELS - 1)
+    }
+
+    /// Files `node` in the timer wheel.
+    /// Safety: `node` should be removed from the wheel before it gets moved or dropped.
+    unsafe fn insert(&mut self, node: &mut ListNode<TimerQueueEntry>) {
+        let when: u64 = self.tick_of(node.expiry).max(self.elapsed);
+        let level: usize = self.level_for(when);
+        let slot: usize = ((when >> (level * SLOTS_PER_LEVEL_SHIFT)) as usize) & (SLOTS_PER_LEVEL - 1);
+        node.level = level;
+        node.slot = slot;
+        self.levels[level].slots[slot].add_front(node);
+        self.levels[level].occupied |= 1 << slot;
+    }
+
+    /// Removes `node` from the timer wheel.
+    /// Safety: `node` should be filed in this wheel.
+    unsafe fn remove(&mut self, node: &mut ListNode<TimerQueueEntry>) {
+        let (level, slot): (usize, usize) = (node.level, node.slot);
+        let list: &mut LinkedList<TimerQueueEntry> = &mut self.levels[level].slots[slot];
+        list.remove(node);
+        if list.is_empty() {
+            self.levels[level].occupied &= !(1 << slot);
+        }
+    }
+
+    /// Finds the non-empty slot that starts the earliest, returning its level, its index and the tick at which it
+    /// starts.
+    fn next_expiration(&self) -> Option<(usize, usize, u64)> {
+        let mut next: Option<(usize, usize, u64)> = None;
+        for (level, wheel_level) in self.levels.iter().enumerate() {
+            if wheel_level.occupied == 0 {
+                continue;
+            }
+            let slot_range: u64 = 1 << (level * SLOTS_PER_LEVEL_SHIFT);
+            let level_range: u64 = slot_range << SLOTS_PER_LEVEL_SHIFT;
+            let now_slot: usize = ((self.elapsed >> (level * SLOTS_PER_LEVEL_SHIFT)) as usize) & (SLOTS_PER_LEVEL - 1);
+            let rotated: u64 = wheel_level.occupied.rotate_right(now_slot as u32);
+            let slot: usize = (rotated.trailing_zeros() as usize + now_slot) & (SLOTS_PER_LEVEL - 1);
+            let mut deadline: u64 = (self.elapsed & !(level_range - 1)) + slot as u64 * slot_range;
+            // Slots behind the current one belong to the next rotation of this level. Only the first level may have
+            // entries that are due in the current slot.
+            if deadline < self.elapsed || (level > 0 && deadline == self.elapsed) {
+                deadline += level_range;
+            }
+            if next.map_or(true, |(_, _, earliest)| deadline < earliest) {
+                next = Some((level, slot, deadline));
+            }
+        }
+        next
+    }
+}
+
 impl<P: TimerPtr> Timer<P> {
     pub fn new(now: Instant) -> Self {
+        Self::with_granularity(now, DEFAULT_TIMER_GRANULARITY)
+    }
+
+    /// Creates a timer whose entries expire at most `granularity` apart from each other.
+    pub fn with_granularity(now: Instant, granularity: Duration) -> Self {
+        assert!(!granularity.is_zero(), "timer granularity should not be zero");
         let inner = TimerInner {
             now,
-            heap: PairingHeap::new(),
+            origin: now,
+            granularity: granularity.as_nanos(),
+            elapsed: 0,
+            levels: array::from_fn(|_| WheelLevel::new()),
+            deferred: Vec::new(),
         };
         Self {
             inner: RefCell::new(inner),
@@ -93,28 +222,51 @@ impl<P: TimerPtr> Timer<P> {
     pub fn advance_clock(&self, now: Instant) {
         let mut inner = self.inner.borrow_mut();
         assert!(inner.now <= now);
+        inner.now = now;
 
-        while let Some(mut first) = inner.heap.peek_min() {
-            unsafe {
-                let entry = first.as_mut();
-                let first_expiry = entry.expiry;
-                if now < first_expiry {
-                    break;
-                }
-                entry.state = PollState::Expired;
-                if let Some(task) = entry.task.take() {
-                    task.wake();
-                }
-                inner.heap.remove(entry);
+        let target: u64 = inner.tick_of(now);
+        while let Some((level, slot, deadline)) = inner.next_expiration() {
+            if deadline > target {
+                break;
             }
+            inner.elapsed = deadline;
+            inner.levels[level].occupied &= !(1 << slot);
+            let mut list: LinkedList<TimerQueueEntry> =
+                mem::replace(&mut inner.levels[level].slots[slot], LinkedList::new());
+            list.drain(|entry| {
+                if entry.expiry <= now {
+                    entry.state = PollState::Expired;
+                    if let Some(task) = entry.task.take() {
+                        task.wake();
+                    }
+                } else if level == 0 {
+                    // This entry expires within the current tick, but not yet.
+                    inner.deferred.push(NonNull::from(entry));
+                } else {
+                    // Cascade this entry down to a lower level.
+                    unsafe { inner.insert(entry) };
+                }
+            });
         }
-        inner.now = now;
+        inner.elapsed = inner.elapsed.max(target);
+
+        let mut deferred: Vec<NonNull<ListNode<TimerQueueEntry>>> = mem::take(&mut inner.deferred);
+        for mut entry in deferred.drain(..) {
+            // Safety: the entry was filed in the wheel, thus it is still alive.
+            unsafe { inner.insert(entry.as_mut()) };
+        }
+        inner.deferred = deferred;
     }
 
     pub fn now(&self) -> Instant {
         self.inner.borrow().now
     }
 
+    /// Returns the granularity of the target timer. Entries may expire up to this much later than requested.
+    pub fn granularity(&self) -> Duration {
+        Duration::from_nanos(self.inner.borrow().granularity as u64)
+    }
+
     pub fn wait(&self, ptr: P, timeout: Duration) -> WaitFuture<P> {
         self.wait_until(ptr, self.now() + timeout)
     }
@@ -124,10 +276,12 @@ impl<P: TimerPtr> Timer<P> {
             expiry,
             task: None,
             state: PollState::Unregistered,
+            level: 0,
+            slot: 0,
         };
         WaitFuture {
             ptr: Some(ptr),
-            wait_node: HeapNode::new(entry),
+            wait_node: ListNode::new(entry),
         }
     }
 }
@@ -150,29 +304,6 @@ impl TimerPtr for TimerRc {
     }
 }
 
-impl PartialEq for TimerQueueEntry {
-    fn eq(&self, other: &TimerQueueEntry) -> bool {
-        // This is technically not correct. However for the usage in this module
-        // we only need to compare timers by expiration.
-        self.expiry == other.expiry
-    }
-}
-
-impl Eq for TimerQueueEntry {}
-
-impl PartialOrd for TimerQueueEntry {
-    fn partial_cmp(&self, other: &TimerQueueEntry) -> Option<core::cmp::Ordering> {
-        // Compare timer queue entries by expiration time
-        self.expiry.partial_cmp(&other.expiry)
-    }
-}
-
-impl Ord for TimerQueueEntry {
-    fn cmp(&self, other: &TimerQueueEntry) -> core::cmp::Ordering {
-        self.expiry.cmp(&other.expiry)
-    }
-}
-
 impl<P: TimerPtr> Future for WaitFuture<P> {
     type Output = ();
 
@@ -195,7 +326,7 @@ impl<P: TimerPtr> Future for WaitFuture<P> {
                         wait_node.task = Some(cx.waker().clone());
                         wait_node.state = PollState::Registered;
                         unsafe {
-                            inner.heap.insert(wait_node);
+                            inner.insert(wait_node);
                         }
                         Poll::Pending
                     }
@@ -229,7 +360,7 @@ impl<P: TimerPtr> Drop for WaitFuture<P> {
         // Otherwise the timer would access invalid memory.
         if let Some(ptr) = &self.ptr {
             if let PollState::Registered = self.wait_node.state {
-                unsafe { ptr.timer().inner.borrow_mut().heap.remove(&mut self.wait_node) };
+                unsafe { ptr.timer().inner.borrow_mut().remove(&mut self.wait_node) };
                 self.wait_node.state = PollState::Unregistered;
             }
         }
@@ -245,7 +376,9 @@ mod tests {
     use super::{
         Timer,
         TimerRc,
+        WaitFuture,
     };
+    use ::test::Bencher;
     use futures::task::noop_waker_ref;
     use std::{
         future::Future,
@@ -297,4 +430,104 @@ mod tests {
 
         assert!(Future::poll(Pin::new(&mut wait_future1), &mut ctx).is_ready());
     }
+
+    #[test]
+    fn test_timer_granularity() {
+        let mut ctx = Context::from_waker(noop_waker_ref());
+        let mut now = Instant::now();
+
+        // Entries should never expire early, even if they do not fall on a tick boundary.
+        let timer = TimerRc(Rc::new(Timer::with_granularity(now, Duration::from_millis(10))));
+        let wait_future = timer.wait(timer.clone(), Duration::from_millis(15));
+        futures::pin_mut!(wait_future);
+        assert!(Future::poll(Pin::new(&mut wait_future), &mut ctx).is_pending());
+
+        now += Duration::from_millis(10);
+        timer.advance_clock(now);
+        assert!(Future::poll(Pin::new(&mut wait_future), &mut ctx).is_pending());
+
+        now += Duration::from_millis(4);
+        timer.advance_clock(now);
+        assert!(Future::poll(Pin::new(&mut wait_future), &mut ctx).is_pending());
+
+        now += Duration::from_millis(1);
+        timer.advance_clock(now);
+        assert!(Future::poll(Pin::new(&mut wait_future), &mut ctx).is_ready());
+    }
+
+    #[test]
+    fn test_timer_cascade() {
+        let mut ctx = Context::from_waker(noop_waker_ref());
+        let mut now = Instant::now();
+
+        // Arm entries that are filed in different levels of the wheel.
+        let timer = TimerRc(Rc::new(Timer::new(now)));
+        let timeouts: [Duration; 4] = [
+            Duration::from_millis(3),
+            Duration::from_millis(300),
+            Duration::from_secs(30),
+            Duration::from_secs(3 * 3600),
+        ];
+        let mut wait_futures: Vec<Pin<Box<WaitFuture<TimerRc>>>> = timeouts
+            .iter()
+            .map(|timeout| Box::pin(timer.wait(timer.clone(), *timeout)))
+            .collect();
+        for wait_future in wait_futures.iter_mut() {
+            assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_pending());
+        }
+
+        // Advance the clock in uneven steps and check that each entry expires exactly on time.
+        let start = now;
+        let step = Duration::from_micros(2_345_678);
+        while now - start <= timeouts[3] + step {
+            now += step;
+            timer.advance_clock(now);
+            for (wait_future, timeout) in wait_futures.iter_mut().zip(timeouts.iter()) {
+                let expired: bool = now - start >= *timeout;
+                if wait_future.ptr.is_some() {
+                    assert_eq!(Future::poll(wait_future.as_mut(), &mut ctx).is_ready(), expired);
+                }
+            }
+        }
+        assert!(wait_futures.iter().all(|wait_future| wait_future.ptr.is_none()));
+    }
+
+    #[test]
+    fn test_timer_cancel() {
+        let mut ctx = Context::from_waker(noop_waker_ref());
+        let mut now = Instant::now();
+
+        // Cancel an entry, and check that the remaining one still expires.
+        let timer = TimerRc(Rc::new(Timer::new(now)));
+        let mut wait_future1 = Box::pin(timer.wait(timer.clone(), Duration::from_millis(5)));
+        let mut wait_future2 = Box::pin(timer.wait(timer.clone(), Duration::from_millis(5)));
+        assert!(Future::poll(wait_future1.as_mut(), &mut ctx).is_pending());
+        assert!(Future::poll(wait_future2.as_mut(), &mut ctx).is_pending());
+        drop(wait_future1);
+
+        now += Duration::from_millis(5);
+        timer.advance_clock(now);
+        assert!(Future::poll(wait_future2.as_mut(), &mut ctx).is_ready());
+    }
+
+    #[bench]
+    fn bench_timer_arm_cancel(b: &mut Bencher) {
+        let mut ctx = Context::from_waker(noop_waker_ref());
+        let now = Instant::now();
+        let timer = TimerRc(Rc::new(Timer::new(now)));
+
+        // Keep many entries armed in the background.
+        let mut background: Vec<Pin<Box<WaitFuture<TimerRc>>>> = (0..4096)
+            .map(|i| Box::pin(timer.wait(timer.clone(), Duration::from_millis(1 + i))))
+            .collect();
+        for wait_future in background.iter_mut() {
+            assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_pending());
+        }
+
+        b.iter(|| {
+            let mut wait_future = Box::pin(timer.wait(timer.clone(), Duration::from_millis(200)));
+            assert!(Future::poll(wait_future.as_mut(), &mut ctx).is_pending());
+            drop(wait_future);
+        });
+    }
 }
@@ -16,7 +16,7 @@ use crate::pal::data_structures::SockAddr;
 //==============================================================================
 
 /// Maximum Length for Scatter-Gather Arrays
-pub const DEMI_SGARRAY_MAXLEN: usize = 1;
+pub const DEMI_SGARRAY_MAXLEN: usize = 16;
 
 //==============================================================================
 // Structures
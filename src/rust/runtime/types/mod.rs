@@ -4,6 +4,7 @@
 mod memory;
 mod ops;
 mod queue;
+mod stats;
 
 //==============================================================================
 // Exports
@@ -22,4 +23,8 @@ pub use self::{
         demi_qresult_t,
     },
     queue::demi_qtoken_t,
+    stats::{
+        demi_histogram_t,
+        demi_stats_t,
+    },
 };
@@ -22,7 +22,7 @@ use ::libc::{
 
 /// Operation Code
 #[repr(C)]
-#[derive(Debug, Eq, PartialEq)]
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
 pub enum demi_opcode_t {
     DEMI_OPC_INVALID = 0,
     DEMI_OPC_PUSH,
@@ -0,0 +1,38 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+#![allow(non_camel_case_types)]
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Histogram Summary
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct demi_histogram_t {
+    pub count: u64,
+    pub sum: u64,
+    pub min: u64,
+    pub max: u64,
+    pub p50: u64,
+    pub p90: u64,
+    pub p99: u64,
+    pub p999: u64,
+}
+
+/// Statistics
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct demi_stats_t {
+    pub push_latency_ns: demi_histogram_t,
+    pub pop_latency_ns: demi_histogram_t,
+    pub accept_latency_ns: demi_histogram_t,
+    pub connect_latency_ns: demi_histogram_t,
+    pub rx_burst_size: demi_histogram_t,
+    pub tx_burst_size: demi_histogram_t,
+    pub tcp_ooo_queue_depth: demi_histogram_t,
+    pub tcp_retransmits: u64,
+    pub heap_pool_misses: u64,
+    pub mbuf_chunk_misses: u64,
+}
@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::{
+    pal::arch,
+    runtime::memory::{
+        alloc_heap_block,
+        free_heap_block,
+    },
+};
+use ::std::{
+    alloc::{
+        AllocError,
+        Allocator,
+        Global,
+        Layout,
+    },
+    ptr::{
+        self,
+        NonNull,
+    },
+};
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Task Allocator
+///
+/// Allocates the storage of tasks from the heap pool of the current thread. Tasks of a given type always land in the
+/// same size class, so once the scheduler warmed up, the storage of each completed task is handed over to the next
+/// task of that type, and inserting a task does not go through the global allocator.
+#[derive(Clone, Copy, Default)]
+pub struct TaskAllocator;
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Allocator Trait Implementation for Task Allocators
+// Safety: blocks of the heap pool stay valid until they are released, and they are cache-line aligned, so they fit any
+// layout that is not stricter than that. Other layouts go to the global allocator.
+unsafe impl Allocator for TaskAllocator {
+    fn allocate(&self, layout: Layout) -> Result<NonNull<[u8]>, AllocError> {
+        if !is_pooled(layout) {
+            return Global.allocate(layout);
+        }
+        let block: NonNull<u8> = alloc_heap_block(layout.size());
+        // Safety: The slice pointer is derived from `block`, which is not null.
+        Ok(unsafe { NonNull::new_unchecked(ptr::slice_from_raw_parts_mut(block.as_ptr(), layout.size())) })
+    }
+
+    unsafe fn deallocate(&self, ptr: NonNull<u8>, layout: Layout) {
+        if !is_pooled(layout) {
+            return Global.deallocate(ptr, layout);
+        }
+        free_heap_block(ptr, layout.size());
+    }
+}
+
+//==============================================================================
+// Standalone Functions
+//==============================================================================
+
+/// Checks whether allocations of a given `layout` are served by the heap pool.
+fn is_pooled(layout: Layout) -> bool {
+    layout.size() != 0 && layout.align() <= arch::CPU_DATA_CACHE_LINE_SIZE
+}
@@ -50,8 +50,14 @@ impl SchedulerHandle {
     }
 
     /// Returns the raw key stored in the target [SchedulerHandle].
+    ///
+    /// The raw key is handed out as a queue token, so the scheduler starts tracking the completion of the associated
+    /// future in its list of completed tasks.
     pub fn into_raw(mut self) -> u64 {
-        self.key.take().unwrap()
+        let key: u64 = self.key.take().unwrap();
+        let subpage_ix: usize = key as usize & (WAKER_BIT_LENGTH - 1);
+        self.chunk.mark_exported(subpage_ix);
+        key
     }
 }
 
@@ -3,6 +3,7 @@
 
 mod page;
 mod page_ref;
+mod summary;
 mod waker_ref;
 
 //==============================================================================
@@ -15,5 +16,6 @@ pub use self::{
         WAKER_PAGE_SIZE,
     },
     page_ref::WakerPageRef,
+    summary::PageSummary,
     waker_ref::WakerRef,
 };
@@ -5,10 +5,14 @@
 // Imports
 //==============================================================================
 
-use crate::scheduler::waker64::{
-    Waker64,
-    WAKER_BIT_LENGTH,
+use crate::scheduler::{
+    page::PageSummary,
+    waker64::{
+        Waker64,
+        WAKER_BIT_LENGTH,
+    },
 };
+use ::std::rc::Rc;
 
 //==============================================================================
 // Constants
@@ -24,7 +28,7 @@ pub const WAKER_PAGE_SIZE: usize = 64;
 /// Waker Page
 ///
 /// This structure holds the status of multiple futures in the scheduler. It is
-/// composed by 3 bitmaps, each of which having the ith bit to represent some
+/// composed by 4 bitmaps, each of which having the ith bit to represent some
 /// state for the ith future.
 ///
 /// The number of bytes in this structure should match the number of bits in a
@@ -33,7 +37,9 @@ pub const WAKER_PAGE_SIZE: usize = 64;
 /// scheduler, so that it may cast back a raw pointer and operate on a specific
 /// future whenever needed.
 ///
-/// TODO: use the unused space in this structure to something useful.
+/// Pages that belong to a scheduler also flag themselves in a [PageSummary]
+/// whenever some future is notified or dropped, so that the scheduler polls
+/// only pages that require attention.
 #[repr(align(64))]
 pub struct WakerPage {
     /// Reference count for the page.
@@ -44,8 +50,14 @@ pub struct WakerPage {
     completed: Waker64,
     /// Flags whether or not a given future has ben dropped.
     dropped: Waker64,
+    /// Flags whether or not a given future was exported as a queue token.
+    exported: Waker64,
+    /// Summary in which the page flags itself.
+    summary: Option<Rc<PageSummary>>,
+    /// Index of the page in the summary.
+    page_ix: usize,
     /// Padding required to make the structure 64-byte big.
-    _unused: [u8; 32],
+    _unused: [u8; 8],
 }
 
 //==============================================================================
@@ -54,10 +66,28 @@ pub struct WakerPage {
 
 /// Associate Functions for Waker Page
 impl WakerPage {
+    /// Creates a waker page that flags itself as the `page_ix` page in `summary`.
+    pub fn with_summary(summary: Rc<PageSummary>, page_ix: usize) -> Self {
+        summary.grow(page_ix + 1);
+        Self {
+            summary: Some(summary),
+            page_ix,
+            ..Default::default()
+        }
+    }
+
+    /// Flags the target [WakerPage] in its summary, if any.
+    fn flag(&self) {
+        if let Some(ref summary) = self.summary {
+            summary.set(self.page_ix);
+        }
+    }
+
     /// Sets the notification flag for the `ix` future in the target [WakerPage].
     pub fn notify(&self, ix: usize) {
         debug_assert!(ix < WAKER_BIT_LENGTH);
         self.notified.fetch_or(1 << ix);
+        self.flag();
     }
 
     /// Takes out notification flags in the target [WakerPage].
@@ -87,6 +117,19 @@ impl WakerPage {
     pub fn mark_dropped(&self, ix: usize) {
         debug_assert!(ix < WAKER_BIT_LENGTH);
         self.dropped.fetch_or(1 << ix);
+        self.flag();
+    }
+
+    /// Sets the exported flag for the `ix` future in the target [WakerPage].
+    pub fn mark_exported(&self, ix: usize) {
+        debug_assert!(ix < WAKER_BIT_LENGTH);
+        self.exported.fetch_or(1 << ix);
+    }
+
+    /// Queries whether or not the exported flag for the `ix` future in the target [WakerPage] is set.
+    pub fn was_exported(&self, ix: usize) -> bool {
+        debug_assert!(ix < WAKER_BIT_LENGTH);
+        self.exported.load() & (1 << ix) != 0
     }
 
     /// Takes out dropped flags in the target [WakerPage].
@@ -103,20 +146,24 @@ impl WakerPage {
 
     /// Resets all flags in the target [WakerPage].
     /// The reference count for the target page is reset to one.
+    #[allow(unused)]
     pub fn reset(&mut self) {
         self.refcount.swap(1);
         self.notified.swap(0);
         self.completed.swap(0);
         self.dropped.swap(0);
+        self.exported.swap(0);
     }
 
     /// Initialize flags for the `ix` future in the target [WakerPage].
-    /// Notification and dropped flags are reset after this operation.
+    /// Notification, completed, dropped and exported flags are reset after this operation.
     pub fn initialize(&self, ix: usize) {
         debug_assert!(ix < WAKER_BIT_LENGTH);
         self.notified.fetch_or(1 << ix);
+        self.flag();
         self.completed.fetch_and(!(1 << ix));
         self.dropped.fetch_and(!(1 << ix));
+        self.exported.fetch_and(!(1 << ix));
     }
 
     /// Clears flags for the `ix` future in the target [WakerPage]
@@ -127,6 +174,7 @@ impl WakerPage {
         self.notified.fetch_and(mask);
         self.completed.fetch_and(mask);
         self.dropped.fetch_and(mask);
+        self.exported.fetch_and(mask);
     }
 
     /// Increments the reference count of the target [WakerPage].
@@ -161,6 +209,9 @@ impl Default for WakerPage {
             notified: Waker64::new(0),
             completed: Waker64::new(0),
             dropped: Waker64::new(0),
+            exported: Waker64::new(0),
+            summary: None,
+            page_ix: 0,
             _unused: Default::default(),
         }
     }
@@ -7,6 +7,7 @@
 
 use crate::scheduler::{
     page::{
+        PageSummary,
         WakerPage,
         WAKER_PAGE_SIZE,
     },
@@ -24,6 +25,7 @@ use ::std::{
         self,
         NonNull,
     },
+    rc::Rc,
 };
 
 //==============================================================================
@@ -47,6 +49,21 @@ impl WakerPageRef {
         Self(waker_page)
     }
 
+    /// Allocates a [WakerPage] that flags itself as the `page_ix` page in `summary`.
+    pub fn with_summary(summary: Rc<PageSummary>, page_ix: usize) -> Self {
+        Self::allocate(WakerPage::with_summary(summary, page_ix))
+    }
+
+    /// Moves `page` into a properly aligned memory location and returns a reference to it.
+    fn allocate(page: WakerPage) -> Self {
+        let layout: Layout = Layout::new::<WakerPage>();
+        assert_eq!(layout.align(), WAKER_PAGE_SIZE);
+        let ptr: NonNull<WakerPage> = Global.allocate(layout).expect("Failed to allocate WakerPage").cast();
+        // Safety: the memory location was just allocated with the layout of a WakerPage.
+        unsafe { ptr.as_ptr().write(page) };
+        Self(ptr)
+    }
+
     /// Casts the target [WakerPageRef] into a [NonNull<u8>].
     ///
     /// The reference itself is not intended for reading/writing to
@@ -121,14 +138,7 @@ impl Deref for WakerPageRef {
 /// Default Trait Implementation for Waker Page References
 impl Default for WakerPageRef {
     fn default() -> Self {
-        let layout: Layout = Layout::new::<WakerPage>();
-        assert_eq!(layout.align(), WAKER_PAGE_SIZE);
-        let mut ptr: NonNull<WakerPage> = Global.allocate(layout).expect("Failed to allocate WakerPage").cast();
-        unsafe {
-            let page: &mut WakerPage = ptr.as_mut();
-            page.reset();
-        }
-        Self(ptr)
+        Self::allocate(WakerPage::default())
     }
 }
 
@@ -0,0 +1,131 @@
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+
+//==============================================================================
+// Imports
+//==============================================================================
+
+use crate::scheduler::waker64::{
+    WAKER_BIT_LENGTH,
+    WAKER_BIT_LENGTH_SHIFT,
+};
+use ::bit_iter::BitIter;
+use ::std::{
+    cell::{
+        RefCell,
+        RefMut,
+    },
+    mem,
+};
+
+//==============================================================================
+// Structures
+//==============================================================================
+
+/// Waker Page Summary
+///
+/// This structure is a two-level bitmap that flags which [crate::scheduler::page::WakerPage]s of a scheduler have
+/// notified or dropped tasks. The ith bit of the jth leaf word flags the page `j * 64 + i`, and the ith bit of the
+/// jth root word flags the leaf word `j * 64 + i` as non-empty. This way, the scheduler may find pages that require
+/// attention without visiting idle ones.
+pub struct PageSummary {
+    /// Leaf words. One bit per page.
+    leaves: RefCell<Vec<u64>>,
+    /// Root words. One bit per leaf word.
+    roots: RefCell<Vec<u64>>,
+}
+
+//==============================================================================
+// Associate Functions
+//==============================================================================
+
+/// Associate Functions for Waker Page Summaries
+impl PageSummary {
+    /// Makes room in the target [PageSummary] for `num_pages` pages.
+    pub fn grow(&self, num_pages: usize) {
+        let num_leaves: usize = (num_pages + WAKER_BIT_LENGTH - 1) >> WAKER_BIT_LENGTH_SHIFT;
+        let num_roots: usize = (num_leaves + WAKER_BIT_LENGTH - 1) >> WAKER_BIT_LENGTH_SHIFT;
+        let mut leaves: RefMut<Vec<u64>> = self.leaves.borrow_mut();
+        if leaves.len() < num_leaves {
+            leaves.resize(num_leaves, 0);
+        }
+        let mut roots: RefMut<Vec<u64>> = self.roots.borrow_mut();
+        if roots.len() < num_roots {
+            roots.resize(num_roots, 0);
+        }
+    }
+
+    /// Flags the `page_ix` page in the target [PageSummary].
+    pub fn set(&self, page_ix: usize) {
+        let leaf_ix: usize = page_ix >> WAKER_BIT_LENGTH_SHIFT;
+        self.leaves.borrow_mut()[leaf_ix] |= 1 << (page_ix & (WAKER_BIT_LENGTH - 1));
+        self.roots.borrow_mut()[leaf_ix >> WAKER_BIT_LENGTH_SHIFT] |= 1 << (leaf_ix & (WAKER_BIT_LENGTH - 1));
+    }
+
+    /// Returns true if no page is flagged in the target [PageSummary].
+    pub fn is_empty(&self) -> bool {
+        self.roots.borrow().iter().all(|&root| root == 0)
+    }
+
+    /// Takes out flagged pages in the target [PageSummary], appending their indexes to `pages` in ascending order.
+    /// Flags are reset after this operation.
+    pub fn take(&self, pages: &mut Vec<usize>) {
+        let mut leaves: RefMut<Vec<u64>> = self.leaves.borrow_mut();
+        let mut roots: RefMut<Vec<u64>> = self.roots.borrow_mut();
+        for root_ix in 0..roots.len() {
+            let root: u64 = mem::replace(&mut roots[root_ix], 0);
+            for root_bit in BitIter::from(root) {
+                let leaf_ix: usize = (root_ix << WAKER_BIT_LENGTH_SHIFT) + root_bit;
+                let leaf: u64 = mem::replace(&mut leaves[leaf_ix], 0);
+                for leaf_bit in BitIter::from(leaf) {
+                    pages.push((leaf_ix << WAKER_BIT_LENGTH_SHIFT) + leaf_bit);
+                }
+            }
+        }
+    }
+}
+
+//==============================================================================
+// Trait Implementations
+//==============================================================================
+
+/// Default Trait Implementation for Waker Page Summaries
+impl Default for PageSummary {
+    fn default() -> Self {
+        Self {
+            leaves: RefCell::new(Vec::new()),
+            roots: RefCell::new(Vec::new()),
+        }
+    }
+}
+
+//==============================================================================
+// Unit Tests
+//==============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::PageSummary;
+
+    #[test]
+    fn test_take() {
+        let summary: PageSummary = PageSummary::default();
+        summary.grow(8192);
+
+        // Flag pages across different leaf and root words, some of them twice.
+        for page_ix in [4097, 0, 63, 64, 8191, 64] {
+            summary.set(page_ix);
+        }
+
+        let mut pages: Vec<usize> = Vec::new();
+        assert!(!summary.is_empty());
+        summary.take(&mut pages);
+        assert_eq!(pages, vec![0, 63, 64, 4097, 8191]);
+        assert!(summary.is_empty());
+
+        // Flags should have been reset.
+        pages.clear();
+        summary.take(&mut pages);
+        assert!(pages.is_empty());
+    }
+}
@@ -5,14 +5,21 @@
 //!
 //! Our scheduler uses a pinned memory slab to store tasks ([SchedulerFuture]s).
 //! As background tasks are polled, they notify task in our scheduler via the
-//! [crate::page::WakerPage]s.
+//! [crate::page::WakerPage]s, which in turn flag themselves in a
+//! [crate::page::PageSummary], so that polling skips pages of idle tasks. Tasks that were handed out as queue tokens are
+//! recorded in a list of completed tasks as soon as they complete, so that
+//! waiting for them does not require a scan over all outstanding tokens. The storage of tasks comes from the heap pool
+//! of the current thread (see [TaskAllocator]), and it is recycled as soon as a task is taken out, so that inserting a
+//! task does not go through the global allocator once the scheduler warmed up.
 
 //==============================================================================
 // Imports
 //==============================================================================
 
 use crate::scheduler::{
+    allocator::TaskAllocator,
     page::{
+        PageSummary,
         WakerPageRef,
         WakerRef,
     },
@@ -26,12 +33,18 @@ use crate::scheduler::{
 };
 use ::bit_iter::BitIter;
 use ::std::{
+    any::{
+        Any,
+        TypeId,
+    },
     cell::{
         Ref,
         RefCell,
         RefMut,
     },
+    collections::VecDeque,
     future::Future,
+    mem,
     pin::Pin,
     ptr::NonNull,
     rc::Rc,
@@ -42,6 +55,20 @@ use ::std::{
     },
 };
 
+//==============================================================================
+// Constants
+//==============================================================================
+
+/// Minimum length of the list of completed tasks that triggers a clean up of stale entries.
+const MIN_COMPLETED_CLEANUP_LEN: usize = 64;
+
+//==============================================================================
+// Types
+//==============================================================================
+
+/// Storage of a task that is held by the scheduler.
+type Task = Box<dyn SchedulerFuture, TaskAllocator>;
+
 //==============================================================================
 // Structures
 //==============================================================================
@@ -52,12 +79,24 @@ struct Inner<F: Future<Output = ()> + Unpin> {
     slab: PinSlab<F>,
     /// Holds the status tasks.
     pages: Vec<WakerPageRef>,
+    /// Flags pages that have notified or dropped tasks.
+    summary: Rc<PageSummary>,
+    /// Scratch list of pages to visit in a poll operation. It is kept around to avoid allocations.
+    ready_pages: Vec<usize>,
+    /// Keys of exported tasks that have completed, in order of completion, along with the generation of each key at
+    /// that time. Entries of tasks that were taken out by other means are lazily removed.
+    completed: VecDeque<(u64, u32)>,
+    /// Generation of each key. It is bumped whenever a task is removed, so that entries in the list of completed tasks
+    /// that refer to an earlier task with the same key are told apart, as keys are reused.
+    generations: Vec<u32>,
+    /// Length of the list of completed tasks that triggers a clean up of stale entries.
+    completed_cleanup_len: usize,
 }
 
 /// Future Scheduler
 #[derive(Clone)]
 pub struct Scheduler {
-    inner: Rc<RefCell<Inner<Box<dyn SchedulerFuture>>>>,
+    inner: Rc<RefCell<Inner<Task>>>,
 }
 
 //==============================================================================
@@ -79,29 +118,77 @@ impl<F: Future<Output = ()> + Unpin> Inner<F> {
 
         // Add a new page to hold this future's status if the current page is filled.
         while key >= self.pages.len() << WAKER_BIT_LENGTH_SHIFT {
-            self.pages.push(WakerPageRef::default());
+            let page_ix: usize = self.pages.len();
+            self.pages
+                .push(WakerPageRef::with_summary(self.summary.clone(), page_ix));
+            self.generations.resize(self.pages.len() << WAKER_BIT_LENGTH_SHIFT, 0);
         }
         let (page, subpage_ix): (&WakerPageRef, usize) = self.get_page(key as u64);
         page.initialize(subpage_ix);
         Some(key as u64)
     }
+
+    /// Checks whether or not the task with a given `key` and `generation` is an exported task that has completed and
+    /// that was not taken out yet. Stale entries in the list of completed tasks fail this check.
+    fn is_completed(&self, key: u64, generation: u32) -> bool {
+        if self.generations[key as usize] != generation || self.slab.get(key as usize).is_none() {
+            return false;
+        }
+        let (page, subpage_ix): (&WakerPageRef, usize) = self.get_page(key);
+        page.has_completed(subpage_ix) && page.was_exported(subpage_ix) && !page.was_dropped(subpage_ix)
+    }
+
+    /// Records the completion of the task with a given `key`.
+    fn push_completed(&mut self, key: u64) {
+        let generation: u32 = self.generations[key as usize];
+        self.completed.push_back((key, generation));
+
+        // Remove stale entries, once in a while. The threshold doubles with the number of live entries, so the cost
+        // of this is amortized over insertions.
+        if self.completed.len() >= self.completed_cleanup_len {
+            let mut completed: VecDeque<(u64, u32)> = mem::take(&mut self.completed);
+            completed.retain(|(key, generation)| self.is_completed(*key, *generation));
+            self.completed = completed;
+            self.completed_cleanup_len = (2 * self.completed.len()).max(MIN_COMPLETED_CLEANUP_LEN);
+        }
+    }
+
+    /// Records the removal of the task with a given `key`, which makes its entry in the list of completed tasks stale.
+    fn retire(&mut self, key: u64) {
+        let generation: &mut u32 = &mut self.generations[key as usize];
+        *generation = generation.wrapping_add(1);
+    }
 }
 
 /// Associate Functions for Scheduler
 impl Scheduler {
-    /// Given a handle representing a future, remove the future from the scheduler returning it.
-    pub fn take(&self, mut handle: SchedulerHandle) -> Box<dyn SchedulerFuture> {
-        let mut inner: RefMut<Inner<Box<dyn SchedulerFuture>>> = self.inner.borrow_mut();
-        let key: u64 = handle.take_key().unwrap();
-        let (page, subpage_ix): (&WakerPageRef, usize) = inner.get_page(key);
-        assert!(!page.was_dropped(subpage_ix));
-        page.clear(subpage_ix);
-        inner.slab.remove_unpin(key as usize).unwrap()
+    /// Given a handle representing a future, remove the future from the scheduler returning it. The storage of the
+    /// future is recycled for later insertions.
+    ///
+    /// This function will panic if the future is not of type `F`.
+    pub fn take<F: SchedulerFuture>(&self, mut handle: SchedulerHandle) -> F {
+        let task: Task = {
+            let mut inner: RefMut<Inner<Task>> = self.inner.borrow_mut();
+            let key: u64 = handle.take_key().unwrap();
+            let (page, subpage_ix): (&WakerPageRef, usize) = inner.get_page(key);
+            assert!(!page.was_dropped(subpage_ix));
+            page.clear(subpage_ix);
+            inner.retire(key);
+            inner.slab.remove_unpin(key as usize).unwrap()
+        };
+        assert!(Any::type_id(&*task) == TypeId::of::<F>(), "Wrong type!");
+
+        // Safety: we just checked that the task holds a future of type `F`.
+        let task: Box<F, TaskAllocator> = unsafe {
+            let (future, allocator): (*mut dyn SchedulerFuture, TaskAllocator) = Box::into_raw_with_allocator(task);
+            Box::from_raw_in(future as *mut F, allocator)
+        };
+        *task
     }
 
     /// Given the raw `key` representing this future return a proper handle.
     pub fn from_raw_handle(&self, key: u64) -> Option<SchedulerHandle> {
-        let inner: Ref<Inner<Box<dyn SchedulerFuture>>> = self.inner.borrow();
+        let inner: Ref<Inner<Task>> = self.inner.borrow();
         inner.slab.get(key as usize)?;
         let (page, _): (&WakerPageRef, usize) = inner.get_page(key);
         let handle: SchedulerHandle = SchedulerHandle::new(key, page.clone());
@@ -110,26 +197,61 @@ impl Scheduler {
 
     /// Insert a new task into our scheduler returning a handle corresponding to it.
     pub fn insert<F: SchedulerFuture>(&self, future: F) -> Option<SchedulerHandle> {
-        let mut inner: RefMut<Inner<Box<dyn SchedulerFuture>>> = self.inner.borrow_mut();
-        let key: u64 = inner.insert(Box::new(future))?;
+        let mut inner: RefMut<Inner<Task>> = self.inner.borrow_mut();
+        let key: u64 = inner.insert(Box::new_in(future, TaskAllocator))?;
         let (page, _): (&WakerPageRef, usize) = inner.get_page(key);
         Some(SchedulerHandle::new(key, page.clone()))
     }
 
+    /// Visits exported tasks that have completed, in order of completion. The visitor returns `true` to signal that it
+    /// will take out the task (and thus that it should be removed from the list of completed tasks) or `false` to leave
+    /// the task for a later visit. The visitor should not call back into the target scheduler.
+    pub fn for_each_completed<F: FnMut(u64) -> bool>(&self, mut visitor: F) {
+        let mut inner: RefMut<Inner<Task>> = self.inner.borrow_mut();
+        for _ in 0..inner.completed.len() {
+            let (key, generation): (u64, u32) = match inner.completed.pop_front() {
+                Some(entry) => entry,
+                None => break,
+            };
+            // Drop stale entries.
+            if !inner.is_completed(key, generation) {
+                continue;
+            }
+            if !visitor(key) {
+                inner.completed.push_back((key, generation));
+            }
+        }
+    }
+
+    /// Returns true if some task was notified or dropped since the last poll operation, and thus requires attention.
+    pub fn has_ready(&self) -> bool {
+        !self.inner.borrow().summary.is_empty()
+    }
+
     /// Poll all futures which are ready to run again. Tasks in our scheduler are notified when
     /// relevant data or events happen. The relevant event have callback function (the waker) which
     /// they can invoke to notify the scheduler that future should be polled again.
-    pub fn poll(&self) {
-        let mut inner: RefMut<Inner<Box<dyn SchedulerFuture>>> = self.inner.borrow_mut();
+    ///
+    /// Only pages that are flagged in the summary are visited, thus the cost of this operation does not depend on the
+    /// number of idle tasks. Returns whether any task was polled.
+    pub fn poll(&self) -> bool {
+        let mut inner: RefMut<Inner<Task>> = self.inner.borrow_mut();
+        let mut polled: bool = false;
+
+        // Take out pages that have notified or dropped tasks. Pages that get flagged while we poll are left for the
+        // next poll operation.
+        let mut ready_pages: Vec<usize> = mem::take(&mut inner.ready_pages);
+        inner.summary.take(&mut ready_pages);
 
         // Iterate through pages.
-        for page_ix in 0..inner.pages.len() {
+        for page_ix in ready_pages.drain(..) {
             let (notified, dropped): (u64, u64) = {
                 let page: &mut WakerPageRef = &mut inner.pages[page_ix];
                 (page.take_notified(), page.take_dropped())
             };
             // There is some notified task in this page, so iterate through it.
             if notified != 0 {
+                polled = true;
                 for subpage_ix in BitIter::from(notified) {
                     // Handle notified tasks only.
                     // Get future using our page indices and poll it!
@@ -140,7 +262,7 @@ impl Scheduler {
                     };
                     let mut sub_ctx: Context = Context::from_waker(&waker);
 
-                    let pinned_ref: Pin<&mut Box<dyn SchedulerFuture>> = inner.slab.get_pin_mut(ix).unwrap();
+                    let pinned_ref: Pin<&mut Task> = inner.slab.get_pin_mut(ix).unwrap();
                     let pinned_ptr = unsafe { Pin::into_inner_unchecked(pinned_ref) as *mut _ };
 
                     // Poll future.
@@ -150,7 +272,12 @@ impl Scheduler {
                     inner = self.inner.borrow_mut();
 
                     match poll_result {
-                        Poll::Ready(()) => inner.pages[page_ix].mark_completed(subpage_ix),
+                        Poll::Ready(()) => {
+                            inner.pages[page_ix].mark_completed(subpage_ix);
+                            if inner.pages[page_ix].was_exported(subpage_ix) {
+                                inner.push_completed(ix as u64);
+                            }
+                        },
                         Poll::Pending => (),
                     }
                 }
@@ -163,10 +290,14 @@ impl Scheduler {
                         let ix: usize = (page_ix << WAKER_BIT_LENGTH_SHIFT) + subpage_ix;
                         inner.slab.remove(ix);
                         inner.pages[page_ix].clear(subpage_ix);
+                        inner.retire(ix as u64);
                     }
                 }
             }
         }
+
+        inner.ready_pages = ready_pages;
+        polled
     }
 }
 
@@ -178,9 +309,14 @@ impl Scheduler {
 impl Default for Scheduler {
     /// Creates a scheduler with default values.
     fn default() -> Self {
-        let inner: Inner<Box<dyn SchedulerFuture>> = Inner {
+        let inner: Inner<Task> = Inner {
             slab: PinSlab::new(),
             pages: vec![],
+            summary: Rc::new(PageSummary::default()),
+            ready_pages: Vec::new(),
+            completed: VecDeque::new(),
+            generations: Vec::new(),
+            completed_cleanup_len: MIN_COMPLETED_CLEANUP_LEN,
         };
         Self {
             inner: Rc::new(RefCell::new(inner)),
@@ -194,15 +330,26 @@ impl Default for Scheduler {
 
 #[cfg(test)]
 mod tests {
-    use crate::scheduler::scheduler::{
-        Scheduler,
-        SchedulerFuture,
-        SchedulerHandle,
+    use crate::{
+        runtime::memory::{
+            heap_pool_stats,
+            HeapPoolStats,
+        },
+        scheduler::scheduler::{
+            Scheduler,
+            SchedulerFuture,
+            SchedulerHandle,
+        },
     };
     use ::std::{
         any::Any,
+        cell::{
+            Cell,
+            RefCell,
+        },
         future::Future,
         pin::Pin,
+        rc::Rc,
         task::{
             Context,
             Poll,
@@ -252,6 +399,67 @@ mod tests {
         }
     }
 
+    /// A future that never completes and that only records the waker of its last poll.
+    struct IdleFuture {
+        polls: Rc<Cell<usize>>,
+        waker: Rc<RefCell<Option<Waker>>>,
+    }
+
+    impl Future for IdleFuture {
+        type Output = ();
+
+        fn poll(self: Pin<&mut Self>, ctx: &mut Context) -> Poll<Self::Output> {
+            self.polls.set(self.polls.get() + 1);
+            *self.waker.borrow_mut() = Some(ctx.waker().clone());
+            Poll::Pending
+        }
+    }
+
+    impl SchedulerFuture for IdleFuture {
+        fn as_any(self: Box<Self>) -> Box<dyn Any> {
+            self
+        }
+
+        fn get_future(&self) -> &dyn Future<Output = ()> {
+            todo!()
+        }
+    }
+
+    /// Inserts `n` idle futures in `scheduler`, and polls all of them once.
+    fn insert_idle(scheduler: &Scheduler, n: usize) -> Vec<SchedulerHandle> {
+        let polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let waker: Rc<RefCell<Option<Waker>>> = Rc::new(RefCell::new(None));
+        let mut handles: Vec<SchedulerHandle> = Vec::<SchedulerHandle>::with_capacity(n);
+        for _ in 0..n {
+            let future: IdleFuture = IdleFuture {
+                polls: polls.clone(),
+                waker: waker.clone(),
+            };
+            let handle: SchedulerHandle = match scheduler.insert(future) {
+                Some(handle) => handle,
+                None => panic!("insert() failed"),
+            };
+            handles.push(handle);
+        }
+        scheduler.poll();
+        handles
+    }
+
+    /// Runs a short-lived task through `scheduler`, as a push or pop operation would.
+    fn run_task(scheduler: &Scheduler, val: usize) -> DummyFuture {
+        let handle: SchedulerHandle = scheduler.insert(DummyFuture::new(val)).expect("insert() failed");
+        let key: u64 = handle.into_raw();
+        scheduler.poll();
+        let handle: SchedulerHandle = scheduler.from_raw_handle(key).expect("invalid key");
+        assert_eq!(handle.has_completed(), true);
+        scheduler.take(handle)
+    }
+
+    /// Returns the number of allocations that the heap pool of the current thread could not serve.
+    fn heap_pool_misses() -> u64 {
+        heap_pool_stats().iter().map(|stats: &HeapPoolStats| stats.misses).sum()
+    }
+
     #[bench]
     fn bench_scheduler_insert(b: &mut Bencher) {
         let scheduler: Scheduler = Scheduler::default();
@@ -306,6 +514,167 @@ mod tests {
         assert_eq!(handle.has_completed(), true);
     }
 
+    #[test]
+    fn scheduler_for_each_completed() {
+        let scheduler: Scheduler = Scheduler::default();
+
+        // Insert a background future and two exported futures in the scheduler.
+        // The first exported future takes two poll operations to complete.
+        let background: SchedulerHandle = scheduler.insert(DummyFuture::new(0)).expect("insert() failed");
+        let slow: u64 = scheduler
+            .insert(DummyFuture::new(1))
+            .expect("insert() failed")
+            .into_raw();
+        let fast: u64 = scheduler
+            .insert(DummyFuture::new(2))
+            .expect("insert() failed")
+            .into_raw();
+
+        // Only exported futures should be listed, in order of completion.
+        scheduler.poll();
+        scheduler.poll();
+        assert_eq!(background.has_completed(), true);
+        let mut completed: Vec<u64> = Vec::new();
+        scheduler.for_each_completed(|key| {
+            completed.push(key);
+            false
+        });
+        assert_eq!(completed, vec![fast, slow]);
+
+        // Take out the fast future, and leave the slow one.
+        scheduler.for_each_completed(|key| key == fast);
+        let handle: SchedulerHandle = scheduler.from_raw_handle(fast).expect("invalid key");
+        let _: DummyFuture = scheduler.take(handle);
+        let mut completed: Vec<u64> = Vec::new();
+        scheduler.for_each_completed(|key| {
+            completed.push(key);
+            false
+        });
+        assert_eq!(completed, vec![slow]);
+
+        // Futures that are taken out by other means should be eventually forgotten.
+        let handle: SchedulerHandle = scheduler.from_raw_handle(slow).expect("invalid key");
+        let _: DummyFuture = scheduler.take(handle);
+        scheduler.for_each_completed(|_| panic!("no future should be listed"));
+    }
+
+    #[test]
+    fn scheduler_for_each_completed_reused_keys() {
+        let scheduler: Scheduler = Scheduler::default();
+
+        // Complete an exported future, and take it out without visiting it, as demi_wait() does.
+        let first: u64 = scheduler
+            .insert(DummyFuture::new(0))
+            .expect("insert() failed")
+            .into_raw();
+        scheduler.poll();
+        let handle: SchedulerHandle = scheduler.from_raw_handle(first).expect("invalid key");
+        let _: DummyFuture = scheduler.take(handle);
+
+        // The next future reuses the key, and it should be listed once, so that demi_wait_next_n() takes it out once.
+        let second: u64 = scheduler
+            .insert(DummyFuture::new(0))
+            .expect("insert() failed")
+            .into_raw();
+        assert_eq!(second, first);
+        scheduler.poll();
+        let mut completed: Vec<u64> = Vec::new();
+        scheduler.for_each_completed(|key| {
+            completed.push(key);
+            true
+        });
+        assert_eq!(completed, vec![second]);
+        let handle: SchedulerHandle = scheduler.from_raw_handle(second).expect("invalid key");
+        let _: DummyFuture = scheduler.take(handle);
+        scheduler.for_each_completed(|_| panic!("no future should be listed"));
+    }
+
+    #[test]
+    fn scheduler_recycles_tasks() {
+        let scheduler: Scheduler = Scheduler::default();
+
+        // Warm up the scheduler, and check that tasks are taken out intact.
+        assert_eq!(run_task(&scheduler, 2).val, 2);
+
+        // Once warmed up, running tasks should not allocate.
+        let misses: u64 = heap_pool_misses();
+        for val in 0..1000 {
+            black_box(run_task(&scheduler, 2 * val));
+        }
+        assert_eq!(heap_pool_misses(), misses);
+    }
+
+    #[test]
+    fn scheduler_poll_skips_idle() {
+        let scheduler: Scheduler = Scheduler::default();
+        let polls: Rc<Cell<usize>> = Rc::new(Cell::new(0));
+        let waker: Rc<RefCell<Option<Waker>>> = Rc::new(RefCell::new(None));
+
+        // Insert futures that span multiple pages. All of them should be polled once.
+        let mut handles: Vec<SchedulerHandle> = Vec::<SchedulerHandle>::with_capacity(200);
+        for _ in 0..200 {
+            let future: IdleFuture = IdleFuture {
+                polls: polls.clone(),
+                waker: waker.clone(),
+            };
+            handles.push(scheduler.insert(future).expect("insert() failed"));
+        }
+        scheduler.poll();
+        assert_eq!(polls.get(), 200);
+
+        // No future was notified, so none of them should be polled again.
+        scheduler.poll();
+        assert_eq!(polls.get(), 200);
+
+        // Notify the last future. Only that one should be polled.
+        waker.borrow_mut().take().expect("no waker").wake();
+        scheduler.poll();
+        assert_eq!(polls.get(), 201);
+        scheduler.poll();
+        assert_eq!(polls.get(), 201);
+
+        // Dropped futures should still be removed.
+        drop(handles.pop());
+        scheduler.poll();
+        assert_eq!(polls.get(), 201);
+        assert!(scheduler.from_raw_handle(199).is_none());
+    }
+
+    #[bench]
+    fn bench_scheduler_run_task(b: &mut Bencher) {
+        let scheduler: Scheduler = Scheduler::default();
+
+        b.iter(|| {
+            black_box(run_task(&scheduler, 0));
+        });
+    }
+
+    #[bench]
+    fn bench_scheduler_poll_idle_1k(b: &mut Bencher) {
+        let scheduler: Scheduler = Scheduler::default();
+
+        // Insert 1024 futures in the scheduler. None of them will be notified again.
+        let handles: Vec<SchedulerHandle> = insert_idle(&scheduler, 1024);
+
+        b.iter(|| {
+            black_box(scheduler.poll());
+        });
+        drop(handles);
+    }
+
+    #[bench]
+    fn bench_scheduler_poll_idle_64k(b: &mut Bencher) {
+        let scheduler: Scheduler = Scheduler::default();
+
+        // Insert 65536 futures in the scheduler. None of them will be notified again.
+        let handles: Vec<SchedulerHandle> = insert_idle(&scheduler, 65536);
+
+        b.iter(|| {
+            black_box(scheduler.poll());
+        });
+        drop(handles);
+    }
+
     #[bench]
     fn bench_scheduler_poll(b: &mut Bencher) {
         let scheduler: Scheduler = Scheduler::default();
@@ -123,6 +123,43 @@ static bool inval_pop(void)
     return (demi_pop(qt, qd) != 0);
 }
 
+/**
+ * @brief Issues an invalid call to demi_push_batch().
+ */
+static bool inval_push_batch(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    demi_sgarray_t *sgas = NULL;
+    int n = -1;
+    int *nr = NULL;
+
+    return (demi_push_batch(qts, qds, sgas, n, nr) != 0);
+}
+
+/**
+ * @brief Issues an invalid call to demi_pop_batch().
+ */
+static bool inval_pop_batch(void)
+{
+    demi_qtoken_t *qts = NULL;
+    int *qds = NULL;
+    int n = -1;
+    int *nr = NULL;
+
+    return (demi_pop_batch(qts, qds, n, nr) != 0);
+}
+
+/**
+ * @brief Issues an invalid call to demi_get_stats().
+ */
+static bool inval_get_stats(void)
+{
+    demi_stats_t *stats = NULL;
+
+    return (demi_get_stats(stats) != 0);
+}
+
 /*===================================================================================================================*
  * System Calls in demi/sga.h                                                                                        *
  *===================================================================================================================*/
@@ -138,6 +175,18 @@ static bool inval_sgaalloc(void)
     return (sga.sga_buf == NULL);
 }
 
+/**
+ * @brief Issues an invalid call to demi_sgaalloc_qd().
+ */
+static bool inval_sgaalloc_qd(void)
+{
+    int qd = -1;
+    size_t len = 0;
+
+    demi_sgarray_t sga = demi_sgaalloc_qd(qd, len);
+    return (sga.sga_buf == NULL);
+}
+
 /**
  * @brief Issues an invalid call to demi_sgafree().
  */
@@ -190,6 +239,19 @@ static bool inval_wait_any(void)
     return (demi_wait_any(qr, ready_offset, qts, num_qts, timeout) != 0);
 }
 
+/**
+ * @brief Issues an invalid system call to demi_wait_next_n().
+ */
+static bool inval_wait_next_n(void)
+{
+    demi_qresult_t *qr = NULL;
+    int n = -1;
+    int *nr = NULL;
+    struct timespec *timeout = NULL;
+
+    return (demi_wait_next_n(qr, n, nr, timeout) != 0);
+}
+
 /*===================================================================================================================*
  * main()                                                                                                            *
  *===================================================================================================================*/
@@ -210,12 +272,16 @@ static struct test tests_libos[] = {{inval_socket, "invalid demi_socket()"},   {
                                     {inval_bind, "invalid demi_bind()"},       {inval_close, "invalid_demi_close()"},
                                     {inval_connect, "invalid demi_connect()"}, {inval_listen, "invalid demi_listen()"},
                                     {inval_pop, "invalid demi_pop()"},         {inval_push, "invalid demi_push()"},
-                                    {inval_pushto, "invalid demi_pushto()"}};
+                                    {inval_pushto, "invalid demi_pushto()"},
+                                    {inval_pop_batch, "invalid demi_pop_batch()"},
+                                    {inval_push_batch, "invalid demi_push_batch()"},
+                                    {inval_get_stats, "invalid demi_get_stats()"}};
 
 /**
  * @brief Tests for system calls in demi/sga.h
  */
 static struct test tests_sga[] = {{inval_sgaalloc, "invalid demi_sgaalloc()"},
+                                  {inval_sgaalloc_qd, "invalid demi_sgaalloc_qd()"},
                                   {inval_sgafree, "invalid demi_sgafree()"}};
 
 /**
@@ -223,7 +289,8 @@ static struct test tests_sga[] = {{inval_sgaalloc, "invalid demi_sgaalloc()"},
  */
 static struct test tests_wait[] = {{inval_timedwait, "invalid demi_timedwait()"},
                                    {inval_wait, "invalid demi_wait()"},
-                                   {inval_wait_any, "invalid demi_wait_any()"}};
+                                   {inval_wait_any, "invalid demi_wait_any()"},
+                                   {inval_wait_next_n, "invalid demi_wait_next_n()"}};
 
 /**
  * @brief Drives the application.
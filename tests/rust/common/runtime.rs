@@ -95,8 +95,11 @@ impl NetworkRuntime for DummyRuntime {
 
     fn receive(&self) -> ArrayVec<DemiBuffer, RECEIVE_BATCH_SIZE> {
         let mut out = ArrayVec::new();
-        if let Some(buf) = self.inner.borrow_mut().incoming.try_recv().ok() {
-            out.push(buf);
+        while !out.is_full() {
+            match self.inner.borrow_mut().incoming.try_recv() {
+                Ok(buf) => out.push(buf),
+                Err(_) => break,
+            }
         }
         out
     }
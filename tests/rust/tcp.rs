@@ -281,6 +281,56 @@ fn tcp_push_remote() {
     bob.join().unwrap();
 }
 
+/// Tests if data that arrives in the same batch as the ACK that completes the handshake is received.
+#[test]
+fn tcp_push_with_handshake_ack() {
+    let (alice_tx, alice_rx): (Sender<DemiBuffer>, Receiver<DemiBuffer>) = crossbeam_channel::unbounded();
+    let (bob_tx, bob_rx): (Sender<DemiBuffer>, Receiver<DemiBuffer>) = crossbeam_channel::unbounded();
+    let mut alice: InetStack = DummyLibOS::new(ALICE_MAC, ALICE_IPV4, alice_tx, bob_rx, arp());
+    let mut bob: InetStack = DummyLibOS::new(BOB_MAC, BOB_IPV4, bob_tx, alice_rx, arp());
+
+    let port: u16 = PORT_BASE;
+    let local: SocketAddrV4 = SocketAddrV4::new(ALICE_IPV4, port);
+
+    // Listen on Alice and connect from Bob: this exchanges the SYN and SYN+ACK segments.
+    let listen_qd: QDesc = safe_socket(&mut alice);
+    safe_bind(&mut alice, listen_qd, local);
+    safe_listen(&mut alice, listen_qd);
+    let accept_qt: QToken = safe_accept(&mut alice, listen_qd);
+    let sockqd: QDesc = safe_socket(&mut bob);
+    let connect_qt: QToken = safe_connect(&mut bob, sockqd, local);
+    bob.poll_bg_work();
+    alice.poll_bg_work();
+    match safe_wait2(&mut bob, connect_qt) {
+        (_, OperationResult::Connect) => (),
+        _ => panic!("connect() has failed"),
+    }
+
+    // Push data from Bob, so that it reaches Alice right behind the ACK of the SYN+ACK segment.
+    let bytes: DemiBuffer = DummyLibOS::cook_data(32);
+    let qt: QToken = safe_push2(&mut bob, sockqd, &bytes);
+    match safe_wait2(&mut bob, qt) {
+        (_, OperationResult::Push) => (),
+        _ => panic!("push() has failed"),
+    }
+
+    // Accept the connection and pop the data on Alice, without running Bob again, which would retransmit it.
+    let qd: QDesc = match safe_wait2(&mut alice, accept_qt) {
+        (_, OperationResult::Accept((qd, addr))) if addr.ip() == &BOB_IPV4 => qd,
+        _ => panic!("accept() has failed"),
+    };
+    let qt: QToken = safe_pop(&mut alice, qd);
+    match safe_wait2(&mut alice, qt) {
+        (_, OperationResult::Pop(_, buf)) => assert_eq!(buf.len(), bytes.len()),
+        (_, qr) => panic!("pop() has failed {:?}", qr),
+    }
+
+    // Close connection.
+    safe_close_active(&mut bob, sockqd);
+    safe_close_active(&mut alice, qd);
+    safe_close_passive(&mut alice, listen_qd);
+}
+
 //======================================================================================================================
 // Bad Socket
 //======================================================================================================================